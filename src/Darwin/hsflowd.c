@@ -512,8 +512,7 @@ extern "C" {
       // we'll call receiver_flush at the end of this tick/tock cycle,
       // and skip the sampler_tick() altogether.
       // sfl_agent_tick(sp->agent, clk);
-      for(SFLPoller *pl = sp->agent->pollers; pl; pl = pl->nxt)
-	sfl_poller_tick(pl, clk);
+      sfl_agent_tickPollers(sp->agent, clk);
     }
     // We can only get away with this scheme because the poller
     // objects are only ever removed and free by this thread.
@@ -70,19 +70,29 @@ extern "C" {
 	bus->events = UTHASH_NEW(EVEvent, name, UTHASH_SKEY);
 	bus->eventList = UTArrayNew(UTARRAY_DFLT);
 	bus->sockets = UTArrayNew(UTARRAY_PACK);
-	bus->sockets_run = UTArrayNew(UTARRAY_DFLT);
 	bus->sockets_del = UTArrayNew(UTARRAY_DFLT);
-	if(pipe(bus->pipe) == -1) {
-	  myLog(LOG_ERR, "pipe() failed : %s", strerror(errno));
+	// inter-bus events arrive on a lock-free ring.  The eventfd is
+	// only written when the ring goes from idle to busy (see eventTxRing).
+	bus->ring = UTMPSCNew(EVBUS_RING_LEN);
+	if((bus->doorbell = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+	  myLog(LOG_ERR, "eventfd() failed : %s", strerror(errno));
+	  abort();
+	}
+	// Sockets are registered with epoll as they come and go, so
+	// there is no per-iteration rebuild and no FD_SETSIZE limit.
+	// Level-triggered, so a readCB that only consumes part of
+	// what is waiting (e.g. EVSocketReadLines) is called again.
+	if((bus->epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+	  myLog(LOG_ERR, "epoll_create1() failed : %s", strerror(errno));
+	  abort();
+	}
+	// the doorbell is marked with a NULL socket pointer
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+	if(epoll_ctl(bus->epollFd, EPOLL_CTL_ADD, bus->doorbell, &ev) == -1) {
+	  myLog(LOG_ERR, "epoll_ctl(doorbell) failed : %s", strerror(errno));
 	  abort();
 	}
-	// possibly set pipe to non-blocking with fcntl
-	// but be aware that this may change the read/write behavior.
-	// We probably want it to block because a full pipe may
-	// indicate some sort of rare meltdown and losing events
-	// to EWOULDBLOCK could make things worse.
 
-	bus->select_mS = EVBUS_SELECT_MS_TICK;
 	bus->stop = NO;
       }
     }
@@ -132,9 +142,16 @@ extern "C" {
 	sock->readCB = readCB;
 	sock->module = mod;
 	sock->magic = magic;
-	UTHashAdd(mod->root->sockets, sock);
-	UTArrayAdd(bus->sockets, sock);
-	bus->socketsChanged = YES;
+	struct epoll_event ev = { .events = EPOLLIN, .data.ptr = sock };
+	if(epoll_ctl(bus->epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+	  myLog(LOG_ERR, "EVBusAddSocket: epoll_ctl(fd=%d) failed : %s", fd, strerror(errno));
+	  my_free(sock);
+	  sock = NULL;
+	}
+	else {
+	  UTHashAdd(mod->root->sockets, sock);
+	  UTArrayAdd(bus->sockets, sock);
+	}
       }
     }
     return sock;
@@ -147,6 +164,9 @@ extern "C" {
       deleted = UTHashDelKey(mod->root->sockets, &search);
       assert(deleted == sock);
       if(sock->fd > 0) {
+	// deregister before close, in case fd has been dup'd
+	if(epoll_ctl(sock->bus->epollFd, EPOLL_CTL_DEL, sock->fd, NULL) == -1)
+	  myDebug(1, "EVSocketClose: epoll_ctl(DEL, fd=%d) failed : %s", sock->fd, strerror(errno));
 	if(closeFD)
 	  while(close(sock->fd) == -1 && errno == EINTR);
 	sock->fd = 0;
@@ -176,8 +196,8 @@ extern "C" {
       evt->actionsChanged = YES;
     }
     if(my_strequal(evt->name, EVEVENT_DECI)) {
-      // shorten select timeout so we can deliver deciTicks
-      evt->bus->select_mS = EVBUS_SELECT_MS_DECI;
+      // wake up in time to deliver deciTicks
+      evt->bus->deciRx = YES;
     }
   }
 
@@ -254,67 +274,98 @@ extern "C" {
     return mod;
   }
 
-  static bool pipeRead(EVBus *bus, int fd, void *buf, size_t bytes) {
-    size_t expected = bytes;
-    while(expected) {
-      int n = read(fd, buf, expected);
-      if(n == 0) {
-	// indicates EOF
-	return NO;
-      }
-      else if(n < 0) {
-	if(errno != EAGAIN
-	   && errno == EINTR) {
-	  myLog(LOG_ERR, "bus %s readv(pipe) error: %s", bus->name, strerror(errno));
-	  return NO;
-	}
-      }
-      else {
-	expected -= n;
+  /*_________________---------------------------__________________
+    _________________    inter-bus event ring   __________________
+    -----------------___________________________------------------
+    Any thread can push onto a bus ring,  but only the bus thread
+    pops.  doorbellRung is YES from the first push after the bus
+    last drained until it drains again,  so a burst of events costs
+    one eventfd write and one wakeup.  Messages are allocated from
+    the system heap because they are freed on a different thread.
+  */
+
+  static void busRxRing(EVBus *bus) {
+    uint64_t rings;
+    while(read(bus->doorbell, &rings, sizeof(rings)) == -1 && errno == EINTR);
+    // clear before draining so a push that races with us rings again
+    __atomic_store_n(&bus->doorbellRung, NO, __ATOMIC_SEQ_CST);
+    uint32_t depth = UTMPSCDepth(bus->ring);
+    if(depth > bus->ringDepthMax)
+      bus->ringDepthMax = depth;
+    // take only what is there now so other sockets get a turn
+    for(uint32_t ii = 0; ii < depth; ii++) {
+      EVEventMsg *msg = (EVEventMsg *)UTMPSCPop(bus->ring);
+      if(msg == NULL)
+	break;
+      EVMod *mod;
+      EVEvent *evt;
+      SEMLOCK_DO(bus->root->sync) {
+	mod = UTArrayAt(bus->root->moduleList, msg->hdr.modId);
+	evt = UTArrayAt(bus->eventList, msg->hdr.eventId);
       }
+      EVEventTx(mod, evt, (msg->hdr.dataLen ? msg->data : NULL), msg->hdr.dataLen);
+      SYS_FREE(msg);
     }
-    return YES;
-  }
-
-  static int busRxPipe(EVBus *bus, int fd) {
-    EVEventHdr hdr = { 0 };
-    char data[PIPE_BUF];
-    if(pipeRead(bus, fd, &hdr, sizeof(hdr)) == NO)
-      return 0;
-    if(hdr.dataLen
-       && pipeRead(bus, fd, data, hdr.dataLen) == NO)
-      return 0;
-    data[hdr.dataLen] = '\0'; // NULL-terminate (convenient if string msg)
-    EVMod *mod;
-    EVEvent *evt;
-    SEMLOCK_DO(bus->root->sync) {
-      mod = UTArrayAt(bus->root->moduleList, hdr.modId);
-      evt = UTArrayAt(bus->eventList, hdr.eventId);
+    if(UTMPSCDepth(bus->ring)
+       && __atomic_exchange_n(&bus->doorbellRung, YES, __ATOMIC_SEQ_CST) == NO) {
+      uint64_t one = 1;
+      while(write(bus->doorbell, &one, sizeof(one)) == -1 && errno == EINTR);
     }
-    return EVEventTx(mod, evt, (hdr.dataLen ? data : NULL), hdr.dataLen);
   }
 
-  static bool eventTxPipe(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    EVEventHdr hdr = { .modId = mod->id,
-		       .eventId = evt->id,
-		       .dataLen = dataLen };
-    if((sizeof(hdr) + dataLen) > PIPE_BUF) {
-      myLog(LOG_ERR, "write() from mod %s to event pipe %s : msg too long(%u) => not atomic",
-	    mod->name,
-	    evt->name,
-	    dataLen);
+  static bool eventTxRing(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    EVBus *bus = evt->bus;
+    EVEventMsg *msg = (EVEventMsg *)SYS_CALLOC(1, sizeof(EVEventMsg) + dataLen + 1);
+    if(msg == NULL) {
+      myLog(LOG_ERR, "event %s from mod %s to bus %s: out of memory", evt->name, mod->name, bus->name);
       return NO;
     }
-
-    struct iovec vec[2] = { { &hdr, sizeof(hdr) }, { data, dataLen } };
-  try_again:
-    if(writev(evt->bus->pipe[1], vec, 2) > 0) {
-      // no partial writes for len <= PIPE_BUF
-      return YES;
+    msg->hdr.modId = mod->id;
+    msg->hdr.eventId = evt->id;
+    msg->hdr.dataLen = dataLen;
+    if(dataLen)
+      memcpy(msg->data, data, dataLen);
+    msg->data[dataLen] = '\0'; // NULL-terminate (convenient if string msg)
+    if(!UTMPSCPush(bus->ring, msg)) {
+      // Ring full. Wait for the bus to catch up rather than lose the
+      // event - just as a writer would block on a full pipe. A full ring
+      // probably means some sort of rare meltdown, and dropping events
+      // could make things worse.
+      __sync_fetch_and_add(&bus->ringOverflows, 1);
+      if(EVCurrentBus())
+	EVLog(60, LOG_ERR, "event ring full on bus %s (event %s from mod %s)", bus->name, evt->name, mod->name);
+      do {
+	my_usleep(1000);
+      } while(!UTMPSCPush(bus->ring, msg));
+    }
+    if(__atomic_exchange_n(&bus->doorbellRung, YES, __ATOMIC_SEQ_CST) == NO) {
+      uint64_t one = 1;
+      while(write(bus->doorbell, &one, sizeof(one)) == -1 && errno == EINTR);
     }
-    if(errno == EINTR) goto try_again;
-    myLog(LOG_ERR, "write() from mod %s to event pipe %s failed : %s", mod->name, evt->name, strerror(errno));
-    return NO;
+    return YES;
+  }
+
+  uint32_t EVBusRingDepth(EVBus *bus) {
+    return UTMPSCDepth(bus->ring);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    quiescent epochs       __________________
+    -----------------___________________________------------------
+    The epoch is bumped on the way into epoll_pwait() and again on the
+    way out,  so it is odd while the bus thread is parked and holds no
+    references from its callbacks.  Once the epoch has moved on from a
+    snapshot (or the snapshot was taken while parked) every callback
+    that might have seen the old data has returned.
+  */
+
+  uint32_t EVBusEpoch(EVBus *bus) {
+    return __atomic_load_n(&bus->epoch, __ATOMIC_SEQ_CST);
+  }
+
+  bool EVBusQuiesced(EVBus *bus, uint32_t epoch) {
+    return ((epoch & 1)
+	    || EVBusEpoch(bus) != epoch);
   }
 
   static void EVSocketFree(EVSocket *sock) {
@@ -344,8 +395,8 @@ extern "C" {
       }
     }
     else {
-      // inter-bus event goes on pipe for simple select() sync.
-      if(eventTxPipe(mod, evt, data, dataLen))
+      // inter-bus event goes on the destination bus ring
+      if(eventTxRing(mod, evt, data, dataLen))
   	sent++;
     }
     return sent;
@@ -375,40 +426,196 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________       timers              __________________
+    -----------------___________________________------------------
+    A binary min-heap per bus,  ordered by deadline.  Each timer
+    remembers its heap index so it can be cancelled in O(log N).
+  */
+
+  static bool timeBefore(struct timespec *t1, struct timespec *t2) {
+    return (t1->tv_sec < t2->tv_sec
+	    || (t1->tv_sec == t2->tv_sec
+		&& t1->tv_nsec < t2->tv_nsec));
+  }
+
+  static void timeAdd_mS(struct timespec *t, uint32_t mS) {
+    t->tv_sec += (mS / 1000);
+    EVTimeAdd_nS(t, (mS % 1000) * 1000000);
+  }
+
+  static void timerHeapPut(EVBus *bus, uint32_t idx, EVTimer *timer) {
+    bus->timers[idx] = timer;
+    timer->heapIdx = idx;
+  }
+
+  static void timerHeapUp(EVBus *bus, uint32_t idx) {
+    EVTimer *timer = bus->timers[idx];
+    while(idx > 0) {
+      uint32_t parent = (idx - 1) / 2;
+      if(!timeBefore(&timer->due, &bus->timers[parent]->due))
+	break;
+      timerHeapPut(bus, idx, bus->timers[parent]);
+      idx = parent;
+    }
+    timerHeapPut(bus, idx, timer);
+  }
+
+  static void timerHeapDown(EVBus *bus, uint32_t idx) {
+    EVTimer *timer = bus->timers[idx];
+    for(;;) {
+      uint32_t child = (2 * idx) + 1;
+      if(child >= bus->timers_n)
+	break;
+      if((child + 1) < bus->timers_n
+	 && timeBefore(&bus->timers[child + 1]->due, &bus->timers[child]->due))
+	child++;
+      if(!timeBefore(&bus->timers[child]->due, &timer->due))
+	break;
+      timerHeapPut(bus, idx, bus->timers[child]);
+      idx = child;
+    }
+    timerHeapPut(bus, idx, timer);
+  }
+
+  static void timerInsert(EVBus *bus, EVTimer *timer) {
+    if(bus->timers_n == bus->timers_siz) {
+      bus->timers_siz = bus->timers_siz ? (bus->timers_siz * 2) : EVBUS_TIMERS_MINSIZ;
+      bus->timers = (EVTimer **)my_realloc(bus->timers, bus->timers_siz * sizeof(EVTimer *));
+    }
+    timerHeapPut(bus, bus->timers_n++, timer);
+    timerHeapUp(bus, timer->heapIdx);
+  }
+
+  static void timerRemove(EVBus *bus, EVTimer *timer) {
+    uint32_t idx = timer->heapIdx;
+    EVTimer *last = bus->timers[--bus->timers_n];
+    timer->heapIdx = -1;
+    if(last != timer) {
+      // move the last one into the gap and restore heap order
+      timerHeapPut(bus, idx, last);
+      timerHeapUp(bus, idx);
+      timerHeapDown(bus, last->heapIdx);
+    }
+  }
+
+  EVTimer *EVTimerAdd(EVMod *mod, EVBus *bus, uint32_t delay_mS, uint32_t period_mS, EVTimerCB timerCB, void *magic) {
+    assert(bus->running == NO || EVCurrentBus() == bus);
+    EVTimer *timer = (EVTimer *)my_calloc(sizeof(EVTimer));
+    timer->bus = bus;
+    timer->module = mod;
+    timer->timerCB = timerCB;
+    timer->magic = magic;
+    timer->period_mS = period_mS;
+    EVClockMono(&timer->due);
+    timeAdd_mS(&timer->due, delay_mS);
+    timerInsert(bus, timer);
+    return timer;
+  }
+
+  void EVTimerCancel(EVTimer *timer) {
+    EVBus *bus = timer->bus;
+    assert(bus->running == NO || EVCurrentBus() == bus);
+    if(timer->running) {
+      // cancelled from its own callback - free it when that returns
+      timer->cancelled = YES;
+      return;
+    }
+    if(timer->heapIdx >= 0)
+      timerRemove(bus, timer);
+    my_free(timer);
+  }
+
+  static void busRunTimers(EVBus *bus) {
+    while(bus->timers_n) {
+      EVTimer *timer = bus->timers[0];
+      if(timeBefore(&bus->now, &timer->due))
+	break;
+      timerRemove(bus, timer);
+      timer->running = YES;
+      (*timer->timerCB)(timer->module, timer, timer->magic);
+      timer->running = NO;
+      if(timer->period_mS
+	 && !timer->cancelled) {
+	timeAdd_mS(&timer->due, timer->period_mS);
+	// if we fell behind then skip ahead rather than firing in a burst
+	if(timeBefore(&timer->due, &bus->now)) {
+	  timer->due = bus->now;
+	  timeAdd_mS(&timer->due, timer->period_mS);
+	}
+	timerInsert(bus, timer);
+      }
+      else {
+	my_free(timer);
+      }
+    }
+  }
+
+  static int clockResolution_mS(void) {
+    clockid_t monoClock = CLOCK_MONOTONIC;
+#ifdef CLOCK_MONOTONIC_COARSE
+    monoClock = CLOCK_MONOTONIC_COARSE;
+#endif
+    struct timespec res = {};
+    clock_getres(monoClock, &res);
+    int res_mS = (res.tv_sec * 1000) + ((res.tv_nsec + 999999) / 1000000);
+    return (res_mS > 0) ? res_mS : 1;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     busTimeout_mS         __________________
+    -----------------___________________________------------------
+    Sleep until the next deadline: the next deci (if anyone is
+    listening for it) or tick, or the next timer - whichever
+    comes first.  A tick is sent once now_deci is more than 1S
+    past now_tick,  so the next one is due 1.1S after now_tick.
+  */
+
+  static int busTimeout_mS(EVBus *bus) {
+    struct timespec deadline;
+    if(bus->deciRx) {
+      deadline = bus->now_deci;
+      EVTimeAdd_nS(&deadline, 100000000);
+    }
+    else {
+      deadline = bus->now_tick;
+      deadline.tv_sec++;
+      EVTimeAdd_nS(&deadline, 100000000);
+    }
+    if(bus->timers_n
+       && timeBefore(&bus->timers[0]->due, &deadline))
+      deadline = bus->timers[0]->due;
+    // Round up by the clock resolution,  so that we wake after the deadline
+    // as EVClockMono() will see it, rather than spinning just before it.
+    static int clockRes_mS;
+    if(clockRes_mS == 0)
+      clockRes_mS = clockResolution_mS();
+    int timeout_mS = EVTimeDiff_mS(&bus->now, &deadline) + clockRes_mS;
+    return (timeout_mS > 0) ? timeout_mS : 0;
+  }
+
   static void busRead(EVBus *bus) {
     EVSocket *sock;
-    fd_set readfds;
-    FD_ZERO(&readfds);
     sigset_t emptyset;
     sigemptyset(&emptyset);
-    int max_fd = 0;
-    // the input pipe
-    FD_SET(bus->pipe[0], &readfds);
-    max_fd = bus->pipe[0];
-    // and other registered sockets
+    // sockets closed since last time can be freed now.  Any
+    // events still referring to them were consumed last time.
     if(bus->socketsChanged) {
       SEMLOCK_DO(bus->root->sync) {
-	UTArrayReset(bus->sockets_run);
-	UTArrayAddAll(bus->sockets_run, bus->sockets);
 	UTARRAY_WALK(bus->sockets_del, sock) EVSocketFree(sock);
 	UTArrayReset(bus->sockets_del);
 	bus->socketsChanged = NO;
       }
     }
-    UTARRAY_WALK(bus->sockets_run, sock) {
-      FD_SET(sock->fd, &readfds);
-      if(sock->fd > max_fd)
-	max_fd = sock->fd;
-    }
-    struct timespec timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_nsec = bus->select_mS * 1000000;
-    int nfds = pselect(max_fd + 1,
-		       &readfds,
-		       (fd_set *)NULL,
-		       (fd_set *)NULL,
-		       &timeout,
-		       &emptyset);
+    struct epoll_event events[EVBUS_EPOLL_MAX_EVENTS];
+    EVClockMono(&bus->now);
+    __atomic_add_fetch(&bus->epoch, 1, __ATOMIC_SEQ_CST); // parked
+    int nfds = epoll_pwait(bus->epollFd,
+			   events,
+			   EVBUS_EPOLL_MAX_EVENTS,
+			   busTimeout_mS(bus),
+			   &emptyset);
+    __atomic_add_fetch(&bus->epoch, 1, __ATOMIC_SEQ_CST); // running
 
     // update clock - monotonic so that it is
     // safe to set timeouts in the future...
@@ -416,18 +623,23 @@ extern "C" {
 
     // see if we got anything
     if(nfds > 0) {
-      if(FD_ISSET(bus->pipe[0], &readfds))
-	busRxPipe(bus, bus->pipe[0]);
-      UTARRAY_WALK(bus->sockets_run, sock) {
-	if(FD_ISSET(sock->fd, &readfds))
+      for(int ii = 0; ii < nfds; ii++) {
+	sock = (EVSocket *)events[ii].data.ptr;
+	if(sock == NULL)
+	  busRxRing(bus);
+	else if(sock->fd > 0) {
+	  // skip if closed by an earlier callback in this batch.
+	  // Treat EPOLLHUP and EPOLLERR as readable, as select() did,
+	  // so the readCB sees the EOF or error.
 	  (*sock->readCB)(sock->module, sock, sock->magic);
+	}
       }
     }
     else if(nfds < 0) {
       // may return prematurely if a signal was caught, in which case nfds will be
       // -1 and errno will be set to EINTR.  If we get any other error, abort.
       if(errno != EINTR) {
-	myLog(LOG_ERR, "bus %s select() returned %d : %s", bus->name, nfds, strerror(errno));
+	myLog(LOG_ERR, "bus %s epoll_pwait() returned %d : %s", bus->name, nfds, strerror(errno));
 	abort();
       }
     }
@@ -475,6 +687,10 @@ extern "C" {
     EVEvent *final = EVGetEvent(bus, EVEVENT_FINAL);
     EVEvent *end = EVGetEvent(bus, EVEVENT_END);
 
+    // start the tick/deci clocks from now
+    EVClockMono(&bus->now);
+    bus->now_tick = bus->now_deci = bus->now;
+
     EVEventTx(mod, start, NULL, 0);
 
     for(;;) {
@@ -487,6 +703,8 @@ extern "C" {
 
       busRead(bus);
 
+      busRunTimers(bus);
+
       // Detect tick/deci boundaries.
       // These tick/tock/deci events used to skip if something
       // blocked for too long in this thread, but not any longer.
@@ -25,6 +25,8 @@ extern "C" {
 #include <dlfcn.h>
 #include <limits.h> // for PIPE_BUF
 #include <signal.h> // for sigemptyset()
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "util.h"
 
@@ -53,6 +55,7 @@ extern "C" {
 #define EVROOTDATA(m) (m)->root->rootModule->data
 
   struct _EVSocket; // fwd decl
+  struct _EVTimer; // fwd decl
 
   typedef struct _EVLogMsg {
     char *msg;
@@ -65,13 +68,24 @@ extern "C" {
     char *name;
     UTHash *events;
     UTArray *eventList;
-    int pipe[2];
+    // inter-bus events: lock-free ring plus eventfd doorbell
+    UTMPSC *ring;
+    int doorbell;
+    int doorbellRung;
+    uint64_t ringOverflows;
+    uint32_t ringDepthMax;
+    // quiescent-state epoch:  odd while parked in epoll_pwait()
+    uint32_t epoch;
+    int epollFd;
     UTArray *sockets;
-    UTArray *sockets_run;
     UTArray *sockets_del;
-    int select_mS;
-#define EVBUS_SELECT_MS_TICK 599
-#define EVBUS_SELECT_MS_DECI 59
+    // timers: binary min-heap ordered by deadline
+    struct _EVTimer **timers;
+    uint32_t timers_n;
+    uint32_t timers_siz;
+#define EVBUS_TIMERS_MINSIZ 16
+#define EVBUS_EPOLL_MAX_EVENTS 64
+#define EVBUS_RING_LEN 4096
     struct timespec now;
     struct timespec now_tick;
     struct timespec now_deci;
@@ -81,6 +95,7 @@ extern "C" {
     bool socketsChanged:1;
     bool running:1;
     bool stop:1;
+    bool deciRx:1; // someone wants deci events
   } EVBus;
 
   typedef void (*EVReadCB)(EVMod *mod, struct _EVSocket *sock, void *magic);
@@ -98,6 +113,20 @@ extern "C" {
     bool errOut;
   } EVSocket;
 
+  typedef void (*EVTimerCB)(EVMod *mod, struct _EVTimer *timer, void *magic);
+
+  typedef struct _EVTimer {
+    EVBus *bus;
+    EVMod *module;
+    EVTimerCB timerCB;
+    void *magic;
+    struct timespec due;
+    uint32_t period_mS; // 0 == one-shot
+    int heapIdx; // -1 when not queued
+    bool running:1;
+    bool cancelled:1;
+  } EVTimer;
+
   struct _EVAction; // fwd decl
 
   typedef struct _EVEvent {
@@ -130,6 +159,14 @@ extern "C" {
     uint32_t dataLen;
   } EVEventHdr;
 
+  // inter-bus event as queued on the destination bus ring
+  typedef struct _EVEventMsg {
+    EVEventHdr hdr;
+    char data[0]; // dataLen bytes + NUL
+  } EVEventMsg;
+
+  // Inter-bus events are no longer limited to this size, but it remains
+  // a convenient bound for config-line and read-line buffers.
 #define EV_MAX_EVT_DATALEN (PIPE_BUF - sizeof(EVEventHdr))
 
   EVMod *EVInit(void *data);
@@ -145,6 +182,19 @@ extern "C" {
   EVSocket *EVBusAddSocket(EVMod *mod, EVBus *bus, int fd, EVReadCB readCB, void *magic);
   bool EVSocketClose(EVMod *mod, EVSocket *sock, bool closeFD);
   void EVClockMono(struct timespec *ts);
+  uint32_t EVBusRingDepth(EVBus *bus);
+  // For deferred frees of data that other bus threads read without a
+  // lock:  take the epoch after unpublishing the data,  and free it once
+  // EVBusQuiesced() says the bus cannot still be holding a reference.
+  uint32_t EVBusEpoch(EVBus *bus);
+  bool EVBusQuiesced(EVBus *bus, uint32_t epoch);
+  // Timers run in the bus thread, and must only be added or cancelled
+  // from that thread (or before the bus is running). A one-shot timer
+  // (period_mS == 0) is freed after its callback returns, so don't hold
+  // on to it after that. A repeating timer runs until cancelled. It is
+  // OK to cancel a timer from its own callback.
+  EVTimer *EVTimerAdd(EVMod *mod, EVBus *bus, uint32_t delay_mS, uint32_t period_mS, EVTimerCB timerCB, void *magic);
+  void EVTimerCancel(EVTimer *timer);
 
 #define EVSOCKETREADLINE_INCBYTES EV_MAX_EVT_DATALEN
 
@@ -1249,6 +1249,12 @@ extern "C" {
 	  case HSPTOKEN_FORGET_VMS:
 	    if((tok = expectInteger32(sp, tok, &sp->forgetVMSecs, 60, 0xFFFFFFFF)) == NULL) return NO;
 	    break;
+	  case HSPTOKEN_PACKETBUSSHARDS:
+	    if((tok = expectInteger32(sp, tok, &sp->packetBusShards, 1, HSP_MAX_PACKET_BUS_SHARDS)) == NULL) return NO;
+	    break;
+	  case HSPTOKEN_MAXPOLLSPERTICK:
+	    if((tok = expectInteger32(sp, tok, &sp->maxPollsPerTick, 0, 0xFFFFFFFF)) == NULL) return NO;
+	    break;
 	    // ======================================================================
 	  case HSPTOKEN_DNS_SD:
 	    if((tok = expectToken(sp, tok, HSPTOKEN_STARTOBJ)) == NULL) return NO;
@@ -1558,6 +1564,9 @@ extern "C" {
 	    case HSPTOKEN_CGROUP_TRAFFIC:
 	      if((tok = expectONOFF(sp, tok, &sp->docker.markTraffic)) == NULL) return NO;
 	      break;
+	    case HSPTOKEN_CGROUP_STATS:
+	      if((tok = expectONOFF(sp, tok, &sp->docker.cgroupStats)) == NULL) return NO;
+	      break;
 	    default:
 	      unexpectedToken(sp, tok, level[depth]);
 	      return NO;
@@ -1667,6 +1676,9 @@ extern "C" {
 	      if((tok = expectONOFF(sp, tok, &pc->vport)) == NULL) return NO;
 	      pc->vport_set = YES;
 	      break;
+	    case HSPTOKEN_RING:
+	      if((tok = expectONOFF(sp, tok, &pc->ring)) == NULL) return NO;
+	      break;
 	    case HSPTOKEN_SPEED:
 	      if((tok = expectIntegerRange64(sp, tok, &pc->speed_min, &pc->speed_max, 0, LLONG_MAX)) == NULL) return NO;
 	      pc->speed_set = YES;
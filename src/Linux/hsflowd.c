@@ -40,13 +40,98 @@ extern "C" {
     myLog(LOG_ERR, "sflow agent error: %s", msg);
   }
 
+  /*_________________---------------------------__________________
+    _________________     flushDatagrams        __________________
+    -----------------___________________________------------------
+    Finished datagrams are queued by agentCB_sendPkt() and sent here
+    with one sendmmsg() per collector socket.  Caller must hold
+    sp->sync_agent.  The send is non-blocking so that a slow collector
+    path cannot stall the encoder - if the socket buffer is full the
+    rest of the batch is dropped and counted.
+  */
+
+  static void sendDatagrams(HSP *sp, HSPCollector *coll, HSPSendQ *sendQ)
+  {
+    struct mmsghdr msgs[HSP_SENDQ_LEN];
+    struct iovec iovs[HSP_SENDQ_LEN];
+    memset(msgs, 0, sizeof(msgs));
+    for(uint32_t ii = 0; ii < sendQ->n; ii++) {
+      iovs[ii].iov_base = sendQ->pkts + (ii * SFL_MAX_DATAGRAM_SIZE);
+      iovs[ii].iov_len = sendQ->pktLen[ii];
+      msgs[ii].msg_hdr.msg_iov = &iovs[ii];
+      msgs[ii].msg_hdr.msg_iovlen = 1;
+      msgs[ii].msg_hdr.msg_name = &coll->sendSocketAddr;
+      msgs[ii].msg_hdr.msg_namelen = coll->socklen;
+    }
+    uint32_t sent = 0;
+    while(sent < sendQ->n) {
+      int result = sendmmsg(coll->socket, msgs + sent, sendQ->n - sent, MSG_DONTWAIT);
+      if(result > 0) {
+	sent += result;
+	continue;
+      }
+      if(result == -1 && errno == EINTR)
+	continue;
+      char ipbuf[51];
+      SFLAddress_print(&coll->ipAddr, ipbuf, 50);
+      if(result == -1
+	 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+	uint32_t drops = sendQ->n - sent;
+	coll->sendDrops += drops;
+	HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_SEND_DROPS, drops);
+	EVLog(60, LOG_ERR, "collector %s: socket buffer full, dropped datagrams=%"PRIu64,
+	      ipbuf,
+	      coll->sendDrops);
+      }
+      else if(result == 0) {
+	EVLog(60, LOG_ERR, "collector %s: sendmmsg sent nothing", ipbuf);
+      }
+      else {
+	coll->sendErrors++;
+	HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_SEND_ERRORS);
+	EVLog(60, LOG_ERR, "collector %s: socket sendmmsg error: %s (errors=%"PRIu64")",
+	      ipbuf,
+	      strerror(errno),
+	      coll->sendErrors);
+	// We have the agent semaphore lock here, so it's safe
+	// to close and clear the socket, then set a countdown
+	// to try opening it again.
+	close(coll->socket);
+	coll->socket = 0;
+	sp->reopenCollectorSocketCountdown = HSP_RETRY_COLLECTOR_SOCKET;
+      }
+      break;
+    }
+  }
+
+  void flushDatagrams(HSP *sp)
+  {
+    HSPSendQ *sendQ = &sp->sendQ;
+    if(sendQ->n == 0)
+      return;
+    // note that we are relying on any new settings being installed atomically from the DNS-SD
+    // thread (it's just a pointer move,  so it should be atomic).
+    HSPSFlowSettings *settings = sp->sFlowSettings;
+    if(settings) {
+      for(HSPCollector *coll = settings->collectors; coll; coll=coll->nxt) {
+	if(coll->socklen && coll->socket > 0)
+	  sendDatagrams(sp, coll, sendQ);
+      }
+    }
+    sendQ->n = 0;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     agentCB_sendPkt       __________________
+    -----------------___________________________------------------
+    Called with sp->sync_agent held whenever the receiver has a full
+    datagram.  Queue it, and flush if the queue is full.  The rest are
+    flushed when the poll bus drains samples or at the end of the tock.
+  */
+
   static void agentCB_sendPkt(void *magic, SFLAgent *agent, SFLReceiver *receiver, u_char *pkt, uint32_t pktLen)
   {
     HSP *sp = (HSP *)magic;
-    // note that we are relying on any new settings being installed atomically from the DNS-SD
-    // thread (it's just a pointer move,  so it should be atomic).  Otherwise we would want to
-    // grab sp->sync whenever we call sfl_sampler_writeFlowSample(),  because that can
-    // bring us here where we read the list of collectors.
 
     if(sp->suppress_sendPkt)
       return;
@@ -54,30 +139,18 @@ extern "C" {
     if(sp->sFlowSettings == NULL)
       return;
 
-    sp->telemetry[HSP_TELEMETRY_DATAGRAMS]++;
-
-    for(HSPCollector *coll = sp->sFlowSettings->collectors; coll; coll=coll->nxt) {
-      if(coll->socklen && coll->socket > 0) {
-	int result = sendto(coll->socket,
-			    pkt,
-			    pktLen,
-			    0,
-			    (struct sockaddr *)&coll->sendSocketAddr,
-			    coll->socklen);
-	if(result == -1 && errno != EINTR) {
-	  EVLog(60, LOG_ERR, "socket sendto error: %s", strerror(errno));
-	  // We have the agent semaphore lock here, so it's safe
-	  // to close and clear the socket, then set a countdown
-	  // to try opening it again.
-	  close(coll->socket);
-	  coll->socket = 0;
-	  sp->reopenCollectorSocketCountdown = HSP_RETRY_COLLECTOR_SOCKET;
-	}
-	else if(result == 0) {
-	  EVLog(60, LOG_ERR, "socket sendto returned 0: %s", strerror(errno));
-	}
-      }
-    }
+    if(pktLen > SFL_MAX_DATAGRAM_SIZE)
+      return;
+
+    HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_DATAGRAMS);
+
+    HSPSendQ *sendQ = &sp->sendQ;
+    if(sendQ->pkts == NULL)
+      sendQ->pkts = (u_char *)my_calloc(HSP_SENDQ_LEN * SFL_MAX_DATAGRAM_SIZE);
+    memcpy(sendQ->pkts + (sendQ->n * SFL_MAX_DATAGRAM_SIZE), pkt, pktLen);
+    sendQ->pktLen[sendQ->n++] = pktLen;
+    if(sendQ->n == HSP_SENDQ_LEN)
+      flushDatagrams(sp);
   }
 
   /*_________________---------------------------__________________
@@ -133,6 +206,181 @@ extern "C" {
     return UTHashGet(sp->adaptorsByPeerIndex, &ad);
   }
 
+  /*_________________---------------------------__________________
+    _________________    ifIndex lookup map     __________________
+    -----------------___________________________------------------
+    takeSample() resolves ifIndex -> adaptor and the veth peer in the
+    global namespace for every packet. Rather than take the UTHASH_SYNC
+    locks on adaptorsByIndex and adaptorsByPeerIndex,  packet threads
+    read an immutable map that is rebuilt here on the poll bus and
+    published with an atomic pointer swap. Small ifIndex numbers are
+    direct-indexed. The rest go in an overflow hash. Retired maps are
+    freed after a grace period,  and so are the adaptors that were
+    deleted while they were live.  The grace period ends when every
+    packet bus has been back to epoll_pwait() (see EVBusQuiesced()),
+    since no packet callback holds a map entry across that.  An ifIndex
+    that is not in the map falls back on the hash tables,  so new
+    adaptors are found before the next rebuild.
+    Flags such as vm_or_container are set in place by the modules,  so
+    those are still read from the adaptor rather than copied here.
+  */
+
+  static HSPIfIndexEntry *ifIndexMapSlot(HSPIfIndexMap *map, uint32_t ifIndex) {
+    if(ifIndex < map->n_dense) {
+      HSPIfIndexEntry *entry = &map->dense[ifIndex];
+      entry->ifIndex = ifIndex;
+      return entry;
+    }
+    HSPIfIndexEntry search = { .ifIndex = ifIndex };
+    HSPIfIndexEntry *entry = UTHashGet(map->sparse, &search);
+    if(entry == NULL) {
+      entry = (HSPIfIndexEntry *)my_calloc(sizeof(HSPIfIndexEntry));
+      entry->ifIndex = ifIndex;
+      UTHashAdd(map->sparse, entry);
+    }
+    return entry;
+  }
+
+  static void freeAdaptors(UTArray *adaptors) {
+    SFLAdaptor *ad;
+    UTARRAY_WALK(adaptors, ad)
+      adaptorFree(ad);
+    UTArrayFree(adaptors);
+  }
+
+  static void ifIndexMapFree(HSPIfIndexMap *map) {
+    HSPIfIndexEntry *entry;
+    UTHASH_WALK(map->sparse, entry)
+      my_free(entry);
+    UTHashFree(map->sparse);
+    if(map->adaptors)
+      freeAdaptors(map->adaptors);
+    if(map->retired)
+      my_free(map->retired);
+    my_free(map->dense);
+    my_free(map);
+  }
+
+  void publishIfIndexMap(HSP *sp) {
+    HSPIfIndexMap *map = (HSPIfIndexMap *)my_calloc(sizeof(HSPIfIndexMap));
+    // size the dense part to fit the highest ifIndex below the limit
+    uint32_t maxIndex = 0;
+    SFLAdaptor *ad;
+    UTHASH_WALK(sp->adaptorsByIndex, ad) {
+      if(ad->ifIndex < HSP_IFINDEX_DENSE_MAX
+	 && ad->ifIndex > maxIndex)
+	maxIndex = ad->ifIndex;
+    }
+    UTHASH_WALK(sp->adaptorsByPeerIndex, ad) {
+      if(ad->peer_ifIndex < HSP_IFINDEX_DENSE_MAX
+	 && ad->peer_ifIndex > maxIndex)
+	maxIndex = ad->peer_ifIndex;
+    }
+    map->n_dense = maxIndex + 1;
+    map->dense = (HSPIfIndexEntry *)my_calloc(map->n_dense * sizeof(HSPIfIndexEntry));
+    map->sparse = UTHASH_NEW(HSPIfIndexEntry, ifIndex, UTHASH_DFLT);
+    UTHASH_WALK(sp->adaptorsByIndex, ad) {
+      ifIndexMapSlot(map, ad->ifIndex)->adaptor = ad;
+    }
+    UTHASH_WALK(sp->adaptorsByPeerIndex, ad) {
+      ifIndexMapSlot(map, ad->peer_ifIndex)->global = ad;
+    }
+    HSPIfIndexMap *old = __atomic_exchange_n(&sp->ifIndexMap, map, __ATOMIC_ACQ_REL);
+    // adaptors deleted since the last publish may be referenced by the
+    // old map (or were just looked up in the hash tables),  so they
+    // share its grace period
+    UTArray *deleted = sp->adaptorsRetiring;
+    sp->adaptorsRetiring = NULL;
+    if(old) {
+      // a packet thread may still be reading it,  so note where each
+      // packet bus is now and wait for them all to pass a quiescent point
+      if(sp->packetBuses) {
+	old->retired = (uint32_t *)my_calloc(sp->packetBusShards * sizeof(uint32_t));
+	for(uint32_t shard = 0; shard < sp->packetBusShards; shard++) {
+	  EVBus *bus = sp->packetBuses[shard];
+	  // a shard not created yet can't have seen this map
+	  old->retired[shard] = bus ? EVBusEpoch(bus) : 1;
+	}
+      }
+      old->adaptors = deleted;
+      old->nxt = sp->ifIndexMapRetired;
+      sp->ifIndexMapRetired = old;
+    }
+    else if(deleted)
+      freeAdaptors(deleted);
+    sp->ifIndexMapDirty = NO;
+  }
+
+  static bool ifIndexMapQuiesced(HSP *sp, HSPIfIndexMap *map) {
+    if(map->retired == NULL)
+      return YES; // no packet buses when it was retired
+    for(uint32_t shard = 0; shard < sp->packetBusShards; shard++) {
+      EVBus *bus = sp->packetBuses[shard];
+      if(bus
+	 && !EVBusQuiesced(bus, map->retired[shard]))
+	return NO;
+    }
+    return YES;
+  }
+
+  static void freeRetiredIfIndexMaps(HSP *sp) {
+    // newest first,  and epochs only move forward,  so once one map is
+    // safe to free so are all the older ones
+    HSPIfIndexMap **p_map = &sp->ifIndexMapRetired;
+    while(*p_map
+	  && !ifIndexMapQuiesced(sp, *p_map))
+      p_map = &(*p_map)->nxt;
+    HSPIfIndexMap *map = *p_map;
+    *p_map = NULL;
+    while(map) {
+      HSPIfIndexMap *nxt = map->nxt;
+      ifIndexMapFree(map);
+      map = nxt;
+    }
+  }
+
+  HSPIfIndexEntry *ifIndexLookup(HSP *sp, uint32_t ifIndex) {
+    HSPIfIndexMap *map = __atomic_load_n(&sp->ifIndexMap, __ATOMIC_ACQUIRE);
+    if(map == NULL)
+      return NULL;
+    if(ifIndex < map->n_dense) {
+      HSPIfIndexEntry *entry = &map->dense[ifIndex];
+      return (entry->adaptor || entry->global) ? entry : NULL;
+    }
+    HSPIfIndexEntry search = { .ifIndex = ifIndex };
+    return UTHashGet(map->sparse, &search);
+  }
+
+  SFLAdaptor *packetAdaptorByIndex(HSP *sp, uint32_t ifIndex) {
+    HSPIfIndexEntry *entry = ifIndexLookup(sp, ifIndex);
+    if(entry
+       && entry->adaptor)
+      return entry->adaptor;
+    return adaptorByIndex(sp, ifIndex);
+  }
+
+  SFLAdaptor *packetAdaptorByPeerIndex(HSP *sp, uint32_t ifIndex) {
+    HSPIfIndexEntry *entry = ifIndexLookup(sp, ifIndex);
+    if(entry
+       && entry->global)
+      return entry->global;
+    return adaptorByPeerIndex(sp, ifIndex);
+  }
+
+  static bool ifIndexMapRefers(HSP *sp, SFLAdaptor *ad) {
+    HSPIfIndexEntry *entry = ifIndexLookup(sp, ad->ifIndex);
+    if(entry
+       && entry->adaptor == ad)
+      return YES;
+    if(ad->peer_ifIndex) {
+      entry = ifIndexLookup(sp, ad->peer_ifIndex);
+      if(entry
+	 && entry->global == ad)
+	return YES;
+    }
+    return NO;
+  }
+
   SFLAdaptor *adaptorByIP(HSP *sp, SFLAddress *ip) {
     SFLAdaptor *adaptor;
     UTHASH_WALK(sp->adaptorsByName, adaptor) {
@@ -152,6 +400,14 @@ extern "C" {
     }
   }
 
+  static void retireAdaptor(HSP *sp, SFLAdaptor *ad) {
+    // packet threads may still hold it,  so free it only after
+    // the grace period of the map that is replaced next
+    if(sp->adaptorsRetiring == NULL)
+      sp->adaptorsRetiring = UTArrayNew(UTARRAY_DFLT);
+    UTArrayAdd(sp->adaptorsRetiring, ad);
+  }
+
   void deleteAdaptor(HSP *sp, SFLAdaptor *ad, int freeFlag) {
     if(sp->allowDeleteAdaptor == NO)
       return;
@@ -160,8 +416,11 @@ extern "C" {
     deleteAdaptorFromHT(sp->adaptorsByMac, ad, "byMac");
     if(ad->peer_ifIndex)
       deleteAdaptorFromHT(sp->adaptorsByPeerIndex, ad, "byPeerIndex");
+    // republished once per sweep or on the next tick
+    if(ifIndexMapRefers(sp, ad))
+      sp->ifIndexMapDirty = YES;
     if(freeFlag)
-      adaptorFree(ad);
+      retireAdaptor(sp, ad);
   }
 
   int deleteMarkedAdaptors(HSP *sp, UTHash *adaptorHT, int freeFlag) {
@@ -171,16 +430,34 @@ extern "C" {
       deleteAdaptor(sp, ad, freeFlag);
       found++;
     }
+    if(sp->ifIndexMapDirty)
+      publishIfIndexMap(sp);
     return found;
   }
 
   int deleteMarkedAdaptors_adaptorList(HSP *sp, SFLAdaptorList *adList) {
+    // deletes the marked adaptors from the hash tables and takes them
+    // out of adList too,  to be freed after the grace period
     int found = 0;
-    SFLAdaptor *ad;
-    ADAPTORLIST_WALK(adList, ad) if(ad->marked) {
-      deleteAdaptor(sp, ad, NO);
-      found++;
+    for(uint32_t ii = 0; ii < adList->num_adaptors; ii++) {
+      SFLAdaptor *ad = adList->adaptors[ii];
+      if(ad && ad->marked) {
+	deleteAdaptor(sp, ad, NO);
+	retireAdaptor(sp, ad);
+	adList->adaptors[ii] = NULL;
+	found++;
+      }
+    }
+    if(found) {
+      uint32_t kept = 0;
+      for(uint32_t ii = 0; ii < adList->num_adaptors; ii++) {
+	if(adList->adaptors[ii])
+	  adList->adaptors[kept++] = adList->adaptors[ii];
+      }
+      adList->num_adaptors = kept;
     }
+    if(sp->ifIndexMapDirty)
+      publishIfIndexMap(sp);
     return found;
   }
 
@@ -293,7 +570,7 @@ extern "C" {
     // host cpu counters
     SFLCounters_sample_element cpuElem = { 0 };
     cpuElem.tag = SFLCOUNTERS_HOST_CPU;
-    if(readCpuCounters(&cpuElem.counterBlock.host_cpu)) {
+    if(readCpuCounters(sp, &cpuElem.counterBlock.host_cpu)) {
       // remember speed and nprocs for other purposes
       sp->cpu_cores = cpuElem.counterBlock.host_cpu.cpu_num;
       sp->cpu_mhz = cpuElem.counterBlock.host_cpu.cpu_speed;
@@ -303,7 +580,7 @@ extern "C" {
     // host memory counters
     SFLCounters_sample_element memElem = { 0 };
     memElem.tag = SFLCOUNTERS_HOST_MEM;
-    if(readMemoryCounters(&memElem.counterBlock.host_mem)) {
+    if(readMemoryCounters(sp, &memElem.counterBlock.host_mem)) {
       // remember mem_total and mem_free for other purposes
       sp->mem_total = memElem.counterBlock.host_mem.mem_total;
       sp->mem_free = memElem.counterBlock.host_mem.mem_free;
@@ -361,7 +638,7 @@ extern "C" {
     SEMLOCK_DO(sp->sync_agent) {
       sfl_poller_writeCountersSample(poller, cs);
       sp->counterSampleQueued = YES;
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+      HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
     }
   }
 
@@ -476,9 +753,10 @@ extern "C" {
     if(state->volumes) strArrayFree(state->volumes);
     if(state->interfaces) {
       adaptorListMarkAll(state->interfaces);
-      // delete any hash-table references to these adaptors
+      // delete any hash-table references to these adaptors,  which
+      // are freed after the ifIndex map grace period
       deleteMarkedAdaptors_adaptorList(sp, state->interfaces);
-      // then free them along with the adaptorList itself
+      // then free the (now empty) adaptorList itself
       adaptorListFree(state->interfaces);
     }
     if(state->poller) {
@@ -521,16 +799,7 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  static void refreshAdaptorsAndAgentAddress(HSP *sp) {
-    uint32_t ad_added=0, ad_removed=0, ad_cameup=0, ad_wentdown=0, ad_changed=0;
-    if(readInterfaces(sp, YES, &ad_added, &ad_removed, &ad_cameup, &ad_wentdown, &ad_changed) == 0) {
-      myLog(LOG_ERR, "failed to re-read interfaces\n");
-    }
-    else {
-      myDebug(1, "interfaces added: %u removed: %u cameup: %u wentdown: %u changed: %u",
-	      ad_added, ad_removed, ad_cameup, ad_wentdown, ad_changed);
-    }
-
+  static void refreshAgentAddress(HSP *sp, uint32_t ad_added, uint32_t ad_removed, uint32_t ad_cameup, uint32_t ad_wentdown, uint32_t ad_changed) {
     int agentAddressChanged=NO;
     if(selectAgentAddress(sp, &agentAddressChanged) == NO) {
       myLog(LOG_ERR, "failed to re-select agent address\n");
@@ -554,15 +823,83 @@ extern "C" {
     }
   }
 
+  static void refreshAdaptorsAndAgentAddress(HSP *sp) {
+    uint32_t ad_added=0, ad_removed=0, ad_cameup=0, ad_wentdown=0, ad_changed=0;
+    if(readInterfaces(sp, YES, &ad_added, &ad_removed, &ad_cameup, &ad_wentdown, &ad_changed) == 0) {
+      myLog(LOG_ERR, "failed to re-read interfaces\n");
+    }
+    else {
+      myDebug(1, "interfaces added: %u removed: %u cameup: %u wentdown: %u changed: %u",
+	      ad_added, ad_removed, ad_cameup, ad_wentdown, ad_changed);
+    }
+    sp->ifIndexMapDirty = YES;
+    refreshAgentAddress(sp, ad_added, ad_removed, ad_cameup, ad_wentdown, ad_changed);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    readIntfEvents         __________________
+    -----------------___________________________------------------
+    rtnetlink told us about link or address changes. Apply them
+    incrementally,  or fall back on a full refresh if the kernel
+    had to drop some.
+  */
+
+  static void readIntfEvents(EVMod *mod, EVSocket *sock, void *magic) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    uint32_t ad_added=0, ad_removed=0, ad_cameup=0, ad_wentdown=0, ad_changed=0;
+    int msgs = readInterfaceEvents(sp, sock->fd, &ad_added, &ad_removed, &ad_cameup, &ad_wentdown, &ad_changed);
+    if(msgs < 0) {
+      sp->refreshAdaptorList = YES;
+      return;
+    }
+    if(msgs) {
+      sp->ifIndexMapDirty = YES;
+      myDebug(1, "interface events: %d msgs added: %u removed: %u cameup: %u wentdown: %u changed: %u",
+	      msgs, ad_added, ad_removed, ad_cameup, ad_wentdown, ad_changed);
+      refreshAgentAddress(sp, ad_added, ad_removed, ad_cameup, ad_wentdown, ad_changed);
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________       tick                __________________
     -----------------___________________________------------------
   */
 
+  static void updateBusTelemetry(HSP *sp) {
+    // inter-bus event rings: deepest seen on any bus, and total overflows
+    EVRoot *root = sp->rootModule->root;
+    uint32_t depthMax = 0;
+    uint64_t overflows = 0;
+    EVBus *bus;
+    SEMLOCK_DO(root->sync) {
+      UTHASH_WALK(root->buses, bus) {
+	if(bus->ringDepthMax > depthMax)
+	  depthMax = bus->ringDepthMax;
+	overflows += __atomic_load_n(&bus->ringOverflows, __ATOMIC_RELAXED);
+      }
+    }
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_EVENT_RING_DEPTH, depthMax);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_EVENT_RING_OVERFLOWS, overflows);
+#ifdef UTHEAP
+    // buffer recycling,  summed over the per-thread realms
+    UTHeapStats heap;
+    UTHeapGetStats(&heap);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_HEAP_REALMS, heap.realms);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_HEAP_BYTES, heap.bytes);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_HEAP_ALLOCS, heap.allocs);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_HEAP_REMOTE_FREES, heap.remoteFrees);
+#endif
+  }
+
   static void evt_poll_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
     HSP *sp = (HSP *)EVROOTDATA(mod);
     time_t clk = evt->bus->now.tv_sec;
 
+    // encode flow samples queued since the last deci
+    flushPendingSamples(sp);
+
+    updateBusTelemetry(sp);
+
     // reset the pollActions
     UTArrayReset(sp->pollActions);
 
@@ -582,8 +919,10 @@ extern "C" {
       // we'll call receiver_flush at the end of this tick/tock cycle,
       // and skip the sampler_tick() altogether.
       // sfl_agent_tick(sp->agent, clk);
-      for(SFLPoller *pl = sp->agent->pollers; pl; pl = pl->nxt)
-	sfl_poller_tick(pl, clk);
+      // The pollers are on a timer wheel,  so only the ones
+      // that are due this second are touched.
+      uint32_t fired = sfl_agent_tickPollers(sp->agent, clk);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_POLLERS_FIRED, fired);
       for(SFLNotifier *nf = sp->agent->notifiers; nf; nf = nf->nxt)
 	sfl_notifier_tick(nf, clk);
 
@@ -627,8 +966,10 @@ extern "C" {
     }
 
     // check for interface changes (relatively frequently)
-    // and request a full refresh if we find anything
-    if(clk >= sp->next_checkAdaptorList) {
+    // and request a full refresh if we find anything. Not
+    // needed if rtnetlink is telling us about changes.
+    if(sp->intfEvents == NULL
+       && clk >= sp->next_checkAdaptorList) {
       sp->next_checkAdaptorList = clk + sp->checkAdaptorListSecs;
       if(detectInterfaceChange(sp))
 	sp->refreshAdaptorList = YES;
@@ -642,6 +983,11 @@ extern "C" {
       refreshAdaptorsAndAgentAddress(sp);
     }
 
+    // republish the packet-thread view of the adaptor tables
+    if(sp->ifIndexMapDirty)
+      publishIfIndexMap(sp);
+    freeRetiredIfIndexMaps(sp);
+
     // rewrite the output if the config has changed
     if(sp->outputRevisionNo != sp->revisionNo) {
       syncOutputFile(sp);
@@ -668,6 +1014,8 @@ extern "C" {
       SEMLOCK_DO(sp->sync_agent) {
 	if(sp->counterSampleQueued) {
 	  sfl_receiver_flush(sp->agent->receivers);
+	  // the flush only queues the datagram,  so send it now too
+	  flushDatagrams(sp);
 	  sp->counterSampleQueued = NO;
 	}
       }
@@ -687,15 +1035,40 @@ extern "C" {
     // cycle in evbus.c if we really need to be sure).  Delaying the flush to
     // here makes it more likely that counters will be flushed out promptly
     // when they are freshly read.
+    flushPendingSamples(sp);
     SEMLOCK_DO(sp->sync_agent) {
       // note - this used to happen inside sfl_agent_tick(), but we
       // disaggregated that call so the pollers get their ticks first
       // and the receiver flush happens at the end.
       sfl_receiver_flush(sp->agent->receivers);
+      flushDatagrams(sp);
       sp->counterSampleQueued = NO;
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________        poll deci          __________________
+    -----------------___________________________------------------
+    The packet buses hand completed flow samples to the poll bus via
+    sp->sampleQ. Drain it every 100mS,  or sooner if a producer posts
+    HSPEVENT_FLUSH_SAMPLES because the queue is filling up.
+  */
+
+  static void evt_poll_deci(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    flushPendingSamples(sp);
+    // datagrams may also be queued by other buses (e.g. json, dropmon)
+    if(sp->sendQ.n) {
+      SEMLOCK_DO(sp->sync_agent)
+	flushDatagrams(sp);
+    }
+  }
+
+  static void evt_poll_flush_samples(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    flushPendingSamples(sp);
+  }
+
   /*_________________---------------------------__________________
     _________________     tock - all buses      __________________
     -----------------___________________________------------------
@@ -740,6 +1113,8 @@ extern "C" {
 		     agentCB_free,
 		     agentCB_error,
 		     agentCB_sendPkt);
+      // spread the pollers out evenly if asked to
+      sfl_agent_set_maxPollsPerTick(sp->agent, sp->maxPollsPerTick);
       // just one receiver - we are serious about making this lightweight for now
       SFLReceiver *receiver = sfl_agent_addReceiver(sp->agent);
 
@@ -772,6 +1147,7 @@ extern "C" {
     sp->checkAdaptorListSecs = HSP_CHECK_ADAPTORS;
     sp->refreshVMListSecs = HSP_REFRESH_VMS;
     sp->forgetVMSecs = HSP_FORGET_VMS;
+    sp->packetBusShards = 1;
     sp->modulesPath = STRINGIFY_DEF(HSP_MOD_DIR);
   }
 
@@ -903,6 +1279,9 @@ extern "C" {
       myLog(LOG_INFO,"Received SIGUSR2");
       // memory only - then keep going
       malloc_stats();
+#ifdef UTHEAP
+      UTHeapLogStats();
+#endif
       break;
     default:
       myLog(LOG_INFO,"Received signal %d", sig);
@@ -932,6 +1311,7 @@ extern "C" {
     // so that modules can weigh in if required,  and, for example, sampling-rates can be set
     // correctly.
     readInterfaces(sp, YES, NULL, NULL, NULL, NULL, NULL);
+    sp->ifIndexMapDirty = YES;
 
     // print some stats to help us size HSP_RLIMIT_MEMLOCK etc.
     if(debug(1))
@@ -1452,6 +1832,27 @@ extern "C" {
     return YES;
   }
 
+  static void raiseMyFileLimit(rlim_t request) {
+    // only the soft limit,  so we stay within what we were given
+    struct rlimit rlim = {0};
+    if(getrlimit(RLIMIT_NOFILE, &rlim) != 0) {
+      myLog(LOG_ERR, "getrlimit(RLIMIT_NOFILE) failed : %s", strerror(errno));
+      return;
+    }
+    if(rlim.rlim_max != RLIM_INFINITY
+       && request > rlim.rlim_max)
+      request = rlim.rlim_max;
+    if(request <= rlim.rlim_cur)
+      return;
+    rlim_t was = rlim.rlim_cur;
+    rlim.rlim_cur = request;
+    if(setrlimit(RLIMIT_NOFILE, &rlim) != 0) {
+      myLog(LOG_ERR, "setrlimit(RLIMIT_NOFILE)=%u failed : %s", (uint32_t)request, strerror(errno));
+      return;
+    }
+    myDebug(1, "setrlimit(RLIMIT_NOFILE)=%u (was %u)", (uint32_t)request, (uint32_t)was);
+  }
+
 #define GETMYLIMIT(L) getMyLimit((L), STRINGIFY(L))
 #define SETMYLIMIT(L,V) setMyLimit((L), STRINGIFY(L), (V))
 
@@ -1748,6 +2149,9 @@ extern "C" {
       }
     }
 
+    // after the daemon fd sweep above,  which walks the whole table
+    raiseMyFileLimit(HSP_RLIMIT_NOFILE);
+
     // open the output file while we still have root priviliges.
     // use mode "w+" because we intend to write it and rewrite it.
     if((sp->f_out = fopen(sp->outputFile, "w+")) == NULL) {
@@ -1781,6 +2185,9 @@ extern "C" {
     sp->sync_agent = (pthread_mutex_t *)my_calloc(sizeof(pthread_mutex_t));
     pthread_mutex_init(sp->sync_agent, NULL);
 
+    // lock-free handoff of flow samples from packet buses to poll bus
+    sp->sampleQ = UTMPSCNew(HSP_SAMPLE_QUEUE_LEN);
+
     // poll actions array
     sp->pollActions = UTArrayNew(UTARRAY_DFLT);
 
@@ -2021,6 +2428,15 @@ extern "C" {
 
     EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_TICK), evt_poll_tick);
     EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_TOCK), evt_poll_tock);
+    EVEventRx(sp->rootModule, EVGetEvent(sp->pollBus, EVEVENT_DECI), evt_poll_deci);
+    sp->evt_flush_samples = EVGetEvent(sp->pollBus, HSPEVENT_FLUSH_SAMPLES);
+    EVEventRx(sp->rootModule, sp->evt_flush_samples, evt_poll_flush_samples);
+
+    // learn about interface changes as they happen. The periodic
+    // refresh then only has to be a consistency sweep.
+    int intfSock = openInterfaceEvents();
+    if(intfSock > 0)
+      sp->intfEvents = EVBusAddSocket(sp->rootModule, sp->pollBus, intfSock, readIntfEvents, NULL);
 
     if(sp->DNSSD.DNSSD) {
       EVLoadModule(sp->rootModule, "mod_dnssd", sp->modulesPath);
@@ -77,8 +77,8 @@ extern "C" {
 
 #define ADD_TO_LIST(linkedlist, obj) \
   do { \
-    obj->nxt = linkedlist; \
-    linkedlist = obj; \
+    (obj)->nxt = linkedlist; \
+    linkedlist = (obj); \
   } while(0)
 
 #define PROCFS_STR STRINGIFY_DEF(PROCFS)
@@ -124,6 +124,11 @@ extern "C" {
 // set to 0 to disable the memlock feature
 #define HSP_RLIMIT_MEMLOCK 0
 
+// raise the soft limit on open files (but never past the hard limit)
+// to this at startup.  mod_docker holds up to 6 counter files open
+// per container.
+#define HSP_RLIMIT_NOFILE 65536
+
 // only one receiver, so the receiverIndex is a constant
 #define HSP_SFLOW_RECEIVER_INDEX 1
 
@@ -158,14 +163,26 @@ extern "C" {
     char *namespace;
     char *deviceName;
     uint32_t deviceIfIndex;
+    // transmit telemetry
+    uint64_t sendErrors;
+    uint64_t sendDrops; // EAGAIN - socket buffer full
   } HSPCollector;
 
+  // finished datagrams waiting to go out with sendmmsg()
+#define HSP_SENDQ_LEN 16
+  typedef struct _HSPSendQ {
+    uint32_t n;
+    uint32_t pktLen[HSP_SENDQ_LEN];
+    u_char *pkts; // HSP_SENDQ_LEN * SFL_MAX_DATAGRAM_SIZE
+  } HSPSendQ;
+
   typedef struct _HSPPcap {
     struct _HSPPcap *nxt;
     char *dev;
     bool promisc;
     bool vport;
     bool vport_set;
+    bool ring; // TPACKET_V3 mmap ring instead of libpcap
     uint64_t speed_min;
     uint64_t speed_max;
     bool speed_set;
@@ -348,6 +365,7 @@ extern "C" {
     uint32_t modinfo_type;
     uint32_t modinfo_len;
     SFLSFP_counters sfp;
+    uint32_t sfp_seqNo; // version of the optics worker cache copied into sfp
     // LACP/bonding data
     SFLLACP_counters lacp;
     // switch ports that are sending individual interface
@@ -367,6 +385,25 @@ extern "C" {
     int opx_id;
   } HSPAdaptorNIO;
 
+  // Read-only view of adaptorsByIndex and adaptorsByPeerIndex for the
+  // packet threads. Rebuilt on the poll bus and published by pointer swap.
+  typedef struct _HSPIfIndexEntry {
+    uint32_t ifIndex;
+    SFLAdaptor *adaptor; // adaptorByIndex()
+    SFLAdaptor *global;  // adaptorByPeerIndex() - veth end in the global namespace
+  } HSPIfIndexEntry;
+
+#define HSP_IFINDEX_DENSE_MAX 65536 // beyond this use the overflow hash
+
+  typedef struct _HSPIfIndexMap {
+    struct _HSPIfIndexMap *nxt; // retired list
+    uint32_t *retired; // packet bus epochs when unpublished - see EVBusQuiesced()
+    uint32_t n_dense;
+    HSPIfIndexEntry *dense;
+    UTHash *sparse;
+    UTArray *adaptors; // deleted while this map was live - freed with it
+  } HSPIfIndexMap;
+
   typedef struct _HSPDiskIO {
     uint64_t last_sectors_read;
     uint64_t last_sectors_written;
@@ -374,9 +411,30 @@ extern "C" {
     uint64_t bytes_written;
   } HSPDiskIO;
 
+  // host counter sources,  opened once and re-read with pread()
+  typedef struct _HSPProcFiles {
+    UTProcFile *loadavg;
+    UTProcFile *stat;
+    UTProcFile *uptime;
+    UTProcFile *cpuinfo;
+    UTProcFile *meminfo;
+    UTProcFile *vmstat;
+    UTProcFile *diskstats;
+    UTProcFile *mounts;
+    struct _HSPFsStats *fsStats; // filesystem capacity,  cached by a worker thread
+    UTProcFile *snmp;
+    UTProcFile *netdev;
+  } HSPProcFiles;
+
 #define HSPBUS_POLL "poll" // main thread
 #define HSPBUS_CONFIG "config" // DNS-SD
 #define HSPBUS_PACKET "packet" // pcap,ulog,nflog,json,tcp,psample packet processing
+// additional packet bus shards are named "packet.1", "packet.2" ...
+#define HSP_MAX_PACKET_BUS_SHARDS 64
+// completed flow samples waiting for the poll bus to encode them
+#define HSP_SAMPLE_QUEUE_LEN 8192
+// producers wake the poll bus early when the queue is this deep
+#define HSP_SAMPLE_QUEUE_WAKE (HSP_SAMPLE_QUEUE_LEN / 4)
 
 // The generic start,tick,tock,final,end events are defined in evbus.h
 #define HSPEVENT_HOST_COUNTER_SAMPLE "csample"   // (csample *) building counter-sample
@@ -393,13 +451,18 @@ extern "C" {
 #define HSPEVENT_INTF_READ "intf_read"           // (adaptor *) reading interface
 #define HSPEVENT_INTF_SPEED "intf_speed"         // (adaptor *) interface speed change
 #define HSPEVENT_INTFS_CHANGED "intfs_changed"   // some interface(s) changed
+#define HSPEVENT_INTF_ADDED "intf_added"         // (adaptor *) new interface (poll bus only)
+#define HSPEVENT_INTF_CHANGED "intf_changed"     // (adaptor *) up/down or attributes changed (poll bus only)
+#define HSPEVENT_INTF_REMOVED "intf_removed"     // (adaptor *) about to be freed (poll bus only)
 #define HSPEVENT_UPDATE_NIO "update_nio"         // (adaptor *) nio counter refresh
+#define HSPEVENT_FLUSH_SAMPLES "flush_samples"   // sampleQ reached HSP_SAMPLE_QUEUE_WAKE (poll bus only)
 
   typedef struct _HSPPendingSample {
     SFL_FLOW_SAMPLE_TYPE *fs;
     SFLSampler *sampler;
     int refCount;
-    UTArray *ptrsToFree;
+    struct _HSPSampleArena *arena; // all sample memory comes from here
+    struct timespec captured; // packet bus clock when the sample was taken
     // header decode
     int ipversion;
     uint8_t *hdr;
@@ -434,6 +497,17 @@ extern "C" {
     HSP_TELEMETRY_FLOW_SAMPLES_SUPPRESSED,
     HSP_TELEMETRY_COUNTER_SAMPLES_SUPPRESSED,
     HSP_TELEMETRY_EVENT_SAMPLES,
+    HSP_TELEMETRY_NETLINK_OVERRUNS,
+    HSP_TELEMETRY_SAMPLE_QUEUE_DEPTH,
+    HSP_TELEMETRY_SEND_ERRORS,
+    HSP_TELEMETRY_SEND_DROPS,
+    HSP_TELEMETRY_EVENT_RING_DEPTH,
+    HSP_TELEMETRY_EVENT_RING_OVERFLOWS,
+    HSP_TELEMETRY_POLLERS_FIRED,
+    HSP_TELEMETRY_HEAP_REALMS,
+    HSP_TELEMETRY_HEAP_BYTES,
+    HSP_TELEMETRY_HEAP_ALLOCS,
+    HSP_TELEMETRY_HEAP_REMOTE_FREES,
     HSP_TELEMETRY_NUM_COUNTERS
   } EnumHSPTelemetry;
 
@@ -446,11 +520,28 @@ extern "C" {
     "datagrams",
     "dropped_samples",
     "flow_samples_suppressed",
-    "counter_samples_suppressed"
+    "counter_samples_suppressed",
     "event_samples",
+    "netlink_overruns",
+    "sample_queue_depth",
+    "send_errors",
+    "send_drops",
+    "event_ring_depth",
+    "event_ring_overflows",
+    "pollers_fired",
+    "heap_realms",
+    "heap_bytes",
+    "heap_allocs",
+    "heap_remote_frees",
   };
 #endif
 
+  // telemetry may be accumulated from more than one bus thread
+#define HSP_TELEMETRY_ADD(sp, ctr, n) __sync_fetch_and_add(&(sp)->telemetry[(ctr)], (n))
+#define HSP_TELEMETRY_INC(sp, ctr) HSP_TELEMETRY_ADD((sp), (ctr), 1)
+  // gauges have a single writer
+#define HSP_TELEMETRY_SET(sp, ctr, n) ((sp)->telemetry[(ctr)] = (n))
+
   typedef enum {
     HSP_VNODE_PRIORITY_SYSTEMD=1,
     HSP_VNODE_PRIORITY_DOCKER,
@@ -458,15 +549,28 @@ extern "C" {
     HSP_VNODE_PRIORITY_XEN
   } EnumVNodePriority;
 
+  typedef enum {
+    HSP_NIO_METHOD_UNKNOWN=0,
+    HSP_NIO_METHOD_GETSTATS, // RTM_GETSTATS (IFLA_STATS_LINK_64)
+    HSP_NIO_METHOD_GETLINK,  // RTM_GETLINK (IFLA_STATS64)
+    HSP_NIO_METHOD_PROCFS    // /proc/net/dev
+  } EnumHSPNioMethod;
+
   typedef struct _HSP {
     char *modulesPath;
     EVMod *rootModule;
     EVBus *pollBus;
-    EVEvent *evt_flow_sample;
+    // packet bus shards. packetBuses[0] is HSPBUS_PACKET
+    uint32_t packetBusShards;
+    EVBus **packetBuses;
 
     // agent
     SFLAgent *agent;
     pthread_mutex_t *sync_agent;
+    // flow samples handed off by packet buses, encoded by poll bus
+    UTMPSC *sampleQ;
+    EVEvent *evt_flush_samples;
+    bool sampleQWakePosted;
     // main host poller
     SFLPoller *poller;
     bool counterSampleQueued;
@@ -480,11 +584,14 @@ extern "C" {
 
     // collector socket failure recovery
     uint32_t reopenCollectorSocketCountdown;
+    // datagram transmit queue (protected by sync_agent)
+    HSPSendQ sendQ;
 
     // resolve actual polling interval
     uint32_t syncPollingInterval;
     uint32_t minPollingInterval;
     uint32_t actualPollingInterval;
+    uint32_t maxPollsPerTick; // 0 == random stagger
 
     // agent/agentIP config results
     uint32_t revisionNo;
@@ -523,6 +630,7 @@ extern "C" {
       uint32_t forgetVMSecs;
       bool hostname;
       bool markTraffic; // TODO: use enum here?
+      bool cgroupStats; // read counters from cgroup files, not the stats API
     } docker;
     struct {
       bool cumulus;
@@ -637,6 +745,10 @@ extern "C" {
     UTHash *adaptorsByPeerIndex;
     UTHash *adaptorsByMac;
     bool allowDeleteAdaptor;
+    HSPIfIndexMap *ifIndexMap; // published for packet threads
+    HSPIfIndexMap *ifIndexMapRetired;
+    UTArray *adaptorsRetiring; // deleted,  waiting for the next publish
+    bool ifIndexMapDirty;
 
     // poll actions for tick-tock cycle
     UTArray *pollActions;
@@ -648,6 +760,16 @@ extern "C" {
     // if it finds evidence that the counters are already 64-bit in the OS,
     // or if it decides that all interface speeds are limited to 1Gbps or less.
     time_t nio_last_update;
+    // bulk interface counters via netlink, falling back to /proc/net/dev
+    EnumHSPNioMethod nio_method;
+    int nio_nl_sock;
+    uint32_t nio_nl_seq;
+    // ethtool settings via genetlink, falling back to SIOCETHTOOL
+    int ethtool_nl_sock;
+    int ethtool_nl_family; // 0=not resolved yet, -1=not available
+    uint32_t ethtool_nl_seq;
+    UTHash *ethtoolDrivers; // stats string-set indexes by (driver,n_stats)
+    struct _HSPSfpPoller *sfpPoller; // optics EEPROM worker
     time_t nio_polling_secs;
 #define HSP_NIO_POLLING_SECS_32BIT 3
     time_t next_nio_poll;
@@ -664,6 +786,7 @@ extern "C" {
 
     uint32_t checkAdaptorListSecs; // poll interval
     time_t next_checkAdaptorList; // deadline
+    EVSocket *intfEvents; // rtnetlink link/address notifications
 
     bool refreshVMList; // request flag
     uint32_t refreshVMListSecs; // poll interval (default)
@@ -671,6 +794,7 @@ extern "C" {
 
     // 64-bit diskIO accumulators
     HSPDiskIO diskIO;
+    HSPProcFiles procFiles;
 
     // physical host / hypervisor vnode characteristics
     uint32_t cpu_mhz;
@@ -715,10 +839,12 @@ extern "C" {
   // read functions
   bool detectInterfaceChange(HSP *sp);
   int readInterfaces(HSP *sp, bool full_discovery, uint32_t *p_added, uint32_t *p_removed, uint32_t *p_cameup, uint32_t *p_wentdown, uint32_t *p_changed);
+  int openInterfaceEvents(void);
+  int readInterfaceEvents(HSP *sp, int nl_sock, uint32_t *p_added, uint32_t *p_removed, uint32_t *p_cameup, uint32_t *p_wentdown, uint32_t *p_changed);
   bool isLocalAddress(HSP *sp, SFLAddress *addr);
   const char *devTypeName(EnumHSPDevType devType);
-  int readCpuCounters(SFLHost_cpu_counters *cpu);
-  int readMemoryCounters(SFLHost_mem_counters *mem);
+  int readCpuCounters(HSP *sp, SFLHost_cpu_counters *cpu);
+  int readMemoryCounters(HSP *sp, SFLHost_mem_counters *mem);
   int readDiskCounters(HSP *sp, SFLHost_dsk_counters *dsk);
   int readNioCounters(HSP *sp, SFLHost_nio_counters *nio, char *devFilter, SFLAdaptorList *adList);
   HSPAdaptorNIO *getAdaptorNIO(SFLAdaptorList *adaptorList, char *deviceName);
@@ -751,6 +877,10 @@ extern "C" {
   SFLAdaptor *adaptorByMac(HSP *sp, SFLMacAddress *mac);
   SFLAdaptor *adaptorByIndex(HSP *sp, uint32_t ifIndex);
   SFLAdaptor *adaptorByPeerIndex(HSP *sp, uint32_t ifIndex);
+  HSPIfIndexEntry *ifIndexLookup(HSP *sp, uint32_t ifIndex);
+  SFLAdaptor *packetAdaptorByIndex(HSP *sp, uint32_t ifIndex);
+  SFLAdaptor *packetAdaptorByPeerIndex(HSP *sp, uint32_t ifIndex);
+  void publishIfIndexMap(HSP *sp);
   SFLAdaptor *adaptorByIP(HSP *sp, SFLAddress *ip);
   void deleteAdaptor(HSP *sp, SFLAdaptor *ad, int freeFlag);
   int deleteMarkedAdaptors(HSP *sp, UTHash *adaptorHT, int freeFlag);
@@ -784,9 +914,17 @@ extern "C" {
   void *pendingSample_calloc(HSPPendingSample *ps, size_t len);
   void holdPendingSample(HSPPendingSample *ps);
   void releasePendingSample(HSP *sp, HSPPendingSample *ps);
+  void flushPendingSamples(HSP *sp);
+  void flushDatagrams(HSP *sp);
   int decodePendingSample(HSPPendingSample *ps);
   SFLPoller *forceCounterPolling(HSP *sp, SFLAdaptor *adaptor);
 
+  // packet bus shards
+  EVBus *packetBusShard(EVMod *mod, uint32_t shard);
+  EVBus *packetBusForModule(EVMod *mod);
+  int packetBusShardIndex(EVMod *mod, EVBus *bus);
+  void packetBusEventRx(EVMod *mod, char *evt_name, EVActionCB cb);
+
   // VM lifecycle
   HSPVMState *getVM(EVMod *mod, char *uuid, bool create, size_t objSize, EnumVMType vmType, getCountersFn_t getCountersFn);
   void removeAndFreeVM(EVMod *mod, HSPVMState *state);
@@ -15,6 +15,7 @@ extern "C" {
 #include <sched.h>
 
 #include "hsflowd.h"
+#include "util_netlink.h"
 #include "cpu_utils.h"
 #include "math.h"
 
@@ -105,6 +106,17 @@ extern "C" {
     "exited",
   };
 
+  // counter files held open in cgroupStats mode
+  typedef enum {
+    HSP_CGFD_CPU=0,
+    HSP_CGFD_MEM,
+    HSP_CGFD_MEMLIMIT,
+    HSP_CGFD_BLKIO_BYTES,
+    HSP_CGFD_BLKIO_OPS, // v1 only (v2 io.stat has both)
+    HSP_CGFD_NETDEV,
+    HSP_CGFD_NUM
+  } EnumHSPCgroupFD;
+
   typedef struct _HSPVMState_DOCKER {
     HSPVMState vm; // superclass: must come first
     char *id;
@@ -122,10 +134,15 @@ extern "C" {
     uint32_t dup_hostname:1;
     uint32_t gpu_dev:1;
     uint32_t gpu_env:1;
+    uint32_t cgroup_v2:1;
+    uint32_t cgroup_nofd:1; // ran out of fds - use the stats API
     uint64_t memoryLimit;
     time_t last_vnic;
+    EVSocket *nlSock; // rtnetlink socket in the container's netns
+    pid_t nl_pid;     // pid whose netns it belongs to
     time_t last_cgroup;
     char *cgroup_devices;
+    int cgroupFD[HSP_CGFD_NUM];
     // we now populate stats here too
     uint32_t cpu_count;
     double cpu_count_dbl;
@@ -209,8 +226,13 @@ extern "C" {
     bool unique;
   } HSPVNIC;
 
-#define HSP_VNIC_REFRESH_TIMEOUT 300
+#define HSP_VNIC_REFRESH_TIMEOUT 300 // retry if the netns could not be opened
+#define HSP_VNIC_NETLINK_TIMEOUT_mS 500
 #define HSP_CGROUP_REFRESH_TIMEOUT 600
+#define HSP_CGROUP_V1_DIR SYSFS_STR "/fs/cgroup/%s%s"
+#define HSP_CGROUP_V2_DIR SYSFS_STR "/fs/cgroup%s"
+#define HSP_CGROUP_V2_HYBRID_DIR SYSFS_STR "/fs/cgroup/unified%s"
+#define HSP_CGROUP_READ_BUFLEN 8192
 
   typedef enum {
     HSP_VNIC_LAYER_NONE,
@@ -252,6 +274,10 @@ extern "C" {
     struct stat myNS;
     EnumHSPVNICLayer vnicLayer;
     UTHash *vnicByIP;
+    struct _HSPNetnsHelper *netnsHelper;
+    uint32_t nl_seq;
+    char *cgroupBuf;
+    bool cgroupNoFdLogged;
   } HSP_mod_DOCKER;
 
 #define HSP_DOCKER_MAX_STATS_LINELEN 512
@@ -270,6 +296,7 @@ extern "C" {
   static void serviceLostRequests(EVMod *mod);
   static HSPDockerRequest *containerStatsRequest(EVMod *mod, HSPVMState_DOCKER *container);
   static const char *containerStateName(EnumHSPContainerState st);
+  static void closeContainerCgroupFiles(HSPVMState_DOCKER *container);
 
   /*_________________---------------------------__________________
     _________________    utils to help debug    __________________
@@ -297,91 +324,93 @@ extern "C" {
   /*________________---------------------------__________________
     ________________   containerLinkCB         __________________
     ----------------___________________________------------------
-    
-    expecting lines of the form:
-    VNIC: <ifindex> <device> <mac>
+    Called for each interface that is up in the container's netns,
+    with the first IPv4 address if it has one.
   */
 
-  static int containerLinkCB(EVMod *mod, HSPVMState_DOCKER *container, char *line) {
+  static void containerLinkCB(EVMod *mod, HSPVMState_DOCKER *container, uint32_t ifIndex, char *deviceName, u_char *mac, SFLAddress *ipAddr) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
-    myDebug(1, "containerLinkCB: line=<%s>", line);
-    char deviceName[HSP_DOCKER_MAX_LINELEN];
-    char macStr[HSP_DOCKER_MAX_LINELEN];
-    char ipStr[HSP_DOCKER_MAX_LINELEN];
-    uint32_t ifIndex;
-    if(sscanf(line, "VNIC: %u %s %s %s", &ifIndex, deviceName, macStr, ipStr) == 4) {
-      u_char mac[6];
-      if(hexToBinary((u_char *)macStr, mac, 6) == 6) {
-	SFLAdaptor *adaptor = adaptorListGet(container->vm.interfaces, deviceName);
-	if(adaptor == NULL) {
-	  adaptor = nioAdaptorNew(deviceName, mac, ifIndex);
-	  adaptorListAdd(container->vm.interfaces, adaptor);
-	  // add to "all namespaces" collections too - but only the ones where
-	  // the id is really global.  For example,  many containers can have
-	  // an "eth0" adaptor so we can't add it to sp->adaptorsByName.
-
-	  // And because the containers are likely to be ephemeral, don't
-	  // replace the global adaptor if it's already there.
-
-	  if(UTHashGet(sp->adaptorsByMac, adaptor) == NULL)
-	    if(UTHashAdd(sp->adaptorsByMac, adaptor) != NULL)
-	      myDebug(1, "Warning: container adaptor overwriting adaptorsByMac");
-
-	  if(UTHashGet(sp->adaptorsByIndex, adaptor) == NULL)
-	    if(UTHashAdd(sp->adaptorsByIndex, adaptor) != NULL)
-	      myDebug(1, "Warning: container adaptor overwriting adaptorsByIndex");
-
-	  // mark it as a vm/container device
-	  ADAPTOR_NIO(adaptor)->vm_or_container = YES;
-
-	  // did we get an ip address too?
-	  SFLAddress ipAddr = { };
-	  if(parseNumericAddress(ipStr, NULL, &ipAddr, AF_INET)) {
-	    if(!SFLAddress_isZero(&ipAddr)
-	       && mdata->vnicByIP) {
-	      myDebug(1, "VNIC: learned virtual ipAddr: %s", ipStr);
-	      // Can use this to associate traffic with this container
-	      // if this address appears in sampled packet header as
-	      // outer or inner IP
-	      ADAPTOR_NIO(adaptor)->ipAddr = ipAddr;
-	      HSPVNIC search = { .ipAddr = ipAddr };
-	      HSPVNIC *vnic = UTHashGet(mdata->vnicByIP, &search);
-	      if(vnic) {
-		// found IP - check for non-unique mapping
-		if(vnic->dsIndex != container->vm.dsIndex) {
-		  myDebug(1, "VNIC: clash between %s (ds=%u) and %s (ds=%u) -- setting unique=no",
-			  vnic->c_name,
-			  vnic->dsIndex,
-			  container->name,
-			  container->vm.dsIndex);
-		  vnic->unique = NO;
-		}
-	      }
-	      else {
-		// add new VNIC entry
-		vnic = (HSPVNIC *)my_calloc(sizeof(HSPVNIC));
-		vnic->ipAddr = ipAddr;
-		vnic->dsIndex = container->vm.dsIndex;
-		vnic->c_name = my_strdup(container->name);
-		UTHashAdd(mdata->vnicByIP, vnic);
-		vnic->unique = YES;
-		myDebug(1, "VNIC: linked to %s (ds=%u)",
-			vnic->c_name,
-			vnic->dsIndex);
-	      }
-	    }
-	  }
-
+    myDebug(1, "containerLinkCB: ifIndex=%u device=%s", ifIndex, deviceName);
+    SFLAdaptor *adaptor = adaptorListGet(container->vm.interfaces, deviceName);
+    if(adaptor) {
+      adaptor->marked = NO;
+      if(adaptor->ifIndex == ifIndex
+	 && !memcmp(adaptor->macs[0].mac, mac, 6))
+	return;
+      // same name,  but a different device now
+      deleteAdaptor(sp, adaptor, NO);
+      adaptor->ifIndex = ifIndex;
+      memcpy(adaptor->macs[0].mac, mac, 6);
+    }
+    else {
+      adaptor = nioAdaptorNew(deviceName, mac, ifIndex);
+      adaptorListAdd(container->vm.interfaces, adaptor);
+    }
+    // add to "all namespaces" collections too - but only the ones where
+    // the id is really global.  For example,  many containers can have
+    // an "eth0" adaptor so we can't add it to sp->adaptorsByName.
+
+    // And because the containers are likely to be ephemeral, don't
+    // replace the global adaptor if it's already there.
+
+    if(UTHashGet(sp->adaptorsByMac, adaptor) == NULL)
+      if(UTHashAdd(sp->adaptorsByMac, adaptor) != NULL)
+	myDebug(1, "Warning: container adaptor overwriting adaptorsByMac");
+
+    if(UTHashGet(sp->adaptorsByIndex, adaptor) == NULL)
+      if(UTHashAdd(sp->adaptorsByIndex, adaptor) != NULL)
+	myDebug(1, "Warning: container adaptor overwriting adaptorsByIndex");
+    sp->ifIndexMapDirty = YES;
+
+    // mark it as a vm/container device
+    ADAPTOR_NIO(adaptor)->vm_or_container = YES;
+
+    // did we get an ip address too?
+    if(!SFLAddress_isZero(ipAddr)
+       && mdata->vnicByIP) {
+      char ipStr[64];
+      myDebug(1, "VNIC: learned virtual ipAddr: %s", SFLAddress_print(ipAddr, ipStr, 64));
+      // Can use this to associate traffic with this container
+      // if this address appears in sampled packet header as
+      // outer or inner IP
+      ADAPTOR_NIO(adaptor)->ipAddr = *ipAddr;
+      HSPVNIC search = { .ipAddr = *ipAddr };
+      HSPVNIC *vnic = UTHashGet(mdata->vnicByIP, &search);
+      if(vnic) {
+	// found IP - check for non-unique mapping
+	if(vnic->dsIndex != container->vm.dsIndex) {
+	  myDebug(1, "VNIC: clash between %s (ds=%u) and %s (ds=%u) -- setting unique=no",
+		  vnic->c_name,
+		  vnic->dsIndex,
+		  container->name,
+		  container->vm.dsIndex);
+	  vnic->unique = NO;
 	}
       }
+      else {
+	// add new VNIC entry
+	vnic = (HSPVNIC *)my_calloc(sizeof(HSPVNIC));
+	vnic->ipAddr = *ipAddr;
+	vnic->dsIndex = container->vm.dsIndex;
+	vnic->c_name = my_strdup(container->name);
+	UTHashAdd(mdata->vnicByIP, vnic);
+	vnic->unique = YES;
+	myDebug(1, "VNIC: linked to %s (ds=%u)",
+		vnic->c_name,
+		vnic->dsIndex);
+      }
     }
-    return YES;
   }
 
 /*________________---------------------------__________________
-  ________________   readContainerInterfaces __________________
+  ________________      netns helper         __________________
   ----------------___________________________------------------
+  A long-lived thread that opens an rtnetlink socket inside a
+  container's network namespace and then switches back.  The
+  socket stays in that namespace,  so after this the poll bus can
+  dump links and addresses through it,  and hear about changes,
+  without leaving its own namespace or forking.
 */
 
 #include <linux/version.h>
@@ -395,171 +424,240 @@ extern "C" {
 #define MY_SETNS(fd, nstype) setns(fd, nstype)
 #endif
 
-
-  int readContainerInterfaces(EVMod *mod, HSPVMState_DOCKER *container)  {
-    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
-    pid_t nspid = container->pid;
-    myDebug(2, "readContainerInterfaces: pid=%u", nspid);
-    if(nspid == 0) return 0;
-
-    // do the dirty work after a fork, so we can just exit afterwards,
-    // same as they do in "ip netns exec"
-    int pfd[2];
-    if(pipe(pfd) == -1) {
-      myLog(LOG_ERR, "pipe() failed : %s", strerror(errno));
-      exit(EXIT_FAILURE);
-    }
-    pid_t cpid;
-    if((cpid = fork()) == -1) {
-      myLog(LOG_ERR, "fork() failed : %s", strerror(errno));
-      exit(EXIT_FAILURE);
-    }
-    if(cpid == 0) {
-      // in child
-      close(pfd[0]);   // close read-end
-      dup2(pfd[1], 1); // stdout -> write-end
-      dup2(pfd[1], 2); // stderr -> write-end
-      close(pfd[1]);
-
-      // open /proc/<nspid>/ns/net
-      char topath[HSP_DOCKER_MAX_FNAME_LEN+1];
-      snprintf(topath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/%u/ns/net", nspid);
-      int nsfd = open(topath, O_RDONLY | O_CLOEXEC);
-      if(nsfd < 0) {
-	fprintf(stderr, "cannot open %s : %s", topath, strerror(errno));
-	exit(EXIT_FAILURE);
-      }
-
-      struct stat statBuf;
-      if(fstat(nsfd, &statBuf) == 0) {
-	myDebug(2, "container namespace dev.inode == %u.%u", statBuf.st_dev, statBuf.st_ino);
-	if(statBuf.st_dev == mdata->myNS.st_dev
-	   && statBuf.st_ino == mdata->myNS.st_ino) {
-	  myDebug(1, "skip my own namespace");
-	  exit(0);
+  typedef struct _HSPNetnsHelper {
+    pthread_mutex_t sync;
+    pthread_cond_t cond;
+    int nsfd;      // request
+    int nl_sock;   // reply
+    bool pending:1;
+    bool done:1;
+    bool dead:1;
+  } HSPNetnsHelper;
+
+  static void *netnsHelper(void *magic) {
+    HSPNetnsHelper *helper = (HSPNetnsHelper *)magic;
+    // remember where we started so we can always come back
+    char myPath[HSP_DOCKER_MAX_FNAME_LEN+1];
+    snprintf(myPath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/self/task/%u/ns/net", (uint32_t)MYGETTID);
+    int myfd = open(myPath, O_RDONLY | O_CLOEXEC);
+    SEMLOCK_DO(&helper->sync) {
+      if(myfd < 0) {
+	myLog(LOG_ERR, "netnsHelper: cannot open %s : %s", myPath, strerror(errno));
+	helper->dead = YES;
+      }
+      while(!helper->dead) {
+	while(!helper->pending)
+	  pthread_cond_wait(&helper->cond, &helper->sync);
+	helper->pending = NO;
+	helper->nl_sock = -1;
+	if(MY_SETNS(helper->nsfd, CLONE_NEWNET) < 0)
+	  myDebug(1, "netnsHelper: setns failed : %s", strerror(errno));
+	else {
+	  helper->nl_sock = UTNLRoute_open(RTMGRP_LINK | RTMGRP_IPV4_IFADDR);
+	  if(MY_SETNS(myfd, CLONE_NEWNET) < 0) {
+	    // stuck in the wrong namespace - so never do this again
+	    myLog(LOG_ERR, "netnsHelper: cannot restore namespace : %s", strerror(errno));
+	    if(helper->nl_sock >= 0)
+	      close(helper->nl_sock);
+	    helper->nl_sock = -1;
+	    helper->dead = YES;
+	  }
 	}
+	helper->done = YES;
+	pthread_cond_signal(&helper->cond);
       }
+      pthread_cond_broadcast(&helper->cond);
+    }
+    return NULL;
+  }
 
-      /* set network namespace
-	 CLONE_NEWNET means nsfd must refer to a network namespace
-      */
-      if(MY_SETNS(nsfd, CLONE_NEWNET) < 0) {
-	fprintf(stderr, "seting network namespace failed: %s", strerror(errno));
-	exit(EXIT_FAILURE);
-      }
+  static HSPNetnsHelper *netnsHelperStart(EVMod *mod) {
+    HSPNetnsHelper *helper = (HSPNetnsHelper *)my_calloc(sizeof(HSPNetnsHelper));
+    pthread_mutex_init(&helper->sync, NULL);
+    pthread_cond_init(&helper->cond, NULL);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, EV_BUS_STACKSIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, netnsHelper, helper);
+    if(err) {
+      myLog(LOG_ERR, "netnsHelperStart: pthread_create() failed: %s", strerror(err));
+      helper->dead = YES;
+    }
+    return helper;
+  }
 
-      /* From "man 2 unshare":  This flag has the same effect as the clone(2)
-	 CLONE_NEWNS flag. Unshare the mount namespace, so that the calling
-	 process has a private copy of its namespace which is not shared with
-	 any other process. Specifying this flag automatically implies CLONE_FS
-	 as well. Use of CLONE_NEWNS requires the CAP_SYS_ADMIN capability. */
-      if(unshare(CLONE_NEWNS) < 0) {
-	fprintf(stderr, "seting network namespace failed: %s", strerror(errno));
-	exit(EXIT_FAILURE);
+  // returns an rtnetlink socket in the namespace of nsfd, or -1
+  static int netnsHelperOpen(HSPNetnsHelper *helper, int nsfd) {
+    int nl_sock = -1;
+    SEMLOCK_DO(&helper->sync) {
+      if(!helper->dead) {
+	helper->nsfd = nsfd;
+	helper->done = NO;
+	helper->pending = YES;
+	pthread_cond_signal(&helper->cond);
+	while(!helper->done
+	      && !helper->dead)
+	  pthread_cond_wait(&helper->cond, &helper->sync);
+	if(helper->done)
+	  nl_sock = helper->nl_sock;
       }
+    }
+    return nl_sock;
+  }
+
+/*________________---------------------------__________________
+  ________________   readContainerInterfaces __________________
+  ----------------___________________________------------------
+*/
+
+  typedef struct _HSPContainerLink {
+    uint32_t ifIndex;
+    uint32_t flags;
+    bool gotMac;
+    u_char mac[6];
+    char devName[IFNAMSIZ];
+    SFLAddress ipAddr;
+  } HSPContainerLink;
 
-      int fd = socket(PF_INET, SOCK_DGRAM, 0);
-      if(fd < 0) {
-	fprintf(stderr, "error opening socket: %d (%s)\n", errno, strerror(errno));
-	exit(EXIT_FAILURE);
+  static void containerLinkMsg(void *magic, struct nlmsghdr *nlh) {
+    UTArray *links = (UTArray *)magic;
+    if(nlh->nlmsg_type != RTM_NEWLINK)
+      return;
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    HSPContainerLink *link = (HSPContainerLink *)my_calloc(sizeof(HSPContainerLink));
+    link->ifIndex = ifi->ifi_index;
+    link->flags = ifi->ifi_flags;
+    int len = IFLA_PAYLOAD(nlh);
+    for(struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+      if(rta->rta_type == IFLA_IFNAME) {
+	int nameLen = RTA_PAYLOAD(rta);
+	if(nameLen >= IFNAMSIZ)
+	  nameLen = IFNAMSIZ - 1;
+	memcpy(link->devName, RTA_DATA(rta), nameLen);
+      }
+      else if(rta->rta_type == IFLA_ADDRESS
+	      && RTA_PAYLOAD(rta) == 6) {
+	memcpy(link->mac, RTA_DATA(rta), 6);
+	link->gotMac = YES;
       }
+    }
+    UTArrayAdd(links, link);
+  }
 
-      FILE *procFile = fopen(PROCFS_STR "/net/dev", "r");
-      if(procFile) {
-	struct ifreq ifr;
-	memset(&ifr, 0, sizeof(ifr));
-	char line[MAX_PROC_LINE_CHARS];
-	int lineNo = 0;
-	int truncated;
-	while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	  if(lineNo++ < 2) continue; // skip headers
-	  char buf[MAX_PROC_LINE_CHARS];
-	  char *p = line;
-	  char *devName = parseNextTok(&p, " \t:", NO, '\0', NO, buf, MAX_PROC_LINE_CHARS);
-	  if(devName && my_strlen(devName) < IFNAMSIZ) {
-	    strncpy(ifr.ifr_name, devName, sizeof(ifr.ifr_name)-1);
-	    // Get the flags for this interface
-	    if(ioctl(fd,SIOCGIFFLAGS, &ifr) < 0) {
-	      fprintf(stderr, "container device %s Get SIOCGIFFLAGS failed : %s",
-		      devName,
-		      strerror(errno));
-	    }
-	    else {
-	      int up = (ifr.ifr_flags & IFF_UP) ? YES : NO;
-	      int loopback = (ifr.ifr_flags & IFF_LOOPBACK) ? YES : NO;
-
-	      if(up && !loopback) {
-		// try to get ifIndex next, because we only care about
-		// ifIndex and MAC when looking at container interfaces
-		if(ioctl(fd,SIOCGIFINDEX, &ifr) < 0) {
-		  // only complain about this if we are debugging
-		  myDebug(1, "container device %s Get SIOCGIFINDEX failed : %s",
-			  devName,
-			  strerror(errno));
-		}
-		else {
-		  int ifIndex = ifr.ifr_ifindex;
-		  SFLAddress ipAddr = {};
-
-		  // see if we can get an IP address
-		  if(ioctl(fd,SIOCGIFADDR, &ifr) < 0) {
-		    // only complain about this if we are debugging
-		    myDebug(1, "device %s Get SIOCGIFADDR failed : %s",
-			    devName,
-			    strerror(errno));
-		  }
-		  else {
-		    if (ifr.ifr_addr.sa_family == AF_INET) {
-		      struct sockaddr_in *s = (struct sockaddr_in *)&ifr.ifr_addr;
-		      // IP addr is now s->sin_addr
-		      ipAddr.type = SFLADDRESSTYPE_IP_V4;
-		      ipAddr.address.ip_v4.addr = s->sin_addr.s_addr;
-		    }
-		  }
-
-		  // Get the MAC Address for this interface
-		  if(ioctl(fd,SIOCGIFHWADDR, &ifr) < 0) {
-		    myDebug(1, "device %s Get SIOCGIFHWADDR failed : %s",
-			      devName,
-			      strerror(errno));
-		  }
-		  else {
-		    u_char macStr[13];
-		    printHex((u_char *)&ifr.ifr_hwaddr.sa_data, 6, macStr, 12, NO);
-		    char ipStr[64];
-		    SFLAddress_print(&ipAddr, ipStr, 64);
-		    // send this info back up the pipe to my my parent
-		    printf("VNIC: %u %s %s %s\n", ifIndex, devName, macStr, ipStr);
-		  }
-		}
-	      }
-	    }
+  static void containerAddrMsg(void *magic, struct nlmsghdr *nlh) {
+    UTArray *links = (UTArray *)magic;
+    if(nlh->nlmsg_type != RTM_NEWADDR)
+      return;
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+    if(ifa->ifa_family != AF_INET
+       || (ifa->ifa_flags & IFA_F_SECONDARY))
+      return;
+    HSPContainerLink *link;
+    UTARRAY_WALK(links, link) {
+      if(link->ifIndex == ifa->ifa_index
+	 && link->ipAddr.type == SFLADDRESSTYPE_UNDEFINED) {
+	int len = IFA_PAYLOAD(nlh);
+	for(struct rtattr *rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+	  if((rta->rta_type == IFA_LOCAL
+	      || rta->rta_type == IFA_ADDRESS)
+	     && RTA_PAYLOAD(rta) == 4) {
+	    link->ipAddr.type = SFLADDRESSTYPE_IP_V4;
+	    memcpy(&link->ipAddr.address.ip_v4.addr, RTA_DATA(rta), 4);
+	    // IFA_LOCAL is the one to use on point-to-point links
+	    if(rta->rta_type == IFA_LOCAL)
+	      break;
 	  }
 	}
       }
+    }
+  }
+
+  static void closeContainerNetns(EVMod *mod, HSPVMState_DOCKER *container) {
+    if(container->nlSock) {
+      EVSocketClose(mod, container->nlSock, YES);
+      container->nlSock = NULL;
+    }
+  }
 
-      // don't even bother to close file-descriptors,  just bail
-      exit(0);
+  static void readContainerNetns(EVMod *mod, EVSocket *sock, void *magic);
 
+  static void openContainerNetns(EVMod *mod, HSPVMState_DOCKER *container) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    char topath[HSP_DOCKER_MAX_FNAME_LEN+1];
+    snprintf(topath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/%u/ns/net", container->pid);
+    int nsfd = open(topath, O_RDONLY | O_CLOEXEC);
+    if(nsfd < 0) {
+      myDebug(1, "cannot open %s : %s", topath, strerror(errno));
+      return;
     }
-    else {
-      // in parent
-      close(pfd[1]); // close write-end
-      // read from read-end
-      FILE *ovs;
-      if((ovs = fdopen(pfd[0], "r")) == NULL) {
-	myLog(LOG_ERR, "readContainerInterfaces: fdopen() failed : %s", strerror(errno));
-	return 0;
+    struct stat statBuf;
+    if(fstat(nsfd, &statBuf) == 0) {
+      myDebug(2, "container namespace dev.inode == %u.%u", statBuf.st_dev, statBuf.st_ino);
+      if(statBuf.st_dev == mdata->myNS.st_dev
+	 && statBuf.st_ino == mdata->myNS.st_ino) {
+	myDebug(1, "skip my own namespace");
+	close(nsfd);
+	return;
       }
-      char line[MAX_PROC_LINE_CHARS];
-      int truncated;
-      while(my_readline(ovs, line, MAX_PROC_LINE_CHARS, &truncated) != EOF)
-	containerLinkCB(mod, container, line);
-      fclose(ovs);
-      wait(NULL); // block here until child is done
     }
+    if(mdata->netnsHelper == NULL)
+      mdata->netnsHelper = netnsHelperStart(mod);
+    int nl_sock = netnsHelperOpen(mdata->netnsHelper, nsfd);
+    close(nsfd);
+    if(nl_sock >= 0)
+      container->nlSock = EVBusAddSocket(mod, mdata->pollBus, nl_sock, readContainerNetns, container);
+  }
 
-    return container->vm.interfaces->num_adaptors;
+  int readContainerInterfaces(EVMod *mod, HSPVMState_DOCKER *container)  {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    pid_t nspid = container->pid;
+    myDebug(2, "readContainerInterfaces: pid=%u", nspid);
+    if(container->nl_pid != nspid) {
+      // new or restarted container
+      closeContainerNetns(mod, container);
+      container->nl_pid = nspid;
+      if(nspid)
+	openContainerNetns(mod, container);
+    }
+    else if(nspid
+	    && container->nlSock == NULL) {
+      // an earlier open failed - try again (our caller only
+      // comes back after HSP_VNIC_REFRESH_TIMEOUT in this case)
+      openContainerNetns(mod, container);
+    }
+    if(nspid == 0) return 0;
+    if(container->nlSock == NULL) return -1;
+
+    int nl_sock = container->nlSock->fd;
+    UTArray *links = UTArrayNew(UTARRAY_DFLT);
+    struct ifinfomsg ifi = { .ifi_family = AF_UNSPEC };
+    struct ifaddrmsg ifa = { .ifa_family = AF_INET };
+    uint32_t linkSeq = ++mdata->nl_seq;
+    uint32_t addrSeq = ++mdata->nl_seq;
+    int err = -EIO;
+    if(UTNLRoute_send(nl_sock, RTM_GETLINK, &ifi, sizeof(ifi), YES, linkSeq) >= 0
+       && (err = UTNLRoute_recv(nl_sock, linkSeq, HSP_VNIC_NETLINK_TIMEOUT_mS, links, containerLinkMsg)) == 0) {
+      err = -EIO;
+      if(UTNLRoute_send(nl_sock, RTM_GETADDR, &ifa, sizeof(ifa), YES, addrSeq) >= 0)
+	err = UTNLRoute_recv(nl_sock, addrSeq, HSP_VNIC_NETLINK_TIMEOUT_mS, links, containerAddrMsg);
+    }
+    if(err)
+      myDebug(1, "readContainerInterfaces: netlink dump failed: %s", strerror(-err));
+
+    HSPContainerLink *link;
+    UTARRAY_WALK(links, link) {
+      // we only care about ifIndex and MAC when looking at container interfaces
+      if(err == 0
+	 && (link->flags & IFF_UP)
+	 && !(link->flags & IFF_LOOPBACK)
+	 && link->gotMac)
+	containerLinkCB(mod, container, link->ifIndex, link->devName, link->mac, &link->ipAddr);
+      my_free(link);
+    }
+    UTArrayFree(links);
+    return err ? -1 : container->vm.interfaces->num_adaptors;
   }
 
   /*________________---------------------------__________________
@@ -682,13 +780,13 @@ extern "C" {
     // be a disaster as we would not copy the whole structure here.
     EVEventTx(sp->rootModule, evt_vm_cs, &ps, sizeof(ps));
     if(ps.suppress) {
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES_SUPPRESSED]++;
+      HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES_SUPPRESSED);
     }
     else {
       SEMLOCK_DO(sp->sync_agent) {
 	sfl_poller_writeCountersSample(vm->poller, &cs);
 	sp->counterSampleQueued = YES;
-	sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+	HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
       }
     }
   }
@@ -738,6 +836,9 @@ extern "C" {
     // remove from pollActions if present (necessary if this happens in tick() and before tock()
     UTHashDel(mdata->pollActions, container);
 
+    closeContainerNetns(mod, container);
+    closeContainerCgroupFiles(container);
+
     // remove from hash tables
     if(UTHashDel(mdata->vmsByID, container) == NULL) {
       myLog(LOG_ERR, "UTHashDel (vmsByID) failed: container %s=%s", container->name, container->id);
@@ -762,6 +863,7 @@ extern "C" {
     }
     if(container->dup_name) mdata->dup_names--;
     if(container->dup_hostname) mdata->dup_hostnames--;
+    if(container->cgroup_devices) my_free(container->cgroup_devices);
     removeAndFreeVM(mod, &container->vm);
   }
 
@@ -787,6 +889,8 @@ extern "C" {
       assert(container != NULL);
       if(container) {
 	container->id = my_strdup(id);
+	for(int ii = 0; ii < HSP_CGFD_NUM; ii++)
+	  container->cgroupFD[ii] = -1;
 	// add to collections
 	UTHashAdd(mdata->vmsByID, container);
 	UTHashAdd(mdata->vmsByUUID, container);
@@ -813,21 +917,171 @@ extern "C" {
       // reset the information that we are about to refresh
       adaptorListMarkAll(vm->interfaces);
       // then refresh it
-      readContainerInterfaces(mod, container);
-      // and clean up
+      if(readContainerInterfaces(mod, container) < 0) {
+	// could not look - keep what we had
+	SFLAdaptor *ad;
+	ADAPTORLIST_WALK(vm->interfaces, ad)
+	  ad->marked = NO;
+      }
+      // and clean up (freed after the ifIndex map grace period)
       deleteMarkedAdaptors_adaptorList(sp, vm->interfaces);
-      adaptorListFreeMarked(vm->interfaces);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________  readContainerNetns       __________________
+    -----------------___________________________------------------
+    Link or address change in the container's namespace.  We only
+    need to know that something happened,  so drain the socket and
+    dump again.
+  */
+
+  static void readContainerNetns(EVMod *mod, EVSocket *sock, void *magic) {
+    HSPVMState_DOCKER *container = (HSPVMState_DOCKER *)magic;
+    char buf[256];
+    int msgs = 0;
+    for(;;) {
+      int len = recv(sock->fd, buf, sizeof(buf), MSG_DONTWAIT | MSG_TRUNC);
+      if(len < 0) {
+	if(errno == EINTR)
+	  continue;
+	if(errno == ENOBUFS) {
+	  // overrun - still worth a look
+	  msgs++;
+	  continue;
+	}
+	break;
+      }
+      msgs++;
+    }
+    if(msgs) {
+      myDebug(1, "readContainerNetns: %d msgs for container %s", msgs, container->name);
+      updateContainerAdaptors(mod, container);
     }
   }
 
   /*_________________-----------------------------__________________
     _________________  updateContainerCgroupPaths __________________
     -----------------_____________________________------------------
+    In cgroupStats mode this is also where the counter files are
+    opened.  They are held open so that each poll is one pread()
+    per file.
   */
 
+  static void closeContainerCgroupFiles(HSPVMState_DOCKER *container) {
+    for(int ii = 0; ii < HSP_CGFD_NUM; ii++) {
+      if(container->cgroupFD[ii] >= 0) {
+	close(container->cgroupFD[ii]);
+	container->cgroupFD[ii] = -1;
+      }
+    }
+  }
+
+  static int openCounterFile(EVMod *mod, HSPVMState_DOCKER *container, char *fpath) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    int fd = open(fpath, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+      myDebug(2, "cannot open %s : %s", fpath, strerror(errno));
+      if(errno == EMFILE
+	 || errno == ENFILE) {
+	container->cgroup_nofd = YES;
+	if(!mdata->cgroupNoFdLogged) {
+	  mdata->cgroupNoFdLogged = YES;
+	  myLog(LOG_ERR, "docker: cannot open %s : %s - using the stats API for containers that do not fit",
+		fpath,
+		strerror(errno));
+	}
+      }
+    }
+    return fd;
+  }
+
+  static int openCgroupFile(EVMod *mod, HSPVMState_DOCKER *container, char *dir, char *fname) {
+    char fpath[PATH_MAX];
+    snprintf(fpath, PATH_MAX, "%s/%s", dir, fname);
+    return openCounterFile(mod, container, fpath);
+  }
+
+  static bool cgroupHasController(char *controllers, char *name) {
+    char buf[MAX_PROC_LINE_CHARS];
+    char *p = controllers;
+    char *tok;
+    while((tok = parseNextTok(&p, ",", NO, '\0', YES, buf, MAX_PROC_LINE_CHARS)) != NULL)
+      if(my_strequal(tok, name))
+	return YES;
+    return NO;
+  }
+
+  static bool containerInMyNetns(EVMod *mod, HSPVMState_DOCKER *container) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    char topath[HSP_DOCKER_MAX_FNAME_LEN+1];
+    snprintf(topath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/%u/ns/net", container->pid);
+    struct stat statBuf;
+    return (stat(topath, &statBuf) == 0
+	    && statBuf.st_dev == mdata->myNS.st_dev
+	    && statBuf.st_ino == mdata->myNS.st_ino);
+  }
+
+  static void openContainerCgroupFiles(EVMod *mod, HSPVMState_DOCKER *container, char *cpuDir, char *memDir, char *blkDir, char *unifiedDir) {
+    closeContainerCgroupFiles(container);
+    container->cgroup_nofd = NO;
+    container->cgroup_v2 = (cpuDir[0] == '\0'
+			    && memDir[0] == '\0'
+			    && blkDir[0] == '\0'
+			    && unifiedDir[0] != '\0');
+    if(container->cgroup_v2) {
+      container->cgroupFD[HSP_CGFD_CPU] = openCgroupFile(mod, container, unifiedDir, "cpu.stat");
+      container->cgroupFD[HSP_CGFD_MEM] = openCgroupFile(mod, container, unifiedDir, "memory.current");
+      container->cgroupFD[HSP_CGFD_MEMLIMIT] = openCgroupFile(mod, container, unifiedDir, "memory.max");
+      container->cgroupFD[HSP_CGFD_BLKIO_BYTES] = openCgroupFile(mod, container, unifiedDir, "io.stat");
+    }
+    else {
+      if(cpuDir[0])
+	container->cgroupFD[HSP_CGFD_CPU] = openCgroupFile(mod, container, cpuDir, "cpuacct.usage");
+      if(memDir[0]) {
+	container->cgroupFD[HSP_CGFD_MEM] = openCgroupFile(mod, container, memDir, "memory.usage_in_bytes");
+	container->cgroupFD[HSP_CGFD_MEMLIMIT] = openCgroupFile(mod, container, memDir, "memory.limit_in_bytes");
+      }
+      if(blkDir[0]) {
+	// same preference as the engine: the throttle files
+	// are the ones that remain when there is no CFQ
+	container->cgroupFD[HSP_CGFD_BLKIO_BYTES] = openCgroupFile(mod, container, blkDir, "blkio.io_service_bytes_recursive");
+	if(container->cgroupFD[HSP_CGFD_BLKIO_BYTES] < 0)
+	  container->cgroupFD[HSP_CGFD_BLKIO_BYTES] = openCgroupFile(mod, container, blkDir, "blkio.throttle.io_service_bytes");
+	container->cgroupFD[HSP_CGFD_BLKIO_OPS] = openCgroupFile(mod, container, blkDir, "blkio.io_serviced_recursive");
+	if(container->cgroupFD[HSP_CGFD_BLKIO_OPS] < 0)
+	  container->cgroupFD[HSP_CGFD_BLKIO_OPS] = openCgroupFile(mod, container, blkDir, "blkio.throttle.io_serviced");
+      }
+    }
+    // network counters as seen from inside the container's namespace. The
+    // fd stays bound to that namespace for as long as we hold it open.
+    if(!containerInMyNetns(mod, container)) {
+      char devpath[HSP_DOCKER_MAX_FNAME_LEN+1];
+      snprintf(devpath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/%u/net/dev", container->pid);
+      container->cgroupFD[HSP_CGFD_NETDEV] = openCounterFile(mod, container, devpath);
+    }
+    if(container->cgroup_nofd) {
+      // give back what we did get,  and ask the engine instead until the
+      // next HSP_CGROUP_REFRESH_TIMEOUT tries again
+      closeContainerCgroupFiles(container);
+    }
+    myDebug(1, "docker: container(%s) cgroup v%u counter files cpu=%s mem=%s blkio=%s net=%s",
+	    container->name,
+	    container->cgroup_v2 ? 2 : 1,
+	    container->cgroupFD[HSP_CGFD_CPU] >= 0 ? "YES" : "NO",
+	    container->cgroupFD[HSP_CGFD_MEM] >= 0 ? "YES" : "NO",
+	    container->cgroupFD[HSP_CGFD_BLKIO_BYTES] >= 0 ? "YES" : "NO",
+	    container->cgroupFD[HSP_CGFD_NETDEV] >= 0 ? "YES" : "NO");
+  }
+
   static void updateContainerCgroupPaths(EVMod *mod, HSPVMState_DOCKER *container) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     HSPVMState *vm = &container->vm;
     if(vm) {
+      char cpuDir[PATH_MAX] = "";
+      char memDir[PATH_MAX] = "";
+      char blkDir[PATH_MAX] = "";
+      char unifiedDir[PATH_MAX] = "";
       // open /proc/<pid>/cgroup
       char cgpath[HSP_DOCKER_MAX_FNAME_LEN+1];
       snprintf(cgpath, HSP_DOCKER_MAX_FNAME_LEN, PROCFS_STR "/%u/cgroup", container->pid);
@@ -838,10 +1092,18 @@ extern "C" {
 	while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
 	  if(!truncated) {
 	    // expect lines like 3:devices:<long_path>
+	    // or 0::<long_path> for the v2 unified hierarchy
 	    int entryNo;
 	    char type[MAX_PROC_LINE_CHARS];
 	    char path[MAX_PROC_LINE_CHARS];
-	    if(sscanf(line, "%d:%[^:]:%[^:]", &entryNo, type, path) == 3) {
+	    if(sscanf(line, "%d::%[^:]", &entryNo, path) == 2) {
+	      snprintf(unifiedDir, PATH_MAX, HSP_CGROUP_V2_DIR "/cgroup.controllers", "");
+	      if(access(unifiedDir, F_OK) == 0)
+		snprintf(unifiedDir, PATH_MAX, HSP_CGROUP_V2_DIR, path);
+	      else
+		snprintf(unifiedDir, PATH_MAX, HSP_CGROUP_V2_HYBRID_DIR, path);
+	    }
+	    else if(sscanf(line, "%d:%[^:]:%[^:]", &entryNo, type, path) == 3) {
 	      if(my_strequal(type, "devices")) {
 		if(!my_strequal(container->cgroup_devices, path)) {
 		  if(container->cgroup_devices)
@@ -850,14 +1112,202 @@ extern "C" {
 		  myDebug(1, "docker: container(%s)->cgroup_devices=%s", container->name, container->cgroup_devices);
 		}
 	      }
+	      if(cgroupHasController(type, "cpuacct"))
+		snprintf(cpuDir, PATH_MAX, HSP_CGROUP_V1_DIR, type, path);
+	      if(cgroupHasController(type, "memory"))
+		snprintf(memDir, PATH_MAX, HSP_CGROUP_V1_DIR, type, path);
+	      if(cgroupHasController(type, "blkio"))
+		snprintf(blkDir, PATH_MAX, HSP_CGROUP_V1_DIR, type, path);
 	    }
 	  }
 	}
 	fclose(procFile);
+	if(sp->docker.cgroupStats)
+	  openContainerCgroupFiles(mod, container, cpuDir, memDir, blkDir, unifiedDir);
+      }
+      else if(errno == EMFILE
+	      || errno == ENFILE)
+	container->cgroup_nofd = YES;
+    }
+  }
+
+  /*_________________-----------------------------__________________
+    _________________ readContainerCgroupCounters __________________
+    -----------------_____________________________------------------
+    The same numbers the stats API would have given us,  read from
+    the files opened above.  Returns NO if there is nothing to read
+    (or the cgroup went away),  so the caller can fall back to asking
+    the engine.
+  */
+
+  static char *readCgroupFile(EVMod *mod, HSPVMState_DOCKER *container, EnumHSPCgroupFD idx) {
+    HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    int fd = container->cgroupFD[idx];
+    if(fd < 0)
+      return NULL;
+    char *buf = mdata->cgroupBuf;
+    int len = 0;
+    while(len < (HSP_CGROUP_READ_BUFLEN - 1)) {
+      int n = pread(fd, buf + len, HSP_CGROUP_READ_BUFLEN - 1 - len, len);
+      if(n < 0) {
+	if(errno == EINTR)
+	  continue;
+	myDebug(1, "docker: container(%s) cgroup read failed : %s", container->name, strerror(errno));
+	return NULL;
+      }
+      if(n == 0)
+	break;
+      len += n;
+    }
+    buf[len] = '\0';
+    return buf;
+  }
+
+  static bool readCgroupValue(EVMod *mod, HSPVMState_DOCKER *container, EnumHSPCgroupFD idx, uint64_t *val) {
+    char *buf = readCgroupFile(mod, container, idx);
+    return (buf
+	    && sscanf(buf, "%"SCNu64, val) == 1);
+  }
+
+  static void readCgroupBlkio(EVMod *mod, HSPVMState_DOCKER *container) {
+    char *line, *save;
+    char *buf = readCgroupFile(mod, container, HSP_CGFD_BLKIO_BYTES);
+    if(buf == NULL)
+      return;
+    memset(&container->dsk, 0, sizeof(container->dsk));
+    if(container->cgroup_v2) {
+      // 8:0 rbytes=1459200 wbytes=314773504 rios=192 wios=353 dbytes=0 dios=0
+      for(line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+	char *tok, *save2;
+	for(tok = strtok_r(line, " ", &save2); tok; tok = strtok_r(NULL, " ", &save2)) {
+	  uint64_t val64;
+	  if(sscanf(tok, "rbytes=%"SCNu64, &val64) == 1)
+	    container->dsk.rd_bytes += val64;
+	  else if(sscanf(tok, "wbytes=%"SCNu64, &val64) == 1)
+	    container->dsk.wr_bytes += val64;
+	  else if(sscanf(tok, "rios=%"SCNu64, &val64) == 1)
+	    container->dsk.rd_req += val64;
+	  else if(sscanf(tok, "wios=%"SCNu64, &val64) == 1)
+	    container->dsk.wr_req += val64;
+	}
+      }
+    }
+    else {
+      // 8:0 Read 29769728 (ignore "Sync", "Async" and "Total")
+      char op[MAX_PROC_LINE_CHARS];
+      uint64_t val64;
+      for(line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+	if(sscanf(line, "%*s %s %"SCNu64, op, &val64) == 2) {
+	  if(my_strequal(op, "Read"))
+	    container->dsk.rd_bytes += val64;
+	  else if(my_strequal(op, "Write"))
+	    container->dsk.wr_bytes += val64;
+	}
+      }
+      buf = readCgroupFile(mod, container, HSP_CGFD_BLKIO_OPS);
+      if(buf == NULL)
+	return;
+      for(line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+	if(sscanf(line, "%*s %s %"SCNu64, op, &val64) == 2) {
+	  if(my_strequal(op, "Read"))
+	    container->dsk.rd_req += val64;
+	  else if(my_strequal(op, "Write"))
+	    container->dsk.wr_req += val64;
+	}
+      }
+    }
+  }
+
+  static void readCgroupNetDev(EVMod *mod, HSPVMState_DOCKER *container) {
+    char *buf = readCgroupFile(mod, container, HSP_CGFD_NETDEV);
+    if(buf == NULL)
+      return;
+    // clear and accumulate over what may be multiple devices
+    memset(&container->net, 0, sizeof(container->net));
+    char *line, *save;
+    int lineNo = 0;
+    for(line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+      if(lineNo++ < 2) continue; // skip headers
+      char *sep = strchr(line, ':');
+      if(sep == NULL)
+	continue;
+      *sep = '\0';
+      char *devName = line;
+      while(*devName == ' ')
+	devName++;
+      if(my_strequal(devName, "lo"))
+	continue;
+      uint64_t bytes_in, pkts_in, errs_in, drops_in;
+      uint64_t bytes_out, pkts_out, errs_out, drops_out;
+      if(sscanf(sep + 1, "%"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %*u %*u %*u %*u %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64,
+		&bytes_in, &pkts_in, &errs_in, &drops_in,
+		&bytes_out, &pkts_out, &errs_out, &drops_out) == 8) {
+	container->net.bytes_in += bytes_in;
+	container->net.pkts_in += pkts_in;
+	container->net.errs_in += errs_in;
+	container->net.drops_in += drops_in;
+	container->net.bytes_out += bytes_out;
+	container->net.pkts_out += pkts_out;
+	container->net.errs_out += errs_out;
+	container->net.drops_out += drops_out;
       }
     }
   }
 
+  static bool readContainerCgroupCounters(EVMod *mod, HSPVMState_DOCKER *container) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(container->cgroupFD[HSP_CGFD_CPU] < 0) {
+      // not opened yet,  or closed after a failure below
+      if(container->pid == 0
+	 || container->state != HSP_CS_running
+	 || container->cgroup_nofd)
+	return NO;
+      updateContainerCgroupPaths(mod, container);
+    }
+    char *buf = readCgroupFile(mod, container, HSP_CGFD_CPU);
+    uint64_t cpu_total = 0;
+    bool cpu_ok = NO;
+    if(buf) {
+      if(container->cgroup_v2) {
+	char *line, *save;
+	for(line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+	  uint64_t usec;
+	  if(sscanf(line, "usage_usec %"SCNu64, &usec) == 1) {
+	    cpu_total = usec * 1000;
+	    cpu_ok = YES;
+	    break;
+	  }
+	}
+      }
+      else
+	cpu_ok = (sscanf(buf, "%"SCNu64, &cpu_total) == 1);
+    }
+    if(!cpu_ok) {
+      // cgroup removed? Try again next time.
+      closeContainerCgroupFiles(container);
+      return NO;
+    }
+    // nS - same as the stats API
+    container->cpu_total = cpu_total;
+
+    uint64_t val64;
+    if(readCgroupValue(mod, container, HSP_CGFD_MEM, &val64))
+      container->mem_usage = val64;
+    // no limit means the whole host,  which is also what the stats API reports
+    // (v2 writes "max" for that)
+    if((buf = readCgroupFile(mod, container, HSP_CGFD_MEMLIMIT)) != NULL) {
+      if(sscanf(buf, "%"SCNu64, &val64) == 1
+	 && (sp->mem_total == 0
+	     || val64 < sp->mem_total))
+	container->memoryLimit = val64;
+      else if(sp->mem_total)
+	container->memoryLimit = sp->mem_total;
+    }
+    readCgroupBlkio(mod, container);
+    readCgroupNetDev(mod, container);
+    return YES;
+  }
+
   /*_________________---------------------------__________________
     _________________   buildRegexPatterns      __________________
     -----------------___________________________------------------
@@ -1155,6 +1605,7 @@ extern "C" {
 
   static void dockerAPI_inspect(EVMod *mod, UTStrBuf *buf, cJSON *jcont, HSPDockerRequest *req) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     myDebug(1, "dockerAPI_inspect");
 
     cJSON *jid = cJSON_GetObjectItem(jcont, "Id");
@@ -1213,11 +1664,12 @@ extern "C" {
 
     container->inspect_rx = YES;
 
-    // now that we have the pid,  we can probe for the MAC and peer-ifIndex
-    // see if spacing the VNIC refresh reduces load
+    // now that we have the pid,  we can probe for the MAC and peer-ifIndex.
+    // After that the netns socket tells us when to look again.
     time_t now_mono = mdata->pollBus->now.tv_sec;
-    if(container->last_vnic == 0
-       || (now_mono - container->last_vnic) > HSP_VNIC_REFRESH_TIMEOUT) {
+    if(container->nl_pid != container->pid
+       || (container->nlSock == NULL
+	   && (now_mono - container->last_vnic) > HSP_VNIC_REFRESH_TIMEOUT)) {
       container->last_vnic = now_mono;
       // skip kubnetes "POD" containers to prevent IP clash
       if(!my_strnequal(container->name, "k8s_POD_", 8))
@@ -1228,7 +1680,9 @@ extern "C" {
        || (now_mono - container->last_cgroup) > HSP_CGROUP_REFRESH_TIMEOUT) {
       container->last_cgroup = now_mono;
       // TODO: skip kubnetes "POD" containers, but we might want to reverse this
-      if(!my_strnequal(container->name, "k8s_POD_", 8))
+      // (we don't skip them when they need the cgroup files for counters)
+      if(!my_strnequal(container->name, "k8s_POD_", 8)
+	 || sp->docker.cgroupStats)
 	updateContainerCgroupPaths(mod, container);
     }
 
@@ -1249,7 +1703,12 @@ extern "C" {
     // 60 seconds then it's a long time for us to not be reporting any gauges.
     // So we introduced the waitQ,  which causes us to wait just a few seconds
     // before sending the first stats request:
-    if(container->stats_wait) {
+    if(sp->docker.cgroupStats
+       && container->cgroupFD[HSP_CGFD_CPU] >= 0) {
+      // no need to wait for the engine - the first counter
+      // sample will go out when the poller comes around.
+    }
+    else if(container->stats_wait) {
       // don't send it - already one outstanding
       mdata->statsWaitRequests++;
     }
@@ -1663,10 +2122,21 @@ extern "C" {
 
   static void getContainerStats(EVMod *mod, HSPVMState_DOCKER *container) {
     HSP_mod_DOCKER *mdata = (HSP_mod_DOCKER *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     if(container->stats_wait) {
       // don't send it - already one outstanding
       mdata->statsWaitRequests++;
     }
+    else if(sp->docker.cgroupStats
+	    && readContainerCgroupCounters(mod, container)) {
+      // got everything locally,  so send the counter sample now
+      container->stats_tx = YES;
+      container->stats_rx = YES;
+      getCounters_DOCKER(mod, container);
+      // maybe this was the last one?
+      if(containerDone(mod, container))
+	removeAndFreeVM_DOCKER(mod, container);
+    }
     else {
       // actually send the stats request
       HSPDockerRequest *reqObj = containerStatsRequest(mod, container);
@@ -2356,6 +2826,8 @@ extern "C" {
     mdata->eventQueue = UTArrayNew(UTARRAY_DFLT);
     mdata->cgroupPathIdx = -1;
     mdata->reqsBySeqNo = UTHASH_NEW(HSPDockerRequest, seqNo, UTHASH_DFLT);
+    if(sp->docker.cgroupStats)
+      mdata->cgroupBuf = my_calloc(HSP_CGROUP_READ_BUFLEN);
     
     // register call-backs
     mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
@@ -2365,17 +2837,16 @@ extern "C" {
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_CONFIG_FIRST), evt_config_first);
 
     if(sp->docker.markTraffic) {
-      EVBus *packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
-      EVEventRx(mod, EVGetEvent(packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
-      mdata->vnicByIP = UTHASH_NEW(HSPVNIC, ipAddr, UTHASH_SYNC); // need sync (poll + packet thread)
+      packetBusEventRx(mod, HSPEVENT_FLOW_SAMPLE, evt_flow_sample);
+      mdata->vnicByIP = UTHASH_NEW(HSPVNIC, ipAddr, UTHASH_SYNC); // need sync (poll + packet threads)
       mdata->vnicLayer = HSP_VNIC_LAYER_IPIP; // TODO: make config parameter
-
-      // learn my own namespace inode from /proc/self/ns/net
-      if(stat("/proc/self/ns/net", &mdata->myNS) == 0)
-	myDebug(1, "my namespace dev.inode == %u.%u",
-		mdata->myNS.st_dev,
-		mdata->myNS.st_ino);
     }
+
+    // learn my own namespace inode from /proc/self/ns/net
+    if(stat("/proc/self/ns/net", &mdata->myNS) == 0)
+      myDebug(1, "my namespace dev.inode == %u.%u",
+	      mdata->myNS.st_dev,
+	      mdata->myNS.st_ino);
   }
 
 #if defined(__cplusplus)
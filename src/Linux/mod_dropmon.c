@@ -28,6 +28,7 @@ extern "C" {
 
 #define HSP_DROPMON_READNL_RCV_BUF 8192
 #define HSP_DROPMON_READNL_BATCH 100
+#define HSP_DROPMON_READNL_VLEN 32
 #define HSP_DROPMON_RCVBUF 8000000
 #define HSP_DROPMON_QUEUE 100
 
@@ -67,6 +68,7 @@ extern "C" {
     bool dropmon_configured;
     int nl_sock;
     EVSocket *nl_evsock;
+    UTNLRecvBatch *nl_batch;
     uint32_t nl_seq;
     int retry_countdown;
 #define HSP_DROPMON_WAIT_RETRY_S 15
@@ -751,7 +753,7 @@ That would allow everything to stay on the stack as it does here, which has nice
 
     SEMLOCK_DO(sp->sync_agent) {
       sfl_notifier_writeEventSample(notifier, &discard);
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+      HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
     }
 
     // first successful event confirms we are up and running
@@ -780,40 +782,45 @@ That would allow everything to stay on the stack as it does here, which has nice
     -----------------___________________________------------------
   */
 
-  static void readNetlink_DROPMON(EVMod *mod, EVSocket *sock, void *magic)
+  static void readNetlinkMsg_DROPMON(void *magic, uint8_t *recv_buf, int numbytes)
   {
+    EVMod *mod = (EVMod *)magic;
     HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
-    uint8_t recv_buf[HSP_DROPMON_READNL_RCV_BUF];
-    int batch = 0;
-    for( ; batch < HSP_DROPMON_READNL_BATCH; batch++) {
-      int numbytes = recv(sock->fd, recv_buf, sizeof(recv_buf), 0);
-      if(numbytes <= 0)
+    myDebug(1, "dropmon: readNetlink_DROPMON - msg = %d bytes", numbytes);
+    struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
+    while(NLMSG_OK(nlh, numbytes)){
+      if(nlh->nlmsg_type == NLMSG_DONE)
 	break;
-      myDebug(1, "dropmon: readNetlink_DROPMON - msg = %d bytes", numbytes);
-      struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
-      while(NLMSG_OK(nlh, numbytes)){
-	if(nlh->nlmsg_type == NLMSG_DONE)
-	  break;
-	if(nlh->nlmsg_type == NLMSG_ERROR){
-	  struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
-	  if(err_msg->error == 0) {
-	    myDebug(1, "received Netlink ACK");
-	  }
-	  else {
-	    // TODO: parse NLMSGERR_ATTR_OFFS to get offset?  Might be helpful
-	    myDebug(1, "dropmon state %u: error in netlink message: %d : %s",
-		    mdata->state,
-		    err_msg->error,
-		    strerror(-err_msg->error));
-	    if(mdata->state == HSP_DROPMON_STATE_CONFIGURE
-	       || mdata->state == HSP_DROPMON_STATE_START)
-	      mdata->feedControlErrors++;
-	  }
-	  break;
+      if(nlh->nlmsg_type == NLMSG_ERROR){
+	struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
+	if(err_msg->error == 0) {
+	  myDebug(1, "received Netlink ACK");
+	}
+	else {
+	  // TODO: parse NLMSGERR_ATTR_OFFS to get offset?  Might be helpful
+	  myDebug(1, "dropmon state %u: error in netlink message: %d : %s",
+		  mdata->state,
+		  err_msg->error,
+		  strerror(-err_msg->error));
+	  if(mdata->state == HSP_DROPMON_STATE_CONFIGURE
+	     || mdata->state == HSP_DROPMON_STATE_START)
+	    mdata->feedControlErrors++;
 	}
-	processNetlink(mod, nlh);
-	nlh = NLMSG_NEXT(nlh, numbytes);
+	break;
       }
+      processNetlink(mod, nlh);
+      nlh = NLMSG_NEXT(nlh, numbytes);
+    }
+  }
+
+  static void readNetlink_DROPMON(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    UTNLRecvBatch_read(mdata->nl_batch, sock->fd, HSP_DROPMON_READNL_BATCH, mod, readNetlinkMsg_DROPMON);
+    if(mdata->nl_batch->overruns) {
+      myDebug(1, "dropmon: netlink socket overrun (%u)", mdata->nl_batch->overruns);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_NETLINK_OVERRUNS, mdata->nl_batch->overruns);
     }
 
     // This should have advanced the state past GET_FAMILY
@@ -852,6 +859,7 @@ That would allow everything to stay on the stack as it does here, which has nice
       if(mdata->nl_sock > 0) {
 	// increase socket receiver buffer size
 	UTSocketRcvbuf(mdata->nl_sock, HSP_DROPMON_RCVBUF);
+	mdata->nl_batch = UTNLRecvBatch_new(HSP_DROPMON_READNL_VLEN, HSP_DROPMON_READNL_RCV_BUF);
 	// and submit for polling
 	mdata->nl_evsock = EVBusAddSocket(mod,
 					  mdata->packetBus,
@@ -892,6 +900,10 @@ That would allow everything to stay on the stack as it does here, which has nice
       EVSocketClose(mod, mdata->nl_evsock, YES);
       mdata->nl_evsock = NULL;
     }
+    if(mdata->nl_batch) {
+      UTNLRecvBatch_free(mdata->nl_batch);
+      mdata->nl_batch = NULL;
+    }
   }
 
   /*_________________---------------------------__________________
@@ -972,11 +984,12 @@ That would allow everything to stay on the stack as it does here, which has nice
   }
 
   /*_________________---------------------------__________________
-    _________________    evt_deci               __________________
+    _________________    timer_quota            __________________
     -----------------___________________________------------------
+    Only armed when the rate-limit is 10 or more.
   */
 
-  static void evt_deci(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
+  static void timer_quota(EVMod *mod, EVTimer *timer, void *magic) {
     HSP_mod_DROPMON *mdata = (HSP_mod_DROPMON *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
 
@@ -984,8 +997,7 @@ That would allow everything to stay on the stack as it does here, which has nice
       return;
 
     // when rate-limit is above 10 we refresh quota here
-    if(sp->dropmon.limit >= 10)
-      mdata->quota = sp->dropmon.limit / 10;
+    mdata->quota = sp->dropmon.limit / 10;
   }
 
   /*_________________---------------------------__________________
@@ -1021,10 +1033,11 @@ That would allow everything to stay on the stack as it does here, which has nice
     mdata->dropPatterns_sw = UTArrayNew(UTARRAY_DFLT);
     mdata->notifiers = UTHASH_NEW(SFLNotifier, dsi, UTHASH_DFLT);
     loadDropPoints(mod);
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    mdata->packetBus = packetBusForModule(mod);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_DECI), evt_deci);
+    if(sp->dropmon.limit >= 10)
+      EVTimerAdd(mod, mdata->packetBus, 100, 100, timer_quota, NULL);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_FINAL), evt_final);
   }
 
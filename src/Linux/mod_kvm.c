@@ -180,7 +180,7 @@ extern "C" {
 	SEMLOCK_DO(sp->sync_agent) {
 	  sfl_poller_writeCountersSample(poller, cs);
 	  sp->counterSampleQueued = YES;
-	  sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+	  HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
 	}
 
 	virDomainFree(domainPtr);
@@ -422,9 +422,9 @@ extern "C" {
 	// fully delete and free the marked adaptors - some may return if
 	// they are still present in the global-namespace list,  but
 	// we have to do this here in case one of these was discovered
-	// and allocated just for this VM.
+	// and allocated just for this VM.  They are freed after the
+	// ifIndex map grace period.
 	deleteMarkedAdaptors_adaptorList(sp, vm->interfaces);
-	adaptorListFreeMarked(vm->interfaces);
       }
     }
     mdata->num_domains = num_domains;
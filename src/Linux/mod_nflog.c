@@ -16,15 +16,19 @@ extern "C" {
    (ignoring MTU constraints). */
 #define HSP_MAX_NFLOG_MSG_BYTES 65536 + 128
 #define HSP_NFLOG_RCV_BUF 8000000
+#define HSP_READPACKET_VLEN_NFLOG 16
 
 #include <linux/netfilter/nfnetlink_log.h>
 #include <libnfnetlink.h>
 
+#include "util_netlink.h"
+
   typedef struct _HSP_mod_NFLOG {
     EVBus *packetBus;
     bool nflog_configured;
     // nflog packet sampling
     struct nfnl_handle *nfnl;
+    UTNLRecvBatch *nl_batch;
     uint32_t nflog_seqno;
     uint32_t nflog_drops;
     uint32_t subSamplingRate;
@@ -36,146 +40,151 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  static void readPackets_nflog(EVMod *mod, EVSocket *sock, void *magic)
+  static void readPacketMsg_nflog(void *magic, uint8_t *buf, int len)
   {
+    EVMod *mod = (EVMod *)magic;
     HSP_mod_NFLOG *mdata = (HSP_mod_NFLOG *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
-    int batch = 0;
     static uint32_t MySkipCount=1;
 
-    if(sp->sFlowSettings == NULL) {
-      // config was turned off
-      return;
-    }
-
-    if(mdata->subSamplingRate == 0) {
-      // packet sampling was disabled by setting desired rate to 0
-      return;
+    if(getDebug() > 1) {
+      struct nlmsghdr *msg = (struct nlmsghdr *)buf;
+      myLog(LOG_INFO, "got NFLOG msg: bytes_read=%u nlmsg_len=%u nlmsg_type=%u OK=%s",
+	    len,
+	    msg->nlmsg_len,
+	    msg->nlmsg_type,
+	    NLMSG_OK(msg, len) ? "true" : "false");
     }
-
-    for( ; batch < HSP_READPACKET_BATCH_NFLOG; batch++) {
-      u_char buf[HSP_MAX_NFLOG_MSG_BYTES];
-      int len = nfnl_recv(mdata->nfnl,
-			  buf,
-			  HSP_MAX_NFLOG_MSG_BYTES);
-      if(len <= 0) break;
+    for(struct nlmsghdr *msg = (struct nlmsghdr *)buf; NLMSG_OK(msg, len); msg=NLMSG_NEXT(msg, len)) {
       if(getDebug() > 1) {
-	struct nlmsghdr *msg = (struct nlmsghdr *)buf;
-	myLog(LOG_INFO, "got NFLOG msg: bytes_read=%u nlmsg_len=%u nlmsg_type=%u OK=%s",
+	myLog(LOG_INFO, "netlink (%u bytes left) msg [len=%u type=%u flags=0x%x seq=%u pid=%u]",
 	      len,
 	      msg->nlmsg_len,
 	      msg->nlmsg_type,
-	      NLMSG_OK(msg, len) ? "true" : "false");
+	      msg->nlmsg_flags,
+	      msg->nlmsg_seq,
+	      msg->nlmsg_pid);
       }
-      for(struct nlmsghdr *msg = (struct nlmsghdr *)buf; NLMSG_OK(msg, len); msg=NLMSG_NEXT(msg, len)) {
-	if(getDebug() > 1) {
-	  myLog(LOG_INFO, "netlink (%u bytes left) msg [len=%u type=%u flags=0x%x seq=%u pid=%u]",
-		len,
-		msg->nlmsg_len,
-		msg->nlmsg_type,
-		msg->nlmsg_flags,
-		msg->nlmsg_seq,
-		msg->nlmsg_pid);
-	}
 
-	// check for drops indicated by sequence no
-	uint32_t droppedSamples = 0;
-	if(mdata->nflog_seqno) {
-	  droppedSamples = msg->nlmsg_seq - mdata->nflog_seqno - 1;
-	  if(droppedSamples) {
-	    mdata->nflog_drops += droppedSamples;
-	  }
+      // check for drops indicated by sequence no
+      uint32_t droppedSamples = 0;
+      if(mdata->nflog_seqno) {
+	droppedSamples = msg->nlmsg_seq - mdata->nflog_seqno - 1;
+	if(droppedSamples) {
+	  mdata->nflog_drops += droppedSamples;
 	}
-	mdata->nflog_seqno = msg->nlmsg_seq;
-
-	switch(msg->nlmsg_type) {
-	case NLMSG_NOOP:
-	case NLMSG_ERROR:
-	case NLMSG_OVERRUN:
-	  // ignore these
-	  break;
-	case NLMSG_DONE: // last in multi-part
-	default:
-	  {
-	    struct nfgenmsg *genmsg;
-	    struct nfattr *attr = nfnl_parse_hdr(mdata->nfnl, msg, &genmsg);
-	    if(attr == NULL) {
-	      continue;
-	    }
-	    int min_len = NLMSG_SPACE(sizeof(struct nfgenmsg));
-	    int attr_len = msg->nlmsg_len - NLMSG_ALIGN(min_len);
-	    struct nfattr *tb[NFULA_MAX] = { 0 };
-
-	    while (NFA_OK(attr, attr_len)) {
-	      if (NFA_TYPE(attr) <= NFULA_MAX) {
-		tb[NFA_TYPE(attr)-1] = attr;
-		myDebug(3, "found attr %d attr_len=%d\n", NFA_TYPE(attr), attr_len);
-	      }
-	      attr = NFA_NEXT(attr,attr_len);
-	    }
-	    // get the essential fields so we know this is really a packet we can sample
-	    struct nfulnl_msg_packet_hdr *msg_pkt_hdr = nfnl_get_pointer_to_data(tb, NFULA_PACKET_HDR, struct nfulnl_msg_packet_hdr);
-	    u_char *cap_hdr = nfnl_get_pointer_to_data(tb, NFULA_PAYLOAD, u_char);
-	    int cap_len = NFA_PAYLOAD(tb[NFULA_PAYLOAD-1]);
-	    if(msg_pkt_hdr == NULL
-	       || cap_hdr == NULL
-	       || cap_len <= 0) {
-	      // not a packet header msg, or no captured payload found
-	      continue;
+      }
+      mdata->nflog_seqno = msg->nlmsg_seq;
+
+      switch(msg->nlmsg_type) {
+      case NLMSG_NOOP:
+      case NLMSG_ERROR:
+      case NLMSG_OVERRUN:
+	// ignore these
+	break;
+      case NLMSG_DONE: // last in multi-part
+      default:
+	{
+	  struct nfgenmsg *genmsg;
+	  struct nfattr *attr = nfnl_parse_hdr(mdata->nfnl, msg, &genmsg);
+	  if(attr == NULL) {
+	    continue;
+	  }
+	  int min_len = NLMSG_SPACE(sizeof(struct nfgenmsg));
+	  int attr_len = msg->nlmsg_len - NLMSG_ALIGN(min_len);
+	  struct nfattr *tb[NFULA_MAX] = { 0 };
+
+	  while (NFA_OK(attr, attr_len)) {
+	    if (NFA_TYPE(attr) <= NFULA_MAX) {
+	      tb[NFA_TYPE(attr)-1] = attr;
+	      myDebug(3, "found attr %d attr_len=%d\n", NFA_TYPE(attr), attr_len);
 	    }
+	    attr = NFA_NEXT(attr,attr_len);
+	  }
+	  // get the essential fields so we know this is really a packet we can sample
+	  struct nfulnl_msg_packet_hdr *msg_pkt_hdr = nfnl_get_pointer_to_data(tb, NFULA_PACKET_HDR, struct nfulnl_msg_packet_hdr);
+	  u_char *cap_hdr = nfnl_get_pointer_to_data(tb, NFULA_PAYLOAD, u_char);
+	  int cap_len = NFA_PAYLOAD(tb[NFULA_PAYLOAD-1]);
+	  if(msg_pkt_hdr == NULL
+	     || cap_hdr == NULL
+	     || cap_len <= 0) {
+	    // not a packet header msg, or no captured payload found
+	    continue;
+	  }
 
-	    myDebug(3, "capture payload (cap_len)=%d\n", cap_len);
-
-	    if(--MySkipCount == 0) {
-	      /* reached zero. Set the next skip */
-	      uint32_t sr = mdata->subSamplingRate;
-	      MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
-
-	      /* and take a sample */
-	      char *prefix = nfnl_get_pointer_to_data(tb, NFULA_PREFIX, char);
-	      uint32_t ifin_phys = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_PHYSINDEV, uint32_t));
-	      uint32_t ifout_phys = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_PHYSOUTDEV, uint32_t));
-	      uint32_t ifin = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_INDEV, uint32_t));
-	      uint32_t ifout = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_OUTDEV, uint32_t));
-	      u_char *mac_hdr = nfnl_get_pointer_to_data(tb, NFULA_HWHEADER, u_char);
-	      uint16_t mac_len = ntohs(nfnl_get_data(tb, NFULA_HWLEN, uint16_t));
-	      uint32_t mark = ntohl(nfnl_get_data(tb, NFULA_MARK, uint32_t));
-	      uint32_t seq = ntohl(nfnl_get_data(tb, NFULA_SEQ, uint32_t));
-	      uint32_t seq_global = ntohl(nfnl_get_data(tb, NFULA_SEQ_GLOBAL, uint32_t));
-
-	      if(getDebug() > 1) {
-		myLog(LOG_INFO, "NFLOG prefix: %s in: %u (phys=%u) out: %u (phys=%u) seq: %u seq_global: %u mark: %u\n",
-		      prefix,
-		      ifin,
-		      ifin_phys,
-		      ifout,
-		      ifout_phys,
-		      seq,
-		      seq_global,
-		      mark);
-	      }
-
-	      takeSample(sp,
-			 adaptorByIndex(sp, (ifin_phys ?: ifin)),
-			 adaptorByIndex(sp, (ifout_phys ?: ifout)),
-			 NULL,
- 			 sp->nflog.ds_options,
-			 msg_pkt_hdr->hook,
-			 mac_hdr,
-			 mac_len,
-			 cap_hdr,
-			 cap_len, /* length of captured payload */
-			 cap_len, /* length of packet (pdu) */
-			 droppedSamples,
-			 mdata->actualSamplingRate,
-			 NULL);
+	  myDebug(3, "capture payload (cap_len)=%d\n", cap_len);
+
+	  if(--MySkipCount == 0) {
+	    /* reached zero. Set the next skip */
+	    uint32_t sr = mdata->subSamplingRate;
+	    MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
+
+	    /* and take a sample */
+	    char *prefix = nfnl_get_pointer_to_data(tb, NFULA_PREFIX, char);
+	    uint32_t ifin_phys = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_PHYSINDEV, uint32_t));
+	    uint32_t ifout_phys = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_PHYSOUTDEV, uint32_t));
+	    uint32_t ifin = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_INDEV, uint32_t));
+	    uint32_t ifout = ntohl(nfnl_get_data(tb, NFULA_IFINDEX_OUTDEV, uint32_t));
+	    u_char *mac_hdr = nfnl_get_pointer_to_data(tb, NFULA_HWHEADER, u_char);
+	    uint16_t mac_len = ntohs(nfnl_get_data(tb, NFULA_HWLEN, uint16_t));
+	    uint32_t mark = ntohl(nfnl_get_data(tb, NFULA_MARK, uint32_t));
+	    uint32_t seq = ntohl(nfnl_get_data(tb, NFULA_SEQ, uint32_t));
+	    uint32_t seq_global = ntohl(nfnl_get_data(tb, NFULA_SEQ_GLOBAL, uint32_t));
+
+	    if(getDebug() > 1) {
+	      myLog(LOG_INFO, "NFLOG prefix: %s in: %u (phys=%u) out: %u (phys=%u) seq: %u seq_global: %u mark: %u\n",
+		    prefix,
+		    ifin,
+		    ifin_phys,
+		    ifout,
+		    ifout_phys,
+		    seq,
+		    seq_global,
+		    mark);
 	    }
+
+	    takeSample(sp,
+		       packetAdaptorByIndex(sp, (ifin_phys ?: ifin)),
+		       packetAdaptorByIndex(sp, (ifout_phys ?: ifout)),
+		       NULL,
+		       sp->nflog.ds_options,
+		       msg_pkt_hdr->hook,
+		       mac_hdr,
+		       mac_len,
+		       cap_hdr,
+		       cap_len, /* length of captured payload */
+		       cap_len, /* length of packet (pdu) */
+		       droppedSamples,
+		       mdata->actualSamplingRate,
+		       NULL);
 	  }
 	}
       }
     }
   }
 
+  static void readPackets_nflog(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_NFLOG *mdata = (HSP_mod_NFLOG *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    if(sp->sFlowSettings == NULL) {
+      // config was turned off
+      return;
+    }
+
+    if(mdata->subSamplingRate == 0) {
+      // packet sampling was disabled by setting desired rate to 0
+      return;
+    }
+
+    UTNLRecvBatch_read(mdata->nl_batch, sock->fd, HSP_READPACKET_BATCH_NFLOG, mod, readPacketMsg_nflog);
+    if(mdata->nl_batch->overruns) {
+      myDebug(1, "NFLOG: netlink socket overrun (%u)", mdata->nl_batch->overruns);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_NETLINK_OVERRUNS, mdata->nl_batch->overruns);
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________     openNFLOG             __________________
     -----------------___________________________------------------
@@ -308,8 +317,10 @@ extern "C" {
       // NFLOG group is set, so open the netfilter
       // socket to NFLOG while we are still root
       int fd = openNFLOG(mod);
-      if(fd > 0)
+      if(fd > 0) {
+	mdata->nl_batch = UTNLRecvBatch_new(HSP_READPACKET_VLEN_NFLOG, HSP_MAX_NFLOG_MSG_BYTES);
 	EVBusAddSocket(mod, mdata->packetBus, fd, readPackets_nflog, NULL);
+      }
     }
 
     mdata->nflog_configured = YES;
@@ -332,7 +343,7 @@ extern "C" {
   void mod_nflog(EVMod *mod) {
     mod->data = my_calloc(sizeof(HSP_mod_NFLOG));
     HSP_mod_NFLOG *mdata = (HSP_mod_NFLOG *)mod->data;
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    mdata->packetBus = packetBusForModule(mod);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_INTFS_CHANGED), evt_intfs_changed);
   }
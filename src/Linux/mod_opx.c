@@ -1057,7 +1057,7 @@ extern "C" {
     HSP *sp = (HSP *)EVROOTDATA(mod);
     mod->data = my_calloc(sizeof(HSP_mod_OPX));
     HSP_mod_OPX *mdata = (HSP_mod_OPX *)mod->data;
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    mdata->packetBus = packetBusForModule(mod);
     mdata->pollBus = EVGetBus(mod, HSPBUS_POLL, YES);
 
     retainRootRequest(mod, "Needed to call out to OPX scripts (PYTHONPATH)");
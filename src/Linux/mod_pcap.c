@@ -21,6 +21,15 @@ extern "C" {
 #include <pcap.h>
 #define HSP_READPACKET_BATCH_PCAP 10000
 
+  // TPACKET_V3 ring geometry. The BPF sampling filter means we only
+  // see the sampled packets here, so the ring does not need to be big.
+  // Blocks are handed to user-space when full or when the retire
+  // timeout expires, whichever comes first.
+#define HSP_PCAP_RING_BLOCK_SIZE (1 << 20)
+#define HSP_PCAP_RING_BLOCKS 8
+#define HSP_PCAP_RING_FRAME_SIZE 2048
+#define HSP_PCAP_RING_RETIRE_MS 50
+
   typedef struct _BPFSoc {
     EVMod *module;
     char *deviceName;
@@ -28,19 +37,43 @@ extern "C" {
     EVSocket *sock;
     uint32_t samplingRate;
     uint32_t subSamplingRate;
+    uint32_t skipCount;
     uint32_t drops;
     bool promisc:1;
     bool vport:1;
     bool vport_set:1;
+    bool ring:1;
     pcap_t *pcap;
     char pcap_err[PCAP_ERRBUF_SIZE];
+    // TPACKET_V3 ring
+    int ring_fd;
+    uint8_t *ring_map;
+    size_t ring_len;
+    struct tpacket_req3 ring_req;
+    uint32_t ring_blk;
+    int ring_soerr; // last SO_ERROR logged
   } BPFSoc;
 
-  typedef struct _HSP_mod_PCAP {
+  // With more than one packet bus shard, every shard opens its own
+  // socket on each device and the kernel fans the packets out
+  // across them (PACKET_FANOUT), so each shard only ever touches
+  // its own BPFSoc objects.
+  typedef struct _HSPPcapShard {
     UTArray *bpf_socs;
     EVBus *packetBus;
+  } HSPPcapShard;
+
+  typedef struct _HSP_mod_PCAP {
+    HSPPcapShard *shards;
   } HSP_mod_PCAP;
 
+  static HSPPcapShard *pcapShard(EVMod *mod) {
+    HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
+    int shard = packetBusShardIndex(mod, EVCurrentBus());
+    assert(shard >= 0);
+    return &mdata->shards[shard];
+  }
+
   static void tap_close(EVMod *mod, BPFSoc *bpfs);
 
   /*_________________---------------------------__________________
@@ -48,12 +81,12 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  // function of type pcap_handler
+  // common to libpcap callback and TPACKET_V3 ring walk.  The ring
+  // passes any 802.1Q tag that the kernel stripped as vlanTag
+  // (TPID << 16 | TCI),  or 0 if there was none.
 
-  static void readPackets_pcap_cb(u_char *user, const struct pcap_pkthdr *hdr, const u_char *buf)
+  static void samplePacket(BPFSoc *bpfs, const u_char *buf, uint32_t caplen, uint32_t len, uint32_t vlanTag)
   {
-    static uint32_t MySkipCount=1;
-    BPFSoc *bpfs = (BPFSoc *)user;
     uint32_t sr = bpfs->subSamplingRate;
 
     if(sr == 0) {
@@ -61,13 +94,30 @@ extern "C" {
       return;
     }
 
-    if(--MySkipCount == 0) {
+    if(--bpfs->skipCount == 0) {
       /* reached zero. Set the next skip */
-      MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
+      bpfs->skipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
 
       EVMod *mod = bpfs->module;
       HSP *sp = (HSP *)EVROOTDATA(mod);
 
+      // put the tag back where libpcap would have it,  so the
+      // sampled header is the same in both modes
+      u_char vlanBuf[HSP_PCAP_RING_FRAME_SIZE + 4];
+      if(vlanTag) {
+	if(caplen > HSP_PCAP_RING_FRAME_SIZE)
+	  caplen = HSP_PCAP_RING_FRAME_SIZE;
+	memcpy(vlanBuf, buf, 12);
+	vlanBuf[12] = vlanTag >> 24;
+	vlanBuf[13] = vlanTag >> 16;
+	vlanBuf[14] = vlanTag >> 8;
+	vlanBuf[15] = vlanTag;
+	memcpy(vlanBuf + 16, buf + 12, caplen - 12);
+	buf = vlanBuf;
+	caplen += 4;
+	len += 4;
+      }
+
       // global MAC -> adaptor
       SFLMacAddress macdst, macsrc;
       memset(&macdst, 0, sizeof(macdst));
@@ -118,14 +168,21 @@ extern "C" {
 		 buf /* mac hdr*/,
 		 14 /* mac len */,
 		 buf + 14 /* payload */,
-		 hdr->caplen - 14, /* length of captured payload */
-		 hdr->len - 14, /* length of packet (pdu) */
+		 caplen - 14, /* length of captured payload */
+		 len - 14, /* length of packet (pdu) */
 		 bpfs->drops, /* droppedSamples */
 		 bpfs->samplingRate,
 		 NULL);
     }
   }
 
+  // function of type pcap_handler
+
+  static void readPackets_pcap_cb(u_char *user, const struct pcap_pkthdr *hdr, const u_char *buf)
+  {
+    samplePacket((BPFSoc *)user, buf, hdr->caplen, hdr->len, 0);
+  }
+
   static void readPackets_pcap(EVMod *mod, EVSocket *sock, void *magic)
   {
     BPFSoc *bpfs = (BPFSoc *)magic;
@@ -140,6 +197,62 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________    readPackets_ring       __________________
+    -----------------___________________________------------------
+    Walk the TPACKET_V3 blocks that the kernel has retired to us,
+    sampling each packet in place, and hand each block back as soon
+    as we are done with it.  A pending socket error (e.g. ENETDOWN
+    after a link flap) keeps EPOLLERR asserted until it is read,  so
+    consume it here first.  The kernel strips any VLAN tag into
+    tp_vlan_tci,  so we pass it along to be reinserted (as libpcap
+    does) if the packet is sampled.
+  */
+
+  static uint32_t ringVlanTag(struct tpacket3_hdr *pkt) {
+    if((pkt->tp_status & TP_STATUS_VLAN_VALID) == 0)
+      return 0;
+    uint32_t tpid = ETH_P_8021Q;
+#ifdef TP_STATUS_VLAN_TPID_VALID
+    if((pkt->tp_status & TP_STATUS_VLAN_TPID_VALID)
+       && pkt->hv1.tp_vlan_tpid)
+      tpid = pkt->hv1.tp_vlan_tpid;
+#endif
+    return (tpid << 16) | (pkt->hv1.tp_vlan_tci & 0xFFFF);
+  }
+
+  static void readPackets_ring(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    BPFSoc *bpfs = (BPFSoc *)magic;
+    int soerr = 0;
+    socklen_t soerrLen = sizeof(soerr);
+    if(getsockopt(sock->fd, SOL_SOCKET, SO_ERROR, &soerr, &soerrLen) == 0
+       && soerr
+       && soerr != bpfs->ring_soerr) {
+      // log each distinct error once
+      myLog(LOG_ERR, "PCAP: ring(%s) socket error: %s", bpfs->deviceName, strerror(soerr));
+      bpfs->ring_soerr = soerr;
+    }
+    for(uint32_t nblk = 0; nblk < bpfs->ring_req.tp_block_nr; nblk++) {
+      struct tpacket_block_desc *pbd = (struct tpacket_block_desc *)
+	(bpfs->ring_map + (bpfs->ring_blk * bpfs->ring_req.tp_block_size));
+      if((pbd->hdr.bh1.block_status & TP_STATUS_USER) == 0)
+	break;
+      __sync_synchronize(); // read block contents only after status
+      uint32_t npkts = pbd->hdr.bh1.num_pkts;
+      struct tpacket3_hdr *pkt = (struct tpacket3_hdr *)((uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt);
+      for(uint32_t ii = 0; ii < npkts; ii++) {
+	if(pkt->tp_snaplen >= 14)
+	  samplePacket(bpfs, (uint8_t *)pkt + pkt->tp_mac, pkt->tp_snaplen, pkt->tp_len, ringVlanTag(pkt));
+	pkt = (struct tpacket3_hdr *)((uint8_t *)pkt + pkt->tp_next_offset);
+      }
+      // give it back to the kernel
+      __sync_synchronize();
+      pbd->hdr.bh1.block_status = TP_STATUS_KERNEL;
+      bpfs->ring_blk = (bpfs->ring_blk + 1) % bpfs->ring_req.tp_block_nr;
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________   setKernelSampling       __________________
     -----------------___________________________------------------
@@ -207,6 +320,10 @@ extern "C" {
 
     // overwrite the sampling-rate
     code[1].k = bpfs->samplingRate;
+    // libpcap truncates to snaplen in user-space, but for the
+    // ring we want the kernel to copy only the header bytes
+    if(bpfs->ring)
+      code[3].k = sp->sFlowSettings_file->headerBytes;
     myDebug(1, "PCAP: sampling rate set to %u for dev=%s", code[1].k, bpfs->deviceName);
     struct sock_fprog bpf = {
       .len = 5, // ARRAY_SIZE(code),
@@ -233,31 +350,150 @@ extern "C" {
   */
 
   static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
+    HSPPcapShard *shard = pcapShard(mod);
     // read pcap stats to get drops - will go out with
     // packet samples sent from readPackets.c
     BPFSoc *bpfs;
-    UTARRAY_WALK(mdata->bpf_socs, bpfs) {
+    UTARRAY_WALK(shard->bpf_socs, bpfs) {
       struct pcap_stat stats;
       if(bpfs->pcap
 	 && pcap_stats(bpfs->pcap, &stats) == 0) {
 	bpfs->drops = stats.ps_drop;
       }
+      // PACKET_STATISTICS is reset on every read, so accumulate
+      // to get the same cumulative semantics as pcap_stats()
+      struct tpacket_stats_v3 rstats;
+      socklen_t rstats_len = sizeof(rstats);
+      if(bpfs->ring_map
+	 && getsockopt(bpfs->ring_fd, SOL_PACKET, PACKET_STATISTICS, &rstats, &rstats_len) == 0) {
+	bpfs->drops += rstats.tp_drops;
+      }
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________      setFanout            __________________
+    -----------------___________________________------------------
+    Join this shard's socket to the device's fanout group. The group
+    id only has to agree across our shards for the same device and
+    be unlikely to clash with another process on the same device.
+    Must be called after the socket is bound.
+  */
+
+  static void setFanout(HSP *sp, BPFSoc *bpfs, int fd) {
+    if(sp->packetBusShards <= 1)
+      return;
+    uint32_t group_id = (getpid() + bpfs->adaptor->ifIndex) & 0xFFFF;
+    int fanout_arg = group_id | (PACKET_FANOUT_HASH << 16);
+    if(setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof(fanout_arg)) < 0)
+      myLog(LOG_ERR, "PCAP: PACKET_FANOUT(%s) failed: %s", bpfs->deviceName, strerror(errno));
+    else
+      myDebug(1, "PCAP: device %s joined fanout group %u", bpfs->deviceName, group_id);
+  }
+
   /*_________________---------------------------__________________
     _________________      tap_open             __________________
     -----------------___________________________------------------
   */
   
+  static void ring_open(EVMod *mod, BPFSoc *bpfs) {
+    HSPPcapShard *shard = pcapShard(mod);
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
+    // protocol 0 so nothing is delivered until the bind() below,
+    // by which time the filter and the ring are in place
+    int fd = socket(PF_PACKET, SOCK_RAW, 0);
+    if(fd < 0) {
+      myLog(LOG_ERR, "PCAP: ring socket(%s) failed: %s", bpfs->deviceName, strerror(errno));
+      return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    // install the sampling filter before we bind, so the ring
+    // never sees the unsampled firehose
+    if(bpfs->samplingRate > 1)
+      setKernelSampling(sp, bpfs, fd);
+
+    int ver = TPACKET_V3;
+    if(setsockopt(fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0) {
+      myLog(LOG_ERR, "PCAP: ring PACKET_VERSION(%s) failed: %s", bpfs->deviceName, strerror(errno));
+      goto fail;
+    }
+
+    struct tpacket_req3 *req = &bpfs->ring_req;
+    memset(req, 0, sizeof(*req));
+    req->tp_block_size = HSP_PCAP_RING_BLOCK_SIZE;
+    req->tp_block_nr = HSP_PCAP_RING_BLOCKS;
+    req->tp_frame_size = HSP_PCAP_RING_FRAME_SIZE;
+    req->tp_frame_nr = (req->tp_block_size * req->tp_block_nr) / req->tp_frame_size;
+    req->tp_retire_blk_tov = HSP_PCAP_RING_RETIRE_MS;
+    if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, req, sizeof(*req)) < 0) {
+      myLog(LOG_ERR, "PCAP: ring PACKET_RX_RING(%s) failed: %s", bpfs->deviceName, strerror(errno));
+      goto fail;
+    }
+
+    bpfs->ring_len = req->tp_block_size * req->tp_block_nr;
+    bpfs->ring_map = mmap(NULL, bpfs->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, fd, 0);
+    if(bpfs->ring_map == MAP_FAILED) {
+      // MAP_LOCKED may be refused under RLIMIT_MEMLOCK, so try without
+      bpfs->ring_map = mmap(NULL, bpfs->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if(bpfs->ring_map == MAP_FAILED) {
+      myLog(LOG_ERR, "PCAP: ring mmap(%s) failed: %s", bpfs->deviceName, strerror(errno));
+      bpfs->ring_map = NULL;
+      goto fail;
+    }
+    bpfs->ring_blk = 0;
+
+    struct sockaddr_ll sll = { 0 };
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = bpfs->adaptor->ifIndex;
+    if(bind(fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+      myLog(LOG_ERR, "PCAP: ring bind(%s) failed: %s", bpfs->deviceName, strerror(errno));
+      goto fail;
+    }
+
+    if(bpfs->promisc) {
+      struct packet_mreq mreq = { 0 };
+      mreq.mr_ifindex = bpfs->adaptor->ifIndex;
+      mreq.mr_type = PACKET_MR_PROMISC;
+      if(setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0)
+	myLog(LOG_ERR, "PCAP: ring PACKET_MR_PROMISC(%s) failed: %s", bpfs->deviceName, strerror(errno));
+    }
+
+    setFanout(sp, bpfs, fd);
+
+    myDebug(1, "PCAP: device %s ring opened OK (blocks=%u blocksize=%u)",
+	    bpfs->deviceName,
+	    req->tp_block_nr,
+	    req->tp_block_size);
+
+    bpfs->ring_fd = fd;
+    bpfs->sock = EVBusAddSocket(mod, shard->packetBus, fd, readPackets_ring, bpfs);
+    forceCounterPolling(sp, bpfs->adaptor);
+    return;
+
+  fail:
+    if(bpfs->ring_map) {
+      munmap(bpfs->ring_map, bpfs->ring_len);
+      bpfs->ring_map = NULL;
+    }
+    close(fd);
+  }
+
   static void tap_open(EVMod *mod, BPFSoc *bpfs) {
-    HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
+    HSPPcapShard *shard = pcapShard(mod);
     HSP *sp = (HSP *)EVROOTDATA(mod);
     
     bpfs->samplingRate = lookupPacketSamplingRate(bpfs->adaptor, sp->sFlowSettings);
     bpfs->subSamplingRate = bpfs->samplingRate;
 
+    if(bpfs->ring) {
+      ring_open(mod, bpfs);
+      return;
+    }
+
     // create pcap
     if((bpfs->pcap = pcap_create(bpfs->deviceName, bpfs->pcap_err)) == NULL) {
       myLog(LOG_ERR, "PCAP: device %s open failed: %s", bpfs->deviceName, bpfs->pcap_err);
@@ -303,8 +539,11 @@ extern "C" {
     if(bpfs->samplingRate > 1)
       setKernelSampling(sp, bpfs, fd);
 
+    // share the device with the other shards
+    setFanout(sp, bpfs, fd);
+
     // register
-    bpfs->sock = EVBusAddSocket(mod, mdata->packetBus, fd, readPackets_pcap, bpfs);
+    bpfs->sock = EVBusAddSocket(mod, shard->packetBus, fd, readPackets_pcap, bpfs);
 
     // assume we always want to get counters for anything we are tapping.
     // Have to force this here in case there are no samples that would
@@ -319,13 +558,20 @@ extern "C" {
   
   static void tap_close(EVMod *mod, BPFSoc *bpfs) {
     bpfs->adaptor = NULL;
-    bpfs->sock->fd = -1;
+    if(bpfs->sock) {
+      // pcap_close() will close the fd itself, but the ring
+      // socket is ours to close
+      EVSocketClose(mod, bpfs->sock, (bpfs->pcap == NULL));
+      bpfs->sock = NULL;
+    }
     if(bpfs->pcap) {
       pcap_close(bpfs->pcap);
       bpfs->pcap = NULL;
     }
-    EVSocketClose(mod, bpfs->sock, YES);
-    bpfs->sock = NULL;
+    if(bpfs->ring_map) {
+      munmap(bpfs->ring_map, bpfs->ring_len);
+      bpfs->ring_map = NULL;
+    }
   }
 
   /*_________________---------------------------__________________
@@ -333,16 +579,18 @@ extern "C" {
     -----------------___________________________------------------
   */
   static void addBPFSocket(EVMod *mod,  HSPPcap *pcap, SFLAdaptor *adaptor) {
-    HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
-    myDebug(1, "PCAP addBPFSocket(%s) speed=%"PRIu64, adaptor->deviceName, adaptor->ifSpeed);
+    HSPPcapShard *shard = pcapShard(mod);
+    myDebug(1, "PCAP addBPFSocket(%s) speed=%"PRIu64" bus=%s", adaptor->deviceName, adaptor->ifSpeed, shard->packetBus->name);
     BPFSoc *bpfs = (BPFSoc *)my_calloc(sizeof(BPFSoc));
-    UTArrayAdd(mdata->bpf_socs, bpfs);
+    UTArrayAdd(shard->bpf_socs, bpfs);
     bpfs->module = mod;
+    bpfs->skipCount = 1;
     bpfs->adaptor = adaptor;
     bpfs->deviceName = adaptor->deviceName;
     bpfs->promisc = pcap->promisc;
     bpfs->vport = pcap->vport;
     bpfs->vport_set = pcap->vport_set;
+    bpfs->ring = pcap->ring;
     tap_open(mod, bpfs);
   }
 
@@ -410,11 +658,11 @@ extern "C" {
   */
 
   static void evt_intfs_changed(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
+    HSPPcapShard *shard = pcapShard(mod);
     HSP *sp = (HSP *)EVROOTDATA(mod);
     // close sockets and remove adaptor references for anything that no longer exists
     BPFSoc *bpfs;
-    UTARRAY_WALK(mdata->bpf_socs, bpfs) {
+    UTARRAY_WALK(shard->bpf_socs, bpfs) {
       if(adaptorByName(sp, bpfs->deviceName) == NULL) {
 	// no longer found
 	tap_close(mod, bpfs);
@@ -428,14 +676,18 @@ extern "C" {
   */
 
   void mod_pcap(EVMod *mod) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
     mod->data = my_calloc(sizeof(HSP_mod_PCAP));
     HSP_mod_PCAP *mdata = (HSP_mod_PCAP *)mod->data;
-    mdata->bpf_socs = UTArrayNew(UTARRAY_DFLT);
+    mdata->shards = (HSPPcapShard *)my_calloc(sp->packetBusShards * sizeof(HSPPcapShard));
+    for(uint32_t ii = 0; ii < sp->packetBusShards; ii++) {
+      mdata->shards[ii].bpf_socs = UTArrayNew(UTARRAY_DFLT);
+      mdata->shards[ii].packetBus = packetBusShard(mod, ii);
+    }
     // register call-backs
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_FIRST), evt_config_first);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_INTFS_CHANGED), evt_intfs_changed);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
+    packetBusEventRx(mod, HSPEVENT_CONFIG_FIRST, evt_config_first);
+    packetBusEventRx(mod, HSPEVENT_INTFS_CHANGED, evt_intfs_changed);
+    packetBusEventRx(mod, EVEVENT_TICK, evt_tick);
   }
 
 #if defined(__cplusplus)
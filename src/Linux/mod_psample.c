@@ -23,6 +23,7 @@ extern "C" {
 
 #define HSP_PSAMPLE_READNL_RCV_BUF 8192
 #define HSP_PSAMPLE_READNL_BATCH 100
+#define HSP_PSAMPLE_READNL_VLEN 32
 #define HSP_PSAMPLE_RCVBUF 8000000
 
   // Shadow the attributes in linux/psample.h so
@@ -64,6 +65,7 @@ extern "C" {
     EVBus *packetBus;
     bool psample_configured;
     int nl_sock;
+    UTNLRecvBatch *nl_batch;
     uint32_t nl_seq;
     int retry_countdown;
 #define HSP_PSAMPLE_WAIT_RETRY_S 15
@@ -208,14 +210,6 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  static void freeExtendedElements(SFLFlow_sample_element *elements) {
-    for(SFLFlow_sample_element *elem = elements; elem; ) {
-      SFLFlow_sample_element *next_elem = elem->nxt;
-      my_free(elem);
-      elem = next_elem;
-    }
-  }
-
   static void processNetlink_PSAMPLE(EVMod *mod, struct nlmsghdr *nlh)
   {
     HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
@@ -231,7 +225,16 @@ extern "C" {
     uint32_t grp_seq=0;
     uint32_t sample_n=0;
     u_char *pkt=NULL;
+    // extension elements are copied into the sample by takeSample().
+    // An attribute may appear more than once,  so the list is only
+    // linked up after the attribute walk.
     SFLFlow_sample_element *ext_elems = NULL;
+    SFLFlow_sample_element egress_Q = { .tag = SFLFLOW_EX_EGRESS_Q };
+    SFLFlow_sample_element Q_depth = { .tag = SFLFLOW_EX_Q_DEPTH };
+    SFLFlow_sample_element transit = { .tag = SFLFLOW_EX_TRANSIT };
+    bool has_egress_Q = NO;
+    bool has_Q_depth = NO;
+    bool has_transit = NO;
     // TODO: tunnel encap/decap may be avaiable too
 
     for(int offset = GENL_HDRLEN; offset < msglen; ) {
@@ -251,31 +254,19 @@ extern "C" {
       case PSAMPLE_ATTR_SAMPLE_RATE: sample_n = *(uint32_t *)datap; break;
       case PSAMPLE_ATTR_DATA: pkt = datap; break;
       case HSP_PSAMPLE_ATTR_OUT_TC:
-	{
-	  // queue id
-	  SFLFlow_sample_element *egress_Q = my_calloc(sizeof(SFLFlow_sample_element));
-	  egress_Q->tag = SFLFLOW_EX_EGRESS_Q;
-	  egress_Q->flowType.egress_queue.queue = *(uint16_t *)datap;
-	  ADD_TO_LIST(ext_elems, egress_Q);
-	}
+	// queue id
+	egress_Q.flowType.egress_queue.queue = *(uint16_t *)datap;
+	has_egress_Q = YES;
 	break;
       case HSP_PSAMPLE_ATTR_OUT_TC_OCC:
-	{
-	  // queue occupancy (bytes)
-	  SFLFlow_sample_element *Q_depth = my_calloc(sizeof(SFLFlow_sample_element));
-	  Q_depth->tag = SFLFLOW_EX_Q_DEPTH;
-	  Q_depth->flowType.queue_depth.depth = *(uint64_t *)datap; // Will take lo 32-bits
-	  ADD_TO_LIST(ext_elems, Q_depth);
-	}
+	// queue occupancy (bytes)
+	Q_depth.flowType.queue_depth.depth = *(uint64_t *)datap; // Will take lo 32-bits
+	has_Q_depth = YES;
 	break;
       case HSP_PSAMPLE_ATTR_LATENCY:
-	{
-	  // transit latency (nS)
-	  SFLFlow_sample_element *transit = my_calloc(sizeof(SFLFlow_sample_element));
-	  transit->tag = SFLFLOW_EX_TRANSIT;
-	  transit->flowType.transit_delay.delay = *(uint64_t *)datap; // Will take lo 32-bits
-	  ADD_TO_LIST(ext_elems, transit);
-	}
+	// transit latency (nS)
+	transit.flowType.transit_delay.delay = *(uint64_t *)datap; // Will take lo 32-bits
+	has_transit = YES;
 	break;
       }
       offset += NLMSG_ALIGN(ps_attr->nla_len);
@@ -287,23 +278,24 @@ extern "C" {
       uint16_t queueIdx = 7;
       uint64_t queueDepth = 22222;
       uint64_t transitDelay = 33333L;
-      SFLFlow_sample_element *egress_Q = my_calloc(sizeof(SFLFlow_sample_element));
-      egress_Q->tag = SFLFLOW_EX_EGRESS_Q;
-      egress_Q->flowType.egress_queue.queue = *(uint16_t *)(&queueIdx);
-      ADD_TO_LIST(ext_elems, egress_Q);
+      egress_Q.flowType.egress_queue.queue = *(uint16_t *)(&queueIdx);
+      has_egress_Q = YES;
       // queue occupancy (bytes)
-      SFLFlow_sample_element *Q_depth = my_calloc(sizeof(SFLFlow_sample_element));
-      Q_depth->tag = SFLFLOW_EX_Q_DEPTH;
-      Q_depth->flowType.queue_depth.depth = *(uint64_t *)(&queueDepth); // Will take lo 32-bits
-      ADD_TO_LIST(ext_elems, Q_depth);
+      Q_depth.flowType.queue_depth.depth = *(uint64_t *)(&queueDepth); // Will take lo 32-bits
+      has_Q_depth = YES;
       // transit latency (nS)
-      SFLFlow_sample_element *transit = my_calloc(sizeof(SFLFlow_sample_element));
-      transit->tag = SFLFLOW_EX_TRANSIT;
-      transit->flowType.transit_delay.delay = *(uint64_t *)(&transitDelay); // Will take lo 32-bits
-      ADD_TO_LIST(ext_elems, transit);
+      transit.flowType.transit_delay.delay = *(uint64_t *)(&transitDelay); // Will take lo 32-bits
+      has_transit = YES;
     }
 #endif
 
+    if(has_egress_Q)
+      ADD_TO_LIST(ext_elems, &egress_Q);
+    if(has_Q_depth)
+      ADD_TO_LIST(ext_elems, &Q_depth);
+    if(has_transit)
+      ADD_TO_LIST(ext_elems, &transit);
+
     myDebug(3, "psample: grp=%u", grp_no);
 
     // TODO: this filter can be pushed into kernel with BPF expression on socket
@@ -340,13 +332,12 @@ extern "C" {
 	      drops,
 	      pkt_len);
 
-      SFLAdaptor *inDev = adaptorByIndex(sp, ifin);
-      SFLAdaptor *outDev = adaptorByIndex(sp, ifout);
+      SFLAdaptor *inDev = packetAdaptorByIndex(sp, ifin);
+      SFLAdaptor *outDev = packetAdaptorByIndex(sp, ifout);
       SFLAdaptor *samplerDev = egress ? outDev : inDev;
       if(!samplerDev) {
         // handle startup race-condition where interface has not been discovered yet
         myDebug(2, "psample: unknown ifindex %u (startup race-condition?)", ifin);
-	freeExtendedElements(ext_elems);
         return;
       }
 
@@ -374,9 +365,7 @@ extern "C" {
       }
 
       if(takeIt) {
-	// take the sample - this will take over responsibility for
-	// freeing the extended elements when the sample has
-	// been fully processed.
+	// take the sample - the extended elements are copied
 	takeSample(sp,
 		   inDev,
 		   outDev,
@@ -392,10 +381,6 @@ extern "C" {
 		   this_sample_n,
 		   ext_elems);
       }
-      else {
-	// clean up
-	freeExtendedElements(ext_elems);
-      }
     }
   }
 
@@ -420,36 +405,41 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  static void readNetlink_PSAMPLE(EVMod *mod, EVSocket *sock, void *magic)
+  static void readNetlinkMsg_PSAMPLE(void *magic, uint8_t *recv_buf, int numbytes)
   {
+    EVMod *mod = (EVMod *)magic;
     HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
-    uint8_t recv_buf[HSP_PSAMPLE_READNL_RCV_BUF];
-    int batch = 0;
-    for( ; batch < HSP_PSAMPLE_READNL_BATCH; batch++) {
-      int numbytes = recv(sock->fd, recv_buf, sizeof(recv_buf), 0);
-      if(numbytes <= 0)
+    struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
+    while(NLMSG_OK(nlh, numbytes)){
+      if(nlh->nlmsg_type == NLMSG_DONE)
 	break;
-      struct nlmsghdr *nlh = (struct nlmsghdr*) recv_buf;
-      while(NLMSG_OK(nlh, numbytes)){
-	if(nlh->nlmsg_type == NLMSG_DONE)
-	  break;
-	if(nlh->nlmsg_type == NLMSG_ERROR){
-	  struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
-	  if(err_msg->error == 0) {
-	    myDebug(1, "received Netlink ACK");
-	  }
-	  else {
-	    // TODO: parse NLMSGERR_ATTR_OFFS to get offset?  Might be helpful
-	    myDebug(1, "psample state %u: error in netlink message: %d : %s",
-		    mdata->state,
-		    err_msg->error,
-		    strerror(-err_msg->error));
-	  }
-	  break;
+      if(nlh->nlmsg_type == NLMSG_ERROR){
+	struct nlmsgerr *err_msg = (struct nlmsgerr *)NLMSG_DATA(nlh);
+	if(err_msg->error == 0) {
+	  myDebug(1, "received Netlink ACK");
+	}
+	else {
+	  // TODO: parse NLMSGERR_ATTR_OFFS to get offset?  Might be helpful
+	  myDebug(1, "psample state %u: error in netlink message: %d : %s",
+		  mdata->state,
+		  err_msg->error,
+		  strerror(-err_msg->error));
 	}
-	processNetlink(mod, nlh);
-	nlh = NLMSG_NEXT(nlh, numbytes);
+	break;
       }
+      processNetlink(mod, nlh);
+      nlh = NLMSG_NEXT(nlh, numbytes);
+    }
+  }
+
+  static void readNetlink_PSAMPLE(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    UTNLRecvBatch_read(mdata->nl_batch, sock->fd, HSP_PSAMPLE_READNL_BATCH, mod, readNetlinkMsg_PSAMPLE);
+    if(mdata->nl_batch->overruns) {
+      myDebug(1, "psample: netlink socket overrun (%u)", mdata->nl_batch->overruns);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_NETLINK_OVERRUNS, mdata->nl_batch->overruns);
     }
 
     // This should have advanced the state past GET_FAMILY
@@ -489,6 +479,7 @@ extern "C" {
       if(mdata->nl_sock > 0) {
 	// increase socket receiver buffer size
 	UTSocketRcvbuf(mdata->nl_sock, HSP_PSAMPLE_RCVBUF);
+	mdata->nl_batch = UTNLRecvBatch_new(HSP_PSAMPLE_READNL_VLEN, HSP_PSAMPLE_READNL_RCV_BUF);
 	// and submit for polling
 	EVBusAddSocket(mod,
 		       mdata->packetBus,
@@ -541,7 +532,7 @@ extern "C" {
     mod->data = my_calloc(sizeof(HSP_mod_PSAMPLE));
     HSP *sp = (HSP *)EVROOTDATA(mod);
     HSP_mod_PSAMPLE *mdata = (HSP_mod_PSAMPLE *)mod->data;
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    mdata->packetBus = packetBusForModule(mod);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
 
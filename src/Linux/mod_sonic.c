@@ -1906,7 +1906,7 @@ extern "C" {
     mdata->configEndEvent = EVGetEvent(mdata->pollBus, HSPEVENT_CONFIG_END);
 
     // intercept samples before they go out so we can rewrite ifindex numbers
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
+    packetBusEventRx(mod, HSPEVENT_FLOW_SAMPLE, evt_flow_sample);
     EVEventRx(mod, EVGetEvent(mdata->pollBus, HSPEVENT_INTF_COUNTER_SAMPLE), evt_cntr_sample);
   }
 
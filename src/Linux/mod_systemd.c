@@ -708,7 +708,7 @@ extern "C" {
     SEMLOCK_DO(sp->sync_agent) {
       sfl_poller_writeCountersSample(vm->poller, &cs);
       sp->counterSampleQueued = YES;
-      sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+      HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
     }
   }
 
@@ -1538,8 +1538,8 @@ static DBusHandlerResult dbusCB(DBusConnection *connection, DBusMessage *message
     // packet bus
     if(sp->systemd.markTraffic) {
       mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
-      EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
-      mdata->listenSocks = UTHASH_NEW(HSPListenSock, sapId, UTHASH_SYNC); // need sync (poll + packet thread)
+      packetBusEventRx(mod, HSPEVENT_FLOW_SAMPLE, evt_flow_sample);
+      mdata->listenSocks = UTHASH_NEW(HSPListenSock, sapId, UTHASH_SYNC); // need sync (poll + packet threads)
       mdata->listenSocksByInode = UTHASH_NEW(HSPListenSock, inode, UTHASH_DFLT); // only used in poll thread
     }
 
@@ -133,8 +133,16 @@ extern "C" {
     uint32_t ipip_tx;
     UTHash *sampleHT;
     UTQ(HSPTCPSample) timeoutQ;
+    EVTimer *timeoutTimer; // armed while timeoutQ is not empty
   } HSP_mod_TCP;
 
+  // each packet bus shard has its own lookup state
+  static HSP_mod_TCP *tcpShardData(EVMod *mod) {
+    int shard = packetBusShardIndex(mod, EVCurrentBus());
+    assert(shard >= 0);
+    return &((HSP_mod_TCP *)mod->data)[shard];
+  }
+
 
 
   /*_________________---------------------------__________________
@@ -170,7 +178,7 @@ extern "C" {
 
   static void parse_diag_msg(EVMod *mod, struct inet_diag_msg *diag_msg, int rtalen, uint32_t seqNo)
   {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP_mod_TCP *mdata = tcpShardData(mod);
     HSP *sp = (HSP *)EVROOTDATA(mod);
 
     mdata->diag_rx++;
@@ -295,7 +303,7 @@ extern "C" {
 
   static void readNL(EVMod *mod, EVSocket *sock, void *magic)
   {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP_mod_TCP *mdata = tcpShardData(mod);
     UTNLDiag_recv(mod, mdata->nl_sock, diagCB);
   }
 
@@ -305,7 +313,7 @@ extern "C" {
   */
 
   static void evt_tick(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP_mod_TCP *mdata = tcpShardData(mod);
     uint32_t n_thisTick = mdata->diag_tx + mdata->diag_rx + mdata->nl_seq_lost + mdata->diag_timeouts;
     if(n_thisTick != mdata->n_lastTick) {
       myDebug(1, "tcp: tx=%u, rx=%u, lost=%u, timeout=%u, annotated=%u, ipip_tx=%u",
@@ -320,14 +328,36 @@ extern "C" {
   }
 
   /*_________________---------------------------__________________
-    _________________       evt_deci            __________________
+    _________________       timeouts            __________________
     -----------------___________________________------------------
+    A one-shot timer is kept armed for the oldest request in the
+    timeoutQ,  so the bus does not have to wake up every 100mS
+    just in case something timed out.
   */
 
-  static void evt_deci(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+  static void timer_timeouts(EVMod *mod, EVTimer *timer, void *magic);
+
+  static void armTimeoutTimer(EVMod *mod, HSP_mod_TCP *mdata) {
+    HSPTCPSample *ts = mdata->timeoutQ.head;
+    if(ts == NULL
+       || mdata->timeoutTimer)
+      return;
+    int age_mS = EVTimeDiff_mS(&ts->qtime, &mdata->packetBus->now);
+    int delay_mS = HSP_TCP_TIMEOUT_MS - age_mS + 1; // +1 to be sure it has expired
+    mdata->timeoutTimer = EVTimerAdd(mod,
+				     mdata->packetBus,
+				     (delay_mS > 0) ? delay_mS : 0,
+				     0,
+				     timer_timeouts,
+				     NULL);
+  }
+
+  static void timer_timeouts(EVMod *mod, EVTimer *timer, void *magic) {
+    HSP_mod_TCP *mdata = tcpShardData(mod);
     HSP *sp = (HSP *)EVROOTDATA(mod);
-    // myLog(LOG_INFO, "evt_deci: samplerHT elements=%u", UTHashN(mdata->sampleHT));
+    // one-shot - freed when we return
+    mdata->timeoutTimer = NULL;
+    // myLog(LOG_INFO, "timer_timeouts: samplerHT elements=%u", UTHashN(mdata->sampleHT));
     for(HSPTCPSample *ts = mdata->timeoutQ.head; ts; ) {
       if(EVTimeDiff_nS(&ts->qtime, &mdata->packetBus->now) <= (HSP_TCP_TIMEOUT_MS * 1000000)) {
 	// not timed-out yet: we know everything after this point is current, so stop walking.
@@ -353,6 +383,8 @@ extern "C" {
 	ts = next_ts;
       }
     }
+    // wait for the next one
+    armTimeoutTimer(mod, mdata);
   }
 
   /*_________________---------------------------__________________
@@ -361,7 +393,7 @@ extern "C" {
   */
 
   static void lookup_sample(EVMod *mod, HSPPendingSample *ps) {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP_mod_TCP *mdata = tcpShardData(mod);
     // src+dst tcp_ports are at start of TCP or UDP header
     uint16_t tcp_ports[2];
     memcpy(tcp_ports, ps->hdr + ps->l4_offset, 4);
@@ -458,6 +490,7 @@ extern "C" {
       // add to HT and timeout queue
       UTHashAdd(mdata->sampleHT, tcpSample);
       UTQ_ADD_TAIL(mdata->timeoutQ, tcpSample);
+      armTimeoutTimer(mod, mdata);
       // send the netlink request
       UTNLDiag_send(mdata->nl_sock,
 		    &tcpSample->conn_req,
@@ -552,7 +585,7 @@ extern "C" {
   */
 
   static void evt_config_first(EVMod *mod, EVEvent *evt, void *data, size_t dataLen) {
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
+    HSP_mod_TCP *mdata = tcpShardData(mod);
 
     // open the netlink monitoring socket
     if((mdata->nl_sock = UTNLDiag_open()) == -1) {
@@ -569,18 +602,20 @@ extern "C" {
   */
 
   void mod_tcp(EVMod *mod) {
-    mod->data = my_calloc(sizeof(HSP_mod_TCP));
-    HSP_mod_TCP *mdata = (HSP_mod_TCP *)mod->data;
-    mdata->sampleHT = UTHASH_NEW(HSPTCPSample, conn_req.id, UTHASH_DFLT);
-    // trim the hash-key len to select only the socket part of inet_diag_sockid
-    // and leave out the interface and the cookie
-    mdata->sampleHT->f_len = 36;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    mod->data = my_calloc(sp->packetBusShards * sizeof(HSP_mod_TCP));
+    for(uint32_t shard = 0; shard < sp->packetBusShards; shard++) {
+      HSP_mod_TCP *mdata = &((HSP_mod_TCP *)mod->data)[shard];
+      mdata->sampleHT = UTHASH_NEW(HSPTCPSample, conn_req.id, UTHASH_DFLT);
+      // trim the hash-key len to select only the socket part of inet_diag_sockid
+      // and leave out the interface and the cookie
+      mdata->sampleHT->f_len = 36;
+      mdata->packetBus = packetBusShard(mod, shard);
+    }
     // register call-backs
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_FIRST), evt_config_first);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_TICK), evt_tick);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, EVEVENT_DECI), evt_deci);
-    EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_FLOW_SAMPLE), evt_flow_sample);
+    packetBusEventRx(mod, HSPEVENT_CONFIG_FIRST, evt_config_first);
+    packetBusEventRx(mod, EVEVENT_TICK, evt_tick);
+    packetBusEventRx(mod, HSPEVENT_FLOW_SAMPLE, evt_flow_sample);
   }
 
 #if defined(__cplusplus)
@@ -16,10 +16,14 @@ extern "C" {
 #include <linux/netfilter_ipv4/ipt_ULOG.h>
 #define HSP_MAX_ULOG_MSG_BYTES 10000
 #define HSP_ULOG_RCV_BUF 8000000
+#define HSP_READPACKET_VLEN_ULOG 32
+
+#include "util_netlink.h"
 
   typedef struct _HSP_mod_ULOG {
     EVBus *packetBus;
     bool ulog_configured;
+    UTNLRecvBatch *nl_batch;
     uint32_t ulog_seqno;
     uint32_t ulog_drops;
     struct sockaddr_nl ulog_bind;
@@ -32,14 +36,98 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  static void readPackets_ulog(EVMod *mod, EVSocket *sock, void *magic)
+  static void readPacketMsg_ulog(void *magic, uint8_t *buf, int len)
   {
+    EVMod *mod = (EVMod *)magic;
     HSP_mod_ULOG *mdata = (HSP_mod_ULOG *)mod->data;
     HSP *sp = (HSP *)EVROOTDATA(mod);
-
-    int batch = 0;
     static uint32_t MySkipCount=1;
 
+    myDebug(1, "got ULOG msg: %u bytes", len);
+    for(struct nlmsghdr *msg = (struct nlmsghdr *)buf; NLMSG_OK(msg, len); msg=NLMSG_NEXT(msg, len)) {
+
+      myDebug(1, "netlink (%u bytes left) msg [len=%u type=%u flags=0x%x seq=%u pid=%u]",
+	      len,
+	      msg->nlmsg_len,
+	      msg->nlmsg_type,
+	      msg->nlmsg_flags,
+	      msg->nlmsg_seq,
+	      msg->nlmsg_pid);
+
+      // check for drops indicated by sequence no
+      uint32_t droppedSamples = 0;
+      if(mdata->ulog_seqno) {
+	droppedSamples = msg->nlmsg_seq - mdata->ulog_seqno - 1;
+	if(droppedSamples) {
+	  mdata->ulog_drops += droppedSamples;
+	}
+      }
+      mdata->ulog_seqno = msg->nlmsg_seq;
+
+      switch(msg->nlmsg_type) {
+      case NLMSG_NOOP:
+      case NLMSG_ERROR:
+      case NLMSG_OVERRUN:
+	// ignore these
+	break;
+      case NLMSG_DONE: // last in multi-part
+      default:
+	{
+
+	  if(--MySkipCount == 0) {
+	    /* reached zero. Set the next skip */
+	    uint32_t sr = mdata->subSamplingRate;
+	    MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
+
+	    /* and take a sample */
+
+	    // we're seeing type==111 on Fedora14
+	    //if(msg->nlmsg_flags & NLM_F_REQUEST) { }
+	    //if(msg->nlmsg_flags & NLM_F_MULTI) { }
+	    //if(msg->nlmsg_flags & NLM_F_ACK) { }
+	    //if(msg->nlmsg_flags & NLM_F_ECHO) { }
+	    ulog_packet_msg_t *pkt = NLMSG_DATA(msg);
+
+	    myDebug(LOG_INFO, "ULOG mark=%u ts=%s prefix=%s",
+		    pkt->mark,
+		    ctime(&pkt->timestamp_sec),
+		    pkt->prefix);
+
+	    SFLAdaptor *dev_in = NULL;
+	    SFLAdaptor *dev_out = NULL;
+
+	    if(pkt->indev_name[0]) {
+	      dev_in = adaptorByName(sp, pkt->indev_name);
+	    }
+	    if(pkt->outdev_name[0]) {
+	      dev_out = adaptorByName(sp, pkt->outdev_name);
+	    }
+
+	    takeSample(sp,
+		       dev_in,
+		       dev_out,
+		       NULL,
+		       sp->ulog.ds_options,
+		       pkt->hook,
+		       pkt->mac,
+		       pkt->mac_len,
+		       pkt->payload,
+		       pkt->data_len, /* length of captured payload */
+		       pkt->data_len, /* length of packet (pdu) */
+		       droppedSamples,
+		       mdata->actualSamplingRate,
+		       NULL);
+	  }
+	}
+      }
+    }
+  }
+
+  static void readPackets_ulog(EVMod *mod, EVSocket *sock, void *magic)
+  {
+    HSP_mod_ULOG *mdata = (HSP_mod_ULOG *)mod->data;
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+
     if(sp->sFlowSettings == NULL) {
       // config was turned off
       return;
@@ -50,88 +138,10 @@ extern "C" {
       return;
     }
 
-    for( ; batch < HSP_READPACKET_BATCH_ULOG; batch++) {
-      char buf[HSP_MAX_ULOG_MSG_BYTES];
-      int len = recvfrom(sock->fd, buf, HSP_MAX_ULOG_MSG_BYTES, 0, NULL, NULL);
-      if(len <= 0) break;
-      myDebug(1, "got ULOG msg: %u bytes", len);
-      for(struct nlmsghdr *msg = (struct nlmsghdr *)buf; NLMSG_OK(msg, len); msg=NLMSG_NEXT(msg, len)) {
-
-	myDebug(1, "netlink (%u bytes left) msg [len=%u type=%u flags=0x%x seq=%u pid=%u]",
-		len,
-		msg->nlmsg_len,
-		msg->nlmsg_type,
-		msg->nlmsg_flags,
-		msg->nlmsg_seq,
-		msg->nlmsg_pid);
-
-	// check for drops indicated by sequence no
-	uint32_t droppedSamples = 0;
-	if(mdata->ulog_seqno) {
-	  droppedSamples = msg->nlmsg_seq - mdata->ulog_seqno - 1;
-	  if(droppedSamples) {
-	    mdata->ulog_drops += droppedSamples;
-	  }
-	}
-	mdata->ulog_seqno = msg->nlmsg_seq;
-
-	switch(msg->nlmsg_type) {
-	case NLMSG_NOOP:
-	case NLMSG_ERROR:
-	case NLMSG_OVERRUN:
-	  // ignore these
-	  break;
-	case NLMSG_DONE: // last in multi-part
-	default:
-	  {
-
-	    if(--MySkipCount == 0) {
-	      /* reached zero. Set the next skip */
-	      uint32_t sr = mdata->subSamplingRate;
-	      MySkipCount = sr == 1 ? 1 : sfl_random((2 * sr) - 1);
-
-	      /* and take a sample */
-
-	      // we're seeing type==111 on Fedora14
-	      //if(msg->nlmsg_flags & NLM_F_REQUEST) { }
-	      //if(msg->nlmsg_flags & NLM_F_MULTI) { }
-	      //if(msg->nlmsg_flags & NLM_F_ACK) { }
-	      //if(msg->nlmsg_flags & NLM_F_ECHO) { }
-	      ulog_packet_msg_t *pkt = NLMSG_DATA(msg);
-
-	      myDebug(LOG_INFO, "ULOG mark=%u ts=%s prefix=%s",
-		      pkt->mark,
-		      ctime(&pkt->timestamp_sec),
-		      pkt->prefix);
-
-	      SFLAdaptor *dev_in = NULL;
-	      SFLAdaptor *dev_out = NULL;
-
-	      if(pkt->indev_name[0]) {
-		dev_in = adaptorByName(sp, pkt->indev_name);
-	      }
-	      if(pkt->outdev_name[0]) {
-		dev_out = adaptorByName(sp, pkt->outdev_name);
-	      }
-
-	      takeSample(sp,
-			 dev_in,
-			 dev_out,
-			 NULL,
- 			 sp->ulog.ds_options,
-			 pkt->hook,
-			 pkt->mac,
-			 pkt->mac_len,
-			 pkt->payload,
-			 pkt->data_len, /* length of captured payload */
-			 pkt->data_len, /* length of packet (pdu) */
-			 droppedSamples,
-			 mdata->actualSamplingRate,
-			 NULL);
-	    }
-	  }
-	}
-      }
+    UTNLRecvBatch_read(mdata->nl_batch, sock->fd, HSP_READPACKET_BATCH_ULOG, mod, readPacketMsg_ulog);
+    if(mdata->nl_batch->overruns) {
+      myDebug(1, "ULOG: netlink socket overrun (%u)", mdata->nl_batch->overruns);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_NETLINK_OVERRUNS, mdata->nl_batch->overruns);
     }
   }
 
@@ -241,8 +251,10 @@ extern "C" {
     if(sp->ulog.group != 0) {
       // ULOG group is set, so open the netfilter socket to ULOG
       int fd = openULOG(mod);
-      if(fd > 0)
+      if(fd > 0) {
+	mdata->nl_batch = UTNLRecvBatch_new(HSP_READPACKET_VLEN_ULOG, HSP_MAX_ULOG_MSG_BYTES);
 	EVBusAddSocket(mod, mdata->packetBus, fd, readPackets_ulog, NULL);
+      }
     }
 
     mdata->ulog_configured = YES;
@@ -265,7 +277,7 @@ extern "C" {
   void mod_ulog(EVMod *mod) {
     mod->data = my_calloc(sizeof(HSP_mod_ULOG));
     HSP_mod_ULOG *mdata = (HSP_mod_ULOG *)mod->data;
-    mdata->packetBus = EVGetBus(mod, HSPBUS_PACKET, YES);
+    mdata->packetBus = packetBusForModule(mod);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_CONFIG_CHANGED), evt_config_changed);
     EVEventRx(mod, EVGetEvent(mdata->packetBus, HSPEVENT_INTFS_CHANGED), evt_intfs_changed);
   }
@@ -437,7 +437,7 @@ extern "C" {
       SEMLOCK_DO(sp->sync_agent) {
 	sfl_poller_writeCountersSample(poller, cs);
 	sp->counterSampleQueued = YES;
-	sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+	HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
       }
     }
   }
@@ -10,21 +10,25 @@ extern "C" {
 #include "cpu_utils.h"
 #include <sys/sysinfo.h> // for get_nprocs()
 
+#define HSP_CPUINFO_PREFIX 4096
+
   /*_________________---------------------------__________________
     _________________     readCpuCounters       __________________
     -----------------___________________________------------------
   */
 
-  int readCpuCounters(SFLHost_cpu_counters *cpu) {
+  int readCpuCounters(HSP *sp, SFLHost_cpu_counters *cpu) {
     int gotData = NO;
-    FILE *procFile;
+    HSPProcFiles *pf = &sp->procFiles;
+    char *buf;
     // We assume that the cpu counters struct has been initialized
     // with all zeros.
-    procFile= fopen(PROCFS_STR "/loadavg", "r");
-    if(procFile) {
+    if(pf->loadavg == NULL)
+      pf->loadavg = UTProcFileNew(PROCFS_STR "/loadavg", 0);
+    if((buf = UTProcFileRead(pf->loadavg)) != NULL) {
       // The docs are pretty clear about %f being "float" rather
-      // that "double", so just give the pointers to fscanf.
-      if(fscanf(procFile, "%f %f %f %"SCNu32"/%"SCNu32"",
+      // that "double", so just give the pointers to sscanf.
+      if(sscanf(buf, "%f %f %f %"SCNu32"/%"SCNu32"",
 		&cpu->load_one,
 		&cpu->load_five,
 		&cpu->load_fifteen,
@@ -38,97 +42,75 @@ extern "C" {
 	// Dave Mangot for pointing this out.
 	cpu->proc_run--;
       }
-      fclose(procFile);
     }
 
-    procFile = fopen(PROCFS_STR "/stat", "r");
-    if(procFile) {
+    if(pf->stat == NULL)
+      pf->stat = UTProcFileNew(PROCFS_STR "/stat", 0);
+    if((buf = UTProcFileRead(pf->stat)) != NULL) {
       // ASCII numbers in /proc/stat may be 64-bit (if not now
       // then someday), so it seems safer to read into
-      // 64-bit ints with scanf first,  then copy them
-      // into the host_cpu structure from there. This also
-      // allows us to convert "jiffies" to milliseconds.
-      uint64_t cpu_user=0;
-      uint64_t cpu_nice =0;
-      uint64_t cpu_system=0;
-      uint64_t cpu_idle=0;
-      uint64_t cpu_wio=0;
-      uint64_t cpu_intr=0;
-      uint64_t cpu_sintr=0;
-      uint64_t cpu_interrupts=0;
-      uint64_t cpu_contexts=0;
-      uint64_t cpu_steal=0;
-      uint64_t cpu_guest=0;
-      uint64_t cpu_guest_nice=0;
-
-#define JIFFY_TO_MS(i) (((i) * 1000L) / HZ)
-
-      // limit the number of chars we will read from each line
-      // (there can be more than this - my_readline will chop for us)
-#define MAX_PROC_LINE_CHARS 240
-      char line[MAX_PROC_LINE_CHARS];
+      // 64-bit ints first,  then copy them into the host_cpu
+      // structure from there. This also allows us to convert
+      // "jiffies" to milliseconds.
+      // user,nice,system,idle,wio,intr,sintr,steal,guest,guest_nice
+      uint64_t jiffies[10] = { 0 };
+      uint64_t val64;
+      char *line;
+      char *p = buf;
       uint32_t lineNo = 0;
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
+      while((line = UTProcNextLine(&p)) != NULL) {
+	char *tok = UTProcNextTok(&line);
+	if(tok == NULL)
+	  continue;
 	if(++lineNo == 1) {
-	  if(sscanf(line, "cpu %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64"",
-		    &cpu_user,
-		    &cpu_nice,
-		    &cpu_system,
-		    &cpu_idle,
-		    &cpu_wio,
-		    &cpu_intr,
-		    &cpu_sintr,
-		    &cpu_steal,
-		    &cpu_guest,
-		    &cpu_guest_nice) >= 4) {
+	  if(my_strequal(tok, "cpu")
+	     && UTProcNextU64s(&line, jiffies, 10) >= 4) {
 	    gotData = YES;
-	    cpu->cpu_user = (uint32_t)(JIFFY_TO_MS(cpu_user));
-	    cpu->cpu_nice = (uint32_t)(JIFFY_TO_MS(cpu_nice));
-	    cpu->cpu_system = (uint32_t)(JIFFY_TO_MS(cpu_system));
-	    cpu->cpu_idle = (uint32_t)(JIFFY_TO_MS(cpu_idle));
-	    cpu->cpu_wio = (uint32_t)(JIFFY_TO_MS(cpu_wio));
-	    cpu->cpu_intr = (uint32_t)(JIFFY_TO_MS(cpu_intr));
-	    cpu->cpu_sintr = (uint32_t)(JIFFY_TO_MS(cpu_sintr));
-	    cpu->cpu_steal = (uint32_t)(JIFFY_TO_MS(cpu_steal));
-	    cpu->cpu_guest = (uint32_t)(JIFFY_TO_MS(cpu_guest));
-	    cpu->cpu_guest_nice = (uint32_t)(JIFFY_TO_MS(cpu_guest_nice));
+	    cpu->cpu_user = (uint32_t)(JIFFY_TO_MS(jiffies[0]));
+	    cpu->cpu_nice = (uint32_t)(JIFFY_TO_MS(jiffies[1]));
+	    cpu->cpu_system = (uint32_t)(JIFFY_TO_MS(jiffies[2]));
+	    cpu->cpu_idle = (uint32_t)(JIFFY_TO_MS(jiffies[3]));
+	    cpu->cpu_wio = (uint32_t)(JIFFY_TO_MS(jiffies[4]));
+	    cpu->cpu_intr = (uint32_t)(JIFFY_TO_MS(jiffies[5]));
+	    cpu->cpu_sintr = (uint32_t)(JIFFY_TO_MS(jiffies[6]));
+	    cpu->cpu_steal = (uint32_t)(JIFFY_TO_MS(jiffies[7]));
+	    cpu->cpu_guest = (uint32_t)(JIFFY_TO_MS(jiffies[8]));
+	    cpu->cpu_guest_nice = (uint32_t)(JIFFY_TO_MS(jiffies[9]));
 	  }
 	}
 	else {
-	  if(line[0] == 'c' &&
-	     line[1] == 'p' &&
-	     line[2] == 'u' &&
-	     (line[3] >= '0' && line[3] <= '9')) {
+	  if(tok[0] == 'c' &&
+	     tok[1] == 'p' &&
+	     tok[2] == 'u' &&
+	     (tok[3] >= '0' && tok[3] <= '9')) {
 	    gotData = YES;
 	    cpu->cpu_num++;
 	  }
-	  else if(strncmp(line, "intr", 4) == 0) {
+	  else if(my_strequal(tok, "intr")) {
 	    // total interrupts is the second token on this line
-	    if(sscanf(line, "intr %"SCNu64"", &cpu_interrupts) == 1) {
+	    if(UTProcNextU64s(&line, &val64, 1) == 1) {
 	      gotData = YES;
-	      cpu->interrupts = (uint32_t)cpu_interrupts;
+	      cpu->interrupts = (uint32_t)val64;
 	    }
 	  }
-	  else if(strncmp(line, "ctxt", 4) == 0) {
-	    if(sscanf(line, "ctxt %"SCNu64"", &cpu_contexts) == 1) {
+	  else if(my_strequal(tok, "ctxt")) {
+	    if(UTProcNextU64s(&line, &val64, 1) == 1) {
 	      gotData = YES;
-	      cpu->contexts = (uint32_t)cpu_contexts;
+	      cpu->contexts = (uint32_t)val64;
 	    }
 	  }
 	}
       }
-      fclose(procFile);
     }
 
-    procFile = fopen(PROCFS_STR "/uptime", "r");
-    if(procFile) {
+    if(pf->uptime == NULL)
+      pf->uptime = UTProcFileNew(PROCFS_STR "/uptime", 0);
+    if((buf = UTProcFileRead(pf->uptime)) != NULL) {
       float uptime = 0;
-      if(fscanf(procFile, "%f",	&uptime) == 1) {
+      if(sscanf(buf, "%f", &uptime) == 1) {
 	gotData = YES;
 	cpu->uptime = (uint32_t)uptime;
       }
-      fclose(procFile);
     }
 
     // GNU libc knows the number of processors so
@@ -147,14 +129,15 @@ extern "C" {
 
     //cpu_speed.  According to Ganglia/libmetrics we should
     // look first in /sys/devices/system/cpu/cpu0/cpufreq/scaling_max_freq
-    // but for now just take the first one from /proc/cpuinfo
-    procFile = fopen(PROCFS_STR "/cpuinfo", "r");
-    if(procFile) {
-#undef MAX_PROC_LINE_CHARS
-#define MAX_PROC_LINE_CHARS 80
-      char line[MAX_PROC_LINE_CHARS];
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
+    // but for now just take the first one from /proc/cpuinfo. It is
+    // near the top,  so only read a prefix (the whole file can run to
+    // hundreds of KB on a big box).
+    if(pf->cpuinfo == NULL)
+      pf->cpuinfo = UTProcFileNew(PROCFS_STR "/cpuinfo", HSP_CPUINFO_PREFIX);
+    if((buf = UTProcFileRead(pf->cpuinfo)) != NULL) {
+      char *line;
+      char *p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
 	if(strncmp(line, "cpu MHz", 7) == 0) {
 	  double cpu_mhz = 0.0;
 	  if(sscanf(line, "cpu MHz : %lf", &cpu_mhz) == 1) {
@@ -164,7 +147,6 @@ extern "C" {
 	  }
 	}
       }
-      fclose(procFile);
     }
 
     return gotData;
@@ -19,6 +19,53 @@ typedef int (*comparison_fn_t)(const void*, const void*);
    be read off */
 #define ASSUMED_DISK_SECTOR_BYTES 512
 
+  // statvfs() can block indefinitely on a hung mount (NFS, CIFS, FUSE),
+  // so filesystem capacity is gathered by a worker thread and the poll
+  // bus only ever reads the cached totals.
+#define HSP_FS_TIMEOUT 5 // seconds before an in-flight statvfs() counts as hung
+#define HSP_FS_MAX_AGE 300 // stop reporting a mount if its result is older
+#define HSP_FS_BACKOFF_MIN 30 // quarantine period after the first hang
+#define HSP_FS_BACKOFF_MAX 3600 // ...doubling up to this
+#define HSP_FS_FIRST_WAIT_MS 500 // how long the poll bus waits for a new mount
+
+  typedef struct _HSPFsMount {
+    char *mount;
+    uint64_t total;
+    uint64_t free;
+    time_t lastOK; // when total/free were read (0 == never)
+    time_t started; // statvfs() in flight since (0 == idle)
+    time_t retryAt; // quarantined until
+    uint32_t backoff; // last quarantine period
+    uint32_t pass; // last refresh pass to visit this mount
+    bool hung:1; // in-flight call timed out and the worker was abandoned
+    bool gone:1; // unmounted while in flight,  so free when it returns
+    bool failed:1; // last statvfs() returned an error
+    bool mark:1;
+  } HSPFsMount;
+
+  typedef struct _HSPFsStats {
+    pthread_mutex_t sync;
+    pthread_cond_t cond; // wakes the worker
+    pthread_cond_t done; // signalled by the worker after each statvfs()
+    UTArray *mounts; // HSPFsMount, shared with the worker
+    uint32_t generation; // bumped to retire a worker stuck in statvfs()
+    uint32_t pass;
+    uint32_t abandoned; // retired workers still blocked
+    bool pending:1; // refresh requested
+    bool running:1; // current-generation worker exists
+  } HSPFsStats;
+
+  static time_t fsNow(void) {
+    struct timespec ts;
+    EVClockMono(&ts);
+    return ts.tv_sec;
+  }
+
+  static void fsMountFree(HSPFsMount *fsm) {
+    my_free(fsm->mount);
+    my_free(fsm);
+  }
+
   /*_________________---------------------------__________________
     _________________     remote_mount          __________________
     -----------------___________________________------------------
@@ -40,6 +87,265 @@ int remote_mount(const char *device, const char *type)
 	  || (!strcmp(type,"none")) );
 }
 
+  /*_________________---------------------------__________________
+    _________________     readLocalMounts       __________________
+    -----------------___________________________------------------
+    borrowed heavily from ganglia/linux/metrics.c for this part where
+    we read the mount points that we will interrogate to add up the
+    disk space on local disks.  Only done when /proc/mounts changes.
+  */
+
+  static HSPFsMount *fsFindMount(HSPFsStats *fs, char *mount) {
+    HSPFsMount *fsm;
+    UTARRAY_WALK(fs->mounts, fsm)
+      if(my_strequal(fsm->mount, mount))
+	return fsm;
+    return NULL;
+  }
+
+  static void readLocalMounts(HSPFsStats *fs, char *buf) {
+    SEMLOCK_DO(&fs->sync) {
+      HSPFsMount *fsm;
+      UTARRAY_WALK(fs->mounts, fsm)
+	fsm->mark = YES;
+      void *treeRoot = NULL;
+      char *line;
+      char *p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
+	char *device = UTProcNextTok(&line);
+	char *mount = UTProcNextTok(&line);
+	char *type = UTProcNextTok(&line);
+	char *mode = UTProcNextTok(&line);
+	if(mode == NULL)
+	  continue;
+	// must start with /dev/ or /dev2/ or ubi:
+	if(strncmp(device, "/dev/", 5) == 0 ||
+	   strncmp(device, "/dev2/", 6) == 0 ||
+	   strncmp(device, "ubi:", 4) == 0) {
+	  // must be read-write
+	  if(strncmp(mode, "ro", 2) != 0) {
+	    // must be local
+	    if(!remote_mount(device, type)) {
+	      // don't count it again if it was seen before
+	      if(tfind(device, &treeRoot, (comparison_fn_t)strcmp) == NULL) {
+		// not found, so remember it
+		tsearch(my_strdup(device), &treeRoot, (comparison_fn_t)strcmp);
+		// and the mount point to ask,  keeping any cached result
+		fsm = fsFindMount(fs, mount);
+		if(fsm)
+		  fsm->mark = NO;
+		else {
+		  fsm = (HSPFsMount *)my_calloc(sizeof(HSPFsMount));
+		  fsm->mount = my_strdup(mount);
+		  UTArrayAdd(fs->mounts, fsm);
+		}
+	      }
+	    }
+	  }
+	}
+      }
+      tdestroy(treeRoot, my_free);
+      // fs->mounts packs on delete,  so collect first and delete
+      // after the walk or entries would be skipped
+      UTArray *unmounted = UTArrayNew(UTARRAY_DFLT);
+      UTARRAY_WALK(fs->mounts, fsm) {
+	if(fsm->mark)
+	  UTArrayAdd(unmounted, fsm);
+      }
+      UTARRAY_WALK(unmounted, fsm) {
+	UTArrayDel(fs->mounts, fsm);
+	// the worker still holds it if statvfs() is in flight
+	if(fsm->started)
+	  fsm->gone = YES;
+	else
+	  fsMountFree(fsm);
+      }
+      UTArrayFree(unmounted);
+      UTArrayPack(fs->mounts);
+      myDebug(1, "readLocalMounts: %u local mounts", UTArrayN(fs->mounts));
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________     fsWorker              __________________
+    -----------------___________________________------------------
+    Runs statvfs() on each mount that is not quarantined,  one at a
+    time,  without holding the lock across the call.  If a call hangs
+    the poll bus retires this worker by bumping the generation and
+    starts another.  When (if) the call ever returns the retired worker
+    records the result and exits.
+  */
+
+  static HSPFsMount *fsNextMount(HSPFsStats *fs, uint32_t pass, time_t now) {
+    HSPFsMount *fsm;
+    UTARRAY_WALK(fs->mounts, fsm)
+      if(fsm->started == 0
+	 && fsm->pass != pass
+	 && fsm->retryAt <= now)
+	return fsm;
+    return NULL;
+  }
+
+  static void *fsWorker(void *magic) {
+    HSPFsStats *fs = (HSPFsStats *)magic;
+    SEMLOCK_DO(&fs->sync) {
+      uint32_t gen = fs->generation;
+      while(gen == fs->generation) {
+	while(!fs->pending)
+	  pthread_cond_wait(&fs->cond, &fs->sync);
+	fs->pending = NO;
+	uint32_t pass = ++fs->pass;
+	HSPFsMount *fsm;
+	while(gen == fs->generation
+	      && (fsm = fsNextMount(fs, pass, fsNow())) != NULL) {
+	  fsm->pass = pass;
+	  fsm->started = fsNow();
+	  pthread_mutex_unlock(&fs->sync);
+	  struct statvfs svfs;
+	  int rc = statvfs(fsm->mount, &svfs);
+	  int err = errno;
+	  pthread_mutex_lock(&fs->sync);
+	  time_t now = fsNow();
+	  if(fsm->gone)
+	    fsMountFree(fsm);
+	  else {
+	    fsm->failed = (rc != 0);
+	    if(rc == 0) {
+	      fsm->total = (uint64_t)svfs.f_blocks * (uint64_t)svfs.f_bsize;
+	      fsm->free = (uint64_t)svfs.f_bavail * (uint64_t)svfs.f_bsize;
+	      fsm->lastOK = now;
+	      // a late answer does not lift the quarantine early
+	      if(!fsm->hung)
+		fsm->backoff = 0;
+	    }
+	    else
+	      myDebug(1, "statvfs(%s) failed : %s", fsm->mount, strerror(err));
+	    if(fsm->hung)
+	      myLog(LOG_INFO, "statvfs(%s) returned after %u seconds",
+		    fsm->mount,
+		    (uint32_t)(now - fsm->started));
+	    fsm->started = 0;
+	    fsm->hung = NO;
+	  }
+	  pthread_cond_broadcast(&fs->done);
+	}
+      }
+      fs->abandoned--;
+    }
+    return NULL;
+  }
+
+  static void fsWorkerStart(HSPFsStats *fs) {
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, EV_BUS_STACKSIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, fsWorker, fs);
+    if(err)
+      myLog(LOG_ERR, "fsWorkerStart: pthread_create() failed: %s", strerror(err));
+    else
+      fs->running = YES;
+    pthread_attr_destroy(&attr);
+  }
+
+  /*_________________---------------------------__________________
+    _________________     readFsCapacity        __________________
+    -----------------___________________________------------------
+    Called on the poll bus.  Never blocks on the filesystems for long:
+    it checks for a hung worker,  adds up the cached results and asks
+    the worker for a fresh pass (for next time).  A mount that has
+    never been read (at startup,  or newly mounted) would make the
+    totals dip,  so for those it waits up to HSP_FS_FIRST_WAIT_MS for
+    the worker,  and if that is not enough it leaves the capacity
+    fields out altogether until the worker has caught up.
+  */
+
+  static bool fsMountUnread(HSPFsMount *fsm, time_t now) {
+    return (fsm->lastOK == 0
+	    && !fsm->failed
+	    && !fsm->hung
+	    && fsm->retryAt <= now);
+  }
+
+  static bool fsAnyUnread(HSPFsStats *fs, time_t now) {
+    HSPFsMount *fsm;
+    UTARRAY_WALK(fs->mounts, fsm)
+      if(fsMountUnread(fsm, now))
+	return YES;
+    return NO;
+  }
+
+  static void fsWorkerKick(HSPFsStats *fs) {
+    if(!fs->running) {
+      if(fs->abandoned)
+	myDebug(1, "readFsCapacity: %u workers still blocked", fs->abandoned);
+      fsWorkerStart(fs);
+    }
+    fs->pending = YES;
+    pthread_cond_signal(&fs->cond);
+  }
+
+  static void readFsCapacity(HSPFsStats *fs, SFLHost_dsk_counters *dsk) {
+    time_t now = fsNow();
+    SEMLOCK_DO(&fs->sync) {
+      HSPFsMount *fsm;
+      UTARRAY_WALK(fs->mounts, fsm) {
+	if(fsm->started
+	   && !fsm->hung
+	   && (now - fsm->started) > HSP_FS_TIMEOUT) {
+	  // quarantine the mount and leave the worker blocked on it
+	  fsm->hung = YES;
+	  fsm->backoff = fsm->backoff
+	    ? (fsm->backoff * 2)
+	    : HSP_FS_BACKOFF_MIN;
+	  if(fsm->backoff > HSP_FS_BACKOFF_MAX)
+	    fsm->backoff = HSP_FS_BACKOFF_MAX;
+	  fsm->retryAt = now + fsm->backoff;
+	  myLog(LOG_ERR, "statvfs(%s) blocked for %u seconds - quarantined for %u seconds",
+		fsm->mount,
+		(uint32_t)(now - fsm->started),
+		fsm->backoff);
+	  fs->generation++;
+	  fs->abandoned++;
+	  fs->running = NO;
+	}
+      }
+      // a new mount gets its first pass now rather than next time
+      bool kicked = NO;
+      if(fsAnyUnread(fs, now)) {
+	// pthread_cond_timedwait() takes CLOCK_REALTIME by default
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_nsec += HSP_FS_FIRST_WAIT_MS * 1000000;
+	deadline.tv_sec += deadline.tv_nsec / 1000000000;
+	deadline.tv_nsec %= 1000000000;
+	fsWorkerKick(fs);
+	kicked = YES;
+	while(fsAnyUnread(fs, fsNow())
+	      && pthread_cond_timedwait(&fs->done, &fs->sync, &deadline) == 0);
+	now = fsNow();
+      }
+      bool complete = !fsAnyUnread(fs, now);
+      if(!complete)
+	myDebug(1, "readFsCapacity: waiting for first statvfs() on new mounts");
+      UTARRAY_WALK(fs->mounts, fsm) {
+	if(complete
+	   && fsm->lastOK
+	   && (now - fsm->lastOK) <= HSP_FS_MAX_AGE
+	   && fsm->total) {
+	  dsk->disk_total += fsm->total;
+	  dsk->disk_free += fsm->free;
+	  // percent used (as % * 100)
+	  uint32_t pc = (uint32_t)(((fsm->total - fsm->free) * 10000) / fsm->total);
+	  if(pc > dsk->part_max_used) dsk->part_max_used = pc;
+	}
+      }
+      if(!kicked)
+	fsWorkerKick(fs);
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________     readDiskCounters      __________________
     -----------------___________________________------------------
@@ -47,65 +353,47 @@ int remote_mount(const char *device, const char *type)
 
   int readDiskCounters(HSP *sp, SFLHost_dsk_counters *dsk) {
     int gotData = NO;
-    FILE *procFile;
-    procFile= fopen(PROCFS_STR "/diskstats", "r");
-    if(procFile) {
+    HSPProcFiles *pf = &sp->procFiles;
+    char *buf;
+    if(pf->diskstats == NULL)
+      pf->diskstats = UTProcFileNew(PROCFS_STR "/diskstats", 0);
+    if((buf = UTProcFileRead(pf->diskstats)) != NULL) {
       // ASCII numbers in /proc/diskstats may be 64-bit (if not now
       // then someday), so it seems safer to read into
-      // 64-bit ints with scanf first,  then copy them
-      // into the host_dsk structure from there.
-      uint32_t majorNo;
-      uint32_t minorNo;
-
-      uint64_t reads = 0;
-      /* uint64_t reads_merged = 0;*/
-      uint64_t sectors_read = 0;
-      uint64_t read_time_ms = 0;
-      uint64_t writes = 0;
-      /* uint64_t writes_merged = 0;*/
-      uint64_t sectors_written = 0;
-      uint64_t write_time_ms = 0;
+      // 64-bit ints first,  then copy them into the host_dsk
+      // structure from there.
+      uint64_t devNo[2];
+      // reads,reads_merged,sectors_read,read_time_ms,
+      // writes,writes_merged,sectors_written,write_time_ms
+      uint64_t io[8];
 
       // handle 64-bit counters specially
       uint64_t total_sectors_read = 0;
       uint64_t total_sectors_written = 0;
 
-      // limit the number of chars we will read from each line
-      // (there can be more than this - my_readline will chop for us)
-#define MAX_PROC_LINE_CHARS 240
-      char line[MAX_PROC_LINE_CHARS];
-      char devName[MAX_PROC_LINE_CHARS];
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	if(sscanf(line, "%"SCNu32" %"SCNu32" %s %"SCNu64" %*u %"SCNu64" %"SCNu64" %"SCNu64" %*u %"SCNu64" %"SCNu64"",
-		  &majorNo,
-		  &minorNo,
-		  devName,
-		  &reads,
-		  /*&reads_merged,*/
-		  &sectors_read,
-		  &read_time_ms,
-		  &writes,
-		  /*&writes_merged,*/
-		  &sectors_written,
-		  &write_time_ms) == 9) {
+      char *line;
+      char *p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
+	if(UTProcNextU64s(&line, devNo, 2) == 2
+	   && UTProcNextTok(&line) != NULL
+	   && UTProcNextU64s(&line, io, 8) == 8) {
 	  gotData = YES;
 	  // report the sum over all disks - except software RAID devices and logical volumes
 	  // because that would cause double-counting.   We identify those by their
 	  // major numbers:
 	  // Software RAID = 9
 	  // Logical Vol = 253
+	  uint64_t majorNo = devNo[0];
 	  if(majorNo != 9 && majorNo != 253) {
-	    dsk->reads += reads;
-	    total_sectors_read += sectors_read;
-	    dsk->read_time += read_time_ms;
-	    dsk->writes += writes;
-	    total_sectors_written += sectors_written;
-	    dsk->write_time += write_time_ms;
+	    dsk->reads += io[0];
+	    total_sectors_read += io[2];
+	    dsk->read_time += io[3];
+	    dsk->writes += io[4];
+	    total_sectors_written += io[6];
+	    dsk->write_time += io[7];
 	  }
 	}
       }
-      fclose(procFile);
 
       // accumulate the 64-bit counters (they may only be 32-bit counters in this OS)
       sp->diskIO.bytes_read += (total_sectors_read - sp->diskIO.last_sectors_read) * ASSUMED_DISK_SECTOR_BYTES;
@@ -117,56 +405,22 @@ int remote_mount(const char *device, const char *type)
       dsk->bytes_written = sp->diskIO.bytes_written;
     }
 
-    // borrowed heavily from ganglia/linux/metrics.c for this part where
-    // we read the mount points and then interrogate them to add up the
-    // disk space on local disks.
-    procFile = fopen(PROCFS_STR "/mounts", "r");
-    if(procFile) {
-#undef MAX_PROC_LINE_CHARS
-#define MAX_PROC_LINE_CHARS 240
-      char line[MAX_PROC_LINE_CHARS];
-      char device[MAX_PROC_LINE_CHARS];
-      char mount[MAX_PROC_LINE_CHARS];
-      char type[MAX_PROC_LINE_CHARS];
-      char mode[MAX_PROC_LINE_CHARS];
-      void *treeRoot = NULL;
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	if(sscanf(line, "%s %s %s %s", device, mount, type, mode) == 4) {
-	  // must start with /dev/ or /dev2/ or ubi:
-	  if(strncmp(device, "/dev/", 5) == 0 ||
-	     strncmp(device, "/dev2/", 6) == 0 ||
-	     strncmp(device, "ubi:", 4) == 0) {
-	    // must be read-write
-	    if(strncmp(mode, "ro", 2) != 0) {
-	      // must be local
-	      if(!remote_mount(device, type)) {
-		// don't count it again if it was seen before
-		if(tfind(device, &treeRoot, (comparison_fn_t)strcmp) == NULL) {
-		  // not found, so remember it
-		  tsearch(my_strdup(device), &treeRoot, (comparison_fn_t)strcmp);
-		  // and get the numbers
-		  struct statvfs svfs;
-		  if(statvfs(mount, &svfs) == 0) {
-		    if(svfs.f_blocks) {
-		      uint64_t dtot64 = (uint64_t)svfs.f_blocks * (uint64_t)svfs.f_bsize;
-		      uint64_t dfree64 = (uint64_t)svfs.f_bavail * (uint64_t)svfs.f_bsize;
-		      dsk->disk_total += dtot64;
-		      dsk->disk_free += dfree64;
-		      // percent used (as % * 100)
-		      uint32_t pc = (uint32_t)(((dtot64 - dfree64) * 10000) / dtot64);
-		      if(pc > dsk->part_max_used) dsk->part_max_used = pc;
-		    }
-		  }
-		}
-	      }
-	    }
-	  }
-	}
-      }
-      tdestroy(treeRoot, my_free);
-      fclose(procFile);
+    // the mount table raises POLLPRI when it changes,  so we only
+    // need to read it again when that happens.
+    if(pf->mounts == NULL) {
+      pf->mounts = UTProcFileNew(PROCFS_STR "/mounts", 0);
+      HSPFsStats *fs = (HSPFsStats *)my_calloc(sizeof(HSPFsStats));
+      pthread_mutex_init(&fs->sync, NULL);
+      pthread_cond_init(&fs->cond, NULL);
+      pthread_cond_init(&fs->done, NULL);
+      fs->mounts = UTArrayNew(UTARRAY_PACK);
+      pf->fsStats = fs;
     }
+    if(UTProcFileChanged(pf->mounts)
+       && (buf = UTProcFileRead(pf->mounts)) != NULL)
+      readLocalMounts(pf->fsStats, buf);
+
+    readFsCapacity(pf->fsStats, dsk);
 
     return gotData;
   }
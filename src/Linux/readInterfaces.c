@@ -8,6 +8,7 @@ extern "C" {
 
 #include "hsflowd.h"
 #include "hsflow_ethtool.h"
+#include "util_netlink.h"
 
 #include <sys/ioctl.h>
 #include <sys/socket.h>
@@ -16,6 +17,9 @@ extern "C" {
 #include <linux/ethtool.h>
 #include <linux/sockios.h>
 #include <linux/if_vlan.h>
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0))
+#include <linux/ethtool_netlink.h>
+#endif
 
 #if (__GLIBC__ >= 2 && __GLIBC_MINOR__ >= 3)
 #include <ifaddrs.h> // for getifaddrs(3)
@@ -268,38 +272,6 @@ extern "C" {
     return -1;
   }
 
-/*________________---------------------------__________________
-  ________________   ethtool_num_counters    __________________
-  ----------------___________________________------------------
-*/
-
-  static int ethtool_num_counters(struct ifreq *ifr, int fd)
-  {
-#ifdef ETHTOOL_GSSET_INFO
-    struct {
-      struct ethtool_sset_info ssi;
-      uint32_t data;
-    } sset_info;
-    memset(&sset_info, 0, sizeof(sset_info));
-    sset_info.ssi.cmd = ETHTOOL_GSSET_INFO;
-    sset_info.ssi.sset_mask = (uint64_t)1 << ETH_SS_STATS;
-    ifr->ifr_data = (char *)&sset_info;
-    if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-      if(sset_info.ssi.sset_mask) {
-	return sset_info.data > 0 ? sset_info.data : 0;
-      }
-    }
-#else
-    struct ethtool_drvinfo drvinfo;
-    drvinfo.cmd = ETHTOOL_GDRVINFO;
-    ifr->ifr_data = (char *)&drvinfo;
-    if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-      return drvinfo.n_stats > 0 ? drvinfo.n_stats : 0;
-    }
-#endif
-    return 0;
-  }
-
 #ifdef ETHTOOL_GLINKSETTINGS
 
 /*________________-----------------------------__________________
@@ -505,35 +477,122 @@ extern "C" {
   ----------------___________________________------------------
 */
 
-  static bool ethtool_get_GDRVINFO(struct ifreq *ifr, int fd, SFLAdaptor *adaptor)
+  static bool ethtool_get_GDRVINFO(struct ifreq *ifr, int fd, struct ethtool_drvinfo *drvinfo)
+  {
+    // no genetlink equivalent for this one, but it also tells us
+    // n_stats, which saves an ETHTOOL_GSSET_INFO call below.
+    memset(drvinfo, 0, sizeof(*drvinfo));
+    drvinfo->cmd = ETHTOOL_GDRVINFO;
+    ifr->ifr_data = (char *)drvinfo;
+    return (ioctl(fd, SIOCETHTOOL, ifr) >= 0);
+  }
+
+  static bool ethtool_setDevType(SFLAdaptor *adaptor, struct ethtool_drvinfo *drvinfo)
   {
     // set device type from ethtool driver info - could also have gone
     // to /sys/class/net/<device>/.
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-    struct ethtool_drvinfo drvinfo;
-    drvinfo.cmd = ETHTOOL_GDRVINFO;
-    ifr->ifr_data = (char *)&drvinfo;
+    EnumHSPDevType devType = HSPDEV_OTHER;
+    if(!strncasecmp(drvinfo->driver, "bridge", strlen("bridge")))
+      devType = HSPDEV_BRIDGE;
+    else if(!strncasecmp(drvinfo->driver, "veth", strlen("veth")))
+      devType = HSPDEV_VETH;
+    else if(!strncasecmp(drvinfo->driver, "vif", strlen("vif")))
+      devType = HSPDEV_VIF;
+    else if(!strncasecmp(drvinfo->driver, "openvswitch", strlen("openvswitch")))
+      devType = HSPDEV_OVS;
+    else if(strncasecmp(drvinfo->driver, "e1000", strlen("e1000")))
+      devType = HSPDEV_PHYSICAL;
+    else if(my_strlen(drvinfo->bus_info))
+      devType = HSPDEV_PHYSICAL;
+
+    if(adaptorNIO->devType != devType) {
+      adaptorNIO->devType = devType;
+      return YES;
+    }
+    return NO;
+  }
+
+/*________________---------------------------__________________
+  ________________  ethtool_driverStrings    __________________
+  ----------------___________________________------------------
+  The ETH_SS_STATS string-set is fixed by the driver, so only run
+  ETHTOOL_GSTRINGS the first time we see a (driver,n_stats) pair.
+  Including n_stats in the key covers drivers that add per-queue
+  counters.
+*/
+
+  typedef struct _HSPEthtoolStrings {
+    struct {
+      char driver[32];
+      uint32_t n_stats;
+    } key;
+    ETCTRFlags et_found;
+    uint8_t et_idx_mcasts_in;
+    uint8_t et_idx_mcasts_out;
+    uint8_t et_idx_bcasts_in;
+    uint8_t et_idx_bcasts_out;
+    uint32_t et_idx_peer_ifindex; // 1-based, 0 if not present
+  } HSPEthtoolStrings;
+
+  static HSPEthtoolStrings *ethtool_driverStrings(HSP *sp, struct ifreq *ifr, int fd, struct ethtool_drvinfo *drvinfo)
+  {
+    if(sp->ethtoolDrivers == NULL)
+      sp->ethtoolDrivers = UTHASH_NEW(HSPEthtoolStrings, key, UTHASH_DFLT);
+    HSPEthtoolStrings search;
+    memset(&search, 0, sizeof(search));
+    memcpy(search.key.driver, drvinfo->driver, sizeof(search.key.driver));
+    search.key.driver[sizeof(search.key.driver) - 1] = '\0';
+    search.key.n_stats = drvinfo->n_stats;
+    HSPEthtoolStrings *strs = UTHashGet(sp->ethtoolDrivers, &search);
+    if(strs)
+      return strs;
+
+    uint32_t nctrs = drvinfo->n_stats;
+    struct ethtool_gstrings *ctrNames;
+    uint32_t bytes = sizeof(*ctrNames) + (nctrs * ETH_GSTRING_LEN);
+    ctrNames = (struct ethtool_gstrings *)my_calloc(bytes);
+    ctrNames->cmd = ETHTOOL_GSTRINGS;
+    ctrNames->string_set = ETH_SS_STATS;
+    ctrNames->len = nctrs;
+    ifr->ifr_data = (char *)ctrNames;
     if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-      EnumHSPDevType devType = HSPDEV_OTHER;
-      if(!strncasecmp(drvinfo.driver, "bridge", strlen("bridge")))
-	devType = HSPDEV_BRIDGE;
-      else if(!strncasecmp(drvinfo.driver, "veth", strlen("veth")))
-	devType = HSPDEV_VETH;
-      else if(!strncasecmp(drvinfo.driver, "vif", strlen("vif")))
-	devType = HSPDEV_VIF;
-      else if(!strncasecmp(drvinfo.driver, "openvswitch", strlen("openvswitch")))
-	devType = HSPDEV_OVS;
-      else if(strncasecmp(drvinfo.driver, "e1000", strlen("e1000")))
-	devType = HSPDEV_PHYSICAL;
-      else if(my_strlen(drvinfo.bus_info))
-	devType = HSPDEV_PHYSICAL;
-
-      if(adaptorNIO->devType != devType) {
-	adaptorNIO->devType = devType;
-	return YES;
+      strs = (HSPEthtoolStrings *)my_calloc(sizeof(HSPEthtoolStrings));
+      strs->key = search.key;
+      // copy out one at a time to make sure we have null-termination
+      char cname[ETH_GSTRING_LEN+1];
+      cname[ETH_GSTRING_LEN] = '\0';
+      for(int ii=0; ii < nctrs; ii++) {
+	memcpy(cname, &ctrNames->data[ii * ETH_GSTRING_LEN], ETH_GSTRING_LEN);
+	myDebug(3, "ethtool counter %s is at index %d", cname, ii);
+	// then see if this is one of the ones we want,
+	// and record the index if it is.
+	if(staticStringsIndexOf(HSP_ethtool_mcasts_in_names, cname) != -1) {
+	  strs->et_idx_mcasts_in = ii+1;
+	  strs->et_found |= HSP_ETCTR_MC_IN;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_mcasts_out_names, cname) != -1) {
+	  strs->et_idx_mcasts_out = ii+1;
+	  strs->et_found |= HSP_ETCTR_MC_OUT;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_bcasts_in_names, cname) != -1) {
+	  strs->et_idx_bcasts_in = ii+1;
+	  strs->et_found |= HSP_ETCTR_BC_IN;
+	}
+	else if(staticStringsIndexOf(HSP_ethtool_bcasts_out_names, cname) != -1) {
+	  strs->et_idx_bcasts_out = ii+1;
+	  strs->et_found |= HSP_ETCTR_BC_OUT;
+	}
+	if(staticStringsIndexOf(HSP_ethtool_peer_ifindex_names, cname) != -1)
+	  strs->et_idx_peer_ifindex = ii+1;
       }
+      myDebug(1, "ethtool: learned %u stats strings for driver %s",
+	      nctrs,
+	      strs->key.driver);
+      UTHashAdd(sp->ethtoolDrivers, strs);
     }
-    return NO;
+    my_free(ctrNames);
+    return strs;
   }
 
 /*________________---------------------------__________________
@@ -541,87 +600,236 @@ extern "C" {
   ----------------___________________________------------------
 */
 
-  static void ethtool_get_GSTATS(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor)
+  static void ethtool_get_GSTATS(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor, struct ethtool_drvinfo *drvinfo)
   {
     // see if the ethtool stats block can give us multicast/broadcast counters too
     HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-    adaptorNIO->et_nctrs = ethtool_num_counters(ifr, fd);
-    if(adaptorNIO->et_nctrs) {
-      struct ethtool_gstrings *ctrNames;
-      uint32_t bytes = sizeof(*ctrNames) + (adaptorNIO->et_nctrs * ETH_GSTRING_LEN);
-      ctrNames = (struct ethtool_gstrings *)my_calloc(bytes);
-      ctrNames->cmd = ETHTOOL_GSTRINGS;
-      ctrNames->string_set = ETH_SS_STATS;
-      ctrNames->len = adaptorNIO->et_nctrs;
-      ifr->ifr_data = (char *)ctrNames;
+    adaptorNIO->et_nctrs = drvinfo ? drvinfo->n_stats : 0;
+    if(adaptorNIO->et_nctrs == 0)
+      return;
+    HSPEthtoolStrings *strs = ethtool_driverStrings(sp, ifr, fd, drvinfo);
+    if(strs == NULL)
+      return;
+    adaptorNIO->et_found = strs->et_found;
+    adaptorNIO->et_idx_mcasts_in = strs->et_idx_mcasts_in;
+    adaptorNIO->et_idx_mcasts_out = strs->et_idx_mcasts_out;
+    adaptorNIO->et_idx_bcasts_in = strs->et_idx_bcasts_in;
+    adaptorNIO->et_idx_bcasts_out = strs->et_idx_bcasts_out;
+    if(strs->et_idx_peer_ifindex) {
+      // Now go ahead and make the call to get the peer_ifindex. This should
+      // work for veth pairs. If the container's device is a macvlan then it's
+      // peer ifIndex will be reported as 0.
+      // Understanding where a macvlan connects to can be
+      // gleaned from a netlink call to RTM_GETLINK,  where the IFLA_LINK
+      // attribute should have the ifIndex of the interface that the macvlan
+      // is on.  See https://github.com/jbenc/plotnetcfg.  However we don't
+      // really need that information to correctly model a macvlan setup as
+      // an sFlow bridge,  so we don't even try to get it here.
+      uint32_t bytes = sizeof(struct ethtool_stats) + (adaptorNIO->et_nctrs * sizeof(uint64_t));
+      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
+      et_stats->cmd = ETHTOOL_GSTATS;
+      et_stats->n_stats = adaptorNIO->et_nctrs;
+      ifr->ifr_data = (char *)et_stats;
       if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-	// copy out one at a time to make sure we have null-termination
-	char cname[ETH_GSTRING_LEN+1];
-	cname[ETH_GSTRING_LEN] = '\0';
-	adaptorNIO->et_found = 0;
-	for(int ii=0; ii < adaptorNIO->et_nctrs; ii++) {
-	  memcpy(cname, &ctrNames->data[ii * ETH_GSTRING_LEN], ETH_GSTRING_LEN);
-	  myDebug(3, "ethtool counter %s is at index %d", cname, ii);
-	  // then see if this is one of the ones we want,
-	  // and record the index if it is.
-	  if(staticStringsIndexOf(HSP_ethtool_mcasts_in_names, cname) != -1) {
-	    adaptorNIO->et_idx_mcasts_in = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_MC_IN;
-	  }
-	  else if(staticStringsIndexOf(HSP_ethtool_mcasts_out_names, cname) != -1) {
-	    adaptorNIO->et_idx_mcasts_out = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_MC_OUT;
-	  }
-	  else if(staticStringsIndexOf(HSP_ethtool_bcasts_in_names, cname) != -1) {
-	    adaptorNIO->et_idx_bcasts_in = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_BC_IN;
-	    }
-	  else if(staticStringsIndexOf(HSP_ethtool_bcasts_out_names, cname) != -1) {
-	    adaptorNIO->et_idx_bcasts_out = ii+1;
-	    adaptorNIO->et_found |= HSP_ETCTR_BC_OUT;
-	  }
-	  if(staticStringsIndexOf(HSP_ethtool_peer_ifindex_names, cname) != -1) {
-	    // Now go ahead and make the call to get the peer_ifindex. This should
-	    // work for veth pairs. If the container's device is a macvlan then it's
-	    // peer ifIndex will be reported as 0.
-	    // Understanding where a macvlan connects to can be
-	    // gleaned from a netlink call to RTM_GETLINK,  where the IFLA_LINK
-	    // attribute should have the ifIndex of the interface that the macvlan
-	    // is on.  See https://github.com/jbenc/plotnetcfg.  However we don't
-	    // really need that information to correctly model a macvlan setup as
-	    // an sFlow bridge,  so we don't even try to get it here.
-	      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
-	      et_stats->cmd = ETHTOOL_GSTATS;
-	      et_stats->n_stats = adaptorNIO->et_nctrs;
-	      ifr->ifr_data = (char *)et_stats;
-	      if(ioctl(fd, SIOCETHTOOL, ifr) >= 0) {
-		adaptor->peer_ifIndex = et_stats->data[ii];
-		adaptorAddOrReplace(sp->adaptorsByPeerIndex, adaptor, "byPeerIndex");
-		myDebug(1, "Interface %s (ifIndex=%u) has peer_ifindex=%u",
-			adaptor->deviceName,
-			adaptor->ifIndex,
-			adaptor->peer_ifIndex);
-	      }
-	      my_free(et_stats);
-	  }
+	adaptor->peer_ifIndex = et_stats->data[strs->et_idx_peer_ifindex - 1];
+	adaptorAddOrReplace(sp->adaptorsByPeerIndex, adaptor, "byPeerIndex");
+	myDebug(1, "Interface %s (ifIndex=%u) has peer_ifindex=%u",
+		adaptor->deviceName,
+		adaptor->ifIndex,
+		adaptor->peer_ifIndex);
+      }
+      my_free(et_stats);
+    }
+  }
+
+#ifdef ETHTOOL_GENL_NAME
+
+/*________________---------------------------__________________
+  ________________  ethtool_nl_linkModes     __________________
+  ----------------___________________________------------------
+  One ETHTOOL_MSG_LINKMODES_GET dump gives speed and duplex for
+  every device in the namespace,  replacing the per-device
+  GLINKSETTINGS handshake (or GSET).  Devices without link settings
+  are left out of the dump by the kernel,  just as the ioctl would
+  have failed for them. Returns NULL if the caller should fall back
+  on the ioctl calls.
+*/
+
+#define HSP_ETHTOOL_NETLINK_TIMEOUT_MS 1000
+
+  typedef struct _HSPLinkModes {
+    uint32_t ifIndex;
+    uint32_t speed;
+    uint8_t duplex;
+  } HSPLinkModes;
+
+  static void linkModesCB(void *magic, struct nlmsghdr *nlh) {
+    UTHash *linkModes = (UTHash *)magic;
+    struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(nlh);
+    if(genl->cmd != ETHTOOL_MSG_LINKMODES_GET_REPLY)
+      return;
+    HSPLinkModes lm = { };
+    bool gotSpeed = NO;
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*genl));
+    for(struct nlattr *attr = (struct nlattr *)((char *)genl + GENL_HDRLEN);
+	UTNLA_OK(attr, len);
+	attr = UTNLA_NEXT(attr, len)) {
+      switch(attr->nla_type & NLA_TYPE_MASK) {
+      case ETHTOOL_A_LINKMODES_HEADER: {
+	int hlen = UTNLA_PAYLOAD(attr);
+	for(struct nlattr *hattr = (struct nlattr *)UTNLA_DATA(attr);
+	    UTNLA_OK(hattr, hlen);
+	    hattr = UTNLA_NEXT(hattr, hlen)) {
+	  if(hattr->nla_type == ETHTOOL_A_HEADER_DEV_INDEX)
+	    lm.ifIndex = *(uint32_t *)UTNLA_DATA(hattr);
 	}
       }
-      my_free(ctrNames);
+	break;
+      case ETHTOOL_A_LINKMODES_SPEED:
+	lm.speed = *(uint32_t *)UTNLA_DATA(attr);
+	gotSpeed = YES;
+	break;
+      case ETHTOOL_A_LINKMODES_DUPLEX:
+	lm.duplex = *(uint8_t *)UTNLA_DATA(attr);
+	break;
+      }
+    }
+    if(lm.ifIndex
+       && gotSpeed) {
+      HSPLinkModes *entry = (HSPLinkModes *)my_calloc(sizeof(HSPLinkModes));
+      *entry = lm;
+      UTHashAdd(linkModes, entry);
     }
   }
 
+  static void ethtool_nl_freeLinkModes(UTHash *linkModes) {
+    HSPLinkModes *lm;
+    UTHASH_WALK(linkModes, lm)
+      my_free(lm);
+    UTHashFree(linkModes);
+  }
+
+  static UTHash *ethtool_nl_linkModes(HSP *sp)
+  {
+    if(sp->ethtool_nl_family < 0)
+      return NULL;
+    if(sp->ethtool_nl_sock <= 0) {
+      if((sp->ethtool_nl_sock = UTNLGeneric_openRequest()) <= 0) {
+	sp->ethtool_nl_family = -1;
+	return NULL;
+      }
+    }
+    if(sp->ethtool_nl_family == 0) {
+      int id = UTNLGeneric_family(sp->ethtool_nl_sock,
+				  ETHTOOL_GENL_NAME,
+				  ++sp->ethtool_nl_seq,
+				  HSP_ETHTOOL_NETLINK_TIMEOUT_MS);
+      if(id == -ETIMEDOUT)
+	return NULL; // try again next time
+      if(id <= 0) {
+	myLog(LOG_INFO, "ethtool netlink family not available (%s), using ioctl",
+	      strerror(-id));
+	sp->ethtool_nl_family = -1;
+	return NULL;
+      }
+      myDebug(1, "ethtool netlink family id=%d", id);
+      sp->ethtool_nl_family = id;
+    }
+    // ask for compact bitsets - we don't look at the link-mode names
+    struct {
+      struct nlattr hdr;
+      struct nlattr flags_hdr;
+      uint32_t flags;
+    } req = {
+      .hdr = { .nla_len = sizeof(req), .nla_type = ETHTOOL_A_LINKMODES_HEADER | NLA_F_NESTED },
+      .flags_hdr = { .nla_len = UTNLA_LENGTH(sizeof(uint32_t)), .nla_type = ETHTOOL_A_HEADER_FLAGS },
+      .flags = ETHTOOL_FLAG_COMPACT_BITSETS
+    };
+    UTHash *linkModes = UTHASH_NEW(HSPLinkModes, ifIndex, UTHASH_DFLT);
+    uint32_t seqNo = ++sp->ethtool_nl_seq;
+    int err = UTNLGeneric_dump(sp->ethtool_nl_sock,
+			       sp->ethtool_nl_family,
+			       ETHTOOL_MSG_LINKMODES_GET,
+			       ETHTOOL_GENL_VERSION,
+			       &req,
+			       sizeof(req),
+			       seqNo);
+    if(err >= 0)
+      err = UTNLRoute_recv(sp->ethtool_nl_sock, seqNo, HSP_ETHTOOL_NETLINK_TIMEOUT_MS, linkModes, linkModesCB);
+    else
+      err = -errno;
+    if(err == 0) {
+      myDebug(1, "ethtool netlink: link modes for %u devices", linkModes->entries);
+      return linkModes;
+    }
+    ethtool_nl_freeLinkModes(linkModes);
+    if(err != -ETIMEDOUT) {
+      myLog(LOG_INFO, "ethtool netlink dump failed (%s), using ioctl",
+	    strerror(-err));
+      sp->ethtool_nl_family = -1;
+    }
+    return NULL;
+  }
+
+/*________________---------------------------__________________
+  ________________  ethtool_nl_setLink       __________________
+  ----------------___________________________------------------
+*/
+
+  static bool ethtool_nl_setLink(HSP *sp, UTHash *linkModes, SFLAdaptor *adaptor)
+  {
+    bool changed = NO;
+    HSPLinkModes search = { .ifIndex = adaptor->ifIndex };
+    HSPLinkModes *lm = UTHashGet(linkModes, &search);
+    if(lm == NULL)
+      return NO;
+    // same interpretation as the ioctl: DUPLEX_UNKNOWN counts as full
+    uint32_t direction = lm->duplex ? 1 : 2;
+    if(direction != adaptor->ifDirection) {
+      changed = YES;
+    }
+    adaptor->ifDirection = direction;
+    if(lm->speed == (uint32_t)-1) {
+      // unknown
+      if(adaptor->ifSpeed != 0) {
+	changed = YES;
+      }
+      setAdaptorSpeed(sp, adaptor, 0, "ETHTOOL_MSG_LINKMODES1");
+    }
+    else {
+      uint64_t ifSpeed_bps = (uint64_t)lm->speed * 1000000;
+      if(adaptor->ifSpeed != ifSpeed_bps) {
+	changed = YES;
+      }
+      setAdaptorSpeed(sp, adaptor, ifSpeed_bps, "ETHTOOL_MSG_LINKMODES2");
+    }
+    return changed;
+  }
+
+#endif /* ETHTOOL_GENL_NAME */
+
 /*________________---------------------------__________________
   ________________  read_ethtool_info        __________________
   ----------------___________________________------------------
+  linkModes is the result of ethtool_nl_linkModes(), or NULL to
+  use the ioctl calls for link settings.
 */
 
-  static bool read_ethtool_info(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor)
+  static bool read_ethtool_info(HSP *sp, struct ifreq *ifr, int fd, SFLAdaptor *adaptor, UTHash *linkModes)
   {
     bool changed = NO;
     HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
 
-    if(nio->ethtool_GDRVINFO) {
-      changed |= ethtool_get_GDRVINFO(ifr, fd, adaptor);
+    struct ethtool_drvinfo drvinfo;
+    bool drvinfoOK = NO;
+    if(nio->ethtool_GDRVINFO
+       || nio->ethtool_GSTATS) {
+      drvinfoOK = ethtool_get_GDRVINFO(ifr, fd, &drvinfo);
+    }
+
+    if(drvinfoOK
+       && nio->ethtool_GDRVINFO) {
+      changed |= ethtool_setDevType(adaptor, &drvinfo);
     }
 
 #if ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEINFO )
@@ -632,8 +840,18 @@ extern "C" {
 
     // GLINKSETTINGS should eventually take over from GSET
     bool glinkSettingsOK = NO;
+#ifdef ETHTOOL_GENL_NAME
+    if(linkModes
+       && (nio->ethtool_GLINKSETTINGS
+	   || nio->ethtool_GSET)) {
+      // the dump already told us everything the ioctls could
+      changed |= ethtool_nl_setLink(sp, linkModes, adaptor);
+      glinkSettingsOK = YES;
+    }
+#endif
+
 #ifdef ETHTOOL_GLINKSETTINGS
-    if(nio->ethtool_GLINKSETTINGS) {
+    if(glinkSettingsOK==NO && nio->ethtool_GLINKSETTINGS) {
       changed |= ethtool_get_GLINKSETTINGS(sp, ifr, fd, adaptor, &glinkSettingsOK);
     }
 #endif
@@ -646,7 +864,7 @@ extern "C" {
 #endif
 
     if(nio->ethtool_GSTATS) {
-      ethtool_get_GSTATS(sp, ifr, fd, adaptor);
+      ethtool_get_GSTATS(sp, ifr, fd, adaptor, drvinfoOK ? &drvinfo : NULL);
     }
     return changed;
   }
@@ -705,6 +923,254 @@ extern "C" {
     return (changed != NULL);
   }
 
+/*________________---------------------------__________________
+  ________________      intfEvent            __________________
+  ----------------___________________________------------------
+  Per-adaptor events are only sent on the poll bus (synchronously),
+  because the adaptor may be freed before an inter-thread event
+  could be delivered.
+*/
+
+  static void intfEvent(HSP *sp, char *evtName, SFLAdaptor *adaptor)
+  {
+    if(sp->pollBus
+       && EVCurrentBus() == sp->pollBus)
+      EVEventTx(sp->rootModule, EVGetEvent(sp->pollBus, evtName), &adaptor, sizeof(adaptor));
+  }
+
+  static void removeAdaptor(HSP *sp, SFLAdaptor *adaptor)
+  {
+    if(sp->allowDeleteAdaptor)
+      intfEvent(sp, HSPEVENT_INTF_REMOVED, adaptor);
+    deleteAdaptor(sp, adaptor, YES);
+  }
+
+/*________________---------------------------__________________
+  ________________      readInterface        __________________
+  ----------------___________________________------------------
+  Read one device,  adding or updating its adaptor. Used for each
+  line of /proc/net/dev by readInterfaces(),  and for individual
+  devices when rtnetlink tells us something changed.
+*/
+
+  typedef struct _HSPIntfDelta {
+    uint32_t added;
+    uint32_t removed;
+    uint32_t cameup;
+    uint32_t wentdown;
+    uint32_t changed;
+  } HSPIntfDelta;
+
+  static SFLAdaptor *readInterface(HSP *sp, int fd, char *devName, bool full_discovery, UTHash *linkModes, UTHash *newLocalIP, HSPIntfDelta *delta)
+  {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    // we set the ifr_name field to make our queries
+    strncpy(ifr.ifr_name, devName, IFNAMSIZ-1);
+
+    myDebug(3, "reading interface %s", devName);
+
+    // Get the flags for this interface
+    if(ioctl(fd,SIOCGIFFLAGS, &ifr) < 0) {
+      // ENODEV is expected if an rtnetlink event raced with the device going away
+      if(errno == ENODEV)
+	myDebug(1, "device %s Get SIOCGIFFLAGS failed : %s",
+		devName,
+		strerror(errno));
+      else
+	myLog(LOG_ERR, "device %s Get SIOCGIFFLAGS failed : %s",
+	      devName,
+	      strerror(errno));
+      return NULL;
+    }
+
+    int up = (ifr.ifr_flags & IFF_UP) ? YES : NO;
+    int loopback = (ifr.ifr_flags & IFF_LOOPBACK) ? YES : NO;
+    int promisc =  (ifr.ifr_flags & IFF_PROMISC) ? YES : NO;
+    int bond_master = (ifr.ifr_flags & IFF_MASTER) ? YES : NO;
+    int bond_slave = (ifr.ifr_flags & IFF_SLAVE) ? YES : NO;
+    //int hasBroadcast = (ifr.ifr_flags & IFF_BROADCAST);
+    //int pointToPoint = (ifr.ifr_flags & IFF_POINTOPOINT);
+
+    // used to ignore loopback interfaces here, and interfaces
+    // that are currently marked down, but now those are
+    // filtered at the point where we roll together the
+    // counters, or build the list for export
+
+    // Try and get the MAC Address for this interface
+    u_char macBytes[6];
+    int gotMac = NO;
+    if(ioctl(fd,SIOCGIFHWADDR, &ifr) < 0) {
+      myLog(LOG_ERR, "device %s Get SIOCGIFHWADDR failed : %s",
+	    devName,
+	    strerror(errno));
+    }
+    else {
+      memcpy(macBytes, (u_char *)&ifr.ifr_hwaddr.sa_data, 6);
+      gotMac = YES;
+    }
+
+    // Try and get the ifIndex for this interface
+    uint32_t ifIndex = 0;
+    if(ioctl(fd,SIOCGIFINDEX, &ifr) < 0) {
+      // only complain about this if we are debugging
+      myDebug(1, "device %s Get SIOCGIFINDEX failed : %s",
+	      devName,
+	      strerror(errno));
+    }
+    else {
+      ifIndex = ifr.ifr_ifindex;
+    }
+
+    // find existing adaptor by name.  We use adaptorsByName as the primary lookup here
+    // assuming that every interface has a unique, non-empty name. We treat this as being
+    // the same interface if it appears with the same name, ifIndex and MAC as last time.
+    // Otherwise a new adaptor object is inserted. Any previous adaptor objects that are not
+    // found in this way are deleted (from all lookup tables) using the mark-and-sweep
+    // mechanism.
+
+    // for now just assume that each interface has only one MAC.  It's not clear how we can
+    // learn multiple MACs this way anyhow.  It seems like there is just one per ifr record.
+    // find or create a new "adaptor" entry
+    SFLAdaptor *adaptor = nioAdaptorNew(devName, (gotMac ? macBytes : NULL), ifIndex);
+
+    bool addAdaptorToHT = YES;
+    bool changed = NO;
+
+    SFLAdaptor *existing = adaptorByName(sp, devName);
+    if(existing
+       && adaptorEqual(adaptor, existing)) {
+      // found by name, and no change to (name,ifIndex,MAC), so use existing object
+      // note that attributes such as peer_ifIndex may differ here, but they may not
+      // have been looked up yet.
+      adaptorFree(adaptor);
+      // this adaptor is going to survive
+      adaptor = existing;
+      // clear the mark so we don't free it below
+      adaptor->marked = NO;
+      // indicate that it is already in the lookup tables
+      addAdaptorToHT = NO;
+    }
+
+    // this flag might belong in the adaptorNIO struct
+    adaptor->promiscuous = promisc;
+
+    // remember some useful flags in the userData structure
+    HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
+    if(adaptorNIO->up != up) {
+      if(up) {
+	delta->cameup++;
+	// trigger test for module eeprom data
+	adaptorNIO->ethtool_GMODULEINFO = YES;
+      }
+      else delta->wentdown++;
+      changed = YES;
+      myDebug(1, "adaptor %s %s",
+	      adaptor->deviceName,
+	      up ? "came up" : "went down");
+    }
+    adaptorNIO->up = up;
+
+    // make sure we notice changes
+    if(adaptorNIO->loopback != loopback
+       || adaptorNIO->bond_master != bond_master
+       || adaptorNIO->bond_slave != bond_slave) {
+      delta->changed++;
+      changed = YES;
+    }
+
+    adaptorNIO->loopback = loopback;
+    adaptorNIO->bond_master = bond_master;
+    adaptorNIO->bond_slave = bond_slave;
+
+    // Try to get the IP address for this interface
+    if(ioctl(fd,SIOCGIFADDR, &ifr) < 0) {
+      // only complain about this if we are debugging
+      myDebug(1, "device %s Get SIOCGIFADDR failed : %s",
+	      devName,
+	      strerror(errno));
+    }
+    else {
+      if (ifr.ifr_addr.sa_family == AF_INET) {
+	struct sockaddr_in *s = (struct sockaddr_in *)&ifr.ifr_addr;
+	// IP addr is now s->sin_addr
+	adaptorNIO->ipAddr.type = SFLADDRESSTYPE_IP_V4;
+	adaptorNIO->ipAddr.address.ip_v4.addr = s->sin_addr.s_addr;
+	// add to localIP hash too
+	if(newLocalIP)
+	  addLocalIP(newLocalIP, &adaptorNIO->ipAddr, adaptor->deviceName);
+      }
+      //else if (ifr.ifr_addr.sa_family == AF_INET6) {
+      // not sure this ever happens - on a linux system IPv6 addresses
+      // are picked up from /proc/net/if_inet6
+      // struct sockaddr_in6 *s = (struct sockaddr_in6 *)&ifr.ifr_addr;
+      // IP6 addr is now s->sin6_addr;
+      //}
+    }
+
+    if(full_discovery) {
+      // allow modules to supply additional info on this adaptor
+      // (and influence ethtool data-gathering).  We broadcast this
+      // but it only really makes sense to receive it on the POLL_BUS
+      EVEventTxAll(sp->rootModule, HSPEVENT_INTF_READ, &adaptor, sizeof(adaptor));
+      // use ethtool to get info about direction/speed, peer_ifIndex and more
+      if(read_ethtool_info(sp, &ifr, fd, adaptor, linkModes) == YES) {
+	delta->changed++;
+	changed = YES;
+      }
+    }
+
+    if(addAdaptorToHT) {
+      // it is a new adaptor name or the mac or ifindex appeared to change.
+      // That could mean it is a new interface, or it could mean something
+      // more subtle such as that the interface was renamed, or given a new
+      // ifIndex or MAC.  Either way, this is a newly allocated adaptor
+      // object that needs to be inserted into the lookup tables.
+      delta->added++;
+      adaptorAddOrReplace(sp->adaptorsByName, adaptor, "byName");
+      // add to "all namespaces" collections too.
+      if(gotMac) adaptorAddOrReplace(sp->adaptorsByMac, adaptor, "byMac");
+      if(ifIndex) adaptorAddOrReplace(sp->adaptorsByIndex, adaptor, "byIndex");
+      if(full_discovery)
+	intfEvent(sp, HSPEVENT_INTF_ADDED, adaptor);
+    }
+    else if(changed
+	    && full_discovery) {
+      intfEvent(sp, HSPEVENT_INTF_CHANGED, adaptor);
+    }
+    return adaptor;
+  }
+
+/*________________---------------------------__________________
+  ________________    installAddresses       __________________
+  ----------------___________________________------------------
+  Sweep for the remaining L3 addresses, set their priorities and
+  swap in the new localIP lookup tables.
+*/
+
+  static void installAddresses(HSP *sp, UTHash *newLocalIP, UTHash *newLocalIP6)
+  {
+    // sweep for additional layer3 addresses
+    readL3Addresses(sp, newLocalIP, newLocalIP6);
+    readIPv6Addresses(sp, newLocalIP6);
+
+    // now that we have the evidence gathered together, we can
+    // set the L3 address priorities (used for auto-selecting
+    // the sFlow-agent-address if requrired to by the config.
+    setAddressPriorities(sp, newLocalIP);
+    setAddressPriorities(sp, newLocalIP6);
+
+    // swap in new localIP lookup tables
+    UTHash *oldLocalIP = sp->localIP;
+    UTHash *oldLocalIP6 = sp->localIP6;
+    sp->localIP = newLocalIP;
+    sp->localIP6 = newLocalIP6;
+    if(oldLocalIP)
+      freeLocalIPs(oldLocalIP);
+    if(oldLocalIP6)
+      freeLocalIPs(oldLocalIP6);
+  }
+
 /*________________---------------------------__________________
   ________________      readInterfaces       __________________
   ----------------___________________________------------------
@@ -712,7 +1178,7 @@ extern "C" {
 
   int readInterfaces(HSP *sp, bool full_discovery,  uint32_t *p_added, uint32_t *p_removed, uint32_t *p_cameup, uint32_t *p_wentdown, uint32_t *p_changed)
   {
-  uint32_t ad_added=0, ad_removed=0, ad_cameup=0, ad_wentdown=0, ad_changed=0;
+  HSPIntfDelta delta = { 0 };
 
   // keep v4 and v6 separate to simplify HT logic
   UTHash *newLocalIP = UTHASH_NEW(HSPLocalIP, ipAddr.address.ip_v4, UTHASH_DFLT);
@@ -735,10 +1201,15 @@ extern "C" {
     return 0;
   }
 
+  // link settings for all devices in one netlink dump, if we can
+  UTHash *linkModes = NULL;
+#ifdef ETHTOOL_GENL_NAME
+  if(full_discovery)
+    linkModes = ethtool_nl_linkModes(sp);
+#endif
+
   FILE *procFile = fopen(PROCFS_STR "/net/dev", "r");
   if(procFile) {
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
     char line[MAX_PROC_LINE_CHARS];
     int lineNo = 0;
     int truncated;
@@ -751,203 +1222,284 @@ extern "C" {
       if(devName == NULL) continue;
       int devNameLen = my_strlen(devName);
       if(devNameLen == 0 || devNameLen >= IFNAMSIZ) continue;
-      // we set the ifr_name field to make our queries
-      strncpy(ifr.ifr_name, devName, IFNAMSIZ-1);
+      readInterface(sp, fd, devName, full_discovery, linkModes, newLocalIP, &delta);
+    }
+    fclose(procFile);
+  }
 
-      myDebug(3, "reading interface %s", devName);
+  close (fd);
+#ifdef ETHTOOL_GENL_NAME
+  if(linkModes)
+    ethtool_nl_freeLinkModes(linkModes);
+#endif
 
-      // Get the flags for this interface
-      if(ioctl(fd,SIOCGIFFLAGS, &ifr) < 0) {
-	myLog(LOG_ERR, "device %s Get SIOCGIFFLAGS failed : %s",
-	      devName,
-	      strerror(errno));
-	continue;
-      }
+  // now remove and free any that are still marked
+  SFLAdaptor *ad;
+  UTHASH_WALK(sp->adaptorsByName, ad) if(ad->marked) {
+    removeAdaptor(sp, ad);
+    delta.removed++;
+  }
 
-      int up = (ifr.ifr_flags & IFF_UP) ? YES : NO;
-      int loopback = (ifr.ifr_flags & IFF_LOOPBACK) ? YES : NO;
-      int promisc =  (ifr.ifr_flags & IFF_PROMISC) ? YES : NO;
-      int bond_master = (ifr.ifr_flags & IFF_MASTER) ? YES : NO;
-      int bond_slave = (ifr.ifr_flags & IFF_SLAVE) ? YES : NO;
-      //int hasBroadcast = (ifr.ifr_flags & IFF_BROADCAST);
-      //int pointToPoint = (ifr.ifr_flags & IFF_POINTOPOINT);
-
-      // used to ignore loopback interfaces here, and interfaces
-      // that are currently marked down, but now those are
-      // filtered at the point where we roll together the
-      // counters, or build the list for export
-
-      // Try and get the MAC Address for this interface
-      u_char macBytes[6];
-      int gotMac = NO;
-      if(ioctl(fd,SIOCGIFHWADDR, &ifr) < 0) {
-	myLog(LOG_ERR, "device %s Get SIOCGIFHWADDR failed : %s",
-	      devName,
-	      strerror(errno));
-      }
-      else {
-	memcpy(macBytes, (u_char *)&ifr.ifr_hwaddr.sa_data, 6);
-	gotMac = YES;
-      }
+  // check in case any of the survivors are specific
+  // to a particular VLAN
+  readVLANs(sp);
 
-      // Try and get the ifIndex for this interface
-      uint32_t ifIndex = 0;
-      if(ioctl(fd,SIOCGIFINDEX, &ifr) < 0) {
-	// only complain about this if we are debugging
-	myDebug(1, "device %s Get SIOCGIFINDEX failed : %s",
-		devName,
-		strerror(errno));
-      }
-      else {
-	ifIndex = ifr.ifr_ifindex;
-      }
-
-      // find existing adaptor by name.  We use adaptorsByName as the primary lookup here
-      // assuming that every interface has a unique, non-empty name. We treat this as being
-      // the same interface if it appears with the same name, ifIndex and MAC as last time.
-      // Otherwise a new adaptor object is inserted. Any previous adaptor objects that are not
-      // found in this way are deleted (from all lookup tables) using the mark-and-sweep
-      // mechanism.
-
-      // for now just assume that each interface has only one MAC.  It's not clear how we can
-      // learn multiple MACs this way anyhow.  It seems like there is just one per ifr record.
-      // find or create a new "adaptor" entry
-      SFLAdaptor *adaptor = nioAdaptorNew(devName, (gotMac ? macBytes : NULL), ifIndex);
-
-      bool addAdaptorToHT = YES;
-
-      SFLAdaptor *existing = adaptorByName(sp, devName);
-      if(existing
-	 && adaptorEqual(adaptor, existing)) {
-	// found by name, and no change to (name,ifIndex,MAC), so use existing object
-	// note that attributes such as peer_ifIndex may differ here, but they may not
-	// have been looked up yet.
-	adaptorFree(adaptor);
-	// this adaptor is going to survive
-	adaptor = existing;
-	// clear the mark so we don't free it below
-	adaptor->marked = NO;
-	// indicate that it is already in the lookup tables
-	addAdaptorToHT = NO;
-      }
-
-      // this flag might belong in the adaptorNIO struct
-      adaptor->promiscuous = promisc;
-
-      // remember some useful flags in the userData structure
-      HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
-      if(adaptorNIO->up != up) {
-	if(up) {
-	  ad_cameup++;
-	  // trigger test for module eeprom data
-	  adaptorNIO->ethtool_GMODULEINFO = YES;
-	}
-	else ad_wentdown++;
-	myDebug(1, "adaptor %s %s",
-		adaptor->deviceName,
-		up ? "came up" : "went down");
-      }
-      adaptorNIO->up = up;
+  installAddresses(sp, newLocalIP, newLocalIP6);
 
-      // make sure we notice changes
-      if(adaptorNIO->loopback != loopback
-	 || adaptorNIO->bond_master != bond_master
-	 || adaptorNIO->bond_slave != bond_slave)
-	ad_changed++;
+  if(p_added) *p_added = delta.added;
+  if(p_removed) *p_removed = delta.removed;
+  if(p_cameup) *p_cameup = delta.cameup;
+  if(p_wentdown) *p_wentdown = delta.wentdown;
+  if(p_changed) *p_changed = delta.changed;
 
-      adaptorNIO->loopback = loopback;
-      adaptorNIO->bond_master = bond_master;
-      adaptorNIO->bond_slave = bond_slave;
+  return sp->adaptorsByName->entries;
+}
 
-      // Try to get the IP address for this interface
-      if(ioctl(fd,SIOCGIFADDR, &ifr) < 0) {
-	// only complain about this if we are debugging
-	myDebug(1, "device %s Get SIOCGIFADDR failed : %s",
-		devName,
-		strerror(errno));
+/*________________---------------------------__________________
+  ________________   openInterfaceEvents     __________________
+  ----------------___________________________------------------
+  Subscribe to rtnetlink link and address notifications so the
+  adaptor tables can be updated incrementally. With this in place
+  readInterfaces() is only needed as a slow consistency sweep.
+*/
+
+#define HSP_INTF_EVENTS_RCVBUF 1048576
+
+  int openInterfaceEvents(void)
+  {
+    int nl_sock = UTNLRoute_open(RTMGRP_LINK
+				 | RTMGRP_IPV4_IFADDR
+				 | RTMGRP_IPV6_IFADDR);
+    if(nl_sock > 0) {
+      // a burst of veth churn can be large
+      UTSocketRcvbuf(nl_sock, HSP_INTF_EVENTS_RCVBUF);
+    }
+    return nl_sock;
+  }
+
+/*________________---------------------------__________________
+  ________________   readInterfaceEvents     __________________
+  ----------------___________________________------------------
+  Drain the rtnetlink socket. Link messages are coalesced per
+  ifIndex and then applied one device at a time. Address messages
+  update the primary IPv4 address directly,  and then the localIP
+  tables are rebuilt without touching the links again. Returns the
+  number of messages handled,  or -1 if the kernel dropped some
+  (ENOBUFS) and a full readInterfaces() is needed to resync.
+*/
+
+  typedef struct _HSPLinkEvent {
+    uint32_t ifIndex;
+    bool deleted;
+    bool gotMac;
+    char devName[IFNAMSIZ];
+    u_char mac[6];
+  } HSPLinkEvent;
+
+  static void linkEvent(UTHash *links, struct nlmsghdr *nlh)
+  {
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    // RTNLGRP_LINK also carries per-family messages about the same
+    // ifIndex,  e.g. an AF_BRIDGE RTM_DELLINK when a port leaves its
+    // bridge.  Only AF_UNSPEC describes the link itself.
+    if(ifi->ifi_family != AF_UNSPEC)
+      return;
+    HSPLinkEvent search = { .ifIndex = ifi->ifi_index };
+    HSPLinkEvent *lev = UTHashGet(links, &search);
+    if(lev == NULL) {
+      lev = (HSPLinkEvent *)my_calloc(sizeof(HSPLinkEvent));
+      lev->ifIndex = ifi->ifi_index;
+      UTHashAdd(links, lev);
+    }
+    // last message wins
+    lev->deleted = (nlh->nlmsg_type == RTM_DELLINK);
+    int len = IFLA_PAYLOAD(nlh);
+    for(struct rtattr *rta = IFLA_RTA(ifi);
+	RTA_OK(rta, len);
+	rta = RTA_NEXT(rta, len)) {
+      if(rta->rta_type == IFLA_IFNAME) {
+	int nameLen = RTA_PAYLOAD(rta);
+	if(nameLen >= IFNAMSIZ)
+	  nameLen = IFNAMSIZ - 1;
+	memset(lev->devName, 0, IFNAMSIZ);
+	memcpy(lev->devName, RTA_DATA(rta), nameLen);
       }
-      else {
-	if (ifr.ifr_addr.sa_family == AF_INET) {
-	  struct sockaddr_in *s = (struct sockaddr_in *)&ifr.ifr_addr;
-	  // IP addr is now s->sin_addr
-	  adaptorNIO->ipAddr.type = SFLADDRESSTYPE_IP_V4;
-	  adaptorNIO->ipAddr.address.ip_v4.addr = s->sin_addr.s_addr;
-	  // add to localIP hash too
-	  addLocalIP(newLocalIP, &adaptorNIO->ipAddr, adaptor->deviceName);
-	}
-	//else if (ifr.ifr_addr.sa_family == AF_INET6) {
-	// not sure this ever happens - on a linux system IPv6 addresses
-	// are picked up from /proc/net/if_inet6
-	// struct sockaddr_in6 *s = (struct sockaddr_in6 *)&ifr.ifr_addr;
-	// IP6 addr is now s->sin6_addr;
-	//}
-      }
-
-      if(full_discovery) {
-	// allow modules to supply additional info on this adaptor
-	// (and influence ethtool data-gathering).  We broadcast this
-	// but it only really makes sense to receive it on the POLL_BUS
-	EVEventTxAll(sp->rootModule, HSPEVENT_INTF_READ, &adaptor, sizeof(adaptor));
-	// use ethtool to get info about direction/speed, peer_ifIndex and more
-	if(read_ethtool_info(sp, &ifr, fd, adaptor) == YES) {
-	  ad_changed++;
-	}
+      else if(rta->rta_type == IFLA_ADDRESS
+	      && RTA_PAYLOAD(rta) == 6) {
+	memcpy(lev->mac, RTA_DATA(rta), 6);
+	lev->gotMac = YES;
       }
+    }
+  }
 
-      if(addAdaptorToHT) {
-	// it is a new adaptor name or the mac or ifindex appeared to change.
-	// That could mean it is a new interface, or it could mean something
-	// more subtle such as that the interface was renamed, or given a new
-	// ifIndex or MAC.  Either way, this is a newly allocated adaptor
-	// object that needs to be inserted into the lookup tables.
-	ad_added++;
-	adaptorAddOrReplace(sp->adaptorsByName, adaptor, "byName");
-	// add to "all namespaces" collections too.
-	if(gotMac) adaptorAddOrReplace(sp->adaptorsByMac, adaptor, "byMac");
-	if(ifIndex) adaptorAddOrReplace(sp->adaptorsByIndex, adaptor, "byIndex");
+  static void addrEvent(HSP *sp, struct nlmsghdr *nlh)
+  {
+    struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
+    if(ifa->ifa_family != AF_INET
+       || (ifa->ifa_flags & IFA_F_SECONDARY))
+      return;
+    SFLAdaptor *adaptor = adaptorByIndex(sp, ifa->ifa_index);
+    if(adaptor == NULL)
+      return;
+    HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(adaptor);
+    int len = IFA_PAYLOAD(nlh);
+    for(struct rtattr *rta = IFA_RTA(ifa);
+	RTA_OK(rta, len);
+	rta = RTA_NEXT(rta, len)) {
+      // IFA_LOCAL is the address (IFA_ADDRESS is the peer on a p2p link)
+      if(rta->rta_type == IFA_LOCAL
+	 && RTA_PAYLOAD(rta) == 4) {
+	SFLAddress addr = { .type = SFLADDRESSTYPE_IP_V4 };
+	memcpy(&addr.address.ip_v4.addr, RTA_DATA(rta), 4);
+	if(nlh->nlmsg_type == RTM_NEWADDR)
+	  adaptorNIO->ipAddr = addr;
+	else if(SFLAddress_equal(&addr, &adaptorNIO->ipAddr))
+	  memset(&adaptorNIO->ipAddr, 0, sizeof(adaptorNIO->ipAddr));
       }
+    }
+  }
+
+  static int adaptorIndexCmp(const void *a, const void *b) {
+    uint32_t ia = (*(SFLAdaptor **)a)->ifIndex;
+    uint32_t ib = (*(SFLAdaptor **)b)->ifIndex;
+    return (ia < ib) ? -1 : (ia > ib) ? 1 : 0;
+  }
 
+  static void refreshAddresses(HSP *sp)
+  {
+    UTHash *newLocalIP = UTHASH_NEW(HSPLocalIP, ipAddr.address.ip_v4, UTHASH_DFLT);
+    UTHash *newLocalIP6 = UTHASH_NEW(HSPLocalIP, ipAddr.address.ip_v6, UTHASH_DFLT);
+    // primary addresses first, in ifIndex order,  so that discoveryIndex
+    // comes out the same way as it would from /proc/net/dev
+    uint32_t n_ads = UTHashN(sp->adaptorsByName);
+    SFLAdaptor **ads = (SFLAdaptor **)my_calloc((n_ads + 1) * sizeof(SFLAdaptor *));
+    uint32_t n = 0;
+    SFLAdaptor *ad;
+    UTHASH_WALK(sp->adaptorsByName, ad) {
+      if(n < n_ads)
+	ads[n++] = ad;
     }
-    fclose(procFile);
+    qsort(ads, n, sizeof(SFLAdaptor *), adaptorIndexCmp);
+    for(uint32_t ii = 0; ii < n; ii++) {
+      HSPAdaptorNIO *adaptorNIO = ADAPTOR_NIO(ads[ii]);
+      if(adaptorNIO->ipAddr.type == SFLADDRESSTYPE_IP_V4)
+	addLocalIP(newLocalIP, &adaptorNIO->ipAddr, ads[ii]->deviceName);
+    }
+    my_free(ads);
+    installAddresses(sp, newLocalIP, newLocalIP6);
   }
 
-  close (fd);
+  int readInterfaceEvents(HSP *sp, int nl_sock, uint32_t *p_added, uint32_t *p_removed, uint32_t *p_cameup, uint32_t *p_wentdown, uint32_t *p_changed)
+  {
+    HSPIntfDelta delta = { 0 };
+    UTHash *links = UTHASH_NEW(HSPLinkEvent, ifIndex, UTHASH_DFLT);
+    bool overrun = NO;
+    bool addrs = NO;
+    int msgs = 0;
+    char *buf = (char *)my_calloc(UTNL_ROUTE_RCV_BUF);
+    for(;;) {
+      int len = recv(nl_sock, buf, UTNL_ROUTE_RCV_BUF, MSG_DONTWAIT);
+      if(len < 0) {
+	if(errno == EINTR)
+	  continue;
+	if(errno == ENOBUFS) {
+	  overrun = YES;
+	  continue;
+	}
+	break;
+      }
+      if(len == 0)
+	break;
+      for(struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	  NLMSG_OK(nlh, len);
+	  nlh = NLMSG_NEXT(nlh, len)) {
+	switch(nlh->nlmsg_type) {
+	case RTM_NEWLINK:
+	case RTM_DELLINK:
+	  linkEvent(links, nlh);
+	  msgs++;
+	  break;
+	case RTM_NEWADDR:
+	case RTM_DELADDR:
+	  addrEvent(sp, nlh);
+	  addrs = YES;
+	  msgs++;
+	  break;
+	}
+      }
+    }
+    my_free(buf);
+
+    if(!overrun
+       && UTHashN(links)) {
+      int fd = socket (PF_INET, SOCK_DGRAM, 0);
+      if(fd < 0) {
+	myLog(LOG_ERR, "readInterfaceEvents: socket failed: %s", strerror(errno));
+	overrun = YES;
+      }
+      else {
+	HSPLinkEvent *lev;
+	UTHASH_WALK(links, lev) {
+	  SFLAdaptor *existing = adaptorByIndex(sp, lev->ifIndex);
+	  if(lev->deleted) {
+	    myDebug(1, "interface event: ifIndex %u deleted", lev->ifIndex);
+	    if(existing) {
+	      removeAdaptor(sp, existing);
+	      delta.removed++;
+	    }
+	    continue;
+	  }
+	  if(lev->devName[0] == '\0'
+	     && if_indextoname(lev->ifIndex, lev->devName) == NULL)
+	    continue;
+	  myDebug(1, "interface event: %s (ifIndex %u)", lev->devName, lev->ifIndex);
+	  // If the (name,ifIndex,MAC) identity changed then readInterface()
+	  // will allocate a new adaptor,  so take the old one out first.
+	  if(existing
+	     && (!my_strequal(existing->deviceName, lev->devName)
+		 || (lev->gotMac
+		     && existing->num_macs
+		     && memcmp(existing->macs[0].mac, lev->mac, 6)))) {
+	    removeAdaptor(sp, existing);
+	    delta.removed++;
+	  }
+	  SFLAdaptor *byName = adaptorByName(sp, lev->devName);
+	  if(byName
+	     && byName->ifIndex != lev->ifIndex) {
+	    removeAdaptor(sp, byName);
+	    delta.removed++;
+	  }
+	  readInterface(sp, fd, lev->devName, YES, NULL, NULL, &delta);
+	}
+	close(fd);
+	if(delta.added)
+	  readVLANs(sp);
+      }
+    }
 
-  // now remove and free any that are still marked
-  ad_removed = deleteMarkedAdaptors(sp, sp->adaptorsByName, YES);
+    HSPLinkEvent *lev;
+    UTHASH_WALK(links, lev)
+      my_free(lev);
+    UTHashFree(links);
 
-  // check in case any of the survivors are specific
-  // to a particular VLAN
-  readVLANs(sp);
+    if(overrun) {
+      myDebug(1, "readInterfaceEvents: overrun - need full refresh");
+      return -1;
+    }
 
-  // sweep for additional layer3 addresses
-  readL3Addresses(sp, newLocalIP, newLocalIP6);
-  readIPv6Addresses(sp, newLocalIP6);
-
-  // now that we have the evidence gathered together, we can
-  // set the L3 address priorities (used for auto-selecting
-  // the sFlow-agent-address if requrired to by the config.
-  setAddressPriorities(sp, newLocalIP);
-  setAddressPriorities(sp, newLocalIP6);
-
-  if(p_added) *p_added = ad_added;
-  if(p_removed) *p_removed = ad_removed;
-  if(p_cameup) *p_cameup = ad_cameup;
-  if(p_wentdown) *p_wentdown = ad_wentdown;
-  if(p_changed) *p_changed = ad_changed;
-
-  // swap in new localIP lookup tables
-  UTHash *oldLocalIP = sp->localIP;
-  UTHash *oldLocalIP6 = sp->localIP6;
-  sp->localIP = newLocalIP;
-  sp->localIP6 = newLocalIP6;
-  if(oldLocalIP)
-    freeLocalIPs(oldLocalIP);
-  if(oldLocalIP6)
-    freeLocalIPs(oldLocalIP6);
+    if(addrs
+       || delta.added
+       || delta.removed) {
+      refreshAddresses(sp);
+    }
 
-  return sp->adaptorsByName->entries;
-}
+    if(p_added) *p_added = delta.added;
+    if(p_removed) *p_removed = delta.removed;
+    if(p_cameup) *p_cameup = delta.cameup;
+    if(p_wentdown) *p_wentdown = delta.wentdown;
+    if(p_changed) *p_changed = delta.changed;
+    return msgs;
+  }
 
 /*________________---------------------------__________________
   ________________   isLocalAddress          __________________
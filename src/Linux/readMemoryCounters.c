@@ -13,24 +13,22 @@ extern "C" {
     -----------------___________________________------------------
   */
 
-  int readMemoryCounters(SFLHost_mem_counters *mem) {
+  int readMemoryCounters(HSP *sp, SFLHost_mem_counters *mem) {
     int gotData = NO;
-    FILE *procFile;
-    // limit the number of chars we will read from each line
-    // (there can be more than this - my_readline will chop for us)
-#define MAX_PROC_LINE_CHARS 80
-    char line[MAX_PROC_LINE_CHARS];
-    char var[MAX_PROC_LINE_CHARS];
+    HSPProcFiles *pf = &sp->procFiles;
+    char *buf, *line, *p, *var;
     uint64_t val64;
 
     // zero the structure so we can accumulate into it.
     memset(mem, 0, sizeof(*mem));
 
-    procFile= fopen(PROCFS_STR "/meminfo", "r");
-    if(procFile) {
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	if(sscanf(line, "%s %"SCNu64"", var, &val64) == 2) {
+    if(pf->meminfo == NULL)
+      pf->meminfo = UTProcFileNew(PROCFS_STR "/meminfo", 0);
+    if((buf = UTProcFileRead(pf->meminfo)) != NULL) {
+      p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
+	if((var = UTProcNextTok(&line)) != NULL
+	   && UTProcNextU64s(&line, &val64, 1) == 1) {
 	  gotData = YES;
 	  if(strcmp(var, "MemTotal:") == 0) mem->mem_total += val64 * 1024;
 	  else if(strcmp(var, "MemFree:") == 0) mem->mem_free += val64 * 1024;
@@ -41,14 +39,15 @@ extern "C" {
 	  else if(strcmp(var, "SReclaimable:") == 0) mem->mem_cached += val64 * 1024;
 	}
       }
-      fclose(procFile);
     }
 
-    procFile= fopen(PROCFS_STR "/vmstat", "r");
-    if(procFile) {
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	if(sscanf(line, "%s %"SCNu64"", var, &val64) == 2) {
+    if(pf->vmstat == NULL)
+      pf->vmstat = UTProcFileNew(PROCFS_STR "/vmstat", 0);
+    if((buf = UTProcFileRead(pf->vmstat)) != NULL) {
+      p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
+	if((var = UTProcNextTok(&line)) != NULL
+	   && UTProcNextU64s(&line, &val64, 1) == 1) {
 	  gotData = YES;
 	  if(strcmp(var, "pgpgin") == 0) mem->page_in += (uint32_t)val64;
 	  else if(strcmp(var, "pgpgout") == 0) mem->page_out += (uint32_t)val64;
@@ -56,7 +55,6 @@ extern "C" {
 	  else if(strcmp(var, "pswpout") == 0) mem->swap_out += (uint32_t)val64;
 	}
       }
-      fclose(procFile);
     }
 
     return gotData;
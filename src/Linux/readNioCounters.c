@@ -7,6 +7,7 @@ extern "C" {
 #endif
 
 #include "hsflowd.h"
+#include "util_netlink.h"
 #include <sys/ioctl.h>
 #include <sys/socket.h>
 #include <net/if.h>
@@ -351,15 +352,15 @@ extern "C" {
       if(nio->poller
 	 && nio->switchPort
 	 && nio->poller->sFlowCpInterval) {
-	uint32_t countdown = nio->poller->countersCountdown;
+	uint32_t countdown = sfl_poller_get_countersCountdown(nio->poller);
 	uint32_t nudgeBack = countdown % sp->syncPollingInterval;
 	uint32_t nudgeFwd = sp->syncPollingInterval - nudgeBack;
 	// take the smaller nudge - as long as it's in the future
 	if(nudgeBack < nudgeFwd
 	   && countdown > nudgeBack)
-	  nio->poller->countersCountdown -= nudgeBack;
+	  sfl_poller_set_countersCountdown(nio->poller, countdown - nudgeBack);
 	else
-	  nio->poller->countersCountdown += nudgeFwd;
+	  sfl_poller_set_countersCountdown(nio->poller, countdown + nudgeFwd);
       }
     }
   }
@@ -401,32 +402,17 @@ extern "C" {
   }
 #define SFF8472_CAL_RXPWR(x, ff) (x) = sff8472_calibration_rxpwr((x), (ff))
 
-  static void sff8472_read(SFLAdaptor *adaptor, struct ifreq *ifr, int fd)
+  static bool sff8472_parse(char *deviceName, uint32_t ifIndex, uint8_t *data, SFLSFP_counters *sfp)
   {
-    struct ethtool_eeprom *eeprom = NULL;
-    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
-
-    if(nio->modinfo_len < ETH_MODULE_SFF_8472_LEN)
-      goto out;
-
-    eeprom = (struct ethtool_eeprom *)my_calloc(sizeof(*eeprom) + ETH_MODULE_SFF_8472_LEN);
-    eeprom->cmd = ETHTOOL_GMODULEEEPROM;
-    eeprom->len = ETH_MODULE_SFF_8472_LEN;
-    ifr->ifr_data = (char *)eeprom;
-    if(ioctl(fd, SIOCETHTOOL, ifr) < 0) {
-      myLog(LOG_ERR, "SFF8036 ethtool ioctl failed: %s", strerror(errno));
-      goto out;
-    }
-
-    if(eeprom->data[0] != 0x03 ||
-       eeprom->data[1] != 0x04) {
-      goto out;
+    if(data[0] != 0x03 ||
+       data[1] != 0x04) {
+      return NO;
     }
 
     // test (SFF_A0_DOM & SFF_A0_DOM_IMPL)
-    if(!(eeprom->data[92] & 0x40)) {
+    if(!(data[92] & 0x40)) {
       // no optical stats
-      goto out;
+      return NO;
     }
 
     uint32_t num_lanes = 1;
@@ -435,10 +421,10 @@ extern "C" {
     double tx_power, tx_power_max, tx_power_min;
     double rx_power, rx_power_max, rx_power_min;
 
-    uint16_t *eew = (uint16_t *)(eeprom->data);
+    uint16_t *eew = (uint16_t *)data;
 
     // wavelength
-    if(!(eeprom->data[8] & 0x0c)) {
+    if(!(data[8] & 0x0c)) {
       wavelength = ntohs(eew[30]);
     }
 
@@ -462,7 +448,7 @@ extern "C" {
     rx_power_min = ntohs(eew[128 + 17]);
 
     // calibration
-    if(eeprom->data[92] & 0x10) {
+    if(data[92] & 0x10) {
       // apply external calibration
       SFF8472_CAL(bias_current, eew, (128 + 38));
       SFF8472_CAL(tx_power, eew, (128 + 40));
@@ -483,13 +469,13 @@ extern "C" {
     }
 
     // populate sFlow structure
-    nio->sfp.lanes = (SFLLane *)my_realloc(nio->sfp.lanes, sizeof(SFLLane) * num_lanes);
-    nio->sfp.module_id = adaptor->ifIndex;
-    nio->sfp.module_total_lanes = num_lanes;
-    nio->sfp.module_supply_voltage = (voltage / 10); // mV
-    nio->sfp.module_temperature = (temperature * 1000); // mC
-    nio->sfp.num_lanes = num_lanes;
-    SFLLane *lane = &(nio->sfp.lanes[0]);
+    sfp->lanes = (SFLLane *)my_calloc(sizeof(SFLLane) * num_lanes);
+    sfp->module_id = ifIndex;
+    sfp->module_total_lanes = num_lanes;
+    sfp->module_supply_voltage = (voltage / 10); // mV
+    sfp->module_temperature = (temperature * 1000); // mC
+    sfp->num_lanes = num_lanes;
+    SFLLane *lane = &(sfp->lanes[0]);
     lane->lane_index = 1;
     lane->tx_bias_current = (bias_current * 2); // uA
     lane->tx_power = (tx_power / 10); // uW
@@ -502,10 +488,10 @@ extern "C" {
     lane->rx_wavelength = wavelength; // same as tx_wavelength
 
     myDebug(1, "SFP8472 %s u=%u(nm) T=%u(mC) V=%u(mV) I=%u(uA) tx=%u(uW) [%u-%u] rx=%u(uW) [%u-%u]",
-	    adaptor->deviceName,
+	    deviceName,
 	    lane->tx_wavelength,
-	    nio->sfp.module_temperature,
-	    nio->sfp.module_supply_voltage,
+	    sfp->module_temperature,
+	    sfp->module_supply_voltage,
 	    lane->tx_bias_current,
 	    lane->tx_power,
 	    lane->tx_power_min,
@@ -514,80 +500,14 @@ extern "C" {
 	    lane->rx_power_min,
 	    lane->rx_power_max);
 
-  out:
-    if(eeprom)
-      my_free(eeprom);
+    return YES;
   }
 
-  static void sff8436_read(SFLAdaptor *adaptor, struct ifreq *ifr, int fd)
+  static bool sff8436_parse(char *deviceName, uint32_t ifIndex, uint8_t *data, SFLSFP_counters *sfp)
   {
-    struct ethtool_eeprom *eeprom = NULL;
-    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
-
-    if(nio->modinfo_len < ETH_MODULE_SFF_8436_LEN)
-      goto out;
-
-    eeprom = (struct ethtool_eeprom *)my_calloc(sizeof(*eeprom) + ETH_MODULE_SFF_8436_LEN);
-    eeprom->cmd = ETHTOOL_GMODULEEEPROM;
-    eeprom->len = ETH_MODULE_SFF_8436_LEN;
-#ifdef HSP_TEST_QSFP
-    int bytes = hexToBinary((u_char *)
-			    "0d-00-02-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-1b-10-00-00-7f-92-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-ff-ff-ff-ff-ff-ff-ff-ff-00"
-			    "0d-00-23-00-00-00-00-40-40-06-d5-05-69-00-00-05"
-			    "0a-00-0a-00-46-49-4e-49-53-41-52-20-43-4f-52-50"
-			    "20-20-20-20-07-00-90-65-46-43-42-47-34-31-30-51"
-			    "42-31-43-31-30-2d-46-43-41-20-42-68-07-d0-46-db"
-			    "00-01-04-da-44-53-4a-30-30-41-41-20-20-20-20-20"
-			    "20-20-20-20-31-34-31-30-32-37-20-20-08-00-00-39"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "0f-10-00-a1-53-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "4b-00-fb-00-46-00-00-00-00-00-00-00-00-00-00-00"
-			    "94-70-6e-f0-86-c4-7b-0c-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
-			    "00-00-22-22-00-00-00-00-00-00-00-00-00-00-33-33"
-			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00",
-			    &eeprom->data[0],
-			    ETH_MODULE_SFF_8436_LEN);
-    if(bytes != ETH_MODULE_SFF_8436_LEN) {
-      myLog(LOG_ERR, "test QSFP: hexToBinary failed (bytes=%d)", bytes);
-    }
-#else
-    ifr->ifr_data = (char *)eeprom;
-    if(ioctl(fd, SIOCETHTOOL, ifr) < 0) {
-      myLog(LOG_ERR, "SFF8036 ethtool ioctl failed: %s", strerror(errno));
-      goto out;
-    }
-#endif
-
     // check for SFF8436_ID_DWDM_QSFP_PLUS
-    if(eeprom->data[0] != 0x0d) {
-      goto out;
+    if(data[0] != 0x0d) {
+      return NO;
     }
 
     uint32_t num_lanes = 4;
@@ -595,7 +515,7 @@ extern "C" {
     double temperature, voltage, bias_current[4];
     double rx_power[4], rx_power_max, rx_power_min;
 
-    uint16_t *eew = (uint16_t *)(eeprom->data);
+    uint16_t *eew = (uint16_t *)data;
 
     // wavelength - determined by transciever technology code
 #ifndef SFF8436_DEVICE_TECH_OFFSET
@@ -620,7 +540,7 @@ extern "C" {
 #define SFF8436_TRANS_850_VCSEL (0 << 4)
 #endif
 
-    uint8_t tx_tech = (eeprom->data[SFF8436_DEVICE_TECH_OFFSET]
+    uint8_t tx_tech = (data[SFF8436_DEVICE_TECH_OFFSET]
 		       & SFF8436_TRANS_TECH_MASK);
     switch (tx_tech) {
     case SFF8436_TRANS_850_VCSEL: wavelength = 850; break;
@@ -653,15 +573,15 @@ extern "C" {
     rx_power_min = ntohs(eew[256 + 25]);
 
     // populate sFlow structure
-    nio->sfp.lanes = (SFLLane *)my_realloc(nio->sfp.lanes, sizeof(SFLLane) * num_lanes);
-    nio->sfp.module_id = adaptor->ifIndex;
-    nio->sfp.module_total_lanes = num_lanes;
-    nio->sfp.module_supply_voltage = (voltage / 10); // mV
-    nio->sfp.module_temperature = (temperature * 1000); // mC
-    nio->sfp.num_lanes = num_lanes;
+    sfp->lanes = (SFLLane *)my_calloc(sizeof(SFLLane) * num_lanes);
+    sfp->module_id = ifIndex;
+    sfp->module_total_lanes = num_lanes;
+    sfp->module_supply_voltage = (voltage / 10); // mV
+    sfp->module_temperature = (temperature * 1000); // mC
+    sfp->num_lanes = num_lanes;
 
     for (int ch=0; ch < num_lanes; ch++) {
-      SFLLane *lane = &(nio->sfp.lanes[ch]);
+      SFLLane *lane = &(sfp->lanes[ch]);
       lane->lane_index = (ch + 1);
       lane->tx_bias_current = (bias_current[ch] * 2); // uA
       lane->tx_wavelength = wavelength;
@@ -671,11 +591,11 @@ extern "C" {
       lane->rx_wavelength = wavelength; // same as tx_wavelength
 
       myDebug(1, "SFP8436 %s[%u] u=%u(nm) T=%u(mC) V=%u(mV) I=%u(uA) tx=%u(uW) [%u-%u] rx=%u(uW) [%u-%u]",
-	    adaptor->deviceName,
+	    deviceName,
 	    ch,
 	    lane->tx_wavelength,
-	    nio->sfp.module_temperature,
-	    nio->sfp.module_supply_voltage,
+	    sfp->module_temperature,
+	    sfp->module_supply_voltage,
 	    lane->tx_bias_current,
 	    lane->tx_power,
 	    lane->tx_power_min,
@@ -685,9 +605,371 @@ extern "C" {
 	    lane->rx_power_max);
     }
 
-  out:
-    if(eeprom)
-      my_free(eeprom);
+    return YES;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     optics worker         __________________
+    -----------------___________________________------------------
+    Transceiver EEPROM reads go over I2C and can take milliseconds per
+    port,  so they run on a worker thread with its own per-port schedule
+    that is slower than the interface counter polling.  The static ID
+    and threshold pages are only read when a port is first seen (and
+    every HSP_SFP_RELOAD_POLLS after that in case the module was
+    swapped),  otherwise just the live diagnostics,  and those are only
+    parsed again if they changed.  The poll bus copies out the cached
+    counters without blocking.
+  */
+
+#define HSP_SFP_MIN_POLL_SECS 60 // never poll a port faster than this
+#define HSP_SFP_POLL_FACTOR 2 // ...or this multiple of the counter polling interval
+#define HSP_SFP_RELOAD_POLLS 10 // read the whole image again every N polls
+#define HSP_SFP_FORGET_POLLS 3 // drop ports not asked for in N poll intervals
+  // live diagnostics: SFF-8472 A2h bytes 96-111,  SFF-8436 lower page
+#define HSP_SFF8472_DIAG_OFFSET (256 + 96)
+#define HSP_SFF8472_DIAG_LEN 16
+#define HSP_SFF8436_DIAG_OFFSET 0
+#define HSP_SFF8436_DIAG_LEN 50
+  // SFF-8436 lower page + pages 00-03 (the kernel's ETH_MODULE_SFF_8436_LEN
+  // only covers the first two)
+#define HSP_SFP_IMAGE_MAX 640
+
+#ifdef HSP_TEST_QSFP
+  static bool sff8436_test_image(uint8_t *data)
+  {
+    int bytes = hexToBinary((u_char *)
+			    "0d-00-02-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-1b-10-00-00-7f-92-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-ff-ff-ff-ff-ff-ff-ff-ff-00"
+			    "0d-00-23-00-00-00-00-40-40-06-d5-05-69-00-00-05"
+			    "0a-00-0a-00-46-49-4e-49-53-41-52-20-43-4f-52-50"
+			    "20-20-20-20-07-00-90-65-46-43-42-47-34-31-30-51"
+			    "42-31-43-31-30-2d-46-43-41-20-42-68-07-d0-46-db"
+			    "00-01-04-da-44-53-4a-30-30-41-41-20-20-20-20-20"
+			    "20-20-20-20-31-34-31-30-32-37-20-20-08-00-00-39"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "0f-10-00-a1-53-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "4b-00-fb-00-46-00-00-00-00-00-00-00-00-00-00-00"
+			    "94-70-6e-f0-86-c4-7b-0c-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00"
+			    "00-00-22-22-00-00-00-00-00-00-00-00-00-00-33-33"
+			    "00-00-00-00-00-00-00-00-00-00-00-00-00-00-00-00",
+			    data,
+			    HSP_SFP_IMAGE_MAX);
+    if(bytes != HSP_SFP_IMAGE_MAX) {
+      myLog(LOG_ERR, "test QSFP: hexToBinary failed (bytes=%d)", bytes);
+      return NO;
+    }
+    return YES;
+  }
+#endif
+
+  typedef struct _HSPSfpPort {
+    uint32_t ifIndex;
+    char deviceName[IFNAMSIZ];
+    uint32_t modinfo_type;
+    uint32_t imageLen; // bytes of EEPROM to read
+    time_t nextPoll;
+    time_t lastFetch; // when the poll bus last asked for it
+    uint32_t polls; // since the whole image was read
+    uint32_t seqNo; // bumped when sfp changes
+    SFLSFP_counters sfp; // parsed,  owns its lanes
+    bool reload:1; // read the whole image next time
+    bool failed:1;
+    uint8_t eeprom[HSP_SFP_IMAGE_MAX]; // only touched by the worker
+  } HSPSfpPort;
+
+  typedef struct _HSPSfpPoller {
+    pthread_mutex_t sync;
+    pthread_cond_t cond;
+    UTHash *ports; // by ifIndex
+    uint32_t pollSecs;
+    bool dead:1;
+  } HSPSfpPoller;
+
+  typedef enum {
+    HSP_SFP_READ_FAILED=0,
+    HSP_SFP_UNCHANGED,
+    HSP_SFP_CHANGED
+  } EnumHSPSfpRead;
+
+  static time_t sfpNow(void) {
+    struct timespec ts;
+    EVClockMono(&ts);
+    return ts.tv_sec;
+  }
+
+  // how much of the EEPROM to read,  or 0 if we can't use it
+  static uint32_t sfpImageLen(uint32_t modinfo_type, uint32_t modinfo_len) {
+    switch(modinfo_type) {
+    case ETH_MODULE_SFF_8472:
+      return (modinfo_len < ETH_MODULE_SFF_8472_LEN) ? 0 : ETH_MODULE_SFF_8472_LEN;
+    case ETH_MODULE_SFF_8436:
+      // the upper pages with the thresholds are optional
+      if(modinfo_len < ETH_MODULE_SFF_8436_LEN)
+	return 0;
+      return (modinfo_len < HSP_SFP_IMAGE_MAX) ? modinfo_len : HSP_SFP_IMAGE_MAX;
+    }
+    return 0;
+  }
+
+  static void sfpPortFree(HSPSfpPort *port) {
+    if(port->sfp.lanes)
+      my_free(port->sfp.lanes);
+    my_free(port);
+  }
+
+  static bool sfpEEPROMRead(int fd, char *dev, uint32_t offset, uint32_t len, uint8_t *dst) {
+#ifdef HSP_TEST_QSFP
+    uint8_t test[HSP_SFP_IMAGE_MAX];
+    if(!sff8436_test_image(test))
+      return NO;
+    memcpy(dst, test + offset, len);
+#else
+    struct {
+      struct ethtool_eeprom hdr;
+      uint8_t data[HSP_SFP_IMAGE_MAX];
+    } eeprom = { .hdr = { .cmd = ETHTOOL_GMODULEEEPROM, .offset = offset, .len = len } };
+    struct ifreq ifr = { 0 };
+    strncpy(ifr.ifr_name, dev, sizeof(ifr.ifr_name)-1);
+    ifr.ifr_data = (char *)&eeprom;
+    if(ioctl(fd, SIOCETHTOOL, &ifr) < 0) {
+      myDebug(1, "SFP %s ETHTOOL_GMODULEEEPROM(%u,%u) failed: %s",
+	      dev,
+	      offset,
+	      len,
+	      strerror(errno));
+      return NO;
+    }
+    memcpy(dst, eeprom.data, len);
+#endif
+    return YES;
+  }
+
+  static EnumHSPSfpRead sfpPortRead(int fd, HSPSfpPort *port, char *dev, uint32_t ifIndex, uint32_t modinfo_type, uint32_t imageLen, bool reload, SFLSFP_counters *sfp) {
+    uint32_t diagOffset = HSP_SFF8472_DIAG_OFFSET;
+    uint32_t diagLen = HSP_SFF8472_DIAG_LEN;
+    if(modinfo_type == ETH_MODULE_SFF_8436) {
+      diagOffset = HSP_SFF8436_DIAG_OFFSET;
+      diagLen = HSP_SFF8436_DIAG_LEN;
+    }
+    if(!reload) {
+      uint8_t diag[HSP_SFF8436_DIAG_LEN];
+      if(!sfpEEPROMRead(fd, dev, diagOffset, diagLen, diag))
+	return HSP_SFP_READ_FAILED;
+      if(memcmp(diag, port->eeprom + diagOffset, diagLen) == 0)
+	return HSP_SFP_UNCHANGED;
+      // the QSFP lower page includes the identifier,  so we can
+      // tell if the module was swapped
+      if(modinfo_type == ETH_MODULE_SFF_8436
+	 && diag[0] != port->eeprom[0])
+	reload = YES;
+      else
+	memcpy(port->eeprom + diagOffset, diag, diagLen);
+    }
+    if(reload) {
+      memset(port->eeprom, 0, HSP_SFP_IMAGE_MAX);
+      if(!sfpEEPROMRead(fd, dev, 0, imageLen, port->eeprom))
+	return HSP_SFP_READ_FAILED;
+    }
+    switch(modinfo_type) {
+    case ETH_MODULE_SFF_8472: sff8472_parse(dev, ifIndex, port->eeprom, sfp); break;
+    case ETH_MODULE_SFF_8436: sff8436_parse(dev, ifIndex, port->eeprom, sfp); break;
+    }
+    return HSP_SFP_CHANGED;
+  }
+
+  static void sfpPortResult(HSPSfpPort *port, EnumHSPSfpRead rc, SFLSFP_counters *sfp) {
+    if(rc == HSP_SFP_READ_FAILED) {
+      if(!port->failed)
+	myLog(LOG_INFO, "SFP %s: cannot read module EEPROM", port->deviceName);
+      port->failed = YES;
+      port->reload = YES;
+      port->polls = 0;
+      if(port->sfp.num_lanes) {
+	// stop reporting it
+	my_free(port->sfp.lanes);
+	memset(&port->sfp, 0, sizeof(port->sfp));
+	port->seqNo++;
+      }
+      return;
+    }
+    port->failed = NO;
+    if(rc == HSP_SFP_CHANGED) {
+      if(port->sfp.lanes)
+	my_free(port->sfp.lanes);
+      port->sfp = *sfp; // struct copy - takes the lanes
+      port->seqNo++;
+    }
+    if(++port->polls >= HSP_SFP_RELOAD_POLLS) {
+      port->polls = 0;
+      port->reload = YES;
+    }
+  }
+
+  static void *sfpWorker(void *magic) {
+    HSPSfpPoller *sfpp = (HSPSfpPoller *)magic;
+    int fd = socket(PF_INET, SOCK_DGRAM, 0);
+    UTArray *forget = UTArrayNew(UTARRAY_DFLT);
+    SEMLOCK_DO(&sfpp->sync) {
+      if(fd < 0) {
+	myLog(LOG_ERR, "sfpWorker: socket() failed : %s", strerror(errno));
+	sfpp->dead = YES;
+      }
+      while(!sfpp->dead) {
+	time_t now = sfpNow();
+	time_t next = now + sfpp->pollSecs;
+	HSPSfpPort *port, *due = NULL;
+	UTHASH_WALK(sfpp->ports, port) {
+	  if((now - port->lastFetch) > (sfpp->pollSecs * HSP_SFP_FORGET_POLLS))
+	    UTArrayAdd(forget, port);
+	  else if(port->nextPoll <= now) {
+	    if(due == NULL
+	       || port->nextPoll < due->nextPoll)
+	      due = port;
+	  }
+	  else if(port->nextPoll < next)
+	    next = port->nextPoll;
+	}
+	// only this thread removes ports,  so "due" stays valid
+	// while we read it without the lock
+	UTARRAY_WALK(forget, port) {
+	  myDebug(1, "sfpWorker: forget %s", port->deviceName);
+	  UTHashDel(sfpp->ports, port);
+	  sfpPortFree(port);
+	}
+	UTArrayReset(forget);
+	if(due == NULL) {
+	  struct timespec until = { .tv_sec = next };
+	  pthread_cond_timedwait(&sfpp->cond, &sfpp->sync, &until);
+	  continue;
+	}
+	char dev[IFNAMSIZ];
+	memcpy(dev, due->deviceName, IFNAMSIZ);
+	uint32_t modinfo_type = due->modinfo_type;
+	uint32_t imageLen = due->imageLen;
+	bool reload = due->reload;
+	due->reload = NO;
+	pthread_mutex_unlock(&sfpp->sync);
+	SFLSFP_counters sfp = { 0 };
+	EnumHSPSfpRead rc = sfpPortRead(fd, due, dev, due->ifIndex, modinfo_type, imageLen, reload, &sfp);
+	pthread_mutex_lock(&sfpp->sync);
+	if(modinfo_type != due->modinfo_type
+	   || imageLen != due->imageLen) {
+	  // changed under our feet - discard and start again
+	  if(sfp.lanes)
+	    my_free(sfp.lanes);
+	  continue;
+	}
+	sfpPortResult(due, rc, &sfp);
+	due->nextPoll = sfpNow() + sfpp->pollSecs;
+      }
+    }
+    if(fd >= 0)
+      close(fd);
+    UTArrayFree(forget);
+    return NULL;
+  }
+
+  static HSPSfpPoller *sfpPollerStart(void) {
+    HSPSfpPoller *sfpp = (HSPSfpPoller *)my_calloc(sizeof(HSPSfpPoller));
+    pthread_mutex_init(&sfpp->sync, NULL);
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sfpp->cond, &cattr);
+    pthread_condattr_destroy(&cattr);
+    sfpp->ports = UTHASH_NEW(HSPSfpPort, ifIndex, UTHASH_DFLT);
+    sfpp->pollSecs = HSP_SFP_MIN_POLL_SECS;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, EV_BUS_STACKSIZE);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, sfpWorker, sfpp);
+    if(err) {
+      myLog(LOG_ERR, "sfpPollerStart: pthread_create() failed: %s", strerror(err));
+      sfpp->dead = YES;
+    }
+    pthread_attr_destroy(&attr);
+    return sfpp;
+  }
+
+  /*_________________---------------------------__________________
+    _________________     sfpFetch              __________________
+    -----------------___________________________------------------
+    Called on the poll bus for a per-interface counter sample. Keeps
+    the port on the worker's schedule and copies out the latest parsed
+    counters if they changed since last time.
+  */
+
+  static void sfpFetch(HSP *sp, SFLAdaptor *adaptor) {
+    HSPAdaptorNIO *nio = ADAPTOR_NIO(adaptor);
+    uint32_t imageLen = sfpImageLen(nio->modinfo_type, nio->modinfo_len);
+    if(imageLen == 0)
+      return;
+    if(sp->sfpPoller == NULL)
+      sp->sfpPoller = sfpPollerStart();
+    HSPSfpPoller *sfpp = sp->sfpPoller;
+    time_t now = sfpNow();
+    SEMLOCK_DO(&sfpp->sync) {
+      uint32_t pollSecs = sp->actualPollingInterval * HSP_SFP_POLL_FACTOR;
+      sfpp->pollSecs = (pollSecs < HSP_SFP_MIN_POLL_SECS) ? HSP_SFP_MIN_POLL_SECS : pollSecs;
+      HSPSfpPort search = { .ifIndex = adaptor->ifIndex };
+      HSPSfpPort *port = UTHashGet(sfpp->ports, &search);
+      if(port == NULL) {
+	port = (HSPSfpPort *)my_calloc(sizeof(HSPSfpPort));
+	port->ifIndex = adaptor->ifIndex;
+	UTHashAdd(sfpp->ports, port);
+      }
+      if(port->modinfo_type != nio->modinfo_type
+	 || port->imageLen != imageLen
+	 || strncmp(port->deviceName, adaptor->deviceName, IFNAMSIZ)) {
+	// new or changed - read it all as soon as possible
+	port->modinfo_type = nio->modinfo_type;
+	port->imageLen = imageLen;
+	strncpy(port->deviceName, adaptor->deviceName, IFNAMSIZ-1);
+	port->reload = YES;
+	port->nextPoll = now;
+	pthread_cond_signal(&sfpp->cond);
+      }
+      port->lastFetch = now;
+      if(port->seqNo != nio->sfp_seqNo) {
+	nio->sfp_seqNo = port->seqNo;
+	SFLLane *lanes = nio->sfp.lanes;
+	uint32_t lanesLen = sizeof(SFLLane) * port->sfp.num_lanes;
+	nio->sfp = port->sfp; // struct copy
+	nio->sfp.lanes = lanes;
+	if(lanesLen) {
+	  nio->sfp.lanes = (SFLLane *)my_realloc(lanes, lanesLen);
+	  memcpy(nio->sfp.lanes, port->sfp.lanes, lanesLen);
+	}
+      }
+    }
   }
 
 #endif /* ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
@@ -844,6 +1126,291 @@ extern "C" {
     return accumulate;
   }
 
+  /*_________________---------------------------__________________
+    _________________    updateAdaptorNio       __________________
+    -----------------___________________________------------------
+    Common to the netlink and /proc/net/dev paths:  add the ethtool
+    (and optical) counters for one adaptor and accumulate the result.
+  */
+
+  typedef struct _HSPNioStats64 {
+    uint32_t ifIndex;
+    struct rtnl_link_stats64 st;
+  } HSPNioStats64;
+
+  typedef struct _HSPNioUpdate {
+    HSP *sp;
+    SFLAdaptor *filter;
+    int fd; // for ethtool ioctls
+    struct ifreq ifr;
+    // netlink replies are held here until the dump completes
+    HSPNioStats64 *nl_stats;
+    uint32_t nl_stats_n;
+    uint32_t nl_stats_siz;
+  } HSPNioUpdate;
+
+  static void updateAdaptorNio(HSPNioUpdate *upd, SFLAdaptor *adaptor, SFLHost_nio_counters *ctrs) {
+    HSPAdaptorNIO *niostate = ADAPTOR_NIO(adaptor);
+
+    if(upd->filter && (upd->filter != adaptor))
+      return;
+
+    if(niostate->procNetDev == NO)
+      return;
+
+    HSP_ethtool_counters et_ctrs = { 0 };
+    if (niostate->ethtool_GSTATS
+	&& niostate->et_found) {
+      // get the latest stats block for this device via ethtool
+      // and read out the counters that we located by name.
+
+      uint32_t bytes = sizeof(struct ethtool_stats);
+      bytes += niostate->et_nctrs * sizeof(uint64_t);
+      bytes += 32; // pad - just in case driver wants to write more
+      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
+      et_stats->cmd = ETHTOOL_GSTATS;
+      et_stats->n_stats = niostate->et_nctrs;
+
+      // now issue the ioctl
+      strncpy(upd->ifr.ifr_name, adaptor->deviceName, sizeof(upd->ifr.ifr_name)-1);
+      upd->ifr.ifr_data = (char *)et_stats;
+      if(ioctl(upd->fd, SIOCETHTOOL, &upd->ifr) >= 0) {
+	if(getDebug() > 2) {
+	  for(int xx = 0; xx < et_stats->n_stats; xx++) {
+	    myDebug(1, "ethtool counter for %s at index %d == %"PRIu64,
+		    adaptor->deviceName,
+		    xx,
+		    et_stats->data[xx]);
+	  }
+	}
+	if(niostate->et_idx_mcasts_in)
+	  et_ctrs.mcasts_in = et_stats->data[niostate->et_idx_mcasts_in - 1];
+	if(niostate->et_idx_mcasts_out)
+	  et_ctrs.mcasts_out = et_stats->data[niostate->et_idx_mcasts_out - 1];
+	if(niostate->et_idx_bcasts_in)
+	  et_ctrs.bcasts_in = et_stats->data[niostate->et_idx_bcasts_in - 1];
+	if(niostate->et_idx_bcasts_out)
+	  et_ctrs.bcasts_out = et_stats->data[niostate->et_idx_bcasts_out - 1];
+      }
+      my_free(et_stats);
+    }
+
+#if ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM )
+    if(upd->filter) {
+      // If we are refreshing stats for an individual device, then
+      // pick up the SFP (lane) stats too.  The EEPROM reads are done
+      // by the optics worker,  so this only copies from its cache.
+      // The host-sflow network totals do not include optical stats,
+      // so there is no need to do it for the full refresh.
+      sfpFetch(upd->sp, adaptor);
+    }
+#endif /*  ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
+
+    accumulateNioCounters(upd->sp, adaptor, ctrs, &et_ctrs);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    netlink link stats     __________________
+    -----------------___________________________------------------
+    One dump request returns 64-bit stats for every link, instead of
+    parsing /proc/net/dev text.  RTM_GETSTATS (kernel 4.7+) can be asked
+    for just the stats64 block.  Older kernels get the RTM_GETLINK dump,
+    which carries IFLA_STATS64 along with everything else.  The columns
+    are mapped the same way the kernel fills in /proc/net/dev.  Nothing
+    is accumulated until the whole dump has arrived,  otherwise a dump
+    that failed partway would be counted again by the /proc/net/dev
+    fallback.
+  */
+
+  static void nioStats64(HSPNioUpdate *upd, uint32_t ifIndex, struct rtnl_link_stats64 *st) {
+    SFLAdaptor *adaptor = adaptorByIndex(upd->sp, ifIndex);
+    if(adaptor == NULL)
+      return;
+    SFLHost_nio_counters ctrs = {
+      .bytes_in = st->rx_bytes,
+      .pkts_in = (uint32_t)st->rx_packets,
+      .errs_in = (uint32_t)st->rx_errors,
+      .drops_in = (uint32_t)(st->rx_dropped + st->rx_missed_errors),
+      .bytes_out = st->tx_bytes,
+      .pkts_out = (uint32_t)st->tx_packets,
+      .errs_out = (uint32_t)st->tx_errors,
+      .drops_out = (uint32_t)st->tx_dropped
+    };
+    updateAdaptorNio(upd, adaptor, &ctrs);
+  }
+
+  static void nioStash64(HSPNioUpdate *upd, uint32_t ifIndex, void *st) {
+    if(upd->nl_stats_n == upd->nl_stats_siz) {
+      upd->nl_stats_siz = upd->nl_stats_siz ? (upd->nl_stats_siz * 2) : 64;
+      upd->nl_stats = (HSPNioStats64 *)my_realloc(upd->nl_stats, upd->nl_stats_siz * sizeof(HSPNioStats64));
+    }
+    HSPNioStats64 *entry = &upd->nl_stats[upd->nl_stats_n++];
+    entry->ifIndex = ifIndex;
+    memcpy(&entry->st, st, sizeof(entry->st)); // may not be 64-bit aligned
+  }
+
+  static void nioNetlinkCB(void *magic, struct nlmsghdr *nlh) {
+    HSPNioUpdate *upd = (HSPNioUpdate *)magic;
+    switch(nlh->nlmsg_type) {
+#ifdef IFLA_STATS_FILTER_BIT
+    case RTM_NEWSTATS: {
+      struct if_stats_msg *ifsm = (struct if_stats_msg *)NLMSG_DATA(nlh);
+      int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifsm));
+      for(struct rtattr *rta = (struct rtattr *)((char *)ifsm + NLMSG_ALIGN(sizeof(*ifsm)));
+	  RTA_OK(rta, len);
+	  rta = RTA_NEXT(rta, len)) {
+	if(rta->rta_type == IFLA_STATS_LINK_64
+	   && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+	  nioStash64(upd, ifsm->ifindex, RTA_DATA(rta));
+	}
+      }
+    }
+      break;
+#endif
+    case RTM_NEWLINK: {
+      struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+      int len = IFLA_PAYLOAD(nlh);
+      for(struct rtattr *rta = IFLA_RTA(ifi);
+	  RTA_OK(rta, len);
+	  rta = RTA_NEXT(rta, len)) {
+	if(rta->rta_type == IFLA_STATS64
+	   && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+	  nioStash64(upd, ifi->ifi_index, RTA_DATA(rta));
+	}
+      }
+    }
+      break;
+    }
+  }
+
+#define HSP_NIO_NETLINK_TIMEOUT_MS 1000
+
+  static void closeNioNetlink(HSP *sp) {
+    if(sp->nio_nl_sock > 0)
+      close(sp->nio_nl_sock);
+    sp->nio_nl_sock = 0;
+  }
+
+  static bool updateNioNetlink(HSPNioUpdate *upd) {
+    HSP *sp = upd->sp;
+    if(sp->nio_nl_sock <= 0) {
+      if((sp->nio_nl_sock = UTNLRoute_open(0)) <= 0) {
+	// use /proc/net/dev this time and try to open again next poll
+	myDebug(1, "updateNioNetlink: open failed: %s", strerror(errno));
+	sp->nio_nl_sock = 0;
+	return NO;
+      }
+    }
+    // ask for just the one device if we can
+    uint32_t ifIndex = upd->filter ? upd->filter->ifIndex : 0;
+    bool dump = (ifIndex == 0);
+    while(sp->nio_method != HSP_NIO_METHOD_PROCFS) {
+      uint32_t seqNo = ++sp->nio_nl_seq;
+      int err;
+#ifdef IFLA_STATS_FILTER_BIT
+      if(sp->nio_method == HSP_NIO_METHOD_GETSTATS) {
+	struct if_stats_msg req = { .family = AF_UNSPEC,
+				    .ifindex = ifIndex,
+				    .filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64) };
+	err = UTNLRoute_send(sp->nio_nl_sock, RTM_GETSTATS, &req, sizeof(req), dump, seqNo);
+      }
+      else
+#endif
+      {
+	struct ifinfomsg req = { .ifi_family = AF_UNSPEC,
+				 .ifi_index = ifIndex };
+	err = UTNLRoute_send(sp->nio_nl_sock, RTM_GETLINK, &req, sizeof(req), dump, seqNo);
+      }
+      upd->nl_stats_n = 0;
+      if(err >= 0)
+	err = UTNLRoute_recv(sp->nio_nl_sock, seqNo, HSP_NIO_NETLINK_TIMEOUT_MS, upd, nioNetlinkCB);
+      else
+	err = -errno;
+      if(err == 0) {
+	// complete - now it is safe to accumulate
+	for(uint32_t ii = 0; ii < upd->nl_stats_n; ii++)
+	  nioStats64(upd, upd->nl_stats[ii].ifIndex, &upd->nl_stats[ii].st);
+	return YES;
+      }
+      if(err == -ENODEV) {
+	// single device went away - nothing to report
+	return YES;
+      }
+      if(err != -EOPNOTSUPP
+	 && err != -EINVAL) {
+	// transient (timeout, ENOBUFS, ...) so use /proc/net/dev this
+	// time and try netlink again next poll on a fresh socket,  so
+	// a late or partial reply cannot be mistaken for the next one
+	myDebug(1, "updateNioNetlink: method %u failed (%s), will retry",
+		sp->nio_method,
+		strerror(-err));
+	closeNioNetlink(sp);
+	return NO;
+      }
+      // not supported here - downgrade
+      EnumHSPNioMethod fallback = (sp->nio_method == HSP_NIO_METHOD_GETSTATS)
+	? HSP_NIO_METHOD_GETLINK
+	: HSP_NIO_METHOD_PROCFS;
+      myLog(LOG_INFO, "interface counters: netlink method %u failed (%s), trying method %u",
+	    sp->nio_method,
+	    strerror(-err),
+	    fallback);
+      sp->nio_method = fallback;
+    }
+    closeNioNetlink(sp);
+    return NO;
+  }
+
+  /*_________________---------------------------__________________
+    _________________   updateNioProcNetDev     __________________
+    -----------------___________________________------------------
+    Fallback for kernels without netlink stats64.
+  */
+
+  static void updateNioProcNetDev(HSPNioUpdate *upd) {
+    HSPProcFiles *pf = &upd->sp->procFiles;
+    char *buf;
+    if(pf->netdev == NULL)
+      pf->netdev = UTProcFileNew(PROCFS_STR "/net/dev", 0);
+    if((buf = UTProcFileRead(pf->netdev)) != NULL) {
+      // ASCII numbers in /proc/net/dev may be 64-bit (if not now
+      // then someday), so it seems safer to read into
+      // 64-bit ints first,  then copy them into the host_nio
+      // structure from there.
+      // assume the format is:
+      // Inter-|   Receive                                                |  Transmit
+      //  face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
+      uint64_t ctr64[12];
+      char *line;
+      char *p = buf;
+      while((line = UTProcNextLine(&p)) != NULL) {
+	char *sep = strchr(line, ':');
+	if(sep == NULL)
+	  continue;
+	*sep++ = '\0';
+	if(UTProcNextU64s(&sep, ctr64, 12) != 12)
+	  continue;
+	char *trimmed = trimWhitespace(line, my_strlen(line));
+	if(trimmed == NULL)
+	  continue;
+	SFLAdaptor *adaptor = adaptorByName(upd->sp, trimmed);
+	if(adaptor) {
+	  SFLHost_nio_counters ctrs = {
+	    .bytes_in = ctr64[0],
+	    .pkts_in = (uint32_t)ctr64[1],
+	    .errs_in = (uint32_t)ctr64[2],
+	    .drops_in = (uint32_t)ctr64[3],
+	    .bytes_out = ctr64[8],
+	    .pkts_out = (uint32_t)ctr64[9],
+	    .errs_out = (uint32_t)ctr64[10],
+	    .drops_out = (uint32_t)ctr64[11]
+	  };
+	  updateAdaptorNio(upd, adaptor, &ctrs);
+	}
+      }
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________    updateNioCounters      __________________
     -----------------___________________________------------------
@@ -873,129 +1440,25 @@ extern "C" {
       }
     }
 
-    FILE *procFile;
-    procFile= fopen(PROCFS_STR "/net/dev", "r");
-    if(procFile) {
-      int fd = socket (PF_INET, SOCK_DGRAM, 0);
-      struct ifreq ifr;
-      memset (&ifr, 0, sizeof(ifr));
-      // ASCII numbers in /proc/diskstats may be 64-bit (if not now
-      // then someday), so it seems safer to read into
-      // 64-bit ints with scanf first,  then copy them
-      // into the host_nio structure from there.
-      uint64_t bytes_in = 0;
-      uint64_t pkts_in = 0;
-      uint64_t errs_in = 0;
-      uint64_t drops_in = 0;
-      uint64_t bytes_out = 0;
-      uint64_t pkts_out = 0;
-      uint64_t errs_out = 0;
-      uint64_t drops_out = 0;
-      // limit the number of chars we will read from each line
-      // (there can be more than this - my_readline will chop for us)
-#define MAX_PROC_LINE_CHARS 240
-      char line[MAX_PROC_LINE_CHARS];
-      int truncated;
-      while(my_readline(procFile, line, MAX_PROC_LINE_CHARS, &truncated) != EOF) {
-	char deviceName[MAX_PROC_LINE_CHARS];
-	// assume the format is:
-	// Inter-|   Receive                                                |  Transmit
-	//  face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed
-	if(sscanf(line, "%[^:]:%"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %*u %*u %*u %*u %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64"",
-		  deviceName,
-		  &bytes_in,
-		  &pkts_in,
-		  &errs_in,
-		  &drops_in,
-		  &bytes_out,
-		  &pkts_out,
-		  &errs_out,
-		  &drops_out) == 9) {
-	  uint32_t devLen = my_strnlen(deviceName, MAX_PROC_LINE_CHARS-1);
-	  char *trimmed = trimWhitespace(deviceName, devLen);
-	  if(trimmed == NULL)
-	    continue;
-	  SFLAdaptor *adaptor = adaptorByName(sp, trimmed);
-	  if(adaptor) {
-
-	    if(filter && (filter != adaptor))
-	      continue;
-
-	    HSPAdaptorNIO *niostate = ADAPTOR_NIO(adaptor);
-
-	    if(niostate->procNetDev == NO)
-	      continue;
-
-	    SFLHost_nio_counters ctrs = {
-	      .bytes_in = bytes_in,
-	      .pkts_in = (uint32_t)pkts_in,
-	      .errs_in = (uint32_t)errs_in,
-	      .drops_in = (uint32_t)drops_in,
-	      .bytes_out = bytes_out,
-	      .pkts_out = (uint32_t)pkts_out,
-	      .errs_out = (uint32_t)errs_out,
-	      .drops_out = (uint32_t)drops_out
-	    };
-	    HSP_ethtool_counters et_ctrs = { 0 };
-	    if (niostate->ethtool_GSTATS
-		&& niostate->et_found) {
-	      // get the latest stats block for this device via ethtool
-	      // and read out the counters that we located by name.
-
-	      uint32_t bytes = sizeof(struct ethtool_stats);
-	      bytes += niostate->et_nctrs * sizeof(uint64_t);
-	      bytes += 32; // pad - just in case driver wants to write more
-	      struct ethtool_stats *et_stats = (struct ethtool_stats *)my_calloc(bytes);
-	      et_stats->cmd = ETHTOOL_GSTATS;
-	      et_stats->n_stats = niostate->et_nctrs;
-
-	      // now issue the ioctl
-	      strncpy(ifr.ifr_name, adaptor->deviceName, sizeof(ifr.ifr_name)-1);
-	      ifr.ifr_data = (char *)et_stats;
-	      if(ioctl(fd, SIOCETHTOOL, &ifr) >= 0) {
-		if(getDebug() > 2) {
-		  for(int xx = 0; xx < et_stats->n_stats; xx++) {
-		    myDebug(1, "ethtool counter for %s at index %d == %"PRIu64,
-			    adaptor->deviceName,
-			    xx,
-			    et_stats->data[xx]);
-		  }
-		}
-		if(niostate->et_idx_mcasts_in)
-		  et_ctrs.mcasts_in = et_stats->data[niostate->et_idx_mcasts_in - 1];
-		if(niostate->et_idx_mcasts_out)
-		  et_ctrs.mcasts_out = et_stats->data[niostate->et_idx_mcasts_out - 1];
-		if(niostate->et_idx_bcasts_in)
-		  et_ctrs.bcasts_in = et_stats->data[niostate->et_idx_bcasts_in - 1];
-		if(niostate->et_idx_bcasts_out)
-		  et_ctrs.bcasts_out = et_stats->data[niostate->et_idx_bcasts_out - 1];
-	      }
-	      my_free(et_stats);
-	    }
-
-#if ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM )
-	    if(filter) {
-	      // If we are refreshing stats for an individual device, then
-	      // check for SFP (lane) stats too. This operation can be slow so
-	      // it's important to avoid doing it when we are refreshing
-	      // counters for all interfaces for host-sflow network totals.
-	      // Since the host-sflow network totals do not include optical
-	      // stats,  this is not a problem.
-	      switch(niostate->modinfo_type) {
-	      case ETH_MODULE_SFF_8472: sff8472_read(adaptor, &ifr, fd); break;
-	      case ETH_MODULE_SFF_8436: sff8436_read(adaptor, &ifr, fd); break;
-	      }
-	    }
-#endif /*  ( HSP_OPTICAL_STATS && ETHTOOL_GMODULEEEPROM ) */
+    HSPNioUpdate upd = { .sp = sp, .filter = filter };
+    upd.fd = socket (PF_INET, SOCK_DGRAM, 0);
 
-	    accumulateNioCounters(sp, adaptor, &ctrs, &et_ctrs);
-	  }
-	}
-      }
-      if(fd >= 0)
-	close(fd);
-      fclose(procFile);
+    if(sp->nio_method == HSP_NIO_METHOD_UNKNOWN) {
+#ifdef IFLA_STATS_FILTER_BIT
+      sp->nio_method = HSP_NIO_METHOD_GETSTATS;
+#else
+      sp->nio_method = HSP_NIO_METHOD_GETLINK;
+#endif
     }
+
+    if(sp->nio_method == HSP_NIO_METHOD_PROCFS
+       || updateNioNetlink(&upd) == NO)
+      updateNioProcNetDev(&upd);
+
+    if(upd.fd >= 0)
+      close(upd.fd);
+    if(upd.nl_stats)
+      my_free(upd.nl_stats);
   }
 
   /*_________________---------------------------__________________
@@ -168,13 +168,13 @@ extern "C" {
 	// TODO: use HSPPendingCSample for HSPEVENT_HOST_COUNTER_SAMPLE too?
 	// (might be useful to consumers to get pointer to the poller too).
 	if(ps.suppress) {
-	  sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES_SUPPRESSED]++;
+	  HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES_SUPPRESSED);
 	}
 	else {
 	  SEMLOCK_DO(sp->sync_agent) {
 	    sfl_poller_writeCountersSample(poller, cs);
 	    sp->counterSampleQueued = YES;
-	    sp->telemetry[HSP_TELEMETRY_COUNTER_SAMPLES]++;
+	    HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_COUNTER_SAMPLES);
 	  }
 	}
       }
@@ -200,13 +200,20 @@ extern "C" {
       SFLDataSource_instance dsi;
       SFL_DS_SET(dsi, 0, adaptor->ifIndex, 0); // ds_class,ds_index,ds_instance
       SEMLOCK_DO(sp->sync_agent) {
-	adaptorNIO->poller = sfl_agent_addPoller(sp->agent, &dsi, sp, agentCB_getCounters_interface_request);
-	sfl_poller_set_sFlowCpInterval(adaptorNIO->poller, sp->actualPollingInterval);
-	sfl_poller_set_sFlowCpReceiver(adaptorNIO->poller, HSP_SFLOW_RECEIVER_INDEX);
-	// remember the device name to make the lookups easier later.
-	// Don't want to point directly to the SFLAdaptor or SFLAdaptorNIO object
-	// in case it gets freed at some point.  The device name is enough.
-	adaptorNIO->poller->userData = (void *)my_strdup(adaptor->deviceName);
+	// check again now that we have the lock, in case
+	// another packet bus shard got here first
+	if(adaptorNIO->poller == NULL) {
+	  SFLPoller *poller = sfl_agent_addPoller(sp->agent, &dsi, sp, agentCB_getCounters_interface_request);
+	  sfl_poller_set_sFlowCpInterval(poller, sp->actualPollingInterval);
+	  sfl_poller_set_sFlowCpReceiver(poller, HSP_SFLOW_RECEIVER_INDEX);
+	  // remember the device name to make the lookups easier later.
+	  // Don't want to point directly to the SFLAdaptor or SFLAdaptorNIO object
+	  // in case it gets freed at some point.  The device name is enough.
+	  poller->userData = (void *)my_strdup(adaptor->deviceName);
+	  // publish only when fully initialized
+	  __sync_synchronize();
+	  adaptorNIO->poller = poller;
+	}
       }
     }
     return adaptorNIO->poller;
@@ -221,6 +228,55 @@ extern "C" {
     return getPoller(sp, adaptor);
   }
 
+  /*_________________---------------------------__________________
+    _________________    packet bus shards      __________________
+    -----------------___________________________------------------
+    With packetBusShards > 1 the packet processing is spread across
+    that many bus threads. Shard 0 is HSPBUS_PACKET. Buses are only
+    started by EVRun(), so modules should ask for their shards from
+    their init function.
+  */
+
+  EVBus *packetBusShard(EVMod *mod, uint32_t shard) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->packetBusShards == 0)
+      sp->packetBusShards = 1;
+    if(sp->packetBuses == NULL)
+      sp->packetBuses = (EVBus **)my_calloc(sp->packetBusShards * sizeof(EVBus *));
+    shard %= sp->packetBusShards;
+    if(sp->packetBuses[shard] == NULL) {
+      char busName[32];
+      if(shard == 0)
+	snprintf(busName, 32, "%s", HSPBUS_PACKET);
+      else
+	snprintf(busName, 32, "%s.%u", HSPBUS_PACKET, shard);
+      sp->packetBuses[shard] = EVGetBus(mod, busName, YES);
+    }
+    return sp->packetBuses[shard];
+  }
+
+  // spread the single-socket packet sources across the shards
+  EVBus *packetBusForModule(EVMod *mod) {
+    return packetBusShard(mod, mod->id);
+  }
+
+  int packetBusShardIndex(EVMod *mod, EVBus *bus) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    if(sp->packetBuses) {
+      for(uint32_t shard = 0; shard < sp->packetBusShards; shard++)
+	if(sp->packetBuses[shard] == bus)
+	  return shard;
+    }
+    return -1;
+  }
+
+  // subscribe on every shard
+  void packetBusEventRx(EVMod *mod, char *evt_name, EVActionCB cb) {
+    HSP *sp = (HSP *)EVROOTDATA(mod);
+    for(uint32_t shard = 0; shard < (sp->packetBusShards ?: 1); shard++)
+      EVEventRx(mod, EVGetEvent(packetBusShard(mod, shard), evt_name), cb);
+  }
+
   /*_________________---------------------------__________________
     _________________       getSampler          __________________
     -----------------___________________________------------------
@@ -234,63 +290,226 @@ extern "C" {
       SFL_DS_SET(dsi, 0, adaptor->ifIndex, 0); // ds_class,ds_index,ds_instance
       // add sampler
       SEMLOCK_DO(sp->sync_agent) {
-	adaptorNIO->sampler = sfl_agent_addSampler(sp->agent, &dsi);
-	sfl_sampler_set_sFlowFsReceiver(adaptorNIO->sampler, HSP_SFLOW_RECEIVER_INDEX);
-	sfl_sampler_set_sFlowFsMaximumHeaderSize(adaptorNIO->sampler, sp->sFlowSettings_file->headerBytes);
+	// check again now that we have the lock, in case
+	// another packet bus shard got here first
+	if(adaptorNIO->sampler == NULL) {
+	  SFLSampler *sampler = sfl_agent_addSampler(sp->agent, &dsi);
+	  sfl_sampler_set_sFlowFsReceiver(sampler, HSP_SFLOW_RECEIVER_INDEX);
+	  sfl_sampler_set_sFlowFsMaximumHeaderSize(sampler, sp->sFlowSettings_file->headerBytes);
+	  // publish only when fully initialized
+	  __sync_synchronize();
+	  adaptorNIO->sampler = sampler;
+	}
       }
     }
     return adaptorNIO->sampler;
   }
 
 
+  /*_________________---------------------------__________________
+    _________________   pendingSample arena     __________________
+    -----------------___________________________------------------
+    A pending sample and everything hung off it (the flow sample,
+    header element, header bytes and any extension elements) is
+    carved out of one arena block.  Blocks are recycled through a
+    per-thread pool, following the same realm idea as UTHeapQNew().
+    A sample is usually freed on the poll bus after encoding,  so
+    blocks are handed back to the owning thread's pool through a
+    lock-free stack that the owner swaps out whole when it runs dry.
+  */
+
+#define HSP_SAMPLE_ARENA_BYTES 2048
+#define HSP_SAMPLE_POOL_MAX 1024
+
+  typedef struct _HSPSampleArena {
+    struct _HSPSampleArena *nxt; // pool free-list or overflow chain
+    struct _HSPSamplePool *pool;
+    uint32_t cap;
+    uint32_t used;
+    uint64_t data[0]; // keep allocations 8-byte aligned
+  } HSPSampleArena;
+
+  typedef struct _HSPSamplePool {
+    HSPSampleArena *freeList; // owner thread only
+    HSPSampleArena *remoteFree; // pushed by any thread
+    uint32_t nFree;
+  } HSPSamplePool;
+
+  static __thread HSPSamplePool *samplePool;
+
+  static HSPSampleArena *sampleArenaNew(size_t len) {
+    if(samplePool == NULL)
+      samplePool = (HSPSamplePool *)my_calloc(sizeof(HSPSamplePool));
+    HSPSamplePool *pool = samplePool;
+    HSPSampleArena *arena = NULL;
+    if(len <= HSP_SAMPLE_ARENA_BYTES) {
+      if(pool->freeList == NULL) {
+	// reclaim everything the other threads have returned
+	pool->freeList = __atomic_exchange_n(&pool->remoteFree, NULL, __ATOMIC_ACQUIRE);
+	for(HSPSampleArena *a = pool->freeList; a; a = a->nxt)
+	  pool->nFree++;
+      }
+      if((arena = pool->freeList) != NULL) {
+	pool->freeList = arena->nxt;
+	pool->nFree--;
+      }
+      len = HSP_SAMPLE_ARENA_BYTES;
+    }
+    if(arena == NULL) {
+      arena = (HSPSampleArena *)my_calloc(sizeof(HSPSampleArena) + len);
+      arena->pool = pool;
+      arena->cap = len;
+    }
+    arena->nxt = NULL;
+    arena->used = 0;
+    return arena;
+  }
+
+  static void sampleArenaFree(HSPSampleArena *arena) {
+    HSPSamplePool *pool = arena->pool;
+    if(arena->cap != HSP_SAMPLE_ARENA_BYTES) {
+      // oversize overflow block - not pooled
+      my_free(arena);
+    }
+    else if(pool == samplePool) {
+      if(pool->nFree >= HSP_SAMPLE_POOL_MAX)
+	my_free(arena);
+      else {
+	arena->nxt = pool->freeList;
+	pool->freeList = arena;
+	pool->nFree++;
+      }
+    }
+    else {
+      // lock-free push onto the owner's return stack.  No ABA problem
+      // because the owner only ever takes the whole stack at once.
+      HSPSampleArena *top = __atomic_load_n(&pool->remoteFree, __ATOMIC_RELAXED);
+      do {
+	arena->nxt = top;
+      } while(!__atomic_compare_exchange_n(&pool->remoteFree, &top, arena, YES, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+  }
+
+  static void *sampleArenaAlloc(HSPSampleArena *arena, size_t len) {
+    len = (len + 7) & ~7;
+    // first block holds the sample.  Overflow blocks are chained behind it.
+    HSPSampleArena *blk = arena->nxt ?: arena;
+    if(blk->used + len > blk->cap) {
+      blk = sampleArenaNew(len);
+      blk->nxt = arena->nxt;
+      arena->nxt = blk;
+    }
+    void *ptr = (char *)blk->data + blk->used;
+    blk->used += len;
+    memset(ptr, 0, len);
+    return ptr;
+  }
+
   /*_________________---------------------------__________________
     _________________     pendingSample         __________________
     -----------------___________________________------------------
   */
 
-  static HSPPendingSample *pendingSampleNew(SFLSampler *sampler, SFL_FLOW_SAMPLE_TYPE *fs)  {
-    HSPPendingSample *ps = (HSPPendingSample *)my_calloc(sizeof(HSPPendingSample));
-    ps->fs = fs;
+  static HSPPendingSample *pendingSampleNew(SFLSampler *sampler)  {
+    HSPSampleArena *arena = sampleArenaNew(0);
+    HSPPendingSample *ps = (HSPPendingSample *)sampleArenaAlloc(arena, sizeof(HSPPendingSample));
+    ps->arena = arena;
+    ps->fs = (SFL_FLOW_SAMPLE_TYPE *)sampleArenaAlloc(arena, sizeof(SFL_FLOW_SAMPLE_TYPE));
     ps->sampler = sampler;
     ps->refCount = 1;
-    ps->ptrsToFree = UTArrayNew(UTARRAY_DFLT);
+    EVBus *bus = EVCurrentBus();
+    if(bus)
+      ps->captured = bus->now;
+    else
+      EVClockMono(&ps->captured);
     return ps;
   }
 
-  static void pendingSample_addHeapPtr(HSPPendingSample *ps, void *ptr) {
-    UTArrayAdd(ps->ptrsToFree, ptr);
-  }
-
   void *pendingSample_calloc(HSPPendingSample *ps, size_t len) {
-    void *ptr = my_calloc(len);
-    pendingSample_addHeapPtr(ps, ptr);
-    return ptr;
+    return sampleArenaAlloc(ps->arena, len);
   }
 
   void holdPendingSample(HSPPendingSample *ps) {
     ps->refCount++;
   }
 
+  static void pendingSampleFree(HSPPendingSample *ps) {
+    // the sample itself lives in the arena, so free that last
+    HSPSampleArena *arena = ps->arena;
+    for(HSPSampleArena *blk = arena->nxt, *nxt; blk; blk = nxt) {
+      nxt = blk->nxt;
+      sampleArenaFree(blk);
+    }
+    sampleArenaFree(arena);
+  }
+
   void releasePendingSample(HSP *sp, HSPPendingSample *ps)
   {
     if(--ps->refCount == 0) {
-      EVBus *bus = EVCurrentBus();
       if(ps->suppress) {
-	sp->telemetry[HSP_TELEMETRY_FLOW_SAMPLES_SUPPRESSED]++;
+	HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_FLOW_SAMPLES_SUPPRESSED);
+	pendingSampleFree(ps);
       }
-      else {
-	SEMLOCK_DO(sp->sync_agent) {
-	  sfl_agent_set_now(ps->sampler->agent, bus->now.tv_sec, bus->now.tv_nsec);
-	  sfl_sampler_writeFlowSample(ps->sampler, ps->fs);
-	  sp->telemetry[HSP_TELEMETRY_FLOW_SAMPLES]++;
+      else if(!UTMPSCPush(sp->sampleQ, ps)) {
+	// encoder is not keeping up - drop rather than block the packet bus
+	HSP_TELEMETRY_INC(sp, HSP_TELEMETRY_DROPPED_SAMPLES);
+	pendingSampleFree(ps);
+      }
+      else if(UTMPSCDepth(sp->sampleQ) >= HSP_SAMPLE_QUEUE_WAKE
+	      && __atomic_exchange_n(&sp->sampleQWakePosted, YES, __ATOMIC_SEQ_CST) == NO) {
+	// don't wait for the next deci - wake the poll bus now.  Only
+	// one wakeup is in flight until flushPendingSamples() runs.
+	EVEventTx(sp->rootModule, sp->evt_flush_samples, NULL, 0);
+      }
+      // ownership has passed to flushPendingSamples()
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________   flushPendingSamples     __________________
+    -----------------___________________________------------------
+    Called on the poll bus, which is the only consumer of sp->sampleQ.
+    Runs on every deci and whenever a producer finds the queue at
+    HSP_SAMPLE_QUEUE_WAKE.  Samples are encoded in batches so that
+    sync_agent is taken once per batch rather than once per sample,  and
+    memory is freed outside the lock.  Each sample is stamped with the
+    time it was captured rather than the time it was encoded.
+  */
+
+#define HSP_SAMPLE_FLUSH_BATCH 256
+
+  void flushPendingSamples(HSP *sp)
+  {
+    // clear before draining so a push that races with us wakes us again
+    __atomic_store_n(&sp->sampleQWakePosted, NO, __ATOMIC_SEQ_CST);
+    uint32_t depth = UTMPSCDepth(sp->sampleQ);
+    HSP_TELEMETRY_SET(sp, HSP_TELEMETRY_SAMPLE_QUEUE_DEPTH, depth);
+    // only take what was there on entry, so busy producers can't hold us here
+    while(depth) {
+      HSPPendingSample *batch[HSP_SAMPLE_FLUSH_BATCH];
+      uint32_t n = 0;
+      while(n < HSP_SAMPLE_FLUSH_BATCH
+	    && n < depth
+	    && (batch[n] = (HSPPendingSample *)UTMPSCPop(sp->sampleQ)) != NULL)
+	n++;
+      if(n == 0)
+	break;
+      depth -= n;
+      SEMLOCK_DO(sp->sync_agent) {
+	for(uint32_t ii = 0; ii < n; ii++) {
+	  // shards may interleave slightly out of order,  but the agent
+	  // clock must not go backwards
+	  struct timespec *ts = &batch[ii]->captured;
+	  if(ts->tv_sec > sp->agent->now
+	     || (ts->tv_sec == sp->agent->now
+		 && ts->tv_nsec > sp->agent->now_nS))
+	    sfl_agent_set_now(sp->agent, ts->tv_sec, ts->tv_nsec);
+	  sfl_sampler_writeFlowSample(batch[ii]->sampler, batch[ii]->fs);
 	}
       }
-      void *ptr;
-      UTARRAY_WALK(ps->ptrsToFree, ptr)
-	my_free(ptr);
-      UTArrayFree(ps->ptrsToFree);
-      my_free(ps->fs);
-      my_free(ps);
+      HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_FLOW_SAMPLES, n);
+      for(uint32_t ii = 0; ii < n; ii++)
+	pendingSampleFree(batch[ii]);
     }
   }
 
@@ -350,7 +569,7 @@ extern "C" {
     if(ad_in) {
       if(ADAPTOR_NIO(ad_in)->vm_or_container)
 	bridgeModel = YES;
-      SFLAdaptor *ad_in_global = adaptorByPeerIndex(sp, ad_in->ifIndex);
+      SFLAdaptor *ad_in_global = packetAdaptorByPeerIndex(sp, ad_in->ifIndex);
       if(ad_in_global) {
 	if(getDebug()) {
 	  myLog(LOG_INFO, "  GlobalNS veth peer ad_in=%s(%u)",
@@ -364,7 +583,7 @@ extern "C" {
     if(ad_out) {
       if(ADAPTOR_NIO(ad_out)->vm_or_container)
 	bridgeModel = YES;
-      SFLAdaptor *ad_out_global = adaptorByPeerIndex(sp, ad_out->ifIndex);
+      SFLAdaptor *ad_out_global = packetAdaptorByPeerIndex(sp, ad_out->ifIndex);
       if(ad_out_global) {
 	if(getDebug()) {
 	  myLog(LOG_INFO, "  GlobalNS veth peer ad_out=%s(%u)",
@@ -394,13 +613,6 @@ extern "C" {
       }
     }
 
-    SFL_FLOW_SAMPLE_TYPE *fs = my_calloc(sizeof(SFL_FLOW_SAMPLE_TYPE));
-
-    // set the ingress and egress ifIndex numbers.
-    // Can be "INTERNAL" (0x3FFFFFFF) or "UNKNOWN" (0).
-    fs->input = ad_in ? ad_in->ifIndex : (internal_in ? SFL_INTERNAL_INTERFACE : 0);
-    fs->output = ad_out ? ad_out->ifIndex : (internal_out ? SFL_INTERNAL_INTERFACE : 0);
-
     SFLAdaptor *sampler_dev = ad_tap;
     if(ad_tap
        && (dsopts & HSP_SAMPLEOPT_DEV_SAMPLER)) {
@@ -461,7 +673,14 @@ extern "C" {
     }
 
     // build the sampled header structure
-    HSPPendingSample *ps = pendingSampleNew(sampler, fs);
+    HSPPendingSample *ps = pendingSampleNew(sampler);
+    SFL_FLOW_SAMPLE_TYPE *fs = ps->fs;
+
+    // set the ingress and egress ifIndex numbers.
+    // Can be "INTERNAL" (0x3FFFFFFF) or "UNKNOWN" (0).
+    fs->input = ad_in ? ad_in->ifIndex : (internal_in ? SFL_INTERNAL_INTERFACE : 0);
+    fs->output = ad_out ? ad_out->ifIndex : (internal_out ? SFL_INTERNAL_INTERFACE : 0);
+
     SFLFlow_sample_element *hdrElem = pendingSample_calloc(ps, sizeof(SFLFlow_sample_element));
     hdrElem->tag = SFLFLOW_HEADER;
     uint32_t FCS_bytes = 4;
@@ -524,33 +743,33 @@ extern "C" {
     // above with the (possibly more granular) ulogSamplingRate, but then
     // we would have to look up the sampler object every time, which
     // might be too expensive in the case where ulogSamplingRate==1.
-    sampler->samplePool += actualSamplingRate;
+    // (atomic, since packet bus shards may share a sampler)
+    __sync_fetch_and_add(&sampler->samplePool, actualSamplingRate);
     
     // accumulate total drops
-    sp->telemetry[HSP_TELEMETRY_DROPPED_SAMPLES] += drops;
+    HSP_TELEMETRY_ADD(sp, HSP_TELEMETRY_DROPPED_SAMPLES, drops);
 
     // also accumulate dropped-samples we detected against whichever sampler
     // sends the next sample. This is not perfect,  but is likely to accrue
     // drops against the point whose sampling-rate needs to be adjusted.
-    samplerNIO->netlink_drops += drops;
-    fs->drops = samplerNIO->netlink_drops;
-
-    // Attach linked list of extension structures if supplied, and
-    // take over responsibility for freeing them when the sample is
-    // released (it might get queued and released later if
-    // another module wants to annotate it further after looking
-    // something up).
-    for(SFLFlow_sample_element *elem = extended_elements; elem; ) {
-      SFLFlow_sample_element *next_elem = elem->nxt;
-      SFLADD_ELEMENT(fs, elem);
-      pendingSample_addHeapPtr(ps, elem);
-      elem = next_elem;
+    fs->drops = __sync_add_and_fetch(&samplerNIO->netlink_drops, drops);
+
+    // Attach linked list of extension structures if supplied.  They
+    // are copied into the sample arena because the sample may be queued
+    // and released later if another module wants to annotate it further
+    // after looking something up. The caller still owns the originals.
+    for(SFLFlow_sample_element *elem = extended_elements; elem; elem = elem->nxt) {
+      SFLFlow_sample_element *copy = pendingSample_calloc(ps, sizeof(SFLFlow_sample_element));
+      *copy = *elem;
+      SFLADD_ELEMENT(fs, copy);
     }
       
-    // wrap it and send it out in case someone else wants to annotate it
-    if(sp->evt_flow_sample == NULL)
-      sp->evt_flow_sample = EVGetEvent(EVCurrentBus(), HSPEVENT_FLOW_SAMPLE);
-    EVEventTx(sp->rootModule, sp->evt_flow_sample, ps, sizeof(*ps));
+    // wrap it and send it out in case someone else wants to annotate it.
+    // Every packet bus shard has its own instance of this event.
+    static __thread EVEvent *evt_flow_sample;
+    if(evt_flow_sample == NULL)
+      evt_flow_sample = EVGetEvent(EVCurrentBus(), HSPEVENT_FLOW_SAMPLE);
+    EVEventTx(sp->rootModule, evt_flow_sample, ps, sizeof(*ps));
     releasePendingSample(sp, ps);
   }
 
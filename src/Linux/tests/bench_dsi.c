@@ -0,0 +1,76 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+// Microbenchmark for the libsflow data-source registry:  adds samplers,
+// pollers and notifiers for N shuffled ifIndex values,  looks each one
+// up by ifIndex and then removes half of them.  Usage: bench_dsi [N]
+// Against a pre-index baseline the default N=100000 takes minutes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "sflow_api.h"
+
+static void *benchAlloc(void *magic, SFLAgent *agent, size_t bytes) { return calloc(1, bytes); }
+static int benchFree(void *magic, SFLAgent *agent, void *obj) { free(obj); return 0; }
+static void benchCounters(void *magic, SFLPoller *poller, SFL_COUNTERS_SAMPLE_TYPE *cs) { }
+
+static double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char **argv) {
+  long nDsi = (argc > 1) ? atol(argv[1]) : 100000;
+
+  SFLAgent agent;
+  SFLAddress ip = { .type = SFLADDRESSTYPE_IP_V4 };
+  sfl_agent_init(&agent, &ip, 0, 0, 0, NULL, benchAlloc, benchFree, NULL, NULL);
+
+  // shuffled ifIndex order,  so neither the old sorted list nor the
+  // new index gets a best-case insert pattern
+  uint32_t *ifIndex = malloc(nDsi * sizeof(uint32_t));
+  for(long ii = 0; ii < nDsi; ii++)
+    ifIndex[ii] = ii + 1;
+  srand(7);
+  for(long ii = nDsi - 1; ii > 0; ii--) {
+    long jj = rand() % (ii + 1);
+    uint32_t tmp = ifIndex[ii];
+    ifIndex[ii] = ifIndex[jj];
+    ifIndex[jj] = tmp;
+  }
+
+  double t0 = benchNow();
+  for(long ii = 0; ii < nDsi; ii++) {
+    SFLDataSource_instance dsi;
+    SFL_DS_SET(dsi, 0, ifIndex[ii], ii % 3);
+    sfl_agent_addSampler(&agent, &dsi);
+    sfl_agent_addPoller(&agent, &dsi, NULL, benchCounters);
+    if(ii % 4 == 0) {
+      SFL_DS_SET(dsi, 2, ifIndex[ii], 0);
+      sfl_agent_addNotifier(&agent, &dsi);
+    }
+  }
+  double t1 = benchNow();
+  long hits = 0;
+  for(long ii = 0; ii < nDsi; ii++) {
+    if(sfl_agent_getSamplerByIfIndex(&agent, ifIndex[ii]))
+      hits++;
+  }
+  double t2 = benchNow();
+  for(long ii = 0; ii < nDsi; ii += 2) {
+    SFLDataSource_instance dsi;
+    SFL_DS_SET(dsi, 0, ifIndex[ii], ii % 3);
+    sfl_agent_removeSampler(&agent, &dsi);
+    sfl_agent_removePoller(&agent, &dsi);
+  }
+  double t3 = benchNow();
+
+  printf("dsi: n=%ld add=%.3fs lookup=%.3fs remove=%.3fs hits=%ld\n",
+	 nDsi, t1 - t0, t2 - t1, t3 - t2, hits);
+  sfl_agent_release(&agent);
+  free(ifIndex);
+  return (hits == nDsi) ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+// Microbenchmark for the libsflow sample encoder:  writes a mix of
+// flow, counter and discard-event samples through one receiver and
+// reports samples/sec.  Usage: bench_encoder [samples] [datagramSize]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sflow_api.h"
+
+static uint32_t datagrams;
+
+static void *benchAlloc(void *magic, SFLAgent *agent, size_t bytes) { return calloc(1, bytes); }
+static int benchFree(void *magic, SFLAgent *agent, void *obj) { free(obj); return 0; }
+static void benchError(void *magic, SFLAgent *agent, char *msg) { fprintf(stderr, "error: %s\n", msg); }
+static void benchSend(void *magic, SFLAgent *agent, SFLReceiver *receiver, u_char *pkt, uint32_t pktLen) { datagrams++; }
+
+static double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char **argv) {
+  long nFlows = (argc > 1) ? atol(argv[1]) : 2000000;
+  uint32_t dgramSize = (argc > 2) ? atoi(argv[2]) : 1400;
+
+  SFLAgent agent;
+  SFLAddress ip = { .type = SFLADDRESSTYPE_IP_V4 };
+  ip.address.ip_v4.addr = 0x0100007f;
+  sfl_agent_init(&agent, &ip, 0, 0, 0, NULL, benchAlloc, benchFree, benchError, benchSend);
+  SFLReceiver *receiver = sfl_agent_addReceiver(&agent);
+  sfl_receiver_set_sFlowRcvrMaximumDatagramSize(receiver, dgramSize);
+
+  u_char hdr[256];
+  for(int ii = 0; ii < sizeof(hdr); ii++)
+    hdr[ii] = ii * 7;
+
+  long nSamples = 0;
+  double t0 = benchNow();
+  for(long ii = 0; ii < nFlows; ii++) {
+    // flow sample: header + switch, sometimes a function symbol
+    SFL_FLOW_SAMPLE_TYPE fs = { 0 };
+    SFLFlow_sample_element hdrElem = { 0 }, swElem = { 0 }, fnElem = { 0 };
+    fs.sequence_number = ii;
+    fs.source_id = 3;
+    fs.sampling_rate = 400;
+    fs.input = 1;
+    fs.output = 2;
+    hdrElem.tag = SFLFLOW_HEADER;
+    hdrElem.flowType.header.header_protocol = SFLHEADER_ETHERNET_ISO8023;
+    hdrElem.flowType.header.frame_length = 1500;
+    hdrElem.flowType.header.header_length = 64 + (ii % 65);
+    hdrElem.flowType.header.header_bytes = hdr;
+    SFLADD_ELEMENT(&fs, &hdrElem);
+    swElem.tag = SFLFLOW_EX_SWITCH;
+    swElem.flowType.sw.src_vlan = ii & 0xFFF;
+    SFLADD_ELEMENT(&fs, &swElem);
+    if(ii % 3 == 0) {
+      fnElem.tag = SFLFLOW_EX_FUNCTION;
+      fnElem.flowType.function.symbol.str = "fn";
+      fnElem.flowType.function.symbol.len = 2;
+      SFLADD_ELEMENT(&fs, &fnElem);
+    }
+    sfl_receiver_writeFlowSample(receiver, &fs);
+    nSamples++;
+
+    if(ii % 5 == 0) {
+      // counter sample: generic + host cpu/mem + port name
+      SFL_COUNTERS_SAMPLE_TYPE cs = { 0 };
+      SFLCounters_sample_element gen = { 0 }, cpu = { 0 }, mem = { 0 }, pn = { 0 };
+      cs.sequence_number = ii;
+      cs.source_id = 7;
+      gen.tag = SFLCOUNTERS_GENERIC;
+      gen.counterBlock.generic.ifIndex = ii;
+      gen.counterBlock.generic.ifInOctets = ii * 1000000007ULL;
+      SFLADD_ELEMENT(&cs, &gen);
+      cpu.tag = SFLCOUNTERS_HOST_CPU;
+      cpu.counterBlock.host_cpu.load_one = 1.5;
+      SFLADD_ELEMENT(&cs, &cpu);
+      mem.tag = SFLCOUNTERS_HOST_MEM;
+      mem.counterBlock.host_mem.mem_total = ii;
+      SFLADD_ELEMENT(&cs, &mem);
+      pn.tag = SFLCOUNTERS_PORTNAME;
+      pn.counterBlock.portName.portName.str = "eth0";
+      pn.counterBlock.portName.portName.len = 4;
+      SFLADD_ELEMENT(&cs, &pn);
+      sfl_receiver_writeCountersSample(receiver, &cs);
+      nSamples++;
+    }
+
+    if(ii % 11 == 0) {
+      // discard event carrying a header
+      SFLEvent_discarded_packet es = { 0 };
+      SFLFlow_sample_element evHdr = hdrElem;
+      evHdr.nxt = NULL;
+      es.sequence_number = ii;
+      es.ds_index = 4;
+      es.reason = 9;
+      SFLADD_ELEMENT(&es, &evHdr);
+      sfl_receiver_writeEventSample(receiver, &es);
+      nSamples++;
+    }
+  }
+  sfl_receiver_flush(receiver);
+  double secs = benchNow() - t0;
+
+  printf("encoder: samples=%ld datagrams=%u time=%.3fs samples/sec=%.0f\n",
+	 nSamples,
+	 datagrams,
+	 secs,
+	 nSamples / secs);
+  return 0;
+}
@@ -0,0 +1,234 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+// Microbenchmark for the host /proc readers:  the same parsing done the
+// old way (fopen + my_readline + sscanf/parseNextTok every poll) and the
+// UTProcFile way (fd held open,  pread + in-place tokenizers),  over
+// meminfo,  vmstat,  stat,  diskstats and net/snmp.  statvfs() and the
+// rest of the counter plumbing are left out.  Usage: bench_procfile [polls]
+
+#include <time.h>
+#include "util.h"
+
+#define BENCH_LINE_CHARS 2048
+#define BENCH_MAX_COUNTERS 32
+
+static double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/*_________________---------------------------__________________
+  _________________   fopen + my_readline     __________________
+  -----------------___________________________------------------
+*/
+
+static uint64_t oldKeyVal(char *path) {
+  uint64_t sum = 0;
+  FILE *procFile = fopen(path, "r");
+  if(procFile) {
+    char line[80];
+    char var[80];
+    uint64_t val64;
+    int truncated;
+    while(my_readline(procFile, line, sizeof(line), &truncated) != EOF) {
+      if(sscanf(line, "%s %"SCNu64"", var, &val64) == 2)
+	sum += val64;
+    }
+    fclose(procFile);
+  }
+  return sum;
+}
+
+static uint64_t oldStat(void) {
+  uint64_t sum = 0;
+  FILE *procFile = fopen("/proc/stat", "r");
+  if(procFile) {
+    char line[240];
+    uint64_t val[10];
+    int truncated;
+    while(my_readline(procFile, line, sizeof(line), &truncated) != EOF) {
+      if(sscanf(line, "cpu %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64" %"SCNu64"",
+		&val[0], &val[1], &val[2], &val[3], &val[4],
+		&val[5], &val[6], &val[7], &val[8], &val[9]) >= 4) {
+	for(int ii = 0; ii < 4; ii++)
+	  sum += val[ii];
+      }
+      else if(sscanf(line, "intr %"SCNu64"", &val[0]) == 1
+	      || sscanf(line, "ctxt %"SCNu64"", &val[0]) == 1)
+	sum += val[0];
+    }
+    fclose(procFile);
+  }
+  return sum;
+}
+
+static uint64_t oldDiskstats(void) {
+  uint64_t sum = 0;
+  FILE *procFile = fopen("/proc/diskstats", "r");
+  if(procFile) {
+    char line[240];
+    char devName[240];
+    uint32_t majorNo, minorNo;
+    uint64_t reads, read_sectors, read_time, writes, write_sectors, write_time;
+    int truncated;
+    while(my_readline(procFile, line, sizeof(line), &truncated) != EOF) {
+      if(sscanf(line, "%"SCNu32" %"SCNu32" %s %"SCNu64" %*u %"SCNu64" %"SCNu64" %"SCNu64" %*u %"SCNu64" %"SCNu64"",
+		&majorNo, &minorNo, devName,
+		&reads, &read_sectors, &read_time,
+		&writes, &write_sectors, &write_time) == 9)
+	sum += reads + read_sectors + read_time + writes + write_sectors + write_time;
+    }
+    fclose(procFile);
+  }
+  return sum;
+}
+
+static uint64_t oldSnmp(void) {
+  uint64_t sum = 0;
+  FILE *procFile = fopen("/proc/net/snmp", "r");
+  if(procFile) {
+    char line[BENCH_LINE_CHARS];
+    int truncated;
+    while(my_readline(procFile, line, BENCH_LINE_CHARS, &truncated) != EOF) {
+      char *p = line;
+      char buf[BENCH_LINE_CHARS];
+      char *var = parseNextTok(&p, " \t", NO, 0, NO, buf, BENCH_LINE_CHARS);
+      if(var == NULL)
+	continue;
+      for(int ff = 0; ff < BENCH_MAX_COUNTERS; ff++) {
+	char *tok = parseNextTok(&p, " \t", NO, 0, NO, buf, BENCH_LINE_CHARS);
+	if(tok == NULL)
+	  break;
+	char *end = NULL;
+	long val = strtol(tok, &end, 0);
+	if(end == tok)
+	  break;
+	sum += (uint32_t)val;
+      }
+    }
+    fclose(procFile);
+  }
+  return sum;
+}
+
+/*_________________---------------------------__________________
+  _________________   UTProcFile              __________________
+  -----------------___________________________------------------
+*/
+
+static uint64_t newKeyVal(UTProcFile *pf) {
+  uint64_t sum = 0;
+  char *p = UTProcFileRead(pf);
+  char *line;
+  uint64_t val64;
+  if(p) {
+    while((line = UTProcNextLine(&p)) != NULL) {
+      if(UTProcNextTok(&line) != NULL
+	 && UTProcNextU64s(&line, &val64, 1) == 1)
+	sum += val64;
+    }
+  }
+  return sum;
+}
+
+static uint64_t newStat(UTProcFile *pf) {
+  uint64_t sum = 0;
+  char *p = UTProcFileRead(pf);
+  char *line, *var;
+  uint64_t val[10];
+  if(p) {
+    while((line = UTProcNextLine(&p)) != NULL) {
+      if((var = UTProcNextTok(&line)) == NULL)
+	continue;
+      if(strcmp(var, "cpu") == 0) {
+	if(UTProcNextU64s(&line, val, 10) >= 4) {
+	  for(int ii = 0; ii < 4; ii++)
+	    sum += val[ii];
+	}
+      }
+      else if(strcmp(var, "intr") == 0
+	      || strcmp(var, "ctxt") == 0) {
+	if(UTProcNextU64s(&line, val, 1) == 1)
+	  sum += val[0];
+      }
+    }
+  }
+  return sum;
+}
+
+static uint64_t newDiskstats(UTProcFile *pf) {
+  uint64_t sum = 0;
+  char *p = UTProcFileRead(pf);
+  char *line;
+  uint64_t devNo[2], io[8];
+  if(p) {
+    while((line = UTProcNextLine(&p)) != NULL) {
+      if(UTProcNextU64s(&line, devNo, 2) == 2
+	 && UTProcNextTok(&line) != NULL
+	 && UTProcNextU64s(&line, io, 8) == 8)
+	sum += io[0] + io[2] + io[3] + io[4] + io[6] + io[7];
+    }
+  }
+  return sum;
+}
+
+static uint64_t newSnmp(UTProcFile *pf) {
+  uint64_t sum = 0;
+  char *p = UTProcFileRead(pf);
+  char *line;
+  uint64_t val[BENCH_MAX_COUNTERS];
+  if(p) {
+    while((line = UTProcNextLine(&p)) != NULL) {
+      if(UTProcNextTok(&line) == NULL)
+	continue;
+      int n = UTProcNextU64s(&line, val, BENCH_MAX_COUNTERS);
+      for(int ff = 0; ff < n; ff++)
+	sum += (uint32_t)val[ff];
+    }
+  }
+  return sum;
+}
+
+int main(int argc, char **argv) {
+  int nPolls = (argc > 1) ? atoi(argv[1]) : 20000;
+  volatile uint64_t sum = 0;
+
+  double t0 = benchNow();
+  for(int ii = 0; ii < nPolls; ii++) {
+    sum += oldKeyVal("/proc/meminfo");
+    sum += oldKeyVal("/proc/vmstat");
+    sum += oldStat();
+    sum += oldDiskstats();
+    sum += oldSnmp();
+  }
+  double t1 = benchNow();
+
+  UTProcFile *meminfo = UTProcFileNew("/proc/meminfo", 0);
+  UTProcFile *vmstat = UTProcFileNew("/proc/vmstat", 0);
+  UTProcFile *stat = UTProcFileNew("/proc/stat", 0);
+  UTProcFile *diskstats = UTProcFileNew("/proc/diskstats", 0);
+  UTProcFile *snmp = UTProcFileNew("/proc/net/snmp", 0);
+  double t2 = benchNow();
+  for(int ii = 0; ii < nPolls; ii++) {
+    sum += newKeyVal(meminfo);
+    sum += newKeyVal(vmstat);
+    sum += newStat(stat);
+    sum += newDiskstats(diskstats);
+    sum += newSnmp(snmp);
+  }
+  double t3 = benchNow();
+  UTProcFileFree(meminfo);
+  UTProcFileFree(vmstat);
+  UTProcFileFree(stat);
+  UTProcFileFree(diskstats);
+  UTProcFileFree(snmp);
+
+  printf("procfile: polls=%d fopen+readline=%.1fus/poll UTProcFile=%.1fus/poll\n",
+	 nPolls,
+	 (t1 - t0) * 1e6 / nPolls,
+	 (t3 - t2) * 1e6 / nPolls);
+  return (sum == 0) ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/* This software is distributed under the following license:
+ * http://sflow.net/license.html
+ */
+
+// Microbenchmark for UTHash:  add,  get (hit and miss),  delete half
+// and get again,  for a uint32_t key and a string key.  Reports ns per
+// operation.  Usage: bench_uthash [N] [sync]
+
+#include <time.h>
+#include "util.h"
+
+typedef struct _BenchObj {
+  uint32_t key;
+  char *name;
+} BenchObj;
+
+#define BENCH_REPEAT 50
+
+static double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+int main(int argc, char **argv) {
+  int nObjs = (argc > 1) ? atoi(argv[1]) : 100000;
+  int sync = (argc > 2) ? UTHASH_SYNC : UTHASH_DFLT;
+
+  BenchObj *objs = (BenchObj *)calloc(nObjs, sizeof(BenchObj));
+  for(int ii = 0; ii < nObjs; ii++) {
+    char buf[32];
+    // odd keys,  so the even ones are all misses
+    objs[ii].key = ((ii * 7919u) << 1) | 1;
+    snprintf(buf, sizeof(buf), "eth%d", ii);
+    objs[ii].name = strdup(buf);
+  }
+  UTHash *byKey = UTHASH_NEW(BenchObj, key, sync);
+  UTHash *byName = UTHASH_NEW(BenchObj, name, sync | UTHASH_SKEY);
+  volatile long found = 0;
+
+  double t0 = benchNow();
+  for(int ii = 0; ii < nObjs; ii++) {
+    UTHashAdd(byKey, &objs[ii]);
+    UTHashAdd(byName, &objs[ii]);
+  }
+  double t1 = benchNow();
+  for(int rr = 0; rr < BENCH_REPEAT; rr++) {
+    for(int ii = 0; ii < nObjs; ii++) {
+      found += (UTHashGet(byKey, &objs[ii]) != NULL);
+      found += (UTHashGet(byName, &objs[ii]) != NULL);
+    }
+  }
+  double t2 = benchNow();
+  BenchObj miss = { 0 };
+  for(int rr = 0; rr < BENCH_REPEAT; rr++) {
+    for(int ii = 0; ii < nObjs; ii++) {
+      miss.key = ii << 1;
+      found += (UTHashGet(byKey, &miss) != NULL);
+    }
+  }
+  double t3 = benchNow();
+  for(int ii = 0; ii < nObjs; ii += 2) {
+    UTHashDel(byKey, &objs[ii]);
+    UTHashDel(byName, &objs[ii]);
+  }
+  double t4 = benchNow();
+  for(int rr = 0; rr < BENCH_REPEAT; rr++) {
+    for(int ii = 1; ii < nObjs; ii += 2)
+      found += (UTHashGet(byKey, &objs[ii]) != NULL);
+  }
+  double t5 = benchNow();
+
+  int nDel = (nObjs + 1) / 2;
+  int nLeft = nObjs - nDel;
+  printf("uthash: n=%d%s add=%.1fns get=%.1fns miss=%.1fns del=%.1fns get-after-del=%.1fns\n",
+	 nObjs,
+	 sync ? " sync" : "",
+	 (t1 - t0) * 1e9 / (nObjs * 2),
+	 (t2 - t1) * 1e9 / ((double)nObjs * 2 * BENCH_REPEAT),
+	 (t3 - t2) * 1e9 / ((double)nObjs * BENCH_REPEAT),
+	 (t4 - t3) * 1e9 / (nDel * 2),
+	 (t5 - t4) * 1e9 / ((double)nLeft * BENCH_REPEAT));
+
+  long expected = ((long)nObjs * 2 + nLeft) * BENCH_REPEAT;
+  if(found != expected
+     || UTHashN(byKey) != nLeft
+     || UTHashN(byName) != nLeft) {
+    fprintf(stderr, "uthash: wrong result found=%ld expected=%ld\n", found, expected);
+    return 1;
+  }
+  UTHashFree(byKey);
+  UTHashFree(byName);
+  return 0;
+}
@@ -7,6 +7,9 @@ extern "C" {
 #endif
 
 #include "util.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
   static int debugLevel = 0;
   static bool daemonFlag = YES;
@@ -228,8 +231,8 @@ extern "C" {
     uint64_t hdrBits64[2];     // force sizeof(UTBufferHeader) == 128bits to ensure alignment
     union _UTHeapHeader *nxt;  // valid when in linked list waiting to be reallocated
     struct {                   // valid when buffer being used - store bookkeeping info here
-      uint32_t realmIdx;
-      uint32_t queueIdx;
+      struct _UTHeapRealm *realm;
+      uint32_t queueIdx;       // still valid on the remote-free stack
     } h;
   } UTHeapHeader;
 
@@ -240,18 +243,82 @@ extern "C" {
   typedef struct _UTHeapRealm {
 #define UT_MAX_BUFFER_Q 32
     UTHeapHeader *bufferLists[UT_MAX_BUFFER_Q];
+    struct _UTHeapRealm *nxt;  // list of all realms, for stats
     pid_t realmIdx;
-    uint32_t totalAllocatedBytes;
+    uint64_t totalAllocatedBytes;
+    uint64_t remoteFrees;
+    uint64_t allocs[UT_MAX_BUFFER_Q];
+    uint32_t osBufs[UT_MAX_BUFFER_Q];
+    // buffers freed by other threads. Pushed without a lock,  and only
+    // taken by the owner,  all at once. On its own cache line.
+    UTHeapHeader *remote __attribute__((aligned(64)));
   } UTHeapRealm;
 
-  // separate realm for each thread
-  static __thread UTHeapRealm utRealm;
+  // separate realm for each thread.  Realms are never freed,  so a
+  // buffer can always be handed back to the realm that allocated it.
+  static __thread UTHeapRealm *utRealm;
+
+  static struct {
+    UTHeapRealm *realms;
+    pthread_mutex_t *sync_realms;
+  } UTHeap;
 
   static uint32_t UTHeapQSize(void *buf) {
     UTHeapHeader *utBuf = UTHeapQHdr(buf);
     return (1 << utBuf->h.queueIdx) - sizeof(UTHeapHeader);
   }
 
+  // call once at startup
+  void UTHeapInit() {
+    if(UTHeap.sync_realms == NULL) {
+      UTHeap.sync_realms = (pthread_mutex_t *)SYS_CALLOC(1, sizeof(pthread_mutex_t));
+      pthread_mutex_init(UTHeap.sync_realms, NULL);
+    }
+  }
+
+  static UTHeapRealm *UTHeapRealmNew(void) {
+    UTHeapRealm *realm;
+    if(posix_memalign((void **)&realm, 64, sizeof(UTHeapRealm)) != 0) {
+      myLog(LOG_ERR, "UTHeapRealmNew: posix_memalign() failed");
+      exit(EXIT_FAILURE);
+    }
+    memset(realm, 0, sizeof(UTHeapRealm));
+    realm->realmIdx = MYGETTID;
+    // the list is only ever pushed at the head,  so readers can walk it
+    SEMLOCK_DO(UTHeap.sync_realms) {
+      realm->nxt = UTHeap.realms;
+      __atomic_store_n(&UTHeap.realms, realm, __ATOMIC_RELEASE);
+    }
+    return realm;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    remote-free stack      __________________
+    -----------------___________________________------------------
+    Any thread can push. Only the owner pops, and it takes the whole
+    stack with one exchange,  so there is no ABA problem.
+  */
+
+  static void UTHeapRemotePush(UTHeapRealm *realm, UTHeapHeader *utBuf) {
+    UTHeapHeader *head = __atomic_load_n(&realm->remote, __ATOMIC_RELAXED);
+    do {
+      utBuf->nxt = head;
+    } while(!__atomic_compare_exchange_n(&realm->remote, &head, utBuf, YES, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+
+  static void UTHeapRemoteDrain(UTHeapRealm *realm) {
+    UTHeapHeader *utBuf = __atomic_exchange_n(&realm->remote, NULL, __ATOMIC_ACQUIRE);
+    while(utBuf) {
+      UTHeapHeader *nextBuf = utBuf->nxt;
+      uint32_t queueIdx = utBuf->h.queueIdx;
+      memset(utBuf, 0, 1 << queueIdx);
+      utBuf->nxt = realm->bufferLists[queueIdx];
+      realm->bufferLists[queueIdx] = utBuf;
+      realm->remoteFrees++;
+      utBuf = nextBuf;
+    }
+  }
+
   /*_________________---------------------------__________________
     _________________         UTHeapQNew        __________________
     -----------------___________________________------------------
@@ -261,71 +328,44 @@ extern "C" {
   void *UTHeapQNew(size_t len) {
     // initialize the realm so that we can trap on any cross-thread
     // allocation activity.
-    if(utRealm.realmIdx == 0) {
-      utRealm.realmIdx = MYGETTID;
-    }
+    if(utRealm == NULL)
+      utRealm = UTHeapRealmNew();
     // take it up to the nearest power of 2, including room for my header
     // but make sure it is at least 16 bytes (queue 4), so we always have
     // 128-bit alignment (just in case it is needed)
     int queueIdx = 4;
     for(int l = (len + 15) >> 4; l > 0; l >>= 1) queueIdx++;
-    UTHeapHeader *utBuf = (UTHeapHeader *)utRealm.bufferLists[queueIdx];
+    UTHeapHeader *utBuf = utRealm->bufferLists[queueIdx];
+    if(utBuf == NULL
+       && __atomic_load_n(&utRealm->remote, __ATOMIC_RELAXED)) {
+      // reclaim anything other threads have given back
+      UTHeapRemoteDrain(utRealm);
+      utBuf = utRealm->bufferLists[queueIdx];
+    }
     if(utBuf) {
       // peel it off
-      utRealm.bufferLists[queueIdx] = utBuf->nxt;
+      utRealm->bufferLists[queueIdx] = utBuf->nxt;
     }
     else {
       // allocate a new one
       utBuf = (UTHeapHeader *)my_os_calloc(1<<queueIdx);
-      utRealm.totalAllocatedBytes += (1<<queueIdx);
+      utRealm->totalAllocatedBytes += (1<<queueIdx);
+      utRealm->osBufs[queueIdx]++;
     }
+    utRealm->allocs[queueIdx]++;
     // remember the details so we know what to do on free (overwriting the nxt pointer)
-    utBuf->h.realmIdx = utRealm.realmIdx;
+    utBuf->h.realm = utRealm;
     utBuf->h.queueIdx = queueIdx;
     // return a pointer to just after the header
     return (char *)utBuf + sizeof(UTHeapHeader);
   }
 
-  /*_________________---------------------------__________________
-    _________________    foreign thread free    __________________
-    -----------------___________________________------------------
-  */
-
-  static struct {
-    UTHeapHeader *foreign;
-    pthread_mutex_t *sync_foreign;
-    uint32_t n_foreign;
-  } UTHeap;
-
-  // call once at startup
-  void UTHeapInit() {
-    if(UTHeap.sync_foreign == NULL) {
-      UTHeap.sync_foreign = (pthread_mutex_t *)SYS_CALLOC(1, sizeof(pthread_mutex_t));
-      pthread_mutex_init(UTHeap.sync_foreign, NULL);
-      UTHeap.n_foreign = 0;
-    }
-  }
-
   // each thread should call this periodically
   void UTHeapGC(void)
   {
-    if(UTHeap.n_foreign) {
-      SEMLOCK_DO(UTHeap.sync_foreign) {
-	for(UTHeapHeader *utBuf = UTHeap.foreign, *prev = NULL; utBuf; ) {
-	  UTHeapHeader *nextBuf = utBuf->nxt;
-	  if(utBuf->h.realmIdx == utRealm.realmIdx) {
-	    // this one is mine - recycle and unlink
-	    myDebug(1, "UTHeapGC: realm %u foreign free (n=%u)", utRealm.realmIdx, UTHeap.n_foreign);
-	    UTHeapQFree(utBuf);
-	    if(prev) prev->nxt = nextBuf;
-	    else UTHeap.foreign = nextBuf;
-	    UTHeap.n_foreign--;
-	  }
-	  else prev = utBuf;
-	  utBuf = nextBuf;
-	}
-      }
-    }
+    if(utRealm
+       && __atomic_load_n(&utRealm->remote, __ATOMIC_RELAXED))
+      UTHeapRemoteDrain(utRealm);
   }
 
   /*_________________---------------------------__________________
@@ -336,22 +376,54 @@ extern "C" {
   void UTHeapQFree(void *buf)
   {
     UTHeapHeader *utBuf = UTHeapQHdr(buf);
-    if(utBuf->h.realmIdx == utRealm.realmIdx) {
+    if(utBuf->h.realm == utRealm) {
       // read the queue index before we overwrite it
       uint16_t queueIdx = utBuf->h.queueIdx;
       memset(utBuf, 0, 1 << queueIdx);
       // put it back on the queue
-      utBuf->nxt = (UTHeapHeader *)(utRealm.bufferLists[queueIdx]);
-      utRealm.bufferLists[queueIdx] = utBuf;
+      utBuf->nxt = utRealm->bufferLists[queueIdx];
+      utRealm->bufferLists[queueIdx] = utBuf;
     }
     else {
-      // foreign realm - queue it for the owner to recycle.  Could
-      // improve this to use a separate mutex and queue for each
-      // realm if we ever find that there is performance pressure.
-      SEMLOCK_DO(UTHeap.sync_foreign) {
-	utBuf->nxt = UTHeap.foreign;
-	UTHeap.foreign = utBuf;
-	UTHeap.n_foreign++;
+      // foreign realm - give it back to the owner to recycle
+      UTHeapRemotePush(utBuf->h.realm, utBuf);
+    }
+  }
+
+  /*_________________---------------------------__________________
+    _________________      UTHeapStats          __________________
+    -----------------___________________________------------------
+    Counters are only written by the owning thread,  so these are
+    just snapshots. No locking,  so UTHeapLogStats() can be called
+    from the SIGUSR2 handler.
+  */
+
+  void UTHeapGetStats(UTHeapStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    UTHeapRealm *realm = __atomic_load_n(&UTHeap.realms, __ATOMIC_ACQUIRE);
+    for(; realm; realm = realm->nxt) {
+      stats->realms++;
+      stats->bytes += __atomic_load_n(&realm->totalAllocatedBytes, __ATOMIC_RELAXED);
+      stats->remoteFrees += __atomic_load_n(&realm->remoteFrees, __ATOMIC_RELAXED);
+      for(int qq = 0; qq < UT_MAX_BUFFER_Q; qq++)
+	stats->allocs += __atomic_load_n(&realm->allocs[qq], __ATOMIC_RELAXED);
+    }
+  }
+
+  void UTHeapLogStats(void) {
+    UTHeapRealm *realm = __atomic_load_n(&UTHeap.realms, __ATOMIC_ACQUIRE);
+    for(; realm; realm = realm->nxt) {
+      myLog(LOG_INFO, "UTHeap realm %u: bytes=%"PRIu64" remoteFrees=%"PRIu64,
+	    realm->realmIdx,
+	    __atomic_load_n(&realm->totalAllocatedBytes, __ATOMIC_RELAXED),
+	    __atomic_load_n(&realm->remoteFrees, __ATOMIC_RELAXED));
+      for(int qq = 0; qq < UT_MAX_BUFFER_Q; qq++) {
+	uint64_t allocs = __atomic_load_n(&realm->allocs[qq], __ATOMIC_RELAXED);
+	if(allocs)
+	  myLog(LOG_INFO, "  size %u: allocs=%"PRIu64" osBufs=%u",
+		1 << qq,
+		allocs,
+		__atomic_load_n(&realm->osBufs[qq], __ATOMIC_RELAXED));
       }
     }
   }
@@ -395,7 +467,6 @@ extern "C" {
     return hash;
   }
 
-  #if 0
   // See "64-bit to 32-bit hash functions"
   // https://gist.github.com/badboy/6267743
   static uint32_t hash6432shift(uint64_t h) {
@@ -407,7 +478,6 @@ extern "C" {
     h ^= (h >> 22);
     return (uint32_t) h;
   }
-  #endif
 
   /*_________________---------------------------__________________
     _________________     safe string fns       __________________
@@ -491,6 +561,146 @@ extern "C" {
     return atEOF ? EOF : count;
   }
 
+  /*_________________---------------------------__________________
+    _________________       UTProcFile          __________________
+    -----------------___________________________------------------
+    Hold the fd open and regenerate the contents with pread() from
+    offset 0 each time,  instead of fopen()/stdio/fclose(). Reading
+    continues until pread() returns 0 because seq_file can hand back
+    less than we asked for before the end.
+  */
+
+#define UTPROCFILE_INITBUF 4096
+
+  UTProcFile *UTProcFileNew(const char *path, uint32_t maxLen) {
+    UTProcFile *pf = (UTProcFile *)my_calloc(sizeof(UTProcFile));
+    pf->path = my_strdup(path);
+    pf->fd = -1;
+    pf->maxLen = maxLen;
+    pf->bufLen = maxLen ?: UTPROCFILE_INITBUF;
+    pf->buf = (char *)my_calloc(pf->bufLen);
+    return pf;
+  }
+
+  void UTProcFileFree(UTProcFile *pf) {
+    if(pf->fd >= 0)
+      close(pf->fd);
+    my_free(pf->path);
+    my_free(pf->buf);
+    my_free(pf);
+  }
+
+  static bool procFileOpen(UTProcFile *pf) {
+    if(pf->fd < 0) {
+      pf->fd = open(pf->path, O_RDONLY | O_CLOEXEC);
+      if(pf->fd < 0) {
+	myDebug(1, "UTProcFile: cannot open %s : %s", pf->path, strerror(errno));
+	return NO;
+      }
+    }
+    return YES;
+  }
+
+  char *UTProcFileRead(UTProcFile *pf) {
+    if(!procFileOpen(pf))
+      return NULL;
+    uint32_t len = 0;
+    for(;;) {
+      if(len == (pf->bufLen - 1)) {
+	// full
+	if(pf->maxLen)
+	  break;
+	pf->bufLen *= 2;
+	pf->buf = (char *)my_realloc(pf->buf, pf->bufLen);
+      }
+      ssize_t n = pread(pf->fd, pf->buf + len, pf->bufLen - 1 - len, len);
+      if(n < 0) {
+	if(errno == EINTR)
+	  continue;
+	myDebug(1, "UTProcFile: cannot read %s : %s", pf->path, strerror(errno));
+	// try a fresh open next time
+	close(pf->fd);
+	pf->fd = -1;
+	return NULL;
+      }
+      if(n == 0)
+	break;
+      len += n;
+    }
+    pf->buf[len] = '\0';
+    pf->len = len;
+    return pf->buf;
+  }
+
+  // For files that raise POLLPRI when their contents change (/proc/mounts,
+  // /proc/swaps). Answers YES the first time,  and then only after a change.
+  bool UTProcFileChanged(UTProcFile *pf) {
+    if(pf->fd < 0)
+      return procFileOpen(pf);
+    struct pollfd pfd = { .fd = pf->fd, .events = POLLPRI };
+    return (poll(&pfd, 1, 0) > 0
+	    && (pfd.revents & (POLLPRI | POLLERR)));
+  }
+
+  char *UTProcNextLine(char **pp) {
+    char *line = *pp;
+    if(line == NULL
+       || *line == '\0')
+      return NULL;
+    char *eol = strchr(line, '\n');
+    if(eol) {
+      *eol = '\0';
+      *pp = eol + 1;
+    }
+    else
+      *pp = line + strlen(line);
+    return line;
+  }
+
+  static inline bool procBlank(char ch) {
+    return (ch == ' ' || ch == '\t');
+  }
+
+  char *UTProcNextTok(char **pp) {
+    char *p = *pp;
+    while(procBlank(*p))
+      p++;
+    if(*p == '\0') {
+      *pp = p;
+      return NULL;
+    }
+    char *tok = p;
+    while(*p && !procBlank(*p))
+      p++;
+    if(*p)
+      *p++ = '\0';
+    *pp = p;
+    return tok;
+  }
+
+  // Parse up to n decimal integers,  stopping at the first token that does
+  // not start with one. Negative numbers (e.g. Tcp MaxConn -1) wrap, the
+  // same as the (uint32_t)strtol() they replace.
+  int UTProcNextU64s(char **pp, uint64_t *vals, int n) {
+    char *p = *pp;
+    int ii = 0;
+    for(; ii < n; ii++) {
+      while(procBlank(*p))
+	p++;
+      bool neg = (*p == '-');
+      char *q = neg ? p + 1 : p;
+      if(*q < '0' || *q > '9')
+	break;
+      uint64_t val = 0;
+      while(*q >= '0' && *q <= '9')
+	val = (val * 10) + (*q++ - '0');
+      vals[ii] = neg ? (uint64_t)(-(int64_t)val) : val;
+      p = q;
+    }
+    *pp = p;
+    return ii;
+  }
+
   /*_________________---------------------------__________________
     _________________     setStr                __________________
     -----------------___________________________------------------
@@ -899,6 +1109,76 @@ extern "C" {
 	    : NULL);
   }
 
+  /*_________________---------------------------__________________
+    _________________  bounded MPSC queue       __________________
+    -----------------___________________________------------------
+    Lock-free ring for many producer threads and one consumer.
+    Each slot carries a sequence number that tells a producer when
+    the slot is free for lap N and tells the consumer when the
+    object written in lap N is ready.  Producers only contend on
+    the CAS of the head index.  The consumer owns the tail.
+  */
+
+  UTMPSC *UTMPSCNew(uint32_t cap) {
+    UTMPSC *q = (UTMPSC *)my_calloc(sizeof(UTMPSC));
+    // round up to power of 2 so we can mask
+    q->cap = 2;
+    while(q->cap < cap) q->cap <<= 1;
+    q->slots = (UTMPSCSlot *)my_calloc(q->cap * sizeof(UTMPSCSlot));
+    for(uint32_t ii = 0; ii < q->cap; ii++)
+      q->slots[ii].seq = ii;
+    return q;
+  }
+
+  void UTMPSCFree(UTMPSC *q) {
+    my_free(q->slots);
+    my_free(q);
+  }
+
+  bool UTMPSCPush(UTMPSC *q, void *obj) {
+    uint64_t pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    for(;;) {
+      UTMPSCSlot *slot = &q->slots[pos & (q->cap - 1)];
+      uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      int64_t diff = (int64_t)seq - (int64_t)pos;
+      if(diff == 0) {
+	// slot is free for this lap - try to claim it
+	if(__atomic_compare_exchange_n(&q->head, &pos, pos + 1, YES, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+	  slot->obj = obj;
+	  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	  return YES;
+	}
+	// CAS failure reloaded pos
+      }
+      else if(diff < 0) {
+	// consumer has not freed this slot yet - full
+	return NO;
+      }
+      else
+	pos = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  void *UTMPSCPop(UTMPSC *q) {
+    uint64_t pos = q->tail;
+    UTMPSCSlot *slot = &q->slots[pos & (q->cap - 1)];
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if((int64_t)seq - (int64_t)(pos + 1) < 0)
+      return NULL; // empty, or producer has not finished writing
+    void *obj = slot->obj;
+    slot->obj = NULL;
+    q->tail = pos + 1;
+    // hand the slot back to producers for the next lap
+    __atomic_store_n(&slot->seq, pos + q->cap, __ATOMIC_RELEASE);
+    return obj;
+  }
+
+  uint32_t UTMPSCDepth(UTMPSC *q) {
+    uint64_t head = __atomic_load_n(&q->head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&q->tail, __ATOMIC_RELAXED);
+    return (head > tail) ? (uint32_t)(head - tail) : 0;
+  }
+
   /*________________---------------------------__________________
     ________________       lookupAddress       __________________
     ----------------___________________________------------------
@@ -1618,48 +1898,91 @@ extern "C" {
     a null-terminated string.  Added this for looking up the
     same SFLAdaptor objects by name, ifIndex, peerIfIndex  and MAC,
     but it's used in other places too.
-    Uses linear probing:
-    http://www.cs.rmit.edu.au/online/blackboard/chapter/05/documents/contribute/chapter/05/linear-probing.html
-    entries can be deleted during a walk.
+    Uses linear probing, with a parallel array of one-byte
+    fingerprints (top bits of the hash) that is scanned a group
+    of bins at a time,  so a probe only compares keys when the
+    fingerprint and stored hash both match.  Deletion shifts the
+    rest of the chain back instead of leaving a tombstone:
+    https://en.wikipedia.org/wiki/Linear_probing#Deletion
+    The current entry can be deleted during a walk.
   */
 
-#define UTHASH_INIT 8 // must be power of 2
+#define UTHASH_GROUP 16 // fingerprints compared at once
+#define UTHASH_INIT 16 // must be power of 2, and at least UTHASH_GROUP
+#define UTHASH_FP(h) (uint8_t)(0x80 | ((h) >> 25))
+  // oh->cap is always a power of 2, so we can just mask the bits
+#define UTHASH_WRAP(oh, pr) ((pr) & ((oh)->cap - 1))
+
+  static inline void hashReadLock(UTHash *oh) {
+    if(oh->sync && pthread_rwlock_rdlock(oh->sync) != 0) {
+      myLog(LOG_ERR, "failed to lock UTHash for read!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  static inline void hashWriteLock(UTHash *oh) {
+    if(oh->sync && pthread_rwlock_wrlock(oh->sync) != 0) {
+      myLog(LOG_ERR, "failed to lock UTHash for write!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  static inline void hashUnlock(UTHash *oh) {
+    if(oh->sync && pthread_rwlock_unlock(oh->sync) != 0) {
+      myLog(LOG_ERR, "failed to unlock UTHash!");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // bitmask of the bins in the group starting at ctrl that hold fp
+  static inline uint32_t hashMatch(uint8_t *ctrl, uint8_t fp) {
+#ifdef __SSE2__
+    __m128i grp = _mm_loadu_si128((__m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(grp, _mm_set1_epi8((char)fp)));
+#else
+    uint32_t bits = 0;
+    for(uint32_t ii = 0; ii < UTHASH_GROUP; ii++)
+      if(ctrl[ii] == fp)
+	bits |= (1 << ii);
+    return bits;
+#endif
+  }
 
-#define UTHASH_BYTES(oh) ((oh)->cap * sizeof(void *))
+  static void hashAlloc(UTHash *oh, uint32_t cap) {
+    // one block: bins, hashes, then the fingerprints with the first
+    // group mirrored at the end so a group never has to wrap
+    oh->cap = cap;
+    char *blk = my_calloc((cap * (sizeof(void *) + sizeof(uint32_t))) + cap + UTHASH_GROUP);
+    oh->bins = (void **)blk;
+    oh->hashes = (uint32_t *)(blk + (cap * sizeof(void *)));
+    oh->ctrl = (uint8_t *)(oh->hashes + cap);
+  }
+
+  static void hashSetBin(UTHash *oh, uint32_t idx, void *obj, uint32_t hash, uint8_t fp) {
+    oh->bins[idx] = obj;
+    oh->hashes[idx] = hash;
+    oh->ctrl[idx] = fp;
+    if(idx < UTHASH_GROUP)
+      oh->ctrl[oh->cap + idx] = fp;
+  }
 
   UTHash *UTHashNew(uint32_t f_offset, uint32_t f_len, uint32_t options) {
     UTHash *oh = (UTHash *)my_calloc(sizeof(UTHash));
     oh->options = options;
     if(options & UTHASH_SYNC) {
-      oh->sync = (pthread_mutex_t *)my_calloc(sizeof(pthread_mutex_t));
-      pthread_mutex_init(oh->sync, NULL);
+      oh->sync = (pthread_rwlock_t *)my_calloc(sizeof(pthread_rwlock_t));
+      pthread_rwlock_init(oh->sync, NULL);
     }
-    oh->cap = UTHASH_INIT;
-    oh->bins = my_calloc(UTHASH_BYTES(oh));
+    hashAlloc(oh, UTHASH_INIT);
     oh->f_offset = (options & (UTHASH_IDTY)) ? 0 : f_offset;
     oh->f_len = (options & (UTHASH_SKEY|UTHASH_IDTY)) ? 0 : f_len;
     return oh;
   }
 
-  static void *hashAdd(UTHash *oh, void *obj);
-
-  static void hashRebuild(UTHash *oh, bool bigger) {
-    uint32_t old_cap = oh->cap;
-    void **old_bins = oh->bins;
-    if(bigger) oh->cap *= 2;
-    oh->bins = my_calloc(UTHASH_BYTES(oh));
-    oh->entries = 0;
-    oh->dbins = 0;
-    for(uint32_t ii = 0; ii < old_cap; ii++)
-      if(old_bins[ii] && old_bins[ii] != UTHASH_DBIN)
-	hashAdd(oh, old_bins[ii]);
-    my_free(old_bins);
-  }
-
   static uint32_t hashHash(UTHash *oh, void *obj) {
     char *f = (char *)obj + oh->f_offset;
     if(oh->f_len) return hash_fnv1a(f, oh->f_len);
-    else if(oh->options & UTHASH_IDTY) return (uint32_t)((uint64_t)obj);
+    else if(oh->options & UTHASH_IDTY) return hash6432shift((uint64_t)obj);
     return my_strhash(*(char **)f);
   }
 
@@ -1673,92 +1996,132 @@ extern "C" {
 	 : my_strequal(*(char **)f1, *(char **)f2));
   }
 
-  // oh->cap is always a power of 2, so we can just mask the bits
-#define UTHASH_WRAP(oh, pr) ((pr) & ((oh)->cap - 1))
-
-static uint32_t hashSearch(UTHash *oh, void *obj, void **found) {
-    uint32_t probe = hashHash(oh, obj);
-    int32_t dbin = -1;
-    probe = UTHASH_WRAP(oh, probe);
-    for( ; oh->bins[probe]; probe=UTHASH_WRAP(oh,probe+1)) {
-      void *entry = oh->bins[probe];
-      if(entry == UTHASH_DBIN) {
-	// remember first dbin
-	if(dbin == -1)  dbin = probe;
-	else if(dbin == probe) break; // all the way around!
+  static uint32_t hashEmptyBin(UTHash *oh, uint32_t probe) {
+    // there is always an empty bin,  so this terminates
+    for(;; probe = UTHASH_WRAP(oh, probe + UTHASH_GROUP)) {
+      uint32_t empty = hashMatch(oh->ctrl + probe, 0);
+      if(empty)
+	return UTHASH_WRAP(oh, probe + __builtin_ctz(empty));
+    }
+  }
+
+  static uint32_t hashSearch(UTHash *oh, void *obj, uint32_t hash, void **found) {
+    uint8_t fp = UTHASH_FP(hash);
+    uint32_t probe = UTHASH_WRAP(oh, hash);
+    for(;; probe = UTHASH_WRAP(oh, probe + UTHASH_GROUP)) {
+      uint32_t empty = hashMatch(oh->ctrl + probe, 0);
+      uint32_t match = hashMatch(oh->ctrl + probe, fp);
+      // the chain ends at the first empty bin
+      if(empty)
+	match &= (empty & -empty) - 1;
+      for(; match; match &= (match - 1)) {
+	uint32_t idx = UTHASH_WRAP(oh, probe + __builtin_ctz(match));
+	if(oh->hashes[idx] == hash
+	   && hashEqual(oh, obj, oh->bins[idx])) {
+	  (*found) = oh->bins[idx];
+	  return idx;
+	}
       }
-      else if(hashEqual(oh, obj, entry)) {
-	(*found) = entry;
-	return probe;
+      if(empty) {
+	// not found - return the empty bin where it would go
+	(*found) = NULL;
+	return UTHASH_WRAP(oh, probe + __builtin_ctz(empty));
       }
     }
-    // not found - reuse the dbin if we encountered one
-    (*found) = NULL;
-    return (dbin == -1) ? probe : dbin;
   }
 
-  static void *hashAdd(UTHash *oh, void *obj) {
+  static void hashRebuild(UTHash *oh) {
+    UTHash old = *oh;
+    hashAlloc(oh, old.cap * 2);
+    for(uint32_t ii = 0; ii < old.cap; ii++) {
+      if(old.ctrl[ii]) {
+	uint32_t idx = hashEmptyBin(oh, UTHASH_WRAP(oh, old.hashes[ii]));
+	hashSetBin(oh, idx, old.bins[ii], old.hashes[ii], old.ctrl[ii]);
+      }
+    }
+    my_free(old.bins);
+  }
+
+  static void *hashAdd(UTHash *oh, void *obj, uint32_t hash) {
     if(obj == NULL) return NULL;
-    // make sure there is room so the search cannot fail
-    if(oh->entries >= (oh->cap >> 1))
-      hashRebuild(oh, YES);
+    // keep the load under 3/4 so chains stay short
+    if(oh->entries >= ((oh->cap >> 2) * 3))
+      hashRebuild(oh);
     // search for obj or empty slot
     void *found = NULL;
-    uint32_t idx = hashSearch(oh, obj, &found);
+    uint32_t idx = hashSearch(oh, obj, hash, &found);
     // put it here
-    oh->bins[idx] = obj;
+    hashSetBin(oh, idx, obj, hash, UTHASH_FP(hash));
     if(!found) oh->entries++;
     // return what was there before
     return found;
   }
 
+  static void hashErase(UTHash *oh, uint32_t idx) {
+    // pull back any later entry in the chain that could live here.
+    // Entries only ever move towards lower bins,  which is why
+    // UTHASH_WALK (walking downwards) may delete its current entry
+    // but not any other.
+    for(uint32_t nxt = UTHASH_WRAP(oh, idx + 1); oh->ctrl[nxt]; nxt = UTHASH_WRAP(oh, nxt + 1)) {
+      uint32_t home = UTHASH_WRAP(oh, oh->hashes[nxt]);
+      if(UTHASH_WRAP(oh, nxt - home) >= UTHASH_WRAP(oh, nxt - idx)) {
+	hashSetBin(oh, idx, oh->bins[nxt], oh->hashes[nxt], oh->ctrl[nxt]);
+	idx = nxt;
+      }
+    }
+    hashSetBin(oh, idx, NULL, 0, 0);
+    oh->entries--;
+  }
+
   void *UTHashAdd(UTHash *oh, void *obj) {
+    if(obj == NULL) return NULL;
+    uint32_t hash = hashHash(oh, obj);
     void *overwritten;
-    SEMLOCK_DO(oh->sync) {
-      overwritten = hashAdd(oh, obj);
-    }
+    hashWriteLock(oh);
+    overwritten = hashAdd(oh, obj, hash);
+    hashUnlock(oh);
     return overwritten;
   }
 
   void *UTHashGet(UTHash *oh, void *obj) {
     if(obj == NULL) return NULL;
+    uint32_t hash = hashHash(oh, obj);
     void *found = NULL;
-    SEMLOCK_DO(oh->sync) {
-      hashSearch(oh, obj, &found);
-    }
+    hashReadLock(oh);
+    hashSearch(oh, obj, hash, &found);
+    hashUnlock(oh);
     return found;
   }
 
   void *UTHashGetOrAdd(UTHash *oh, void *obj) {
     if(obj == NULL) return NULL;
+    uint32_t hash = hashHash(oh, obj);
     void *found = NULL;
-    SEMLOCK_DO(oh->sync) {
-      hashSearch(oh, obj, &found);
-      if(!found)
-	hashAdd(oh, obj);
-    }
+    hashWriteLock(oh);
+    hashSearch(oh, obj, hash, &found);
+    if(!found)
+      hashAdd(oh, obj, hash);
+    hashUnlock(oh);
     return found;
   }
 
   static void *hashDelete(UTHash *oh, void *obj, bool identity) {
     if(obj == NULL) return NULL;
+    uint32_t hash = hashHash(oh, obj);
     void *found = NULL;
-    SEMLOCK_DO(oh->sync) {
-      int idx = hashSearch(oh, obj, &found);
-      if (found
-	  && (found == obj
-	      || identity == NO)) {
-	oh->bins[idx] = UTHASH_DBIN;
-	oh->entries--;
-	if(++oh->dbins >= (oh->cap >> 1))
-	  hashRebuild(oh, NO);
-      }
-    }
+    hashWriteLock(oh);
+    uint32_t idx = hashSearch(oh, obj, hash, &found);
+    if (found
+	&& (found == obj
+	    || identity == NO))
+      hashErase(oh, idx);
+    hashUnlock(oh);
     return found;
   }
 
   void *UTHashDel(UTHash *oh, void *obj) {
-    // delete this particular object
+    // delete this particular object.  Inside UTHASH_WALK only the
+    // current entry may be deleted.
     return hashDelete(oh, obj, YES);
   }
 
@@ -1768,19 +2131,27 @@ static uint32_t hashSearch(UTHash *oh, void *obj, void **found) {
   }
 
   void UTHashReset(UTHash *oh) {
-    memset(oh->bins, 0, UTHASH_BYTES(oh));
+    memset(oh->bins, 0, (oh->cap * (sizeof(void *) + sizeof(uint32_t))) + oh->cap + UTHASH_GROUP);
     oh->entries = 0;
-    oh->dbins = 0;
    }
 
   uint32_t UTHashN(UTHash *oh) {
     return oh->entries;
   }
 
+  uint32_t UTHashWalkStart(UTHash *oh) {
+    // UTHASH_WALK goes backwards from here. Deleting the current
+    // entry can only pull back entries that were already visited.
+    return hashEmptyBin(oh, 0);
+  }
+
   void UTHashFree(UTHash *oh) {
     if(oh == NULL) return;
     my_free(oh->bins);
-    if(oh->sync) my_free(oh->sync);
+    if(oh->sync) {
+      pthread_rwlock_destroy(oh->sync);
+      my_free(oh->sync);
+    }
     my_free(oh);
   }
 
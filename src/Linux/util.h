@@ -22,6 +22,7 @@ extern "C" {
 #include <syslog.h>
 #include <assert.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #define __STDC_FORMAT_MACROS
@@ -94,6 +95,14 @@ extern "C" {
   void *UTHeapQReAlloc(void *buf, size_t newSiz);
   void UTHeapQFree(void *buf);
   void UTHeapGC(void);
+  typedef struct _UTHeapStats {
+    uint32_t realms;
+    uint64_t bytes;       // obtained from the OS
+    uint64_t allocs;
+    uint64_t remoteFrees; // freed by a thread other than the allocator
+  } UTHeapStats;
+  void UTHeapGetStats(UTHeapStats *stats);
+  void UTHeapLogStats(void);
 
 #define my_calloc UTHeapQNew
 #define my_realloc UTHeapQReAlloc
@@ -114,6 +123,25 @@ extern "C" {
   uint32_t my_binhash(const char *bytes, const uint32_t len);
   int my_readline(FILE *ff, char *buf, uint32_t len, int *p_truncated);
 
+  // /proc text files read with pread() on an fd that stays open.
+  // The buffer grows to fit unless maxLen limits us to a prefix.
+  typedef struct _UTProcFile {
+    char *path;
+    int fd;
+    char *buf;
+    uint32_t bufLen;
+    uint32_t len;
+    uint32_t maxLen;
+  } UTProcFile;
+  UTProcFile *UTProcFileNew(const char *path, uint32_t maxLen);
+  void UTProcFileFree(UTProcFile *pf);
+  char *UTProcFileRead(UTProcFile *pf);
+  bool UTProcFileChanged(UTProcFile *pf);
+  // tokenizers for the buffer returned by UTProcFileRead() (modify in place)
+  char *UTProcNextLine(char **pp);
+  char *UTProcNextTok(char **pp);
+  int UTProcNextU64s(char **pp, uint64_t *vals, int n);
+
   // mutual-exclusion semaphores
   static inline int lockOrDie(pthread_mutex_t *sem) {
     if(sem && pthread_mutex_lock(sem) != 0) {
@@ -214,6 +242,26 @@ extern "C" {
   uint32_t UTArraySnapshot(UTArray *ar, uint32_t buf_n, void *buf);
 #define UTARRAY_WALK(ar, obj) for(uint32_t _ii=0; _ii<UTArrayN(ar); _ii++) if(((obj)=(typeof(obj))UTArrayAt((ar), _ii)))
 
+  // bounded lock-free queue: many producer threads, one consumer
+  typedef struct _UTMPSCSlot {
+    uint64_t seq;
+    void *obj;
+  } UTMPSCSlot;
+
+  typedef struct _UTMPSC {
+    uint32_t cap;
+    UTMPSCSlot *slots;
+    // keep producer and consumer indices on separate cache lines
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t tail __attribute__((aligned(64)));
+  } UTMPSC;
+
+  UTMPSC *UTMPSCNew(uint32_t cap);
+  void UTMPSCFree(UTMPSC *q);
+  bool UTMPSCPush(UTMPSC *q, void *obj);
+  void *UTMPSCPop(UTMPSC *q);
+  uint32_t UTMPSCDepth(UTMPSC *q);
+
   // tokenizer
   char *parseNextTok(char **str, char *sep, int delim, char quot, int trim, char *buf, int buflen);
 
@@ -269,12 +317,13 @@ extern "C" {
   // UTHash
   typedef struct _UTHash {
     void **bins;
-    pthread_mutex_t *sync;
+    uint32_t *hashes; // full hash of each entry, for probing and rebuilds
+    uint8_t *ctrl;    // per-bin fingerprint, 0 == empty
+    pthread_rwlock_t *sync;
     uint32_t f_offset;
     uint32_t f_len;
     uint32_t cap;
     uint32_t entries;
-    uint32_t dbins;
     uint32_t options;
   } UTHash;
 
@@ -292,10 +341,14 @@ extern "C" {
   void *UTHashDelKey(UTHash *oh, void *obj);
   void UTHashReset(UTHash *oh);
    uint32_t UTHashN(UTHash *oh);
-
-#define UTHASH_DBIN (void *)-1
-
-#define UTHASH_WALK(oh, obj) for(uint32_t _ii=0; _ii<oh->cap; _ii++) if(((obj)=(typeof(obj))oh->bins[_ii]) && (obj) != UTHASH_DBIN)
+  uint32_t UTHashWalkStart(UTHash *oh);
+
+  // Walk backwards from an empty bin so the current entry can be deleted.
+  // Deleting it only pulls later entries back towards bins already
+  // visited,  so nothing is skipped or repeated.  Deleting any other
+  // entry,  or adding (which may grow the table),  during the walk can
+  // skip or repeat entries - collect them and do it after the walk.
+#define UTHASH_WALK(oh, obj) for(uint32_t _ii=UTHashWalkStart(oh), _nn=(oh)->cap; _nn; _nn--, _ii=((_ii-1) & ((oh)->cap-1))) if(((obj)=(typeof(obj))(oh)->bins[_ii]))
 
   regex_t *UTRegexCompile(char *pattern_str);
   int UTRegexExtractInt(regex_t *rx, char *str, int nvals, int *val1, int *val2, int *val3);
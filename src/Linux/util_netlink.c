@@ -92,6 +92,85 @@ extern "C" {
     }
   }
 
+  /*_________________---------------------------__________________
+    _________________     UTNLRecvBatch         __________________
+    -----------------___________________________------------------
+    Read netlink datagrams with recvmmsg(2) into a preallocated
+    vector of buffers, draining the socket until EAGAIN (or until
+    maxMsgs datagrams have been read, so that one busy socket cannot
+    starve the rest of the bus). ENOBUFS means the kernel overran our
+    receive buffer and dropped messages, so count it and keep going.
+  */
+
+  UTNLRecvBatch *UTNLRecvBatch_new(uint32_t n_bufs, uint32_t buf_len) {
+    UTNLRecvBatch *batch = (UTNLRecvBatch *)my_calloc(sizeof(UTNLRecvBatch));
+    batch->n_bufs = n_bufs;
+    batch->buf_len = buf_len;
+    batch->bufs = (uint8_t *)my_calloc(n_bufs * buf_len);
+    batch->iovs = (struct iovec *)my_calloc(n_bufs * sizeof(struct iovec));
+    batch->addrs = (struct sockaddr_nl *)my_calloc(n_bufs * sizeof(struct sockaddr_nl));
+    batch->msgs = (struct mmsghdr *)my_calloc(n_bufs * sizeof(struct mmsghdr));
+    for(uint32_t ii = 0; ii < n_bufs; ii++) {
+      batch->iovs[ii].iov_base = batch->bufs + (ii * buf_len);
+      batch->iovs[ii].iov_len = buf_len;
+      batch->msgs[ii].msg_hdr.msg_iov = &batch->iovs[ii];
+      batch->msgs[ii].msg_hdr.msg_iovlen = 1;
+      batch->msgs[ii].msg_hdr.msg_name = &batch->addrs[ii];
+      batch->msgs[ii].msg_hdr.msg_namelen = sizeof(struct sockaddr_nl);
+    }
+    return batch;
+  }
+
+  void UTNLRecvBatch_free(UTNLRecvBatch *batch) {
+    my_free(batch->bufs);
+    my_free(batch->iovs);
+    my_free(batch->addrs);
+    my_free(batch->msgs);
+    my_free(batch);
+  }
+
+  int UTNLRecvBatch_read(UTNLRecvBatch *batch, int sockFd, uint32_t maxMsgs, void *magic, UTNLRecvCB recvCB)
+  {
+    uint32_t total = 0;
+    batch->overruns = 0;
+    while(total < maxMsgs) {
+      uint32_t vlen = maxMsgs - total;
+      if(vlen > batch->n_bufs)
+	vlen = batch->n_bufs;
+      int nmsgs = recvmmsg(sockFd, batch->msgs, vlen, MSG_DONTWAIT, NULL);
+      if(nmsgs < 0) {
+	if(errno == EINTR)
+	  continue;
+	if(errno == ENOBUFS) {
+	  batch->overruns++;
+	  continue;
+	}
+	if(errno != EAGAIN
+	   && errno != EWOULDBLOCK)
+	  myDebug(1, "UTNLRecvBatch_read: recvmmsg() failed: %s", strerror(errno));
+	break;
+      }
+      for(int ii = 0; ii < nmsgs; ii++) {
+	struct msghdr *hdr = &batch->msgs[ii].msg_hdr;
+	int numbytes = batch->msgs[ii].msg_len;
+	if(hdr->msg_flags & MSG_TRUNC)
+	  myDebug(1, "UTNLRecvBatch_read: datagram truncated to %u bytes", numbytes);
+	// only accept datagrams from the kernel
+	if(batch->addrs[ii].nl_pid == 0
+	   && numbytes > 0)
+	  (*recvCB)(magic, (uint8_t *)batch->iovs[ii].iov_base, numbytes);
+	// reset for next time
+	hdr->msg_namelen = sizeof(struct sockaddr_nl);
+	hdr->msg_flags = 0;
+      }
+      total += nmsgs;
+      // a short read means the socket is now empty
+      if((uint32_t)nmsgs < vlen)
+	break;
+    }
+    return total;
+  }
+
   /*_________________---------------------------__________________
     _________________       fcntl utils         __________________
     -----------------___________________________------------------
@@ -165,6 +244,24 @@ extern "C" {
     return nl_sock;
   }
 
+  /*_________________---------------------------__________________
+    _________________  UTNLGeneric_openRequest  __________________
+    -----------------___________________________------------------
+    For synchronous request/response use. The kernel assigns the
+    port id when the first request is sent.
+  */
+
+  int UTNLGeneric_openRequest(void) {
+    int nl_sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_GENERIC);
+    if(nl_sock < 0) {
+      myLog(LOG_ERR, "UTNLGeneric_openRequest: socket failed: %s", strerror(errno));
+      return -1;
+    }
+    setNonBlocking(nl_sock);
+    setCloseOnExec(nl_sock);
+    return nl_sock;
+  }
+
   /*_________________---------------------------__________________
     _________________      UTNLGeneric_send     __________________
     -----------------___________________________------------------
@@ -200,6 +297,192 @@ extern "C" {
     return sendmsg(sockfd, &msg, 0);
   }
 
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_dump       __________________
+    -----------------___________________________------------------
+    attrs is the pre-encoded attribute list (may be empty). Replies
+    are collected with UTNLRoute_recv(),  which is not specific to
+    NETLINK_ROUTE.
+  */
+
+  int UTNLGeneric_dump(int sockfd, int type, int cmd, int version, void *attrs, int attrs_len, uint32_t seqNo) {
+    struct nlmsghdr nlh = { };
+    struct genlmsghdr ge = { };
+
+    ge.cmd = cmd;
+    ge.version = version;
+
+    nlh.nlmsg_len = NLMSG_LENGTH(sizeof(ge) + attrs_len);
+    nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    nlh.nlmsg_type = type;
+    nlh.nlmsg_seq = seqNo;
+
+    struct iovec iov[3] = {
+      { .iov_base = &nlh,  .iov_len = sizeof(nlh) },
+      { .iov_base = &ge,   .iov_len = sizeof(ge) },
+      { .iov_base = attrs, .iov_len = attrs_len }
+    };
+
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+    struct msghdr msg = { .msg_name = &sa, .msg_namelen = sizeof(sa), .msg_iov = iov, .msg_iovlen = 3 };
+    return sendmsg(sockfd, &msg, 0);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLGeneric_family     __________________
+    -----------------___________________________------------------
+    Synchronous CTRL_CMD_GETFAMILY. Returns the family id, or -errno
+    (-ENOENT if the family is not registered in this kernel).
+  */
+
+  static void familyCB(void *magic, struct nlmsghdr *nlh) {
+    int *p_id = (int *)magic;
+    struct genlmsghdr *genl = (struct genlmsghdr *)NLMSG_DATA(nlh);
+    int len = nlh->nlmsg_len - NLMSG_LENGTH(sizeof(*genl));
+    for(struct nlattr *attr = (struct nlattr *)((char *)genl + GENL_HDRLEN);
+	UTNLA_OK(attr, len);
+	attr = UTNLA_NEXT(attr, len)) {
+      if(attr->nla_type == CTRL_ATTR_FAMILY_ID
+	 && UTNLA_PAYLOAD(attr) >= sizeof(uint16_t))
+	(*p_id) = *(uint16_t *)UTNLA_DATA(attr);
+    }
+  }
+
+  int UTNLGeneric_family(int sockfd, char *family_name, uint32_t seqNo, int timeout_mS) {
+    if(UTNLGeneric_send(sockfd,
+			0,
+			GENL_ID_CTRL,
+			CTRL_CMD_GETFAMILY,
+			CTRL_ATTR_FAMILY_NAME,
+			family_name,
+			my_strlen(family_name)+1,
+			seqNo) < 0)
+      return -errno;
+    int id = -ENOENT;
+    int err = UTNLRoute_recv(sockfd, seqNo, timeout_mS, &id, familyCB);
+    return err ? err : id;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLRoute_open         __________________
+    -----------------___________________________------------------
+    groups == 0 for a request/response socket
+  */
+
+  int UTNLRoute_open(uint32_t groups) {
+    int nl_sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+    if(nl_sock < 0) {
+      myLog(LOG_ERR, "UTNLRoute_open: socket failed: %s", strerror(errno));
+      return -1;
+    }
+    if(groups) {
+      struct sockaddr_nl sa = { .nl_family = AF_NETLINK,
+				.nl_groups = groups };
+      if(bind(nl_sock, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+	myLog(LOG_ERR, "UTNLRoute_open: bind failed: %s", strerror(errno));
+	close(nl_sock);
+	return -1;
+      }
+    }
+    setNonBlocking(nl_sock);
+    setCloseOnExec(nl_sock);
+    return nl_sock;
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLRoute_send         __________________
+    -----------------___________________________------------------
+    req is the family header (e.g. struct ifinfomsg) plus any attributes.
+  */
+
+  int UTNLRoute_send(int sockfd, int type, void *req, int req_len, bool dump, uint32_t seqNo) {
+    struct nlmsghdr nlh = { };
+    nlh.nlmsg_len = NLMSG_LENGTH(req_len);
+    nlh.nlmsg_flags = NLM_F_REQUEST;
+    if(dump)
+      nlh.nlmsg_flags |= NLM_F_DUMP;
+    nlh.nlmsg_type = type;
+    nlh.nlmsg_seq = seqNo;
+
+    struct iovec iov[2] = {
+      { .iov_base = &nlh, .iov_len = sizeof(nlh) },
+      { .iov_base = req,  .iov_len = req_len }
+    };
+
+    struct sockaddr_nl sa = { .nl_family = AF_NETLINK };
+    struct msghdr msg = { .msg_name = &sa, .msg_namelen = sizeof(sa), .msg_iov = iov, .msg_iovlen = 2 };
+    return sendmsg(sockfd, &msg, 0);
+  }
+
+  /*_________________---------------------------__________________
+    _________________    UTNLRoute_recv         __________________
+    -----------------___________________________------------------
+    Wait for the reply to request seqNo,  which may be a multipart
+    dump.  Returns 0 when complete, or -errno (-ETIMEDOUT if no reply
+    came within timeout_mS).  Anything left over from an earlier
+    request that timed out is skipped.
+  */
+
+  int UTNLRoute_recv(int sockfd, uint32_t seqNo, int timeout_mS, void *magic, UTNLRouteCB routeCB) {
+    int bufLen = UTNL_ROUTE_RCV_BUF;
+    char *buf = (char *)my_calloc(bufLen);
+    int result = -ETIMEDOUT;
+    bool done = NO;
+    while(!done) {
+      struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+      int nfds = poll(&pfd, 1, timeout_mS);
+      if(nfds < 0 && errno == EINTR)
+	continue;
+      if(nfds <= 0)
+	break;
+      // peek at the real size first so a big dump chunk is never cut short
+      int len = recv(sockfd, buf, bufLen, MSG_DONTWAIT | MSG_PEEK | MSG_TRUNC);
+      if(len > bufLen) {
+	bufLen = len;
+	buf = (char *)my_realloc(buf, bufLen);
+      }
+      if(len >= 0)
+	len = recv(sockfd, buf, bufLen, MSG_DONTWAIT | MSG_TRUNC);
+      if(len < 0) {
+	if(errno == EINTR
+	   || errno == EAGAIN
+	   || errno == EWOULDBLOCK)
+	  continue;
+	result = -errno;
+	break;
+      }
+      if(len > bufLen) {
+	// truncated anyway - the rest of the dump can't be trusted
+	result = -EMSGSIZE;
+	break;
+      }
+      for(struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+	  NLMSG_OK(nlh, len);
+	  nlh = NLMSG_NEXT(nlh, len)) {
+	if(nlh->nlmsg_seq != seqNo)
+	  continue;
+	if(nlh->nlmsg_type == NLMSG_DONE) {
+	  result = 0;
+	  done = YES;
+	  break;
+	}
+	if(nlh->nlmsg_type == NLMSG_ERROR) {
+	  struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(nlh);
+	  result = err->error; // 0 for ACK
+	  done = YES;
+	  break;
+	}
+	(*routeCB)(magic, nlh);
+	if(!(nlh->nlmsg_flags & NLM_F_MULTI)) {
+	  // single reply
+	  result = 0;
+	  done = YES;
+	}
+      }
+    }
+    my_free(buf);
+    return result;
+  }
 
 #if defined(__cplusplus)
 } /* extern "C" */
@@ -13,6 +13,8 @@ extern "C" {
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #include <linux/genetlink.h>
+#include <linux/if_link.h>
+#include <poll.h>
 #include <net/if.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
@@ -53,10 +55,38 @@ extern "C" {
   void UTNLDiag_recv(void *magic, int sockFd, UTNLDiagCB diagCB);
 
   int UTNLGeneric_open(uint32_t mod_id);
+  int UTNLGeneric_openRequest(void);
 
   uint32_t UTNLGeneric_pid(uint32_t mod_id);
 
   int UTNLGeneric_send(int sockfd, uint32_t mod_id, int type, int cmd, int req_type, void *req, int req_len, uint32_t seqNo);
+  int UTNLGeneric_dump(int sockfd, int type, int cmd, int version, void *attrs, int attrs_len, uint32_t seqNo);
+  int UTNLGeneric_family(int sockfd, char *family_name, uint32_t seqNo, int timeout_mS);
+
+  // rtnetlink request/response (e.g. for link stats). Replies that belong to
+  // the request are passed to the callback one message at a time.
+  int UTNLRoute_open(uint32_t groups);
+  int UTNLRoute_send(int sockfd, int type, void *req, int req_len, bool dump, uint32_t seqNo);
+  typedef void (*UTNLRouteCB)(void *magic, struct nlmsghdr *nlh);
+  int UTNLRoute_recv(int sockfd, uint32_t seqNo, int timeout_mS, void *magic, UTNLRouteCB routeCB);
+#define UTNL_ROUTE_RCV_BUF 65536 // initial size - grown if a reply is bigger
+
+  // Batched receive: recvmmsg() into a preallocated vector of buffers.
+  // The callback is invoked once per datagram read from the kernel.
+  typedef struct _UTNLRecvBatch {
+    uint32_t n_bufs;
+    uint32_t buf_len;
+    uint8_t *bufs;
+    struct iovec *iovs;
+    struct sockaddr_nl *addrs;
+    struct mmsghdr *msgs;
+    uint32_t overruns; // ENOBUFS seen during last UTNLRecvBatch_read()
+  } UTNLRecvBatch;
+
+  typedef void (*UTNLRecvCB)(void *magic, uint8_t *buf, int len);
+  UTNLRecvBatch *UTNLRecvBatch_new(uint32_t n_bufs, uint32_t buf_len);
+  void UTNLRecvBatch_free(UTNLRecvBatch *batch);
+  int UTNLRecvBatch_read(UTNLRecvBatch *batch, int sockFd, uint32_t maxMsgs, void *magic, UTNLRecvCB recvCB);
 
   // linux/netlink.h defines struct nlattr but doesn't provide the walking macros NLA_OK, NLA_NEXT.
   // rtnetlink.h provides RTA_OK, RTA_NEXT macros.
@@ -12,6 +12,7 @@ static void * sflAlloc(SFLAgent *agent, size_t bytes);
 static void sflFree(SFLAgent *agent, void *obj);
 static void sfl_agent_jumpTableAdd(SFLAgent *agent, SFLSampler *sampler);
 static void sfl_agent_jumpTableRemove(SFLAgent *agent, SFLSampler *sampler);
+static void sfl_dsiIndexRelease(SFLAgent *agent, SFLDsiIndex *idx);
 
 /*________________--------------------------__________________
   ________________    sfl_agent_init        __________________
@@ -80,6 +81,7 @@ void sfl_agent_release(SFLAgent *agent)
     pl = nextPl;
   }
   agent->pollers = NULL;
+  memset(&agent->pollerWheel, 0, sizeof(agent->pollerWheel));
 
   /* release and free the notifiers */
   for( nf = agent->notifiers; nf != NULL; ) {
@@ -97,6 +99,15 @@ void sfl_agent_release(SFLAgent *agent)
   }
   agent->receivers = NULL;
 
+  /* release the lookup tables */
+  sfl_dsiIndexRelease(agent, &agent->samplerIndex);
+  sfl_dsiIndexRelease(agent, &agent->pollerIndex);
+  sfl_dsiIndexRelease(agent, &agent->notifierIndex);
+  if(agent->jumpTable) sflFree(agent, agent->jumpTable);
+  agent->jumpTable = NULL;
+  agent->jumpTableSize = 0;
+  agent->jumpTableEntries = 0;
+
 #ifdef SFLOW_DO_SOCKET
   /* close the sockets */
   if(agent->receiverSocket4 > 0) close(agent->receiverSocket4);
@@ -113,12 +124,11 @@ void sfl_agent_tick(SFLAgent *agent, time_t now)
 {
   SFLReceiver *rcv;
   SFLSampler *sm;
-  SFLPoller *pl;
   SFLNotifier *nf;
 
   agent->now = now;
   /* pollers use ticks to decide when to ask for counters */
-  for( pl = agent->pollers; pl != NULL; pl = pl->nxt) sfl_poller_tick(pl, now);
+  sfl_agent_tickPollers(agent, now);
   /* receivers use ticks to flush send data */
   for( rcv = agent->receivers; rcv != NULL; rcv = rcv->nxt) sfl_receiver_tick(rcv, now);
   /* samplers use ticks to decide when they are sampling too fast */
@@ -127,6 +137,150 @@ void sfl_agent_tick(SFLAgent *agent, time_t now)
   for( nf = agent->notifiers; nf != NULL; nf = nf->nxt) sfl_notifier_tick(nf, now);
 }
 
+/*_________________---------------------------__________________
+  _________________   poller timer wheel      __________________
+  -----------------___________________________------------------
+Each poller on the wheel is due at an absolute tick.  Level 0 holds
+the pollers due in the next SFL_WHEEL0_SLOTS ticks, level 1 holds
+those due in the next SFL_WHEEL1_SLOTS blocks of SFL_WHEEL0_SLOTS
+ticks, and the rest wait on the far list.  Pollers move down a level
+when the tick counter crosses into their block, so a tick only
+touches the pollers that are due (plus the occasional cascade).
+*/
+
+static void sfl_wheelLink(SFLPoller **pList, SFLPoller *poller)
+{
+  poller->wheel_nxt = *pList;
+  if(poller->wheel_nxt) poller->wheel_nxt->wheel_pprev = &poller->wheel_nxt;
+  poller->wheel_pprev = pList;
+  *pList = poller;
+}
+
+static void sfl_wheelInsert(SFLPollerWheel *wh, SFLPoller *poller)
+{
+  uint32_t due = poller->dueTick;
+  if((due - wh->tick) < SFL_WHEEL0_SLOTS) {
+    poller->wheelLevel = 0;
+    wh->load0[due & (SFL_WHEEL0_SLOTS - 1)]++;
+    sfl_wheelLink(&wh->slot0[due & (SFL_WHEEL0_SLOTS - 1)], poller);
+  }
+  else if(((due >> SFL_WHEEL0_BITS) - (wh->tick >> SFL_WHEEL0_BITS)) < SFL_WHEEL1_SLOTS) {
+    poller->wheelLevel = 1;
+    sfl_wheelLink(&wh->slot1[(due >> SFL_WHEEL0_BITS) & (SFL_WHEEL1_SLOTS - 1)], poller);
+  }
+  else {
+    poller->wheelLevel = 2;
+    sfl_wheelLink(&wh->far, poller);
+  }
+}
+
+static void sfl_wheelCascade(SFLPollerWheel *wh, SFLPoller **pList)
+{
+  SFLPoller *pl = *pList;
+  *pList = NULL;
+  while(pl) {
+    SFLPoller *nextPl = pl->wheel_nxt;
+    sfl_wheelInsert(wh, pl);
+    pl = nextPl;
+  }
+}
+
+void sfl_agent_schedulePoller(SFLAgent *agent, SFLPoller *poller, uint32_t countdown)
+{
+  sfl_agent_unschedulePoller(agent, poller);
+  poller->dueTick = agent->pollerWheel.tick + countdown;
+  sfl_wheelInsert(&agent->pollerWheel, poller);
+}
+
+void sfl_agent_unschedulePoller(SFLAgent *agent, SFLPoller *poller)
+{
+  if(poller->wheel_pprev == NULL) return; /* not scheduled */
+  *poller->wheel_pprev = poller->wheel_nxt;
+  if(poller->wheel_nxt) poller->wheel_nxt->wheel_pprev = poller->wheel_pprev;
+  poller->wheel_nxt = NULL;
+  poller->wheel_pprev = NULL;
+  if(poller->wheelLevel == 0)
+    agent->pollerWheel.load0[poller->dueTick & (SFL_WHEEL0_SLOTS - 1)]--;
+  /* park the remaining countdown */
+  poller->countersCountdown = poller->dueTick - agent->pollerWheel.tick;
+}
+
+/*_________________---------------------------__________________
+  _________________   poller staggering       __________________
+  -----------------___________________________------------------
+Start a new poller in the least busy of the next "interval" seconds
+(the earliest one if there is a tie), so that pollers added together
+are dealt out evenly instead of at random.  Only the level 0 slots
+are counted, so intervals longer than that are spread over the first
+SFL_WHEEL0_SLOTS-1 seconds.
+*/
+
+void sfl_agent_set_maxPollsPerTick(SFLAgent *agent, uint32_t maxPollsPerTick)
+{
+  agent->pollerWheel.maxPollsPerTick = maxPollsPerTick;
+}
+
+uint32_t sfl_agent_staggerCountdown(SFLAgent *agent, uint32_t interval)
+{
+  SFLPollerWheel *wh = &agent->pollerWheel;
+  uint32_t span = (interval < SFL_WHEEL0_SLOTS) ? interval : (SFL_WHEEL0_SLOTS - 1);
+  uint32_t best = 1, bestLoad = 0xFFFFFFFF, cd;
+  for(cd = 1; cd <= span; cd++) {
+    uint32_t load = wh->load0[(wh->tick + cd) & (SFL_WHEEL0_SLOTS - 1)];
+    if(load < bestLoad) {
+      best = cd;
+      bestLoad = load;
+      if(load == 0) break;
+    }
+  }
+  return best;
+}
+
+/*_________________---------------------------__________________
+  _________________   sfl_agent_tickPollers   __________________
+  -----------------___________________________------------------
+*/
+
+uint32_t sfl_agent_tickPollers(SFLAgent *agent, time_t now)
+{
+  SFLPollerWheel *wh = &agent->pollerWheel;
+  SFLPoller **pSlot;
+  SFLPoller *pl;
+  uint32_t slot, fired = 0;
+
+  wh->tick++;
+  if((wh->tick & (SFL_WHEEL0_SLOTS - 1)) == 0) {
+    /* crossed into a new level-0 block */
+    if(((wh->tick >> SFL_WHEEL0_BITS) & (SFL_WHEEL1_SLOTS - 1)) == 0)
+      sfl_wheelCascade(wh, &wh->far);
+    sfl_wheelCascade(wh, &wh->slot1[(wh->tick >> SFL_WHEEL0_BITS) & (SFL_WHEEL1_SLOTS - 1)]);
+  }
+  /* take the due pollers off one at a time, since the
+     callbacks are allowed to reschedule other pollers */
+  slot = wh->tick & (SFL_WHEEL0_SLOTS - 1);
+  pSlot = &wh->slot0[slot];
+  while((pl = *pSlot) != NULL) {
+    sfl_agent_unschedulePoller(agent, pl);
+    if(wh->maxPollsPerTick
+       && (fired + 1 + wh->load0[slot]) > wh->maxPollsPerTick
+       && !pl->pinned
+       && !pl->deferred
+       && pl->sFlowCpInterval > 1) {
+      /* Too many due this second, so move this one to the least busy
+	 second of its next interval.  It stays on the new phase, so this
+	 only happens once per poller per cycle.  Pollers that were aligned
+	 on purpose (bonds, switch-port batches) are never moved, and are
+	 the last to be counted against the limit. */
+      pl->deferred = 1;
+      sfl_agent_schedulePoller(agent, pl, sfl_agent_staggerCountdown(agent, (uint32_t)pl->sFlowCpInterval));
+      continue;
+    }
+    sfl_poller_fire(pl);
+    fired++;
+  }
+  return fired;
+}
+
 /*_________________---------------------------__________________
   _________________   sfl_agent_set_now       __________________
   -----------------___________________________------------------
@@ -204,6 +358,151 @@ static int sfl_dsi_compare(SFLDataSource_instance *pdsi1, SFLDataSource_instance
   return cmp;
 }
 
+/*_________________---------------------------__________________
+  _________________     data-source index     __________________
+  -----------------___________________________------------------
+  Hash table + skiplist over SFLDataSource_instance (see SFLDsiIndex
+  in sflow_api.h).  The skiplist uses sfl_dsi_compare() exactly as
+  the old linear scans did, so the nxt lists keep the same order.
+*/
+
+static uint32_t sfl_dsi_hash(SFLDataSource_instance *pdsi) {
+  uint32_t hash = pdsi->ds_index;
+  hash ^= pdsi->ds_class * 0x9E3779B1;
+  hash ^= pdsi->ds_instance * 0x85EBCA77;
+  hash ^= hash >> 15;
+  hash *= 0x2C1B3C6D;
+  hash ^= hash >> 12;
+  return hash;
+}
+
+static uint32_t sfl_dsiIndexRandomLevel(SFLDsiIndex *idx) {
+  // xorshift32 - each level has 1/4 the nodes of the one below
+  uint32_t rnd, levels = 1;
+  if(idx->seed == 0) idx->seed = 0x2545F491;
+  rnd = idx->seed;
+  rnd ^= rnd << 13;
+  rnd ^= rnd >> 17;
+  rnd ^= rnd << 5;
+  idx->seed = rnd;
+  while((rnd & 3) == 0 && levels < SFL_DSI_INDEX_LEVELS) {
+    levels++;
+    rnd >>= 2;
+  }
+  return levels;
+}
+
+static void sfl_dsiIndexGrow(SFLAgent *agent, SFLDsiIndex *idx) {
+  uint32_t newSize = idx->hashSize ? (idx->hashSize * 2) : SFL_DSI_INDEX_MINSIZ;
+  SFLDsiNode **newTable = (SFLDsiNode **)sflAlloc(agent, newSize * sizeof(SFLDsiNode *));
+  uint32_t ii;
+  memset(newTable, 0, newSize * sizeof(SFLDsiNode *));
+  for(ii = 0; ii < idx->hashSize; ii++) {
+    SFLDsiNode *node = idx->hashTable[ii];
+    while(node) {
+      SFLDsiNode *nextNode = node->hash_nxt;
+      uint32_t bucket = sfl_dsi_hash(&node->dsi) & (newSize - 1);
+      node->hash_nxt = newTable[bucket];
+      newTable[bucket] = node;
+      node = nextNode;
+    }
+  }
+  if(idx->hashTable) sflFree(agent, idx->hashTable);
+  idx->hashTable = newTable;
+  idx->hashSize = newSize;
+}
+
+static SFLDsiNode *sfl_dsiIndexGet(SFLDsiIndex *idx, SFLDataSource_instance *pdsi) {
+  SFLDsiNode *node;
+  if(idx->hashSize == 0) return NULL;
+  for(node = idx->hashTable[sfl_dsi_hash(pdsi) & (idx->hashSize - 1)]; node; node = node->hash_nxt)
+    if(sfl_dsi_compare(pdsi, &node->dsi) == 0) return node;
+  return NULL;
+}
+
+/* Find the forward-pointer arrays that lead to pdsi at each level, and
+   return the node that it follows in sort order (NULL for the head) */
+static SFLDsiNode *sfl_dsiIndexSearch(SFLDsiIndex *idx, SFLDataSource_instance *pdsi, SFLDsiNode ***update) {
+  SFLDsiNode *prev = NULL;
+  SFLDsiNode **fwd = idx->head;
+  int lvl;
+  for(lvl = (int)idx->levels - 1; lvl >= 0; lvl--) {
+    while(fwd[lvl] && sfl_dsi_compare(pdsi, &fwd[lvl]->dsi) > 0) {
+      prev = fwd[lvl];
+      fwd = prev->fwd;
+    }
+    update[lvl] = fwd;
+  }
+  return prev;
+}
+
+/* Add obj, which must not be in the index already.  Returns the object
+   that it should follow in the nxt list, or NULL if it goes first. */
+static void *sfl_dsiIndexAdd(SFLAgent *agent, SFLDsiIndex *idx, SFLDataSource_instance *pdsi, void *obj) {
+  SFLDsiNode **update[SFL_DSI_INDEX_LEVELS];
+  SFLDsiNode *prev, *node;
+  uint32_t lvl, levels, bucket;
+
+  if(idx->entries >= idx->hashSize) sfl_dsiIndexGrow(agent, idx);
+  prev = sfl_dsiIndexSearch(idx, pdsi, update);
+  levels = sfl_dsiIndexRandomLevel(idx);
+  for(lvl = idx->levels; lvl < levels; lvl++) update[lvl] = idx->head;
+  if(levels > idx->levels) idx->levels = levels;
+
+  node = (SFLDsiNode *)sflAlloc(agent, sizeof(SFLDsiNode) + (levels * sizeof(SFLDsiNode *)));
+  memset(node, 0, sizeof(SFLDsiNode) + (levels * sizeof(SFLDsiNode *)));
+  node->dsi = *pdsi; /* structure copy */
+  node->obj = obj;
+  node->levels = levels;
+  for(lvl = 0; lvl < levels; lvl++) {
+    node->fwd[lvl] = update[lvl][lvl];
+    update[lvl][lvl] = node;
+  }
+  bucket = sfl_dsi_hash(pdsi) & (idx->hashSize - 1);
+  node->hash_nxt = idx->hashTable[bucket];
+  idx->hashTable[bucket] = node;
+  idx->entries++;
+  return prev ? prev->obj : NULL;
+}
+
+/* Remove pdsi. Returns the object, or NULL if it was not found. The
+   object that preceded it in the nxt list is returned in *pPrev. */
+static void *sfl_dsiIndexRemove(SFLAgent *agent, SFLDsiIndex *idx, SFLDataSource_instance *pdsi, void **pPrev) {
+  SFLDsiNode **update[SFL_DSI_INDEX_LEVELS];
+  SFLDsiNode *prev, *node, **hp;
+  uint32_t lvl;
+  void *obj;
+
+  *pPrev = NULL;
+  if((node = sfl_dsiIndexGet(idx, pdsi)) == NULL) return NULL;
+  prev = sfl_dsiIndexSearch(idx, pdsi, update);
+  for(lvl = 0; lvl < node->levels; lvl++)
+    if(update[lvl][lvl] == node) update[lvl][lvl] = node->fwd[lvl];
+  while(idx->levels > 0 && idx->head[idx->levels - 1] == NULL) idx->levels--;
+  for(hp = &idx->hashTable[sfl_dsi_hash(pdsi) & (idx->hashSize - 1)]; *hp; hp = &(*hp)->hash_nxt) {
+    if(*hp == node) {
+      *hp = node->hash_nxt;
+      break;
+    }
+  }
+  idx->entries--;
+  obj = node->obj;
+  sflFree(agent, node);
+  *pPrev = prev ? prev->obj : NULL;
+  return obj;
+}
+
+static void sfl_dsiIndexRelease(SFLAgent *agent, SFLDsiIndex *idx) {
+  SFLDsiNode *node = idx->head[0];
+  while(node) {
+    SFLDsiNode *nextNode = node->fwd[0];
+    sflFree(agent, node);
+    node = nextNode;
+  }
+  if(idx->hashTable) sflFree(agent, idx->hashTable);
+  memset(idx, 0, sizeof(*idx));
+}
+
 /*_________________---------------------------__________________
   _________________   sfl_agent_addSampler    __________________
   -----------------___________________________------------------
@@ -211,22 +510,22 @@ static int sfl_dsi_compare(SFLDataSource_instance *pdsi1, SFLDataSource_instance
 
 SFLSampler *sfl_agent_addSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLSampler *newsm, *prev, *sm, *test;
+  SFLSampler *newsm, *prev, *test;
 
-  prev = NULL;
-  sm = agent->samplers;
-  // keep the list sorted
-  for(; sm != NULL; prev = sm, sm = sm->nxt) {
-    int64_t cmp = sfl_dsi_compare(pdsi, &sm->dsi);
-    if(cmp == 0) return sm;  // found - return existing one
-    if(cmp < 0) break;       // insert here
-  }
-  // either we found the insert point, or reached the end of the list...
+  if((newsm = sfl_agent_getSampler(agent, pdsi)) != NULL)
+    return newsm; // found - return existing one
   newsm = (SFLSampler *)sflAlloc(agent, sizeof(SFLSampler));
   sfl_sampler_init(newsm, agent, pdsi);
-  if(prev) prev->nxt = newsm;
-  else agent->samplers = newsm;
-  newsm->nxt = sm;
+  // keep the list sorted
+  prev = (SFLSampler *)sfl_dsiIndexAdd(agent, &agent->samplerIndex, pdsi, newsm);
+  if(prev) {
+    newsm->nxt = prev->nxt;
+    prev->nxt = newsm;
+  }
+  else {
+    newsm->nxt = agent->samplers;
+    agent->samplers = newsm;
+  }
 
   // see if we should go in the ifIndex jumpTable
   if(SFL_DS_CLASS(newsm->dsi) == 0) {
@@ -251,21 +550,22 @@ SFLPoller *sfl_agent_addPoller(SFLAgent *agent,
 			       void *magic,         /* ptr to pass back in getCountersFn() */
 			       getCountersFn_t getCountersFn)
 {
-  SFLPoller *newpl;
+  SFLPoller *newpl, *prev;
 
-  // keep the list sorted
-  SFLPoller *prev = NULL, *pl = agent->pollers;
-  for(; pl != NULL; prev = pl, pl = pl->nxt) {
-    int64_t cmp = sfl_dsi_compare(pdsi, &pl->dsi);
-    if(cmp == 0) return pl;  // found - return existing one
-    if(cmp < 0) break;       // insert here
-  }
-  // either we found the insert point, or reached the end of the list...
+  if((newpl = sfl_agent_getPoller(agent, pdsi)) != NULL)
+    return newpl; // found - return existing one
   newpl = (SFLPoller *)sflAlloc(agent, sizeof(SFLPoller));
   sfl_poller_init(newpl, agent, pdsi, magic, getCountersFn);
-  if(prev) prev->nxt = newpl;
-  else agent->pollers = newpl;
-  newpl->nxt = pl;
+  // keep the list sorted
+  prev = (SFLPoller *)sfl_dsiIndexAdd(agent, &agent->pollerIndex, pdsi, newpl);
+  if(prev) {
+    newpl->nxt = prev->nxt;
+    prev->nxt = newpl;
+  }
+  else {
+    newpl->nxt = agent->pollers;
+    agent->pollers = newpl;
+  }
   return newpl;
 }
 
@@ -276,21 +576,22 @@ SFLPoller *sfl_agent_addPoller(SFLAgent *agent,
 
 SFLNotifier *sfl_agent_addNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLNotifier *newnf;
+  SFLNotifier *newnf, *prev;
 
-  // keep the list sorted
-  SFLNotifier *prev = NULL, *nf = agent->notifiers;
-  for(; nf != NULL; prev = nf, nf = nf->nxt) {
-    int64_t cmp = sfl_dsi_compare(pdsi, &nf->dsi);
-    if(cmp == 0) return nf;  // found - return existing one
-    if(cmp < 0) break;       // insert here
-  }
-  // either we found the insert point, or reached the end of the list...
+  if((newnf = sfl_agent_getNotifier(agent, pdsi)) != NULL)
+    return newnf; // found - return existing one
   newnf = (SFLNotifier *)sflAlloc(agent, sizeof(SFLNotifier));
   sfl_notifier_init(newnf, agent, pdsi);
-  if(prev) prev->nxt = newnf;
-  else agent->notifiers = newnf;
-  newnf->nxt = nf;
+  // keep the list sorted
+  prev = (SFLNotifier *)sfl_dsiIndexAdd(agent, &agent->notifierIndex, pdsi, newnf);
+  if(prev) {
+    newnf->nxt = prev->nxt;
+    prev->nxt = newnf;
+  }
+  else {
+    newnf->nxt = agent->notifiers;
+    agent->notifiers = newnf;
+  }
   return newnf;
 }
 
@@ -304,17 +605,13 @@ int sfl_agent_removeSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
   SFLSampler *prev, *sm;
 
   /* find it, unlink it and free it */
-  for(prev = NULL, sm = agent->samplers; sm != NULL; prev = sm, sm = sm->nxt) {
-    if(sfl_dsi_compare(pdsi, &sm->dsi) == 0) {
-      if(prev == NULL) agent->samplers = sm->nxt;
-      else prev->nxt = sm->nxt;
-      sfl_agent_jumpTableRemove(agent, sm);
-      sflFree(agent, sm);
-      return 1;
-    }
-  }
-  /* not found */
-  return 0;
+  sm = (SFLSampler *)sfl_dsiIndexRemove(agent, &agent->samplerIndex, pdsi, (void **)&prev);
+  if(sm == NULL) return 0; /* not found */
+  if(prev == NULL) agent->samplers = sm->nxt;
+  else prev->nxt = sm->nxt;
+  sfl_agent_jumpTableRemove(agent, sm);
+  sflFree(agent, sm);
+  return 1;
 }
 
 /*_________________---------------------------__________________
@@ -325,17 +622,15 @@ int sfl_agent_removeSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 int sfl_agent_removePoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
   SFLPoller *prev, *pl;
+
   /* find it, unlink it and free it */
-  for(prev = NULL, pl = agent->pollers; pl != NULL; prev = pl, pl = pl->nxt) {
-    if(sfl_dsi_compare(pdsi, &pl->dsi) == 0) {
-      if(prev == NULL) agent->pollers = pl->nxt;
-      else prev->nxt = pl->nxt;
-      sflFree(agent, pl);
-      return 1;
-    }
-  }
-  /* not found */
-  return 0;
+  pl = (SFLPoller *)sfl_dsiIndexRemove(agent, &agent->pollerIndex, pdsi, (void **)&prev);
+  if(pl == NULL) return 0; /* not found */
+  if(prev == NULL) agent->pollers = pl->nxt;
+  else prev->nxt = pl->nxt;
+  sfl_agent_unschedulePoller(agent, pl);
+  sflFree(agent, pl);
+  return 1;
 }
 
 /*_________________---------------------------__________________
@@ -346,17 +641,14 @@ int sfl_agent_removePoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
 int sfl_agent_removeNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
   SFLNotifier *prev, *nf;
+
   /* find it, unlink it and free it */
-  for(prev = NULL, nf = agent->notifiers; nf != NULL; prev = nf, nf = nf->nxt) {
-    if(sfl_dsi_compare(pdsi, &nf->dsi) == 0) {
-      if(prev == NULL) agent->notifiers = nf->nxt;
-      else prev->nxt = nf->nxt;
-      sflFree(agent, nf);
-      return 1;
-    }
-  }
-  /* not found */
-  return 0;
+  nf = (SFLNotifier *)sfl_dsiIndexRemove(agent, &agent->notifierIndex, pdsi, (void **)&prev);
+  if(nf == NULL) return 0; /* not found */
+  if(prev == NULL) agent->notifiers = nf->nxt;
+  else prev->nxt = nf->nxt;
+  sflFree(agent, nf);
+  return 1;
 }
 
 /*_________________--------------------------------__________________
@@ -364,11 +656,35 @@ int sfl_agent_removeNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
   -----------------________________________________------------------
 */
 
+static void sfl_agent_jumpTableGrow(SFLAgent *agent)
+{
+  uint32_t newSize = agent->jumpTableSize ? (agent->jumpTableSize * 2) : SFL_JUMPTABLE_MINSIZ;
+  SFLSampler **newTable = (SFLSampler **)sflAlloc(agent, newSize * sizeof(SFLSampler *));
+  uint32_t ii;
+  memset(newTable, 0, newSize * sizeof(SFLSampler *));
+  for(ii = 0; ii < agent->jumpTableSize; ii++) {
+    SFLSampler *sm = agent->jumpTable[ii];
+    while(sm) {
+      SFLSampler *nextSm = sm->hash_nxt;
+      uint32_t hashIndex = SFL_DS_INDEX(sm->dsi) & (newSize - 1);
+      sm->hash_nxt = newTable[hashIndex];
+      newTable[hashIndex] = sm;
+      sm = nextSm;
+    }
+  }
+  if(agent->jumpTable) sflFree(agent, agent->jumpTable);
+  agent->jumpTable = newTable;
+  agent->jumpTableSize = newSize;
+}
+
 static void sfl_agent_jumpTableAdd(SFLAgent *agent, SFLSampler *sampler)
 {
-  uint32_t hashIndex = SFL_DS_INDEX(sampler->dsi) % SFL_HASHTABLE_SIZ;
+  uint32_t hashIndex;
+  if(agent->jumpTableEntries >= agent->jumpTableSize) sfl_agent_jumpTableGrow(agent);
+  hashIndex = SFL_DS_INDEX(sampler->dsi) & (agent->jumpTableSize - 1);
   sampler->hash_nxt = agent->jumpTable[hashIndex];
   agent->jumpTable[hashIndex] = sampler;
+  agent->jumpTableEntries++;
 }
 
 /*_________________--------------------------------__________________
@@ -378,14 +694,18 @@ static void sfl_agent_jumpTableAdd(SFLAgent *agent, SFLSampler *sampler)
 
 static void sfl_agent_jumpTableRemove(SFLAgent *agent, SFLSampler *sampler)
 {
-  uint32_t hashIndex = SFL_DS_INDEX(sampler->dsi) % SFL_HASHTABLE_SIZ;
-  SFLSampler *search = agent->jumpTable[hashIndex], *prev = NULL;
+  uint32_t hashIndex;
+  SFLSampler *search, *prev = NULL;
+  if(agent->jumpTableSize == 0) return;
+  hashIndex = SFL_DS_INDEX(sampler->dsi) & (agent->jumpTableSize - 1);
+  search = agent->jumpTable[hashIndex];
   for( ; search != NULL; prev = search, search = search->hash_nxt) if(search == sampler) break;
   if(search) {
     // found - unlink
     if(prev) prev->hash_nxt = search->hash_nxt;
     else agent->jumpTable[hashIndex] = search->hash_nxt;
     search->hash_nxt = NULL;
+    agent->jumpTableEntries--;
   }
 }
 
@@ -403,7 +723,9 @@ static void sfl_agent_jumpTableRemove(SFLAgent *agent, SFLSampler *sampler)
 
 SFLSampler *sfl_agent_getSamplerByIfIndex(SFLAgent *agent, uint32_t ifIndex)
 {
-  SFLSampler *search = agent->jumpTable[ifIndex % SFL_HASHTABLE_SIZ];
+  SFLSampler *search;
+  if(agent->jumpTableSize == 0) return NULL;
+  search = agent->jumpTable[ifIndex & (agent->jumpTableSize - 1)];
   for( ; search != NULL; search = search->hash_nxt) if(SFL_DS_INDEX(search->dsi) == ifIndex) break;
   return search;
 }
@@ -415,13 +737,8 @@ SFLSampler *sfl_agent_getSamplerByIfIndex(SFLAgent *agent, uint32_t ifIndex)
 
 SFLSampler *sfl_agent_getSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLSampler *sm;
-
-  /* find it and return it */
-  for( sm = agent->samplers; sm != NULL; sm = sm->nxt)
-    if(sfl_dsi_compare(pdsi, &sm->dsi) == 0) return sm;
-  /* not found */
-  return NULL;
+  SFLDsiNode *node = sfl_dsiIndexGet(&agent->samplerIndex, pdsi);
+  return node ? (SFLSampler *)node->obj : NULL;
 }
 
 /*_________________---------------------------__________________
@@ -431,13 +748,8 @@ SFLSampler *sfl_agent_getSampler(SFLAgent *agent, SFLDataSource_instance *pdsi)
 
 SFLPoller *sfl_agent_getPoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLPoller *pl;
-
-  /* find it and return it */
-  for( pl = agent->pollers; pl != NULL; pl = pl->nxt)
-    if(sfl_dsi_compare(pdsi, &pl->dsi) == 0) return pl;
-  /* not found */
-  return NULL;
+  SFLDsiNode *node = sfl_dsiIndexGet(&agent->pollerIndex, pdsi);
+  return node ? (SFLPoller *)node->obj : NULL;
 }
 
 /*_________________---------------------------__________________
@@ -447,13 +759,8 @@ SFLPoller *sfl_agent_getPoller(SFLAgent *agent, SFLDataSource_instance *pdsi)
 
 SFLNotifier *sfl_agent_getNotifier(SFLAgent *agent, SFLDataSource_instance *pdsi)
 {
-  SFLNotifier *nf;
-
-  /* find it and return it */
-  for( nf = agent->notifiers; nf != NULL; nf = nf->nxt)
-    if(sfl_dsi_compare(pdsi, &nf->dsi) == 0) return nf;
-  /* not found */
-  return NULL;
+  SFLDsiNode *node = sfl_dsiIndexGet(&agent->notifierIndex, pdsi);
+  return node ? (SFLNotifier *)node->obj : NULL;
 }
 
 /*_________________---------------------------__________________
@@ -92,6 +92,7 @@ typedef struct _SFLDataSource_instance {
 typedef struct _SFLSampleCollector {
   uint32_t data[SFL_SAMPLECOLLECTOR_DATA_QUADS];
   uint32_t *datap; /* packet fill pointer */
+  int overflow; /* set if a write was refused at the end of the buffer */
   uint32_t pktlen; /* accumulated size */
   uint32_t packetSeqNo;
   uint32_t numSamples;
@@ -165,8 +166,15 @@ typedef struct _SFLPoller {
   getCountersFn_t getCountersFn;
   /* private fields */
   SFLReceiver *myReceiver;
-  time_t countersCountdown;
+  time_t countersCountdown;  /* only valid when not on the agent's timer wheel */
   uint32_t countersSampleSeqNo;
+  /* for the agent's timer wheel */
+  struct _SFLPoller *wheel_nxt;
+  struct _SFLPoller **wheel_pprev; /* NULL when not scheduled */
+  uint32_t dueTick;
+  uint8_t wheelLevel;
+  uint8_t pinned;   /* countdown was aligned on purpose - never defer */
+  uint8_t deferred; /* already pushed back once this cycle */
   /* optional alias datasource index */
   uint32_t ds_alias;
 } SFLPoller;
@@ -209,11 +217,59 @@ typedef struct _SFLNotifier {
   uint32_t ds_alias;
 } SFLNotifier;
 
-/* prime numbers are good for hash tables */
-#define SFL_HASHTABLE_SIZ 199
+/* Index of samplers, pollers or notifiers by data-source instance.
+   The hash table finds an entry directly.  The skiplist keeps the
+   entries in the same order as the agent's nxt list, so that the
+   place to link in a new one (or unlink an old one) can be found
+   in O(log N) instead of walking the list. */
+#define SFL_DSI_INDEX_LEVELS 24
+#define SFL_DSI_INDEX_MINSIZ 64   /* power of 2 */
+
+typedef struct _SFLDsiNode {
+  SFLDataSource_instance dsi;
+  void *obj;                       /* SFLSampler, SFLPoller or SFLNotifier */
+  struct _SFLDsiNode *hash_nxt;
+  uint32_t levels;
+  struct _SFLDsiNode *fwd[0];      /* skiplist forward pointers [levels] */
+} SFLDsiNode;
+
+typedef struct _SFLDsiIndex {
+  SFLDsiNode **hashTable;
+  uint32_t hashSize;               /* power of 2, grows to keep load <= 1 */
+  uint32_t entries;
+  uint32_t levels;
+  uint32_t seed;
+  SFLDsiNode *head[SFL_DSI_INDEX_LEVELS];
+} SFLDsiIndex;
+
+#define SFL_JUMPTABLE_MINSIZ 256  /* power of 2 */
+
+/* Pollers are kept on a two-level timer wheel, so that each tick only
+   touches the pollers that are due.  Level 0 has one slot per tick for
+   the next 256 ticks, level 1 has one slot per 256 ticks for the next
+   64 of those, and anything further out waits on the "far" list. */
+#define SFL_WHEEL0_BITS 8
+#define SFL_WHEEL0_SLOTS (1 << SFL_WHEEL0_BITS)
+#define SFL_WHEEL1_BITS 6
+#define SFL_WHEEL1_SLOTS (1 << SFL_WHEEL1_BITS)
+
+typedef struct _SFLPollerWheel {
+  uint32_t tick;                    /* ticks so far */
+  uint32_t maxPollsPerTick;         /* 0 == random stagger, no limit */
+  uint32_t load0[SFL_WHEEL0_SLOTS]; /* pollers due in each level 0 slot */
+  SFLPoller *slot0[SFL_WHEEL0_SLOTS];
+  SFLPoller *slot1[SFL_WHEEL1_SLOTS];
+  SFLPoller *far;
+} SFLPollerWheel;
 
 typedef struct _SFLAgent {
-  SFLSampler *jumpTable[SFL_HASHTABLE_SIZ]; /* fast lookup table for samplers (by ifIndex) */
+  SFLSampler **jumpTable; /* fast lookup table for samplers (by ifIndex) */
+  uint32_t jumpTableSize; /* power of 2, grows with the number of entries */
+  uint32_t jumpTableEntries;
+  SFLDsiIndex samplerIndex;
+  SFLDsiIndex pollerIndex;
+  SFLDsiIndex notifierIndex;
+  SFLPollerWheel pollerWheel;
   SFLSampler *samplers;   /* the list of samplers */
   SFLPoller  *pollers;    /* the list of samplers */
   SFLNotifier *notifiers; /* the list of notifiers */
@@ -316,6 +372,9 @@ void     sfl_poller_set_sFlowCpReceiver(SFLPoller *poller, uint32_t sFlowCpRecei
 uint32_t sfl_poller_get_sFlowCpInterval(SFLPoller *poller);
 void     sfl_poller_set_sFlowCpInterval(SFLPoller *poller, uint32_t sFlowCpInterval);
 void     sfl_poller_synchronize_polling(SFLPoller *poller, SFLPoller *master);
+/* ticks until the next counter poll (0 == not polling) */
+uint32_t sfl_poller_get_countersCountdown(SFLPoller *poller);
+void     sfl_poller_set_countersCountdown(SFLPoller *poller, uint32_t countdown);
 /* notifier */
 uint32_t sfl_notifier_get_sFlowEsReceiver(SFLNotifier *notifier);
 void sfl_notifier_set_sFlowEsReceiver(SFLNotifier *notifier, uint32_t sFlowEsReceiver);
@@ -347,6 +406,14 @@ uint32_t sfl_sampler_get_backoffThreshold(SFLSampler *sampler);
 /* call this once per second (N.B. not on interrupt stack i.e. not hard real-time) */
 void sfl_agent_tick(SFLAgent *agent, time_t now);
 
+/* or call this once per second to tick just the pollers. Returns the number that were due */
+uint32_t sfl_agent_tickPollers(SFLAgent *agent, time_t now);
+
+/* Spread pollers deterministically across their polling interval (each one is
+   started in the least busy second), and push unaligned pollers back a second
+   if more than maxPollsPerTick are due together. 0 == random start, no limit. */
+void sfl_agent_set_maxPollsPerTick(SFLAgent *agent, uint32_t maxPollsPerTick);
+
 /* call this to set more accurate "now" - e.g. to influence datagram timestamp */
 void sfl_agent_set_now(SFLAgent *agent, time_t now_S, time_t now_nS);
 
@@ -383,7 +450,10 @@ void sfl_notifier_init(SFLNotifier *notifier, SFLAgent *agent, SFLDataSource_ins
 
 
 void sfl_receiver_tick(SFLReceiver *receiver, time_t now);
-void sfl_poller_tick(SFLPoller *poller, time_t now);
+void sfl_poller_fire(SFLPoller *poller);
+void sfl_agent_schedulePoller(SFLAgent *agent, SFLPoller *poller, uint32_t countdown);
+void sfl_agent_unschedulePoller(SFLAgent *agent, SFLPoller *poller);
+uint32_t sfl_agent_staggerCountdown(SFLAgent *agent, uint32_t interval);
 void sfl_sampler_tick(SFLSampler *sampler, time_t now);
 void sfl_notifier_tick(SFLNotifier *notifier, time_t now);
 
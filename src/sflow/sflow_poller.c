@@ -29,7 +29,8 @@ void sfl_poller_init(SFLPoller *poller,
   /* clear everything */
   memset(poller, 0, sizeof(*poller));
   
-  /* restore the linked list ptr */
+  /* restore the linked list ptr.  (The timer-wheel links are not preserved,
+     so the poller must be off the wheel before we get here) */
   poller->nxt = nxtPtr;
   
   /* now copy in the parameters */
@@ -47,9 +48,26 @@ void sfl_poller_init(SFLPoller *poller,
 static void reset(SFLPoller *poller)
 {
   SFLDataSource_instance dsi = poller->dsi;
+  sfl_agent_unschedulePoller(poller->agent, poller);
   sfl_poller_init(poller, poller->agent, &dsi, poller->magic, poller->getCountersFn);
 }
 
+/*_________________---------------------------__________________
+  _________________       reschedule          __________________
+  -----------------___________________________------------------
+Only pollers that are actually due to send somewhere are kept on
+the agent's timer wheel.  Otherwise the countdown is just parked in
+countersCountdown until the receiver is set.
+*/
+
+static void reschedule(SFLPoller *poller, uint32_t countdown)
+{
+  sfl_agent_unschedulePoller(poller->agent, poller);
+  poller->countersCountdown = countdown;
+  if(countdown && poller->sFlowCpReceiver)
+    sfl_agent_schedulePoller(poller->agent, poller, countdown);
+}
+
 /*_________________---------------------------__________________
   _________________      MIB access           __________________
   -----------------___________________________------------------
@@ -64,6 +82,7 @@ void sfl_poller_set_sFlowCpReceiver(SFLPoller *poller, uint32_t sFlowCpReceiver)
   else {
     /* retrieve and cache a direct pointer to my receiver */
     poller->myReceiver = sfl_agent_getReceiver(poller->agent, poller->sFlowCpReceiver);
+    reschedule(poller, sfl_poller_get_countersCountdown(poller));
   }
 }
 
@@ -72,21 +91,42 @@ uint32_t sfl_poller_get_sFlowCpInterval(SFLPoller *poller) {
 }
 
 void sfl_poller_set_sFlowCpInterval(SFLPoller *poller, uint32_t sFlowCpInterval) {
+  uint32_t countdown = 0;
   poller->sFlowCpInterval = sFlowCpInterval;
-  /* Set the countersCountdown to be a randomly selected value between 1 and
-     sFlowCpInterval. That way the counter polling would be desynchronised
-     (on a 200-port switch, polling all the counters in one second could be harmful). */
-  poller->countersCountdown = sFlowCpInterval ? sfl_random(sFlowCpInterval) : 0;
+  poller->pinned = 0;
+  /* Set the countersCountdown to be a value between 1 and sFlowCpInterval. That
+     way the counter polling would be desynchronised (on a 200-port switch, polling
+     all the counters in one second could be harmful).  The value is chosen at random
+     unless the agent has been asked to stagger the pollers deterministically. */
+  if(sFlowCpInterval) {
+    countdown = poller->agent->pollerWheel.maxPollsPerTick
+      ? sfl_agent_staggerCountdown(poller->agent, sFlowCpInterval)
+      : sfl_random(sFlowCpInterval);
+  }
+  reschedule(poller, countdown);
 }
 
 void sfl_poller_synchronize_polling(SFLPoller *poller, SFLPoller *master) {
   /* This can be used if there is a reason to make pollers report at about the same
      time,  such as if they are in a LAG relationship */
-  if(master->countersCountdown) {
-    poller->countersCountdown = master->countersCountdown;
+  uint32_t countdown = sfl_poller_get_countersCountdown(master);
+  if(countdown) {
+    reschedule(poller, countdown);
+    poller->pinned = master->pinned = 1;
   }
 }
 
+uint32_t sfl_poller_get_countersCountdown(SFLPoller *poller) {
+  if(poller->wheel_pprev)
+    return poller->dueTick - poller->agent->pollerWheel.tick;
+  return (uint32_t)poller->countersCountdown;
+}
+
+void sfl_poller_set_countersCountdown(SFLPoller *poller, uint32_t countdown) {
+  reschedule(poller, countdown);
+  poller->pinned = 1;
+}
+
 /*_________________---------------------------------__________________
   _________________   sequence number reset         __________________
   -----------------_________________________________------------------
@@ -103,27 +143,25 @@ Used where we want to export a remapped namespace for datasource index
 void sfl_poller_set_dsAlias(SFLPoller *poller, uint32_t ds_alias) { poller->ds_alias = ds_alias; }
 
 /*_________________---------------------------__________________
-  _________________    sfl_poller_tick        __________________
+  _________________    sfl_poller_fire        __________________
   -----------------___________________________------------------
+Called by the agent when the countdown expires (the poller has
+already been taken off the timer wheel).
 */
 
-void sfl_poller_tick(SFLPoller *poller, time_t now)
+void sfl_poller_fire(SFLPoller *poller)
 {
-  if(poller->countersCountdown == 0) return; /* counters retrieval was not enabled */
-  if(poller->sFlowCpReceiver == 0) return;
-
-  if(--poller->countersCountdown == 0) {
-    if(poller->getCountersFn != NULL) {
-      /* call out for counters */
-      SFL_COUNTERS_SAMPLE_TYPE cs;
-      memset(&cs, 0, sizeof(cs));
-      poller->getCountersFn(poller->magic, poller, &cs);
-      // this countersFn is expected to fill in some counter block elements
-      // and then call sfl_poller_writeCountersSample(poller, &cs);
-    }
-    /* reset the countdown */
-    poller->countersCountdown = poller->sFlowCpInterval;
+  poller->deferred = 0;
+  if(poller->getCountersFn != NULL) {
+    /* call out for counters */
+    SFL_COUNTERS_SAMPLE_TYPE cs;
+    memset(&cs, 0, sizeof(cs));
+    poller->getCountersFn(poller->magic, poller, &cs);
+    // this countersFn is expected to fill in some counter block elements
+    // and then call sfl_poller_writeCountersSample(poller, &cs);
   }
+  /* reset the countdown */
+  reschedule(poller, (uint32_t)poller->sFlowCpInterval);
 }
 
 /*_________________---------------------------------__________________
@@ -8,6 +8,7 @@ extern "C" {
 #endif
 
 #include <assert.h>
+#include <stddef.h>
 #include "sflow_api.h"
 
 static void resetSampleCollector(SFLReceiver *receiver);
@@ -160,34 +161,50 @@ void sfl_receiver_tick(SFLReceiver *receiver, time_t now)
 /*_________________-----------------------------__________________
   _________________   receiver write utilities  __________________
   -----------------_____________________________------------------
+  Samples are encoded in a single pass, straight into the buffer.
+  Every write is checked against the end of the buffer first.  If it
+  would run off the end it is refused and the overflow flag is set,
+  so that writeSample() can wind the sample back.
 */
- 
-static void put32(SFLReceiver *receiver, uint32_t val)
+
+static int sflReserve(SFLReceiver *receiver, uint32_t quads)
 {
-  *receiver->sampleCollector.datap++ = val;
+  SFLSampleCollector *sc = &receiver->sampleCollector;
+  if((sc->datap + quads) > (sc->data + SFL_SAMPLECOLLECTOR_DATA_QUADS)) {
+    sc->overflow = 1;
+    return 0;
+  }
+  return 1;
 }
 
-static void putNet32(SFLReceiver *receiver, uint32_t val)
+static void put32(SFLReceiver *receiver, uint32_t val)
 {
-  *receiver->sampleCollector.datap++ = htonl(val);
+  if(sflReserve(receiver, 1))
+    *receiver->sampleCollector.datap++ = val;
 }
 
-static void putNetFloat(SFLReceiver *receiver, float val)
+static void putNet32(SFLReceiver *receiver, uint32_t val)
 {
-  // not sure how to byte-swap a float - just alias it to an int32
-  uint32_t reg32;
-  memcpy(&reg32, &val, 4);
-  putNet32(receiver, reg32);
+  if(sflReserve(receiver, 1))
+    *receiver->sampleCollector.datap++ = htonl(val);
 }
 
 static void putNet32_run(SFLReceiver *receiver, void *obj, size_t quads)
 {
   uint32_t *from = (uint32_t *)obj;
-  while(quads--) putNet32(receiver, *from++);
+  uint32_t *to = receiver->sampleCollector.datap;
+  size_t ii;
+  if(sflReserve(receiver, quads)) {
+    // plain indexed loop so the compiler can vectorize the byte-swap
+    for(ii = 0; ii < quads; ii++) to[ii] = htonl(from[ii]);
+    receiver->sampleCollector.datap += quads;
+  }
 }
 
 static void putNet64(SFLReceiver *receiver, uint64_t val64)
 {
+  if(!sflReserve(receiver, 2))
+    return;
   uint32_t *firstQuadPtr = receiver->sampleCollector.datap;
   // first copy the bytes in
   memcpy((u_char *)firstQuadPtr, &val64, 8);
@@ -202,20 +219,25 @@ static void putNet64(SFLReceiver *receiver, uint64_t val64)
 
 static void put128(SFLReceiver *receiver, u_char *val)
 {
-  memcpy(receiver->sampleCollector.datap, val, 16);
-  receiver->sampleCollector.datap += 4;
+  if(sflReserve(receiver, 4)) {
+    memcpy(receiver->sampleCollector.datap, val, 16);
+    receiver->sampleCollector.datap += 4;
+  }
 }
 
-static void putString(SFLReceiver *receiver, SFLString *s)
+static void putOpaque(SFLReceiver *receiver, void *bytes, uint32_t len)
 {
-  putNet32(receiver, s->len);
-  memcpy(receiver->sampleCollector.datap, s->str, s->len);
-  receiver->sampleCollector.datap += (s->len + 3) / 4; /* pad to 4-byte boundary */
+  uint32_t quads = (len + 3) / 4; /* pad to 4-byte boundary */
+  if(sflReserve(receiver, quads)) {
+    memcpy(receiver->sampleCollector.datap, bytes, len);
+    receiver->sampleCollector.datap += quads;
+  }
 }
 
-static uint32_t stringEncodingLength(SFLString *s) {
-  // answer in bytes,  so remember to mulitply by 4 after rounding up to nearest 4-byte boundary
-  return 4 + (((s->len + 3) / 4) * 4);
+static void putString(SFLReceiver *receiver, SFLString *s)
+{
+  putNet32(receiver, s->len);
+  putOpaque(receiver, s->str, s->len);
 }
 
 static void putAddress(SFLReceiver *receiver, SFLAddress *addr)
@@ -232,14 +254,349 @@ static void putAddress(SFLReceiver *receiver, SFLAddress *addr)
   }
 }
 
-static uint32_t addressEncodingLength(SFLAddress *addr) {
-  return (addr->type == SFLADDRESSTYPE_IP_V6) ? 20 : 8;  // type + address (unspecified == IPV4)
+static void putMACAddress(SFLReceiver *receiver, uint8_t *mac)
+{
+  if(sflReserve(receiver, 2)) {
+    memcpy(receiver->sampleCollector.datap, mac, 6);
+    receiver->sampleCollector.datap += 2;
+  }
+}
+
+/* Reserve a quad for a length (or count) that is not known until
+   after the data that follows it has been written. */
+
+static uint32_t *putLengthPlaceholder(SFLReceiver *receiver)
+{
+  uint32_t *lenp = receiver->sampleCollector.datap;
+  putNet32(receiver, 0);
+  return lenp;
 }
 
-static void putMACAddress(SFLReceiver *receiver, uint8_t *mac)
+static uint32_t backPatchLength(SFLReceiver *receiver, uint32_t *lenp)
+{
+  // bytes written since the placeholder
+  uint32_t len = (uint32_t)((u_char *)receiver->sampleCollector.datap - (u_char *)(lenp + 1));
+  if(!receiver->sampleCollector.overflow)
+    *lenp = htonl(len);
+  return len;
+}
+
+/*_________________-----------------------------__________________
+  _________________   counter block layouts     __________________
+  -----------------_____________________________------------------
+  The fixed-size counter structs are described by tables of
+  {offset, size} - one entry per field, in XDR order - so that
+  putNetFields() can encode a whole block with one loop, keeping
+  the write pointer in a register.  Field sizes are taken from the
+  struct, so they must be 4 (uint32_t or float) or 8 (uint64_t).
+  Blocks that lead with a MAC or string write that part first.
+*/
+
+typedef struct _SFLXDRField {
+  uint16_t offset;
+  uint16_t size;
+} SFLXDRField;
+
+typedef struct _SFLXDRLayout {
+  uint32_t nFields;
+  const SFLXDRField *fields;
+} SFLXDRLayout;
+
+#define SFLXDR_FIELD(type, field) { offsetof(type, field), sizeof(((type *)0)->field) }
+#define SFLXDR_LAYOUT(nm, flds) static const SFLXDRLayout nm = { sizeof(flds) / sizeof(flds[0]), flds }
+
+static const SFLXDRField ifCountersFields[] = {
+  SFLXDR_FIELD(SFLIf_counters, ifIndex),
+  SFLXDR_FIELD(SFLIf_counters, ifType),
+  SFLXDR_FIELD(SFLIf_counters, ifSpeed),
+  SFLXDR_FIELD(SFLIf_counters, ifDirection),
+  SFLXDR_FIELD(SFLIf_counters, ifStatus),
+  SFLXDR_FIELD(SFLIf_counters, ifInOctets),
+  SFLXDR_FIELD(SFLIf_counters, ifInUcastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifInMulticastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifInBroadcastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifInDiscards),
+  SFLXDR_FIELD(SFLIf_counters, ifInErrors),
+  SFLXDR_FIELD(SFLIf_counters, ifInUnknownProtos),
+  SFLXDR_FIELD(SFLIf_counters, ifOutOctets),
+  SFLXDR_FIELD(SFLIf_counters, ifOutUcastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifOutMulticastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifOutBroadcastPkts),
+  SFLXDR_FIELD(SFLIf_counters, ifOutDiscards),
+  SFLXDR_FIELD(SFLIf_counters, ifOutErrors),
+  SFLXDR_FIELD(SFLIf_counters, ifPromiscuousMode)
+};
+SFLXDR_LAYOUT(ifCountersLayout, ifCountersFields);
+
+static const SFLXDRField vgCountersFields[] = {
+  SFLXDR_FIELD(SFLVg_counters, dot12InHighPriorityFrames),
+  SFLXDR_FIELD(SFLVg_counters, dot12InHighPriorityOctets),
+  SFLXDR_FIELD(SFLVg_counters, dot12InNormPriorityFrames),
+  SFLXDR_FIELD(SFLVg_counters, dot12InNormPriorityOctets),
+  SFLXDR_FIELD(SFLVg_counters, dot12InIPMErrors),
+  SFLXDR_FIELD(SFLVg_counters, dot12InOversizeFrameErrors),
+  SFLXDR_FIELD(SFLVg_counters, dot12InDataErrors),
+  SFLXDR_FIELD(SFLVg_counters, dot12InNullAddressedFrames),
+  SFLXDR_FIELD(SFLVg_counters, dot12OutHighPriorityFrames),
+  SFLXDR_FIELD(SFLVg_counters, dot12OutHighPriorityOctets),
+  SFLXDR_FIELD(SFLVg_counters, dot12TransitionIntoTrainings),
+  SFLXDR_FIELD(SFLVg_counters, dot12HCInHighPriorityOctets),
+  SFLXDR_FIELD(SFLVg_counters, dot12HCInNormPriorityOctets),
+  SFLXDR_FIELD(SFLVg_counters, dot12HCOutHighPriorityOctets)
+};
+SFLXDR_LAYOUT(vgCountersLayout, vgCountersFields);
+
+static const SFLXDRField vlanCountersFields[] = {
+  SFLXDR_FIELD(SFLVlan_counters, vlan_id),
+  SFLXDR_FIELD(SFLVlan_counters, octets),
+  SFLXDR_FIELD(SFLVlan_counters, ucastPkts),
+  SFLXDR_FIELD(SFLVlan_counters, multicastPkts),
+  SFLXDR_FIELD(SFLVlan_counters, broadcastPkts),
+  SFLXDR_FIELD(SFLVlan_counters, discards)
+};
+SFLXDR_LAYOUT(vlanCountersLayout, vlanCountersFields);
+
+static const SFLXDRField lacpCountersFields[] = {
+  SFLXDR_FIELD(SFLLACP_counters, attachedAggID),
+  SFLXDR_FIELD(SFLLACP_counters, portState.all),
+  SFLXDR_FIELD(SFLLACP_counters, LACPDUsRx),
+  SFLXDR_FIELD(SFLLACP_counters, markerPDUsRx),
+  SFLXDR_FIELD(SFLLACP_counters, markerResponsePDUsRx),
+  SFLXDR_FIELD(SFLLACP_counters, unknownRx),
+  SFLXDR_FIELD(SFLLACP_counters, illegalRx),
+  SFLXDR_FIELD(SFLLACP_counters, LACPDUsTx),
+  SFLXDR_FIELD(SFLLACP_counters, markerPDUsTx),
+  SFLXDR_FIELD(SFLLACP_counters, markerResponsePDUsTx)
+};
+SFLXDR_LAYOUT(lacpCountersLayout, lacpCountersFields);
+
+static const SFLXDRField processorCountersFields[] = {
+  SFLXDR_FIELD(SFLProcessor_counters, five_sec_cpu),
+  SFLXDR_FIELD(SFLProcessor_counters, one_min_cpu),
+  SFLXDR_FIELD(SFLProcessor_counters, five_min_cpu),
+  SFLXDR_FIELD(SFLProcessor_counters, total_memory),
+  SFLXDR_FIELD(SFLProcessor_counters, free_memory)
+};
+SFLXDR_LAYOUT(processorCountersLayout, processorCountersFields);
+
+static const SFLXDRField hostParFields[] = {
+  SFLXDR_FIELD(SFLHost_par_counters, dsClass),
+  SFLXDR_FIELD(SFLHost_par_counters, dsIndex)
+};
+SFLXDR_LAYOUT(hostParLayout, hostParFields);
+
+static const SFLXDRField hostCpuFields[] = {
+  SFLXDR_FIELD(SFLHost_cpu_counters, load_one),
+  SFLXDR_FIELD(SFLHost_cpu_counters, load_five),
+  SFLXDR_FIELD(SFLHost_cpu_counters, load_fifteen),
+  SFLXDR_FIELD(SFLHost_cpu_counters, proc_run),
+  SFLXDR_FIELD(SFLHost_cpu_counters, proc_total),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_num),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_speed),
+  SFLXDR_FIELD(SFLHost_cpu_counters, uptime),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_user),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_nice),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_system),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_idle),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_wio),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_intr),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_sintr),
+  SFLXDR_FIELD(SFLHost_cpu_counters, interrupts),
+  SFLXDR_FIELD(SFLHost_cpu_counters, contexts),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_steal),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_guest),
+  SFLXDR_FIELD(SFLHost_cpu_counters, cpu_guest_nice)
+};
+SFLXDR_LAYOUT(hostCpuLayout, hostCpuFields);
+
+static const SFLXDRField hostMemFields[] = {
+  SFLXDR_FIELD(SFLHost_mem_counters, mem_total),
+  SFLXDR_FIELD(SFLHost_mem_counters, mem_free),
+  SFLXDR_FIELD(SFLHost_mem_counters, mem_shared),
+  SFLXDR_FIELD(SFLHost_mem_counters, mem_buffers),
+  SFLXDR_FIELD(SFLHost_mem_counters, mem_cached),
+  SFLXDR_FIELD(SFLHost_mem_counters, swap_total),
+  SFLXDR_FIELD(SFLHost_mem_counters, swap_free),
+  SFLXDR_FIELD(SFLHost_mem_counters, page_in),
+  SFLXDR_FIELD(SFLHost_mem_counters, page_out),
+  SFLXDR_FIELD(SFLHost_mem_counters, swap_in),
+  SFLXDR_FIELD(SFLHost_mem_counters, swap_out)
+};
+SFLXDR_LAYOUT(hostMemLayout, hostMemFields);
+
+static const SFLXDRField hostDskFields[] = {
+  SFLXDR_FIELD(SFLHost_dsk_counters, disk_total),
+  SFLXDR_FIELD(SFLHost_dsk_counters, disk_free),
+  SFLXDR_FIELD(SFLHost_dsk_counters, part_max_used),
+  SFLXDR_FIELD(SFLHost_dsk_counters, reads),
+  SFLXDR_FIELD(SFLHost_dsk_counters, bytes_read),
+  SFLXDR_FIELD(SFLHost_dsk_counters, read_time),
+  SFLXDR_FIELD(SFLHost_dsk_counters, writes),
+  SFLXDR_FIELD(SFLHost_dsk_counters, bytes_written),
+  SFLXDR_FIELD(SFLHost_dsk_counters, write_time)
+};
+SFLXDR_LAYOUT(hostDskLayout, hostDskFields);
+
+static const SFLXDRField hostNioFields[] = {
+  SFLXDR_FIELD(SFLHost_nio_counters, bytes_in),
+  SFLXDR_FIELD(SFLHost_nio_counters, pkts_in),
+  SFLXDR_FIELD(SFLHost_nio_counters, errs_in),
+  SFLXDR_FIELD(SFLHost_nio_counters, drops_in),
+  SFLXDR_FIELD(SFLHost_nio_counters, bytes_out),
+  SFLXDR_FIELD(SFLHost_nio_counters, pkts_out),
+  SFLXDR_FIELD(SFLHost_nio_counters, errs_out),
+  SFLXDR_FIELD(SFLHost_nio_counters, drops_out)
+};
+SFLXDR_LAYOUT(hostNioLayout, hostNioFields);
+
+static const SFLXDRField hostVrtNodeFields[] = {
+  SFLXDR_FIELD(SFLHost_vrt_node_counters, mhz),
+  SFLXDR_FIELD(SFLHost_vrt_node_counters, cpus),
+  SFLXDR_FIELD(SFLHost_vrt_node_counters, memory),
+  SFLXDR_FIELD(SFLHost_vrt_node_counters, memory_free),
+  SFLXDR_FIELD(SFLHost_vrt_node_counters, num_domains)
+};
+SFLXDR_LAYOUT(hostVrtNodeLayout, hostVrtNodeFields);
+
+static const SFLXDRField hostVrtCpuFields[] = {
+  SFLXDR_FIELD(SFLHost_vrt_cpu_counters, state),
+  SFLXDR_FIELD(SFLHost_vrt_cpu_counters, cpuTime),
+  SFLXDR_FIELD(SFLHost_vrt_cpu_counters, nrVirtCpu)
+};
+SFLXDR_LAYOUT(hostVrtCpuLayout, hostVrtCpuFields);
+
+static const SFLXDRField hostVrtMemFields[] = {
+  SFLXDR_FIELD(SFLHost_vrt_mem_counters, memory),
+  SFLXDR_FIELD(SFLHost_vrt_mem_counters, maxMemory)
+};
+SFLXDR_LAYOUT(hostVrtMemLayout, hostVrtMemFields);
+
+static const SFLXDRField hostVrtDskFields[] = {
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, capacity),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, allocation),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, available),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, rd_req),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, rd_bytes),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, wr_req),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, wr_bytes),
+  SFLXDR_FIELD(SFLHost_vrt_dsk_counters, errs)
+};
+SFLXDR_LAYOUT(hostVrtDskLayout, hostVrtDskFields);
+
+static const SFLXDRField hostVrtNioFields[] = {
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, bytes_in),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, pkts_in),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, errs_in),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, drops_in),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, bytes_out),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, pkts_out),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, errs_out),
+  SFLXDR_FIELD(SFLHost_vrt_nio_counters, drops_out)
+};
+SFLXDR_LAYOUT(hostVrtNioLayout, hostVrtNioFields);
+
+static const SFLXDRField hostGpuNvmlFields[] = {
+  SFLXDR_FIELD(SFLHost_gpu_nvml, device_count),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, processes),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, gpu_time),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, mem_time),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, mem_total),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, mem_free),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, ecc_errors),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, energy),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, temperature),
+  SFLXDR_FIELD(SFLHost_gpu_nvml, fan_speed)
+};
+SFLXDR_LAYOUT(hostGpuNvmlLayout, hostGpuNvmlFields);
+
+static const SFLXDRField appCountersFields[] = {
+  SFLXDR_FIELD(SFLAPPCounters, status_OK),
+  SFLXDR_FIELD(SFLAPPCounters, errors_OTHER),
+  SFLXDR_FIELD(SFLAPPCounters, errors_TIMEOUT),
+  SFLXDR_FIELD(SFLAPPCounters, errors_INTERNAL_ERROR),
+  SFLXDR_FIELD(SFLAPPCounters, errors_BAD_REQUEST),
+  SFLXDR_FIELD(SFLAPPCounters, errors_FORBIDDEN),
+  SFLXDR_FIELD(SFLAPPCounters, errors_TOO_LARGE),
+  SFLXDR_FIELD(SFLAPPCounters, errors_NOT_IMPLEMENTED),
+  SFLXDR_FIELD(SFLAPPCounters, errors_NOT_FOUND),
+  SFLXDR_FIELD(SFLAPPCounters, errors_UNAVAILABLE),
+  SFLXDR_FIELD(SFLAPPCounters, errors_UNAUTHORIZED)
+};
+SFLXDR_LAYOUT(appCountersLayout, appCountersFields);
+
+static const SFLXDRField appResourcesFields[] = {
+  SFLXDR_FIELD(SFLAPPResources, user_time),
+  SFLXDR_FIELD(SFLAPPResources, system_time),
+  SFLXDR_FIELD(SFLAPPResources, mem_used),
+  SFLXDR_FIELD(SFLAPPResources, mem_max),
+  SFLXDR_FIELD(SFLAPPResources, fd_open),
+  SFLXDR_FIELD(SFLAPPResources, fd_max),
+  SFLXDR_FIELD(SFLAPPResources, conn_open),
+  SFLXDR_FIELD(SFLAPPResources, conn_max)
+};
+SFLXDR_LAYOUT(appResourcesLayout, appResourcesFields);
+
+static const SFLXDRField appWorkersFields[] = {
+  SFLXDR_FIELD(SFLAPPWorkers, workers_active),
+  SFLXDR_FIELD(SFLAPPWorkers, workers_idle),
+  SFLXDR_FIELD(SFLAPPWorkers, workers_max),
+  SFLXDR_FIELD(SFLAPPWorkers, req_delayed),
+  SFLXDR_FIELD(SFLAPPWorkers, req_dropped)
+};
+SFLXDR_LAYOUT(appWorkersLayout, appWorkersFields);
+
+static const SFLXDRField sfpFields[] = {
+  SFLXDR_FIELD(SFLSFP_counters, module_id),
+  SFLXDR_FIELD(SFLSFP_counters, module_total_lanes),
+  SFLXDR_FIELD(SFLSFP_counters, module_supply_voltage),
+  SFLXDR_FIELD(SFLSFP_counters, module_temperature),
+  SFLXDR_FIELD(SFLSFP_counters, num_lanes)
+};
+SFLXDR_LAYOUT(sfpLayout, sfpFields);
+
+static const SFLXDRField sfpLaneFields[] = {
+  SFLXDR_FIELD(SFLLane, lane_index),
+  SFLXDR_FIELD(SFLLane, tx_bias_current),
+  SFLXDR_FIELD(SFLLane, tx_power),
+  SFLXDR_FIELD(SFLLane, tx_power_min),
+  SFLXDR_FIELD(SFLLane, tx_power_max),
+  SFLXDR_FIELD(SFLLane, tx_wavelength),
+  SFLXDR_FIELD(SFLLane, rx_power),
+  SFLXDR_FIELD(SFLLane, rx_power_min),
+  SFLXDR_FIELD(SFLLane, rx_power_max),
+  SFLXDR_FIELD(SFLLane, rx_wavelength)
+};
+SFLXDR_LAYOUT(sfpLaneLayout, sfpLaneFields);
+
+static void putNetFields(SFLReceiver *receiver, void *obj, const SFLXDRLayout *layout)
 {
-  memcpy(receiver->sampleCollector.datap, mac, 6);
-  receiver->sampleCollector.datap += 2;
+  SFLSampleCollector *sc = &receiver->sampleCollector;
+  uint32_t *to = sc->datap;
+  uint32_t *lim = sc->data + SFL_SAMPLECOLLECTOR_DATA_QUADS;
+  u_char *from = (u_char *)obj;
+  uint32_t ii;
+
+  for(ii = 0; ii < layout->nFields; ii++) {
+    const SFLXDRField *fld = &layout->fields[ii];
+    if(fld->size == 8) {
+      uint64_t val64;
+      if((to + 2) > lim) break;
+      memcpy(&val64, from + fld->offset, 8);
+      to[0] = htonl((uint32_t)(val64 >> 32));
+      to[1] = htonl((uint32_t)val64);
+      to += 2;
+    }
+    else {
+      uint32_t val32;
+      if((to + 1) > lim) break;
+      // floats are aliased to an int32 - same as putNetFloat()
+      memcpy(&val32, from + fld->offset, 4);
+      *to++ = htonl(val32);
+    }
+  }
+  if(ii < layout->nFields)
+    sc->overflow = 1;
+  sc->datap = to;
 }
 
 static void putSampledEthernet(SFLReceiver *receiver, SFLSampled_ethernet *ethernet)
@@ -289,10 +646,6 @@ static void putRouter(SFLReceiver *receiver, SFLExtended_router *router)
   putNet32(receiver, router->dst_mask);
 }
 
-static uint32_t routerEncodingLength(SFLExtended_router *router) {
-  return addressEncodingLength(&router->nexthop) + 8;
-}
-
 static void putGateway(SFLReceiver *receiver, SFLExtended_gateway *gw)
 {
   uint32_t seg;
@@ -312,30 +665,6 @@ static void putGateway(SFLReceiver *receiver, SFLExtended_gateway *gw)
   putNet32(receiver, gw->localpref);
 }
 
-static uint32_t gatewayEncodingLength(SFLExtended_gateway *gw) {
-  uint32_t seg, elemSiz;
-
-  elemSiz = addressEncodingLength(&gw->nexthop);
-  elemSiz += 16; // as, src_as, src_peer_as, dst_as_path_segments 
-  for(seg = 0; seg < gw->dst_as_path_segments; seg++) {
-    elemSiz += 8; // type, length 
-    elemSiz += 4 * gw->dst_as_path[seg].length; // set/seq bytes
-  }
-  elemSiz += 4; // communities_length
-  elemSiz += 4 * gw->communities_length; // communities
-  elemSiz += 4; // localpref
-  return elemSiz;
-}
-
-static uint32_t hostIdEncodingLength(SFLHost_hid_counters *hid) {
-  uint32_t elemSiz = stringEncodingLength(&hid->hostname);
-  elemSiz += 16; // uuid
-  elemSiz += 4; // machine
-  elemSiz += 4; // os
-  elemSiz += stringEncodingLength(&hid->os_release);
-  return elemSiz;
-}
-
 static void putUser(SFLReceiver *receiver, SFLExtended_user *user)
 {
   putNet32(receiver, user->src_charset);
@@ -344,13 +673,6 @@ static void putUser(SFLReceiver *receiver, SFLExtended_user *user)
   putString(receiver, &user->dst_user);
 }
 
-static uint32_t userEncodingLength(SFLExtended_user *user) {
-  return 4
-    + stringEncodingLength(&user->src_user)
-    + 4
-    + stringEncodingLength(&user->dst_user);
-}
-
 static void putUrl(SFLReceiver *receiver, SFLExtended_url *url)
 {
   putNet32(receiver, url->direction);
@@ -358,22 +680,12 @@ static void putUrl(SFLReceiver *receiver, SFLExtended_url *url)
   putString(receiver, &url->host);
 }
 
-static uint32_t urlEncodingLength(SFLExtended_url *url) {
-  return 4
-    + stringEncodingLength(&url->url)
-    + stringEncodingLength(&url->host);
-}
-
 static void putLabelStack(SFLReceiver *receiver, SFLLabelStack *labelStack)
 {
   putNet32(receiver, labelStack->depth);
   putNet32_run(receiver, labelStack->stack, labelStack->depth);
 }
 
-static uint32_t labelStackEncodingLength(SFLLabelStack *labelStack) {
-  return 4 + (4 * labelStack->depth);
-}
-
 static void putMpls(SFLReceiver *receiver, SFLExtended_mpls *mpls)
 {
   putAddress(receiver, &mpls->nextHop);
@@ -381,23 +693,12 @@ static void putMpls(SFLReceiver *receiver, SFLExtended_mpls *mpls)
   putLabelStack(receiver, &mpls->out_stack);
 }
 
-static uint32_t mplsEncodingLength(SFLExtended_mpls *mpls) {
-  return addressEncodingLength(&mpls->nextHop)
-    + labelStackEncodingLength(&mpls->in_stack)
-    + labelStackEncodingLength(&mpls->out_stack);
-}
-
 static void putNat(SFLReceiver *receiver, SFLExtended_nat *nat)
 {
   putAddress(receiver, &nat->src);
   putAddress(receiver, &nat->dst);
 }
 
-static uint32_t natEncodingLength(SFLExtended_nat *nat) {
-  return addressEncodingLength(&nat->src)
-    + addressEncodingLength(&nat->dst);
-}
-
 static void putMplsTunnel(SFLReceiver *receiver, SFLExtended_mpls_tunnel *tunnel)
 {
   putString(receiver, &tunnel->tunnel_lsp_name);
@@ -405,10 +706,6 @@ static void putMplsTunnel(SFLReceiver *receiver, SFLExtended_mpls_tunnel *tunnel
   putNet32(receiver, tunnel->tunnel_cos);
 }
 
-static uint32_t mplsTunnelEncodingLength(SFLExtended_mpls_tunnel *tunnel) {
-  return stringEncodingLength(&tunnel->tunnel_lsp_name) + 8;
-}
-
 static void putMplsVc(SFLReceiver *receiver, SFLExtended_mpls_vc *vc)
 {
   putString(receiver, &vc->vc_instance_name);
@@ -416,46 +713,22 @@ static void putMplsVc(SFLReceiver *receiver, SFLExtended_mpls_vc *vc)
   putNet32(receiver, vc->vc_label_cos);
 }
 
-static uint32_t mplsVcEncodingLength(SFLExtended_mpls_vc *vc) {
-  return stringEncodingLength( &vc->vc_instance_name) + 8;
-}
-
 static void putMplsFtn(SFLReceiver *receiver, SFLExtended_mpls_FTN *ftn)
 {
   putString(receiver, &ftn->mplsFTNDescr);
   putNet32(receiver, ftn->mplsFTNMask);
 }
 
-static uint32_t mplsFtnEncodingLength(SFLExtended_mpls_FTN *ftn) {
-  return stringEncodingLength( &ftn->mplsFTNDescr) + 4;
-}
-
 static void putMplsLdpFec(SFLReceiver *receiver, SFLExtended_mpls_LDP_FEC *ldpfec)
 {
   putNet32(receiver, ldpfec->mplsFecAddrPrefixLength);
 }
 
-static uint32_t mplsLdpFecEncodingLength(SFLExtended_mpls_LDP_FEC *ldpfec) {
-  return 4;
-}
-
-static uint32_t tunnelDecapEncodingLength(SFLExtended_decapsulate *decap) {
-  return 4;
-}
-
-static uint32_t tunnelVniEncodingLength(SFLExtended_vni *vni) {
-  return 4;
-}
-
 static void putVlanTunnel(SFLReceiver *receiver, SFLExtended_vlan_tunnel *vlanTunnel)
 {
   putLabelStack(receiver, &vlanTunnel->stack);
 }
 
-static uint32_t vlanTunnelEncodingLength(SFLExtended_vlan_tunnel *vlanTunnel) {
-  return labelStackEncodingLength(&vlanTunnel->stack);
-}
-
 static void putAdaptorList(SFLReceiver *receiver, SFLAdaptorList *adaptorList)
 {
   uint32_t i, j;
@@ -471,41 +744,9 @@ static void putAdaptorList(SFLReceiver *receiver, SFLAdaptorList *adaptorList)
   }
 }
 
-static uint32_t adaptorListEncodingLength(SFLAdaptorList *adaptorList)
-{
-  uint32_t i;
-  uint32_t len = 4; // number of adaptors
-
-  for(i = 0; i < adaptorList->num_adaptors; i++) {
-    SFLAdaptor *adaptor = adaptorList->adaptors[i];
-    len += 4; // ifIndex
-    len += 4; // number of MACs
-    len += (adaptor->num_macs * 8); // mac bytes
-  }
-  return len;
-}
-
 static void putGenericCounters(SFLReceiver *receiver, SFLIf_counters *counters)
 {
-  putNet32(receiver, counters->ifIndex);
-  putNet32(receiver, counters->ifType);
-  putNet64(receiver, counters->ifSpeed);
-  putNet32(receiver, counters->ifDirection);
-  putNet32(receiver, counters->ifStatus);
-  putNet64(receiver, counters->ifInOctets);
-  putNet32(receiver, counters->ifInUcastPkts);
-  putNet32(receiver, counters->ifInMulticastPkts);
-  putNet32(receiver, counters->ifInBroadcastPkts);
-  putNet32(receiver, counters->ifInDiscards);
-  putNet32(receiver, counters->ifInErrors);
-  putNet32(receiver, counters->ifInUnknownProtos);
-  putNet64(receiver, counters->ifOutOctets);
-  putNet32(receiver, counters->ifOutUcastPkts);
-  putNet32(receiver, counters->ifOutMulticastPkts);
-  putNet32(receiver, counters->ifOutBroadcastPkts);
-  putNet32(receiver, counters->ifOutDiscards);
-  putNet32(receiver, counters->ifOutErrors);
-  putNet32(receiver, counters->ifPromiscuousMode);
+  putNetFields(receiver, counters, &ifCountersLayout);
 }
 
 
@@ -516,14 +757,6 @@ static void putAPPContext(SFLReceiver *receiver, SFLSampled_APP_CTXT *ctxt)
   putString(receiver, &ctxt->attributes);
 }
 
-static uint32_t appContextLength(SFLSampled_APP_CTXT *ctxt) {
-  uint32_t elemSiz = 0;
-  elemSiz += stringEncodingLength(&ctxt->application);
-  elemSiz += stringEncodingLength(&ctxt->operation);
-  elemSiz += stringEncodingLength(&ctxt->attributes);
-  return elemSiz;
-}
-
 static void putAPP(SFLReceiver *receiver, SFLSampled_APP *app)
 {
   putAPPContext(receiver, &app->context);
@@ -534,16 +767,6 @@ static void putAPP(SFLReceiver *receiver, SFLSampled_APP *app)
   putNet32(receiver, app->status);
 }
 
-static uint32_t appEncodingLength(SFLSampled_APP *app) {
-  uint32_t elemSiz = 0;
-  elemSiz += appContextLength(&app->context);
-  elemSiz += stringEncodingLength(&app->status_descr);
-  elemSiz += 16; // req/resp bytes
-  elemSiz += 4; // duration_uS
-  elemSiz += 4; // status
-  return elemSiz;
-}
-
 static void putSocket4(SFLReceiver *receiver, SFLExtended_socket_ipv4 *socket4) {
     putNet32(receiver, socket4->protocol);
     put32(receiver, socket4->local_ip.addr);
@@ -582,147 +805,95 @@ static void putEntities(SFLReceiver *receiver, SFLExtended_entities *entities) {
     putNet32(receiver, entities->dst_dsIndex);
 }
 
-static uint32_t appCountersEncodingLength(SFLAPPCounters *appctrs) {
-  uint32_t elemSiz = 0;
-  elemSiz += stringEncodingLength(&appctrs->application);
-  elemSiz += 11 * 4; // success and 10 error counters
-  return elemSiz;
-}
-
-static uint32_t appResourcesEncodingLength(SFLAPPResources *appresource) {
-  uint32_t elemSiz = 0;
-  elemSiz += 6 * 4; // 6x32-bit
-  elemSiz += 2 * 8; // 2x64-bit (mem) gauges
-  return elemSiz;
-}
-
-static uint32_t appWorkersEncodingLength(SFLAPPWorkers *appworkers) {
-  uint32_t elemSiz = 0;
-  elemSiz += 5 * 4; // 5x32-bit
-  return elemSiz;
-}
-
-static uint32_t sfpEncodingLength(SFLSFP_counters *sfp) {
-  uint32_t elemSiz = 0;
-  elemSiz += 16; // id, total_lanes, voltage, temp
-  elemSiz += 4; // num_lanes
-  elemSiz += (sfp->num_lanes * XDRSIZ_LANE_COUNTERS);
-  return elemSiz;
-}
-
 static void putSFP(SFLReceiver *receiver, SFLSFP_counters *sfp) {
   uint32_t ii;
-  putNet32(receiver, sfp->module_id);
-  putNet32(receiver, sfp->module_total_lanes);
-  putNet32(receiver, sfp->module_supply_voltage);
-  putNet32(receiver, sfp->module_temperature);
-  putNet32(receiver, sfp->num_lanes);
-  for(ii = 0; ii < sfp->num_lanes; ii++) {
-    SFLLane *lane = &(sfp->lanes[ii]);
-    putNet32(receiver, lane->lane_index);
-    putNet32(receiver, lane->tx_bias_current);
-    putNet32(receiver, lane->tx_power);
-    putNet32(receiver, lane->tx_power_min);
-    putNet32(receiver, lane->tx_power_max);
-    putNet32(receiver, lane->tx_wavelength);
-    putNet32(receiver, lane->rx_power);
-    putNet32(receiver, lane->rx_power_min);
-    putNet32(receiver, lane->rx_power_max);
-    putNet32(receiver, lane->rx_wavelength);
-  }
+  putNetFields(receiver, sfp, &sfpLayout);
+  for(ii = 0; ii < sfp->num_lanes; ii++)
+    putNetFields(receiver, &sfp->lanes[ii], &sfpLaneLayout);
 }
  
    
-/*_________________-------------------------------------__________________
-  _________________      computeFlowSampleElementsSize  __________________
-  -----------------_____________________________________------------------
+/*_________________---------------------------__________________
+  _________________      writeSample          __________________
+  -----------------___________________________------------------
+  Encode one sample directly into the datagram, with the lengths
+  and element counts back-patched as we go.  The encoding may run
+  past the maximum datagram size into the pad area at the end of
+  the buffer.  If it does, the datagram is sent without it and the
+  sample is moved down to start the next one.  Only if the buffer
+  itself runs out is the sample wiped and encoded again (or, if it
+  is too big even for an empty datagram, dropped without disturbing
+  the samples already queued).
 */
 
-static int computeFlowSampleElementsSize(SFLReceiver *receiver, SFLFlow_sample_element *elements, uint32_t *nFound)
+typedef int (*SFLEncodeFn)(SFLReceiver *receiver, void *sample);
+
+static void rollbackSample(SFLReceiver *receiver, uint32_t *start)
 {
-  SFLFlow_sample_element *elem;
-  uint32_t elemSiz;
-  uint siz = 4; /* num_elements */
-  uint32_t num_elements = 0;
-  for(elem = elements; elem != NULL; elem = elem->nxt) {
-    num_elements++;
-    siz += 8; /* tag, length */
-    elemSiz = 0;
-    switch(elem->tag) {
-    case SFLFLOW_HEADER:
-      elemSiz = 16; /* header_protocol, frame_length, stripped, header_length */
-      elemSiz += ((elem->flowType.header.header_length + 3) / 4) * 4; /* header, rounded up to nearest 4 bytes */
-      break;
-    case SFLFLOW_ETHERNET: elemSiz = sizeof(SFLSampled_ethernet); break;
-    case SFLFLOW_IPV4: elemSiz = sizeof(SFLSampled_ipv4); break;
-    case SFLFLOW_IPV6: elemSiz = sizeof(SFLSampled_ipv6); break;
-    case SFLFLOW_EX_SWITCH: elemSiz = sizeof(SFLExtended_switch); break;
-    case SFLFLOW_EX_ROUTER: elemSiz = routerEncodingLength(&elem->flowType.router); break;
-    case SFLFLOW_EX_GATEWAY: elemSiz = gatewayEncodingLength(&elem->flowType.gateway); break;
-    case SFLFLOW_EX_USER: elemSiz = userEncodingLength(&elem->flowType.user); break;
-    case SFLFLOW_EX_URL: elemSiz = urlEncodingLength(&elem->flowType.url); break;
-    case SFLFLOW_EX_MPLS: elemSiz = mplsEncodingLength(&elem->flowType.mpls); break;
-    case SFLFLOW_EX_NAT: elemSiz = natEncodingLength(&elem->flowType.nat); break;
-    case SFLFLOW_EX_MPLS_TUNNEL: elemSiz = mplsTunnelEncodingLength(&elem->flowType.mpls_tunnel); break;
-    case SFLFLOW_EX_MPLS_VC: elemSiz = mplsVcEncodingLength(&elem->flowType.mpls_vc); break;
-    case SFLFLOW_EX_MPLS_FTN: elemSiz = mplsFtnEncodingLength(&elem->flowType.mpls_ftn); break;
-    case SFLFLOW_EX_MPLS_LDP_FEC: elemSiz = mplsLdpFecEncodingLength(&elem->flowType.mpls_ldp_fec); break;
-    case SFLFLOW_EX_VLAN_TUNNEL: elemSiz = vlanTunnelEncodingLength(&elem->flowType.vlan_tunnel); break;
-	case SFLFLOW_EX_L2_TUNNEL_EGRESS:
-	case SFLFLOW_EX_L2_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_l2_tunnel); break;
-	case SFLFLOW_EX_IPV4_TUNNEL_EGRESS:
-	case SFLFLOW_EX_IPV4_TUNNEL_INGRESS: elemSiz = sizeof(SFLExtended_ipv4_tunnel); break;
-	case SFLFLOW_EX_DECAP_EGRESS:
-	case SFLFLOW_EX_DECAP_INGRESS: elemSiz = tunnelDecapEncodingLength(&elem->flowType.tunnel_decap); break;
-	case SFLFLOW_EX_VNI_EGRESS:
-	case SFLFLOW_EX_VNI_INGRESS: elemSiz = tunnelVniEncodingLength(&elem->flowType.tunnel_vni); break;
-    case SFLFLOW_APP: elemSiz = appEncodingLength(&elem->flowType.app); break;
-    case SFLFLOW_APP_CTXT: elemSiz = appContextLength(&elem->flowType.context); break;
-    case SFLFLOW_APP_ACTOR_INIT:
-    case SFLFLOW_APP_ACTOR_TGT: elemSiz = stringEncodingLength(&elem->flowType.actor.actor); break;
-    case SFLFLOW_EX_PROXY_SOCKET4:
-    case SFLFLOW_EX_SOCKET4: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET4;  break;
-    case SFLFLOW_EX_PROXY_SOCKET6:
-    case SFLFLOW_EX_SOCKET6: elemSiz = XDRSIZ_SFLEXTENDED_SOCKET6;  break;
-    case SFLFLOW_EX_TCP_INFO: elemSiz = XDRSIZ_SFLEXTENDED_TCP_INFO;  break;
-    case SFLFLOW_EX_ENTITIES: elemSiz = XDRSIZ_SFLEXTENDED_ENTITIES; break;
-    case SFLFLOW_EX_EGRESS_Q: elemSiz = XDRSIZ_SFLEXTENDED_EGRESS_Q; break;
-    case SFLFLOW_EX_FUNCTION:  elemSiz = stringEncodingLength(&elem->flowType.function.symbol); break;
-    case SFLFLOW_EX_TRANSIT: elemSiz = XDRSIZ_SFLEXTENDED_TRANSIT; break;
-    case SFLFLOW_EX_Q_DEPTH: elemSiz = XDRSIZ_SFLEXTENDED_Q_DEPTH; break;
-	case SFLCOUNTERS_VNT_HYPERV: break;
-    default:
-      sflError(receiver, "unexpected packet_data_tag");
-      return -1;
-      break;
-    }
-    // cache the element size, and accumulate it into the overall FlowSample size
-    elem->length = elemSiz;
-    siz += elemSiz;
-  }
-  *nFound = num_elements;
-  return siz;
+  SFLSampleCollector *sc = &receiver->sampleCollector;
+  /* wipe what was written, so that pad bytes will still be zeros */
+  if(sc->datap > start)
+    memset(start, 0, (u_char *)sc->datap - (u_char *)start);
+  sc->datap = start;
+  sc->overflow = 0;
 }
-   
-/*_________________-----------------------------__________________
-  _________________      computeFlowSampleSize  __________________
-  -----------------_____________________________------------------
-*/
 
-static int computeFlowSampleSize(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs)
+static void commitSample(SFLReceiver *receiver)
 {
-#ifdef SFL_USE_32BIT_INDEX
-  int siz = 48; /* tag, length, sequence_number, ds_class, ds_index, sampling_rate,
-		   sample_pool, drops, inputFormat, input, outputFormat, output */
-#else
-  int siz = 36; /* tag, length, sequence_number, source_id, sampling_rate,
-		   sample_pool, drops, input, output */
-#endif
+  SFLSampleCollector *sc = &receiver->sampleCollector;
+  sc->numSamples++;
+  sc->pktlen = (uint32_t)((u_char *)sc->datap - (u_char *)sc->data);
+}
 
-  int elemListSiz = computeFlowSampleElementsSize(receiver, fs->elements, &fs->num_elements);
-  if(elemListSiz == -1)
-    return -1;
-  return siz + elemListSiz;
+static int writeSample(SFLReceiver *receiver, SFLEncodeFn encodeFn, void *sample, char *sampleType)
+{
+  SFLSampleCollector *sc = &receiver->sampleCollector;
+  uint32_t *start, *dst;
+  uint32_t packedSize, hdrSize;
+  int tries;
+
+  for(tries = 0; tries < 2; tries++) {
+    start = sc->datap;
+    if(encodeFn(receiver, sample) == -1) {
+      rollbackSample(receiver, start);
+      return -1;
+    }
+    packedSize = (uint32_t)((u_char *)sc->datap - (u_char *)start);
+    if(!sc->overflow) {
+      if((sc->pktlen + packedSize) <= receiver->sFlowRcvrMaximumDatagramSize) {
+	commitSample(receiver);
+	return (int)packedSize;
+      }
+      if(sc->numSamples > 0) {
+	/* send the datagram without this sample, then move it down */
+	sc->datap = start;
+	sendSample(receiver);
+	dst = sc->datap;
+	hdrSize = (uint32_t)((u_char *)dst - (u_char *)sc->data);
+	if((hdrSize + packedSize) <= receiver->sFlowRcvrMaximumDatagramSize) {
+	  memmove(dst, start, packedSize);
+	  memset((u_char *)dst + packedSize, 0, (u_char *)start - (u_char *)dst);
+	  sc->datap = (uint32_t *)((u_char *)dst + packedSize);
+	  commitSample(receiver);
+	  return (int)packedSize;
+	}
+	/* too big even for an empty datagram */
+	memset(start, 0, packedSize);
+	break;
+      }
+    }
+    rollbackSample(receiver, start);
+    if(sc->numSamples == 0)
+      break;
+    sendSample(receiver);
+  }
+
+  {
+    char errm[128];
+    sprintf(errm, "%s sample too big for datagram", sampleType);
+    sfl_agent_error(receiver->agent, "receiver", errm);
+  }
+  return -1;
 }
 
 /*_________________---------------------------------------__________________
@@ -738,7 +909,7 @@ static int sfl_receiver_writeFlowSampleElements(SFLReceiver *receiver, SFLFlow_s
   for(elem = elements; elem != NULL; elem = elem->nxt) {
     nFound++;
     putNet32(receiver, elem->tag);
-    putNet32(receiver, elem->length); // length cached in computeFlowSampleSize()
+    uint32_t *lenp = putLengthPlaceholder(receiver);
 
     switch(elem->tag) {
     case SFLFLOW_HEADER:
@@ -746,10 +917,8 @@ static int sfl_receiver_writeFlowSampleElements(SFLReceiver *receiver, SFLFlow_s
     putNet32(receiver, elem->flowType.header.frame_length);
     putNet32(receiver, elem->flowType.header.stripped);
     putNet32(receiver, elem->flowType.header.header_length);
-    /* the header */
-    memcpy(receiver->sampleCollector.datap, elem->flowType.header.header_bytes, elem->flowType.header.header_length);
-    /* round up to multiple of 4 to preserve alignment */
-    receiver->sampleCollector.datap += ((elem->flowType.header.header_length + 3) / 4);
+    /* the header, rounded up to multiple of 4 to preserve alignment */
+    putOpaque(receiver, elem->flowType.header.header_bytes, elem->flowType.header.header_length);
       break;
 	case SFLFLOW_ETHERNET: putSampledEthernet(receiver, &elem->flowType.ethernet); break;
 	case SFLFLOW_IPV4: putSampledIPv4(receiver, &elem->flowType.ipv4); break;
@@ -802,10 +971,15 @@ static int sfl_receiver_writeFlowSampleElements(SFLReceiver *receiver, SFLFlow_s
     case SFLFLOW_EX_Q_DEPTH: putNet32(receiver, elem->flowType.queue_depth.depth); break;
 	case SFLCOUNTERS_VNT_HYPERV: break;
     default:
-      sflError(receiver, "unexpected packet_data_tag");
-      return -1;
+      {
+	char errm[128];
+	sprintf(errm, "unexpected packet_data_tag (%u)", elem->tag);
+	sfl_agent_error(receiver->agent, "receiver", errm);
+	return -1;
+      }
       break;
     }
+    elem->length = backPatchLength(receiver, lenp);
   }
   return nFound;
 }
@@ -815,27 +989,9 @@ static int sfl_receiver_writeFlowSampleElements(SFLReceiver *receiver, SFLFlow_s
   -----------------_______________________________------------------
 */
 
-int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs)
+static int encodeFlowSample(SFLReceiver *receiver, void *sample)
 {
-  int packedSize;
-
-  if(fs == NULL) return -1;
-  if((packedSize = computeFlowSampleSize(receiver, fs)) == -1) return -1;
-
-  // check in case this one sample alone is too big for the datagram
-  // in fact - if it is even half as big then we should ditch it. Very
-  // important to avoid overruning the packet buffer.
-  if(packedSize > (int)(receiver->sFlowRcvrMaximumDatagramSize)) {
-    sflError(receiver, "flow sample too big for datagram");
-    return -1;
-  }
-
-  // if the sample pkt is full enough so that this sample might put
-  // it over the limit, then we should send it now before going on.
-  if((receiver->sampleCollector.pktlen + packedSize) >= receiver->sFlowRcvrMaximumDatagramSize)
-    sendSample(receiver);
-    
-  receiver->sampleCollector.numSamples++;
+  SFL_FLOW_SAMPLE_TYPE *fs = (SFL_FLOW_SAMPLE_TYPE *)sample;
 
 #ifdef SFL_USE_32BIT_INDEX
   putNet32(receiver, SFLFLOW_SAMPLE_EXPANDED);
@@ -843,7 +999,7 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
   putNet32(receiver, SFLFLOW_SAMPLE);
 #endif
 
-  putNet32(receiver, packedSize - 8); // don't include tag and len
+  uint32_t *lenp = putLengthPlaceholder(receiver);
   putNet32(receiver, fs->sequence_number);
 
 #ifdef SFL_USE_32BIT_INDEX
@@ -867,19 +1023,23 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
   putNet32(receiver, fs->output);
 #endif
 
-  putNet32(receiver, fs->num_elements);
+  uint32_t *nump = putLengthPlaceholder(receiver);
   int nFound = sfl_receiver_writeFlowSampleElements(receiver, fs->elements);
-  if(nFound != fs->num_elements) {
-    sflError(receiver, "flow sample #elements error");
-    abort();
-  }
-  
-  // sanity check
-  int dgramSize = ((u_char *)receiver->sampleCollector.datap - (u_char *)receiver->sampleCollector.data);
-  assert(dgramSize - receiver->sampleCollector.pktlen == packedSize);
+  if(nFound == -1)
+    return -1;
+  fs->num_elements = nFound;
+  if(!receiver->sampleCollector.overflow)
+    *nump = htonl(nFound);
+  backPatchLength(receiver, lenp);
+  return 0;
+}
 
-  // update the pktlen
-  receiver->sampleCollector.pktlen = (uint32_t)dgramSize;
+int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs)
+{
+  int packedSize;
+
+  if(fs == NULL) return -1;
+  if((packedSize = writeSample(receiver, encodeFlowSample, fs, "flow")) == -1) return -1;
 
   // if the sample pkt is full enough so that another packet-sample the same size would
   // put it over the size threshold, then just send it now.  After all,  if we waited and then
@@ -889,51 +1049,18 @@ int sfl_receiver_writeFlowSample(SFLReceiver *receiver, SFL_FLOW_SAMPLE_TYPE *fs
 
   return packedSize;
 }
-   
-/*_________________-----------------------------__________________
-  _________________      computeEventSampleSize  __________________
-  -----------------_____________________________------------------
-*/
-
-static int computeEventSampleSize(SFLReceiver *receiver, SFLEvent_discarded_packet *es)
-{
-  int siz = 36; /* tag, length, sequence_number, ds_class, ds_index,
-		   drops, input, output, reason */
-  int elemListSiz = computeFlowSampleElementsSize(receiver, es->elements, &es->num_elements);
-  if(elemListSiz == -1)
-    return -1;
-  return siz + elemListSiz;
-}
 
 /*_________________-------------------------------__________________
   _________________ sfl_receiver_writeEventSample __________________
   -----------------_______________________________------------------
 */
 
-int sfl_receiver_writeEventSample(SFLReceiver *receiver, SFLEvent_discarded_packet *es)
+static int encodeEventSample(SFLReceiver *receiver, void *sample)
 {
-  int packedSize;
-  
-  if(es == NULL) return -1;
-  if((packedSize = computeEventSampleSize(receiver, es)) == -1) return -1;
-
-  // check in case this one sample alone is too big for the datagram
-  // in fact - if it is even half as big then we should ditch it. Very
-  // important to avoid overruning the packet buffer.
-  if(packedSize > (int)(receiver->sFlowRcvrMaximumDatagramSize)) {
-    sflError(receiver, "flow sample too big for datagram");
-    return -1;
-  }
-
-  // if the sample pkt is full enough so that this sample might put
-  // it over the limit, then we should send it now before going on.
-  if((receiver->sampleCollector.pktlen + packedSize) >= receiver->sFlowRcvrMaximumDatagramSize)
-    sendSample(receiver);
-    
-  receiver->sampleCollector.numSamples++;
+  SFLEvent_discarded_packet *es = (SFLEvent_discarded_packet *)sample;
 
   putNet32(receiver, SFLEVENT_DISCARDED_PACKET);
-  putNet32(receiver, packedSize - 8); // don't include tag and len
+  uint32_t *lenp = putLengthPlaceholder(receiver);
   putNet32(receiver, es->sequence_number);
 
   putNet32(receiver, es->ds_class);
@@ -943,19 +1070,23 @@ int sfl_receiver_writeEventSample(SFLReceiver *receiver, SFLEvent_discarded_pack
   putNet32(receiver, es->output);
   putNet32(receiver, es->reason);
 
-  putNet32(receiver, es->num_elements);
+  uint32_t *nump = putLengthPlaceholder(receiver);
   int nFound = sfl_receiver_writeFlowSampleElements(receiver, es->elements);
-  if(nFound != es->num_elements) {
-    sflError(receiver, "event sample #elements error");
-    abort();
-  }
+  if(nFound == -1)
+    return -1;
+  es->num_elements = nFound;
+  if(!receiver->sampleCollector.overflow)
+    *nump = htonl(nFound);
+  backPatchLength(receiver, lenp);
+  return 0;
+}
 
-  // sanity check
-  int dgramSize = ((u_char *)receiver->sampleCollector.datap - (u_char *)receiver->sampleCollector.data);
-  assert(dgramSize - receiver->sampleCollector.pktlen == packedSize);
+int sfl_receiver_writeEventSample(SFLReceiver *receiver, SFLEvent_discarded_packet *es)
+{
+  int packedSize;
 
-  // update the pktlen
-  receiver->sampleCollector.pktlen = (uint32_t)dgramSize;
+  if(es == NULL) return -1;
+  if((packedSize = writeSample(receiver, encodeEventSample, es, "event")) == -1) return -1;
 
   // if the sample pkt is full enough so that another packet-sample the same size would
   // put it over the size threshold, then just send it now.  After all,  if we waited and then
@@ -966,113 +1097,23 @@ int sfl_receiver_writeEventSample(SFLReceiver *receiver, SFLEvent_discarded_pack
   return packedSize;
 }
 
-/*_________________-----------------------------__________________
-  _________________ computeCountersSampleSize   __________________
-  -----------------_____________________________------------------
-*/
-
-static int computeCountersSampleSize(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_TYPE *cs)
-{
-  SFLCounters_sample_element *elem;
-  uint32_t elemSiz;
-
-#ifdef SFL_USE_32BIT_INDEX
-  uint siz = 24; /* tag, length, sequence_number, ds_class, ds_index, number of elements */
-#else
-  uint32_t siz = 20; /* tag, length, sequence_number, source_id, number of elements */
-#endif
-
-  cs->num_elements = 0; /* we're going to count them again even if this was set by the client */
-  for( elem = cs->elements; elem != NULL; elem = elem->nxt) {
-    cs->num_elements++;
-    siz += 8; /* tag, length */
-    elemSiz = 0;
-    /* here we are assuming that the structure fields are not expanded to be 64-bit aligned,
-       because then the sizeof(struct) would be larger than the wire-encoding. */
-
-    switch(elem->tag) {
-    case SFLCOUNTERS_GENERIC:  elemSiz = sizeof(elem->counterBlock.generic); break;
-    case SFLCOUNTERS_ETHERNET: elemSiz = sizeof(elem->counterBlock.ethernet); break;
-    case SFLCOUNTERS_TOKENRING: elemSiz = sizeof(elem->counterBlock.tokenring); break;
-    case SFLCOUNTERS_VG: elemSiz = sizeof(elem->counterBlock.vg); break;
-    case SFLCOUNTERS_VLAN: elemSiz = sizeof(elem->counterBlock.vlan); break;
-    case SFLCOUNTERS_LACP: elemSiz = XDRSIZ_LACP_COUNTERS; break;
-    case SFLCOUNTERS_SFP: elemSiz = sfpEncodingLength(&elem->counterBlock.sfp); break;
-    case SFLCOUNTERS_PROCESSOR: elemSiz = sizeof(elem->counterBlock.processor);  break;
-    case SFLCOUNTERS_HOST_HID: elemSiz = hostIdEncodingLength(&elem->counterBlock.host_hid);  break;
-    case SFLCOUNTERS_HOST_PAR: elemSiz = 8 /*sizeof(elem->counterBlock.host_par)*/;  break;
-    case SFLCOUNTERS_ADAPTORS: elemSiz = adaptorListEncodingLength(elem->counterBlock.adaptors);  break;
-    case SFLCOUNTERS_HOST_CPU: elemSiz = 80 /*sizeof(elem->counterBlock.host_cpu)*/;  break;
-    case SFLCOUNTERS_HOST_MEM: elemSiz = 72 /*sizeof(elem->counterBlock.host_mem)*/ ;  break;
-    case SFLCOUNTERS_HOST_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_dsk)*/;  break;
-    case SFLCOUNTERS_HOST_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_nio)*/;  break;
-    case SFLCOUNTERS_HOST_IP: elemSiz = XDRSIZ_IP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_ICMP: elemSiz = XDRSIZ_ICMP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_TCP: elemSiz = XDRSIZ_TCP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_UDP: elemSiz = XDRSIZ_UDP_COUNTERS;  break;
-    case SFLCOUNTERS_HOST_VRT_NODE: elemSiz = 28 /*sizeof(elem->counterBlock.host_vrt_node)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_CPU: elemSiz = 12 /*sizeof(elem->counterBlock.host_vrt_cpu)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_MEM: elemSiz = 16 /*sizeof(elem->counterBlock.host_vrt_mem)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_DSK: elemSiz = 52 /*sizeof(elem->counterBlock.host_vrt_dsk)*/;  break;
-    case SFLCOUNTERS_HOST_VRT_NIO: elemSiz = 40 /*sizeof(elem->counterBlock.host_vrt_nio)*/;  break;
-    case SFLCOUNTERS_HOST_GPU_NVML: elemSiz = 48 /*sizeof(elem->counterBlock.host_gpu_nvml)*/;  break;
-    case SFLCOUNTERS_APP:  elemSiz = appCountersEncodingLength(&elem->counterBlock.app); break;
-    case SFLCOUNTERS_APP_RESOURCES:  elemSiz = appResourcesEncodingLength(&elem->counterBlock.appResources); break;
-    case SFLCOUNTERS_APP_WORKERS:  elemSiz = appWorkersEncodingLength(&elem->counterBlock.appWorkers); break;
-    case SFLCOUNTERS_PORTNAME:  elemSiz = stringEncodingLength(&elem->counterBlock.portName.portName); break;
-    case SFLCOUNTERS_BCM_TABLES: elemSiz = XDRSIZ_BCM_TABLES;  break;
-	case SFLCOUNTERS_VNT_HYPERV: elemSiz = 0; break;
-    default:
-      {
-	char errm[128];
-	sprintf(errm, "computeCounterSampleSize(): unexpected counters tag (%u)", elem->tag);
-	sflError(receiver, errm);
-	return -1;
-      }
-      break;
-    }
-    // cache the element size, and accumulate it into the overall FlowSample size
-    elem->length = elemSiz;
-    siz += elemSiz;
-  }
-  return siz;
-}
-
 /*_________________----------------------------------__________________
   _________________ sfl_receiver_writeCountersSample __________________
   -----------------__________________________________------------------
 */
 
-int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_TYPE *cs)
+static int encodeCountersSample(SFLReceiver *receiver, void *sample)
 {
-  int packedSize;
+  SFL_COUNTERS_SAMPLE_TYPE *cs = (SFL_COUNTERS_SAMPLE_TYPE *)sample;
   SFLCounters_sample_element *elem;
 
-  if(cs == NULL) return -1;
-  // if the sample pkt is full enough so that this sample might put
-  // it over the limit, then we should send it now.
-  if((packedSize = computeCountersSampleSize(receiver, cs)) == -1) return -1;
-  
-  // check in case this one sample alone is too big for the datagram
-  // in fact - if it is even half as big then we should ditch it. Very
-  // important to avoid overruning the packet buffer.
-  if(packedSize > (int)(receiver->sFlowRcvrMaximumDatagramSize)) {
-    sflError(receiver, "counters sample too big for datagram");
-    return -1;
-  }
-  
-  if((receiver->sampleCollector.pktlen + packedSize) >= receiver->sFlowRcvrMaximumDatagramSize)
-    sendSample(receiver);
-  
-  receiver->sampleCollector.numSamples++;
-  
 #ifdef SFL_USE_32BIT_INDEX
   putNet32(receiver, SFLCOUNTERS_SAMPLE_EXPANDED);
 #else
   putNet32(receiver, SFLCOUNTERS_SAMPLE);
 #endif
 
-  putNet32(receiver, packedSize - 8); // tag and length not included
+  uint32_t *lenp = putLengthPlaceholder(receiver);
   putNet32(receiver, cs->sequence_number);
 
 #ifdef SFL_USE_32BIT_INDEX
@@ -1082,12 +1123,13 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
   putNet32(receiver, cs->source_id);
 #endif
 
-  putNet32(receiver, cs->num_elements);
-  
+  uint32_t *nump = putLengthPlaceholder(receiver);
+  cs->num_elements = 0; /* we're going to count them again even if this was set by the client */
+
   for(elem = cs->elements; elem != NULL; elem = elem->nxt) {
-    
+    cs->num_elements++;
     putNet32(receiver, elem->tag);
-    putNet32(receiver, elem->length); // length cached in computeCountersSampleSize()
+    uint32_t *elemLenp = putLengthPlaceholder(receiver);
     
     switch(elem->tag) {
     case SFLCOUNTERS_GENERIC:
@@ -1102,52 +1144,21 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
       putNet32_run(receiver, &elem->counterBlock.tokenring, sizeof(elem->counterBlock.tokenring) / 4);
       break;
     case SFLCOUNTERS_VG:
-      putNet32(receiver, elem->counterBlock.vg.dot12InHighPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12InHighPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12InNormPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12InNormPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12InIPMErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InOversizeFrameErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InDataErrors);
-      putNet32(receiver, elem->counterBlock.vg.dot12InNullAddressedFrames);
-      putNet32(receiver, elem->counterBlock.vg.dot12OutHighPriorityFrames);
-      putNet64(receiver, elem->counterBlock.vg.dot12OutHighPriorityOctets);
-      putNet32(receiver, elem->counterBlock.vg.dot12TransitionIntoTrainings);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCInHighPriorityOctets);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCInNormPriorityOctets);
-      putNet64(receiver, elem->counterBlock.vg.dot12HCOutHighPriorityOctets);
+      putNetFields(receiver, &elem->counterBlock.vg, &vgCountersLayout);
       break;
     case SFLCOUNTERS_VLAN:
-      putNet32(receiver, elem->counterBlock.vlan.vlan_id);
-      putNet64(receiver, elem->counterBlock.vlan.octets);
-      putNet32(receiver, elem->counterBlock.vlan.ucastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.multicastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.broadcastPkts);
-      putNet32(receiver, elem->counterBlock.vlan.discards);
+      putNetFields(receiver, &elem->counterBlock.vlan, &vlanCountersLayout);
       break;
     case SFLCOUNTERS_LACP:
       putMACAddress(receiver, elem->counterBlock.lacp.actorSystemID);
       putMACAddress(receiver, elem->counterBlock.lacp.partnerSystemID);
-      putNet32(receiver, elem->counterBlock.lacp.attachedAggID);
-      putNet32(receiver, elem->counterBlock.lacp.portState.all);
-      putNet32(receiver, elem->counterBlock.lacp.LACPDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.markerPDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsRx);
-      putNet32(receiver, elem->counterBlock.lacp.unknownRx);
-      putNet32(receiver, elem->counterBlock.lacp.illegalRx);
-      putNet32(receiver, elem->counterBlock.lacp.LACPDUsTx);
-      putNet32(receiver, elem->counterBlock.lacp.markerPDUsTx);
-      putNet32(receiver, elem->counterBlock.lacp.markerResponsePDUsTx);
+      putNetFields(receiver, &elem->counterBlock.lacp, &lacpCountersLayout);
       break;
     case SFLCOUNTERS_SFP:
       putSFP(receiver, &elem->counterBlock.sfp);
       break;
     case SFLCOUNTERS_PROCESSOR:
-      putNet32(receiver, elem->counterBlock.processor.five_sec_cpu);
-      putNet32(receiver, elem->counterBlock.processor.one_min_cpu);
-      putNet32(receiver, elem->counterBlock.processor.five_min_cpu);
-      putNet64(receiver, elem->counterBlock.processor.total_memory);
-      putNet64(receiver, elem->counterBlock.processor.free_memory);
+      putNetFields(receiver, &elem->counterBlock.processor, &processorCountersLayout);
       break;
     case SFLCOUNTERS_HOST_HID:
       putString(receiver, &elem->counterBlock.host_hid.hostname);
@@ -1157,115 +1168,40 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
       putString(receiver, &elem->counterBlock.host_hid.os_release);
       break;
     case SFLCOUNTERS_HOST_PAR:
-      putNet32(receiver, elem->counterBlock.host_par.dsClass);
-      putNet32(receiver, elem->counterBlock.host_par.dsIndex);
+      putNetFields(receiver, &elem->counterBlock.host_par, &hostParLayout);
       break;
     case SFLCOUNTERS_ADAPTORS:
       putAdaptorList(receiver, elem->counterBlock.adaptors);
       break;
     case SFLCOUNTERS_HOST_CPU:
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_one);
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_five);
-      putNetFloat(receiver, elem->counterBlock.host_cpu.load_fifteen);
-      putNet32(receiver, elem->counterBlock.host_cpu.proc_run);
-      putNet32(receiver, elem->counterBlock.host_cpu.proc_total);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_num);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_speed);
-      putNet32(receiver, elem->counterBlock.host_cpu.uptime);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_user);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_nice);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_system);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_idle);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_wio);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_intr);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_sintr);
-      putNet32(receiver, elem->counterBlock.host_cpu.interrupts);
-      putNet32(receiver, elem->counterBlock.host_cpu.contexts);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_steal);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest);
-      putNet32(receiver, elem->counterBlock.host_cpu.cpu_guest_nice);
+      putNetFields(receiver, &elem->counterBlock.host_cpu, &hostCpuLayout);
       break;
     case SFLCOUNTERS_HOST_MEM:
-      putNet64(receiver, elem->counterBlock.host_mem.mem_total);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_free);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_shared);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_buffers);
-      putNet64(receiver, elem->counterBlock.host_mem.mem_cached);
-      putNet64(receiver, elem->counterBlock.host_mem.swap_total);
-      putNet64(receiver, elem->counterBlock.host_mem.swap_free);
-      putNet32(receiver, elem->counterBlock.host_mem.page_in);
-      putNet32(receiver, elem->counterBlock.host_mem.page_out);
-      putNet32(receiver, elem->counterBlock.host_mem.swap_in);
-      putNet32(receiver, elem->counterBlock.host_mem.swap_out);
+      putNetFields(receiver, &elem->counterBlock.host_mem, &hostMemLayout);
       break;
     case SFLCOUNTERS_HOST_DSK:
-      putNet64(receiver, elem->counterBlock.host_dsk.disk_total);
-      putNet64(receiver, elem->counterBlock.host_dsk.disk_free);
-      putNet32(receiver, elem->counterBlock.host_dsk.part_max_used);
-      putNet32(receiver, elem->counterBlock.host_dsk.reads);
-      putNet64(receiver, elem->counterBlock.host_dsk.bytes_read);
-      putNet32(receiver, elem->counterBlock.host_dsk.read_time);
-      putNet32(receiver, elem->counterBlock.host_dsk.writes);
-      putNet64(receiver, elem->counterBlock.host_dsk.bytes_written);
-      putNet32(receiver, elem->counterBlock.host_dsk.write_time);
+      putNetFields(receiver, &elem->counterBlock.host_dsk, &hostDskLayout);
       break;
     case SFLCOUNTERS_HOST_NIO:
-      putNet64(receiver, elem->counterBlock.host_nio.bytes_in);
-      putNet32(receiver, elem->counterBlock.host_nio.pkts_in);
-      putNet32(receiver, elem->counterBlock.host_nio.errs_in);
-      putNet32(receiver, elem->counterBlock.host_nio.drops_in);
-      putNet64(receiver, elem->counterBlock.host_nio.bytes_out);
-      putNet32(receiver, elem->counterBlock.host_nio.pkts_out);
-      putNet32(receiver, elem->counterBlock.host_nio.errs_out);
-      putNet32(receiver, elem->counterBlock.host_nio.drops_out);
+      putNetFields(receiver, &elem->counterBlock.host_nio, &hostNioLayout);
       break;
     case SFLCOUNTERS_HOST_VRT_NODE:
-      putNet32(receiver, elem->counterBlock.host_vrt_node.mhz);
-      putNet32(receiver, elem->counterBlock.host_vrt_node.cpus);
-      putNet64(receiver, elem->counterBlock.host_vrt_node.memory);
-      putNet64(receiver, elem->counterBlock.host_vrt_node.memory_free);
-      putNet32(receiver, elem->counterBlock.host_vrt_node.num_domains);
+      putNetFields(receiver, &elem->counterBlock.host_vrt_node, &hostVrtNodeLayout);
       break;
     case SFLCOUNTERS_HOST_VRT_CPU:
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.state);
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.cpuTime);
-      putNet32(receiver, elem->counterBlock.host_vrt_cpu.nrVirtCpu);
+      putNetFields(receiver, &elem->counterBlock.host_vrt_cpu, &hostVrtCpuLayout);
       break;
     case SFLCOUNTERS_HOST_VRT_MEM:
-      putNet64(receiver, elem->counterBlock.host_vrt_mem.memory);
-      putNet64(receiver, elem->counterBlock.host_vrt_mem.maxMemory);
+      putNetFields(receiver, &elem->counterBlock.host_vrt_mem, &hostVrtMemLayout);
       break;
     case SFLCOUNTERS_HOST_VRT_DSK:
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.capacity);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.allocation);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.available);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.rd_req);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.rd_bytes);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.wr_req);
-      putNet64(receiver, elem->counterBlock.host_vrt_dsk.wr_bytes);
-      putNet32(receiver, elem->counterBlock.host_vrt_dsk.errs);
+      putNetFields(receiver, &elem->counterBlock.host_vrt_dsk, &hostVrtDskLayout);
       break;
     case SFLCOUNTERS_HOST_VRT_NIO:
-      putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_in);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_in);
-      putNet64(receiver, elem->counterBlock.host_vrt_nio.bytes_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.pkts_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.errs_out);
-      putNet32(receiver, elem->counterBlock.host_vrt_nio.drops_out);
+      putNetFields(receiver, &elem->counterBlock.host_vrt_nio, &hostVrtNioLayout);
       break; 
     case SFLCOUNTERS_HOST_GPU_NVML:
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.device_count);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.processes);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.gpu_time);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.mem_time);
-      putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_total);
-      putNet64(receiver, elem->counterBlock.host_gpu_nvml.mem_free);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.ecc_errors);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.energy);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.temperature);
-      putNet32(receiver, elem->counterBlock.host_gpu_nvml.fan_speed);
+      putNetFields(receiver, &elem->counterBlock.host_gpu_nvml, &hostGpuNvmlLayout);
       break;
 
     case SFLCOUNTERS_HOST_IP:
@@ -1283,34 +1219,13 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
 
     case SFLCOUNTERS_APP:
       putString(receiver, &elem->counterBlock.app.application);
-      putNet32(receiver, elem->counterBlock.app.status_OK);
-      putNet32(receiver, elem->counterBlock.app.errors_OTHER);
-      putNet32(receiver, elem->counterBlock.app.errors_TIMEOUT);
-      putNet32(receiver, elem->counterBlock.app.errors_INTERNAL_ERROR);
-      putNet32(receiver, elem->counterBlock.app.errors_BAD_REQUEST);
-      putNet32(receiver, elem->counterBlock.app.errors_FORBIDDEN);
-      putNet32(receiver, elem->counterBlock.app.errors_TOO_LARGE);
-      putNet32(receiver, elem->counterBlock.app.errors_NOT_IMPLEMENTED);
-      putNet32(receiver, elem->counterBlock.app.errors_NOT_FOUND);
-      putNet32(receiver, elem->counterBlock.app.errors_UNAVAILABLE);
-      putNet32(receiver, elem->counterBlock.app.errors_UNAUTHORIZED);
+      putNetFields(receiver, &elem->counterBlock.app, &appCountersLayout);
       break; 
     case SFLCOUNTERS_APP_RESOURCES:
-      putNet32(receiver, elem->counterBlock.appResources.user_time);
-      putNet32(receiver, elem->counterBlock.appResources.system_time);
-      putNet64(receiver, elem->counterBlock.appResources.mem_used);
-      putNet64(receiver, elem->counterBlock.appResources.mem_max);
-      putNet32(receiver, elem->counterBlock.appResources.fd_open);
-      putNet32(receiver, elem->counterBlock.appResources.fd_max);
-      putNet32(receiver, elem->counterBlock.appResources.conn_open);
-      putNet32(receiver, elem->counterBlock.appResources.conn_max);
+      putNetFields(receiver, &elem->counterBlock.appResources, &appResourcesLayout);
       break;
     case SFLCOUNTERS_APP_WORKERS:
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_active);
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_idle);
-      putNet32(receiver, elem->counterBlock.appWorkers.workers_max);
-      putNet32(receiver, elem->counterBlock.appWorkers.req_delayed);
-      putNet32(receiver, elem->counterBlock.appWorkers.req_dropped);
+      putNetFields(receiver, &elem->counterBlock.appWorkers, &appWorkersLayout);
       break;
     case SFLCOUNTERS_PORTNAME: 
       putString(receiver, &elem->counterBlock.portName.portName);
@@ -1325,20 +1240,23 @@ int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_
       {
 	char errm[128];
 	sprintf(errm, "unexpected counters tag (%u)", elem->tag);
-	sflError(receiver, errm);
+	sfl_agent_error(receiver->agent, "receiver", errm);
 	return -1;
       }
       break;
     }
+    elem->length = backPatchLength(receiver, elemLenp);
   }
-  // sanity check
-  assert(((u_char *)receiver->sampleCollector.datap
-	  - (u_char *)receiver->sampleCollector.data
-	  - receiver->sampleCollector.pktlen)  == (uint32_t)packedSize);
+  if(!receiver->sampleCollector.overflow)
+    *nump = htonl(cs->num_elements);
+  backPatchLength(receiver, lenp);
+  return 0;
+}
 
-  // update the pktlen
-  receiver->sampleCollector.pktlen = (uint32_t)((u_char *)receiver->sampleCollector.datap - (u_char *)receiver->sampleCollector.data);
-  return packedSize;
+int sfl_receiver_writeCountersSample(SFLReceiver *receiver, SFL_COUNTERS_SAMPLE_TYPE *cs)
+{
+  if(cs == NULL) return -1;
+  return writeSample(receiver, encodeCountersSample, cs, "counters");
 }
 
 /*_________________-------------------------------__________________
@@ -1453,11 +1371,13 @@ static void sendSample(SFLReceiver *receiver)
 
 static void resetSampleCollector(SFLReceiver *receiver)
 {
+  /* clear the part of the buffer that was used (ensures that pad bytes will always be zeros - thank you CW).
+     Everything after pktlen is kept zeroed already, apart from a sample that writeSample() is carrying
+     over to the next datagram. */
+  memset((u_char *)receiver->sampleCollector.data, 0, receiver->sampleCollector.pktlen);
   receiver->sampleCollector.pktlen = 0;
   receiver->sampleCollector.numSamples = 0;
-
-  /* clear the buffer completely (ensures that pad bytes will always be zeros - thank you CW) */
-  memset((u_char *)receiver->sampleCollector.data, 0, (SFL_SAMPLECOLLECTOR_DATA_QUADS * 4));
+  receiver->sampleCollector.overflow = 0;
 
   /* point the datap to just after the header */
   receiver->sampleCollector.datap = (receiver->agent->myIP.type == SFLADDRESSTYPE_IP_V6) ?